@@ -0,0 +1,472 @@
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+#include "utils.h"
+#include "algebra.h"
+#include "input-parser.h"
+#include "binary-parser.h"
+#include "binary-writer.h"
+#include "mapped-file.h"
+#include "model-loader.h"
+#include "firing-spikes.h"
+#include "voltages.h"
+#include "weights.h"
+#include "offscreen-context.h"
+#include "profiler.h"
+#include "model-area.h"
+#include "viz-window.h"
+#include "batch-renderer.h"
+
+static bool ends_with(std::string const &s, std::string const &end) {
+	std::string si = s;
+	std::transform(si.begin(), si.end(), si.begin(), ::tolower);
+	if (si.length() < end.length()) { return false; }
+	return si.compare(si.length() - end.length(), end.length(), end) == 0;
+}
+
+// Returns the length of a filename without its extension
+static size_t stem_length(const std::string &f) {
+	size_t d = f.find_last_of('.');
+	size_t s = f.find_last_of("/\\");
+	if (d == std::string::npos || (s != std::string::npos && d < s)) { return f.length(); }
+	return d;
+}
+
+static bool parse_size(const char *s, int &v) {
+	char *end;
+	long n = strtol(s, &end, 10);
+	if (end == s || *end || n < 1 || n > 16384) { return false; }
+	v = (int)n;
+	return true;
+}
+
+static bool parse_cycle(const char *s, size32_t &v) {
+	char *end;
+	unsigned long n = strtoul(s, &end, 10);
+	if (end == s || *end || *s == '-') { return false; }
+	v = (size32_t)n;
+	return true;
+}
+
+// Parses a comma-separated list of the binary model sections to skip
+static bool parse_sections(const char *s, unsigned int &v) {
+	std::istringstream ss(s);
+	std::string n;
+	while (std::getline(ss, n, ',')) {
+		if (n == "fields") { v &= ~(unsigned int)Brain_Model::FIELDS_SECTION; }
+		else if (n == "synapses") { v &= ~(unsigned int)Brain_Model::SYNAPSES_SECTION; }
+		else if (n == "gap-junctions") { v &= ~(unsigned int)Brain_Model::GAP_JUNCTIONS_SECTION; }
+		else { return false; }
+	}
+	return true;
+}
+
+static bool report(Read_Status status, const std::string &f) {
+	if (status == SUCCESS) { return true; }
+	std::cerr << read_status_message(status, f.c_str()) << "\n";
+	return false;
+}
+
+// Reads simulation data from a text file, compressed or not
+template<class T>
+static bool read_text(T *d, const std::string &f) {
+	Read_Status status;
+	if (ends_with(f, ".gz")) {
+		Gzip_Input_Parser gip(f.c_str());
+		if (!gip.good()) {
+			std::cerr << "Could not load " << f << "!\n";
+			return false;
+		}
+		status = d->read_from(gip, NULL);
+	}
+	else {
+		Input_Parser ip(f.c_str());
+		if (!ip.good()) {
+			std::cerr << "Could not load " << f << "!\n";
+			return false;
+		}
+		status = d->read_from(ip, NULL);
+	}
+	return report(status, f);
+}
+
+// Reads simulation data from a binary file
+template<class T, class P>
+static bool read_binary(T *d, const std::string &f) {
+	P p(f.c_str());
+	if (!p.good()) {
+		std::cerr << "Could not load " << f << "!\n";
+		return false;
+	}
+	return report(d->read_from(p, NULL), f);
+}
+
+Batch_Renderer::Batch_Renderer() : _model_filename(), _firing_spikes_filename(), _voltages_filename(),
+	_weights_filename(), _state_filename(), _output_filename(), _trace_filename(), _saved_model_filename(),
+	_sections(Brain_Model::ALL_SECTIONS), _width(DEFAULT_WIDTH),
+	_height(DEFAULT_HEIGHT), _display(Draw_Options::STATIC_MODEL), _display_chosen(false), _cycles(), _animated(false),
+	_stop_chosen(false), _start(0), _stop(0), _step(1), _compression(Image::Compression::fast()), _model_area(NULL) {}
+
+Batch_Renderer::~Batch_Renderer() {
+	delete _model_area;
+}
+
+void Batch_Renderer::usage(std::ostream &os) {
+	os << "Usage: viz --render MODEL -o IMAGE [options]\n"
+		"       viz --render MODEL --save-model FILE\n"
+		"Exports images of a model from " PROGRAM_NAME " without opening any windows.\n\n"
+		"  -o, --output IMAGE     image file to write (.png, .tga, or .ppm)\n"
+		"  -f, --firings FILE     firing spikes file to load\n"
+		"  -v, --voltages FILE    voltages file to load (after firing spikes)\n"
+		"  -w, --weights FILE     weights file to load (after firing spikes)\n"
+		"  -s, --state FILE       saved state file to load\n"
+		"  -d, --display MODE     static, firings, voltages, or weights\n"
+		"                         (default: firings if loaded, static otherwise)\n"
+		"  -t, --cycle N          simulation cycle to export; may be repeated, in which case\n"
+		"                         the cycle is appended to each image's name\n"
+		"  -W, --width N          image width in pixels (default: " << DEFAULT_WIDTH << ")\n"
+		"  -H, --height N         image height in pixels (default: " << DEFAULT_HEIGHT << ")\n"
+		"      --trace FILE       Chrome trace file to save how long loading and drawing took\n"
+		"      --skip SECTIONS    binary model sections not to read, from fields, synapses, and\n"
+		"                         gap-junctions, separated by commas (only for version 3 .vbm files)\n"
+		"      --save-model FILE  binary model file to save with compressed chunks (.vbm)\n\n"
+		"Any of these export an animation instead, one image per cycle from the first to the\n"
+		"last, with the cycle appended to each image's name:\n"
+		"      --from N           first cycle of the animation (default: 0)\n"
+		"      --to N             last cycle of the animation (default: the last cycle)\n"
+		"      --stride N         cycles between the animation's images (default: 1)\n\n"
+		"The animation's PNG images are compressed for speed, which these can change:\n"
+		"      --level N          zlib compression level, 0 (none) to 9 (best) (default: 1)\n"
+		"      --strategy NAME    zlib strategy: default, filtered, huffman, rle, or fixed\n"
+		"                         (default: default)\n"
+		"      --filter NAME      PNG row filter: none, sub, up, avg, paeth, or all\n"
+		"                         (default: sub)\n";
+}
+
+bool Batch_Renderer::parse_args(int argc, char **argv) {
+	for (int i = 0; i < argc; i++) {
+		const char *a = argv[i];
+		if (a[0] != '-') {
+			if (!_model_filename.empty()) { return false; }
+			_model_filename = a;
+			continue;
+		}
+		if (i + 1 >= argc) { return false; }
+		const char *v = argv[++i];
+		if (!strcmp(a, "-o") || !strcmp(a, "--output")) {
+			_output_filename = v;
+		}
+		else if (!strcmp(a, "-f") || !strcmp(a, "--firings")) {
+			_firing_spikes_filename = v;
+		}
+		else if (!strcmp(a, "-v") || !strcmp(a, "--voltages")) {
+			_voltages_filename = v;
+		}
+		else if (!strcmp(a, "-w") || !strcmp(a, "--weights")) {
+			_weights_filename = v;
+		}
+		else if (!strcmp(a, "-s") || !strcmp(a, "--state")) {
+			_state_filename = v;
+		}
+		else if (!strcmp(a, "-d") || !strcmp(a, "--display")) {
+			_display_chosen = true;
+			if (!strcmp(v, "static")) { _display = Draw_Options::STATIC_MODEL; }
+			else if (!strcmp(v, "firings")) { _display = Draw_Options::FIRING_SPIKES; }
+			else if (!strcmp(v, "voltages")) { _display = Draw_Options::VOLTAGES; }
+			else if (!strcmp(v, "weights")) { _display = Draw_Options::WEIGHTS; }
+			else { return false; }
+		}
+		else if (!strcmp(a, "-t") || !strcmp(a, "--cycle")) {
+			size32_t t;
+			if (!parse_cycle(v, t)) { return false; }
+			_cycles.push_back(t);
+		}
+		else if (!strcmp(a, "-W") || !strcmp(a, "--width")) {
+			if (!parse_size(v, _width)) { return false; }
+		}
+		else if (!strcmp(a, "-H") || !strcmp(a, "--height")) {
+			if (!parse_size(v, _height)) { return false; }
+		}
+		else if (!strcmp(a, "--trace")) {
+			_trace_filename = v;
+		}
+		else if (!strcmp(a, "--skip")) {
+			if (!parse_sections(v, _sections)) { return false; }
+		}
+		else if (!strcmp(a, "--save-model")) {
+			_saved_model_filename = v;
+		}
+		else if (!strcmp(a, "--from")) {
+			if (!parse_cycle(v, _start)) { return false; }
+			_animated = true;
+		}
+		else if (!strcmp(a, "--to")) {
+			if (!parse_cycle(v, _stop)) { return false; }
+			_animated = _stop_chosen = true;
+		}
+		else if (!strcmp(a, "--stride")) {
+			if (!parse_cycle(v, _step) || !_step) { return false; }
+			_animated = true;
+		}
+		else if (!strcmp(a, "--level")) {
+			size32_t l;
+			if (!parse_cycle(v, l) || l > 9) { return false; }
+			_compression.level = (int)l;
+		}
+		else if (!strcmp(a, "--strategy")) {
+			if (!_compression.strategy_named(v)) { return false; }
+		}
+		else if (!strcmp(a, "--filter")) {
+			if (!_compression.filters_named(v)) { return false; }
+		}
+		else {
+			return false;
+		}
+	}
+	// A saved model must be whole, so no sections can be skipped for one
+	if (!_saved_model_filename.empty() && _sections != Brain_Model::ALL_SECTIONS) { return false; }
+	return !_model_filename.empty() && (!_output_filename.empty() || !_saved_model_filename.empty());
+}
+
+int Batch_Renderer::run(int argc, char **argv) {
+	if (!parse_args(argc, argv)) {
+		usage(std::cerr);
+		return EXIT_FAILURE;
+	}
+	_model_area = new(std::nothrow) Model_Area(0, 0, _width, _height);
+	if (_model_area == NULL) {
+		std::cerr << "Not enough memory was available!\n";
+		return EXIT_FAILURE;
+	}
+	if (!open_model() || !save_model()) { return EXIT_FAILURE; }
+	if (_output_filename.empty()) { return write_trace() ? EXIT_SUCCESS : EXIT_FAILURE; }
+	if (!load_firing_spikes() || !load_voltages() || !load_weights() || !load_state()) {
+		return EXIT_FAILURE;
+	}
+	bool rendered = render();
+	return rendered && write_trace() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+bool Batch_Renderer::open_model() {
+	Profiler::Scope scope("open model");
+	const std::string &f = _model_filename;
+	Model_Loader *ml;
+	bool good;
+	Brain_Model &bm = _model_area->model();
+	if (ends_with(f, ".vbm.gz")) {
+		Gzip_Binary_Parser *gbp = new Gzip_Binary_Parser(f.c_str());
+		good = gbp->good();
+		ml = new Model_Loader(bm, gbp, _sections);
+	}
+	else if (ends_with(f, ".txt.gz")) {
+		Gzip_Input_Parser *gip = new Gzip_Input_Parser(f.c_str());
+		good = gip->good();
+		ml = new Model_Loader(bm, gip);
+	}
+	else if (ends_with(f, ".vbm")) {
+		Binary_Parser *bp = new Binary_Parser(f.c_str());
+		good = bp->good();
+		ml = new Model_Loader(bm, bp, _sections);
+	}
+	else {
+		Input_Parser *ip = new Input_Parser(f.c_str());
+		good = ip->good();
+		ml = new Model_Loader(bm, ip);
+	}
+	if (!good) {
+		delete ml;
+		std::cerr << "Could not open " << f << "!\n";
+		return false;
+	}
+	// Read the whole model, since nothing is drawn until it is done
+	Read_Status status = _model_area->read_model_from(*ml);
+	if (status == SUCCESS) { status = ml->finish(); }
+	delete ml;
+	if (!report(status, f)) { return false; }
+	bm.filename(f.c_str());
+	// Color the types the same as the default configuration file does
+	std::ifstream ifs(DEFAULT_CONFIG_FILE);
+	if (ifs.good()) { report(bm.read_config_from(ifs), DEFAULT_CONFIG_FILE); }
+	return true;
+}
+
+bool Batch_Renderer::save_model() {
+	const std::string &f = _saved_model_filename;
+	if (f.empty()) { return true; }
+	Profiler::Scope scope("save model");
+	// Compressed chunks make the file smaller and are still decompressed in parallel when it is read
+	Binary_Writer bw(f.c_str());
+	if (!_model_area->const_model().write_to(bw, true) || !bw.close()) {
+		std::cerr << "Could not write to " << f << "!\n";
+		return false;
+	}
+	return true;
+}
+
+bool Batch_Renderer::load_firing_spikes() {
+	const std::string &f = _firing_spikes_filename;
+	if (f.empty()) { return true; }
+	Profiler::Scope scope("load firing spikes");
+	Brain_Model &bm = _model_area->model();
+	Firing_Spikes *fd = new(std::nothrow) Firing_Spikes(&bm);
+	if (fd == NULL) {
+		std::cerr << "Could not load " << f << "!\nNot enough memory was available.\n";
+		return false;
+	}
+	bool good = ends_with(f, ".vbf") ? read_binary<Firing_Spikes, Binary_Parser>(fd, f) : read_text(fd, f);
+	if (!good) {
+		delete fd;
+		return false;
+	}
+	bm.firing_spikes(fd);
+	if (!_display_chosen) { _display = Draw_Options::FIRING_SPIKES; }
+	return true;
+}
+
+bool Batch_Renderer::load_voltages() {
+	const std::string &f = _voltages_filename;
+	if (f.empty()) { return true; }
+	Profiler::Scope scope("load voltages");
+	Brain_Model &bm = _model_area->model();
+	if (!bm.has_firing_spikes()) {
+		std::cerr << "Could not load " << f << "!\nFiring spikes must be loaded first.\n";
+		return false;
+	}
+	Voltages *v = new(std::nothrow) Voltages(&bm, bm.const_firing_spikes()->num_cycles());
+	if (v == NULL) {
+		std::cerr << "Could not load " << f << "!\nNot enough memory was available.\n";
+		return false;
+	}
+	bool good = ends_with(f, ".vbv") ? read_binary<Voltages, Mapped_File>(v, f) : read_text(v, f);
+	if (!good) {
+		delete v;
+		return false;
+	}
+	bm.voltages(v);
+	return true;
+}
+
+bool Batch_Renderer::load_weights() {
+	const std::string &f = _weights_filename;
+	if (f.empty()) { return true; }
+	Profiler::Scope scope("load weights");
+	Brain_Model &bm = _model_area->model();
+	if (!bm.has_firing_spikes()) {
+		std::cerr << "Could not load " << f << "!\nFiring spikes must be loaded first.\n";
+		return false;
+	}
+	Weights *w = new(std::nothrow) Weights(&bm, bm.const_firing_spikes()->num_cycles());
+	if (w == NULL) {
+		std::cerr << "Could not load " << f << "!\nNot enough memory was available.\n";
+		return false;
+	}
+	bool good = ends_with(f, ".vbw") ? read_binary<Weights, Binary_Parser>(w, f) : read_text(w, f);
+	if (!good) {
+		delete w;
+		return false;
+	}
+	bm.weights(w);
+	return true;
+}
+
+bool Batch_Renderer::load_state() {
+	const std::string &f = _state_filename;
+	if (f.empty()) { return true; }
+	Profiler::Scope scope("load state");
+	Input_Parser ip(f.c_str());
+	if (!ip.good()) {
+		std::cerr << "Could not load " << f << "!\n";
+		return false;
+	}
+	return report(_model_area->read_state_from(ip), f);
+}
+
+bool Batch_Renderer::render() {
+	Offscreen_Context oc(_width, _height);
+	if (!oc.good()) {
+		std::cerr << "Could not create an offscreen OpenGL context!\n";
+		return false;
+	}
+	Brain_Model &bm = _model_area->model();
+	Draw_Options &opts = _model_area->draw_options();
+	bool simulated = (_display == Draw_Options::FIRING_SPIKES && bm.has_firing_spikes()) ||
+		(_display == Draw_Options::VOLTAGES && bm.has_voltages()) ||
+		(_display == Draw_Options::WEIGHTS && bm.has_weights());
+	opts.display(simulated ? _display : Draw_Options::STATIC_MODEL);
+	Image::Format fmt = image_format(_output_filename);
+	if (_animated && bm.has_firing_spikes()) { return render_animation(oc, fmt); }
+	if (_cycles.empty() || !bm.has_firing_spikes()) {
+		std::string f = _output_filename;
+		int err = _model_area->write_image(f.c_str(), fmt, oc);
+		if (err) { std::cerr << "Could not write to " << f << "!\n"; }
+		return !err;
+	}
+	size32_t max_time = bm.const_firing_spikes()->max_time();
+	for (std::vector<size32_t>::const_iterator it = _cycles.begin(); it != _cycles.end(); ++it) {
+		// Step forward to later cycles, which is faster than seeking to them
+		size32_t t = bm.const_firing_spikes()->time();
+		size32_t c = MIN(*it, max_time);
+		if (c > t) { bm.step_time(c - t); }
+		else if (c < t) { bm.start_time(c); }
+		std::string f = output_filename(c);
+		int err = _model_area->write_image(f.c_str(), fmt, oc);
+		if (err) {
+			std::cerr << "Could not write to " << f << "!\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Batch_Renderer::render_animation(Offscreen_Context &oc, Image::Format m) {
+	size32_t max_time = _model_area->const_model().const_firing_spikes()->max_time();
+	size32_t stop = _stop_chosen ? MIN(_stop, max_time) : max_time;
+	if (_start > stop) {
+		std::cerr << "The animation's first cycle is after its last one!\n";
+		return false;
+	}
+	int err = _model_area->write_animation(output_prefix(), _start, stop, _step, m, _compression, &oc);
+	if (err) { std::cerr << "Could not write the animation to " << _output_filename << "!\n"; }
+	return !err;
+}
+
+bool Batch_Renderer::write_trace() {
+	if (_trace_filename.empty()) { return true; }
+	std::ofstream ofs(_trace_filename.c_str());
+	if (!ofs.good()) {
+		std::cerr << "Could not write to " << _trace_filename << "!\n";
+		return false;
+	}
+	Profiler::write_trace_to(ofs);
+	return true;
+}
+
+std::string Batch_Renderer::output_filename(size32_t t) const {
+	if (_cycles.size() < 2) { return _output_filename; }
+	// Number the images by cycle, padded to sort in order
+	size32_t n = _model_area->const_model().const_firing_spikes()->num_cycles();
+	int z = (int)ceil(log10((float)n));
+	const std::string &f = _output_filename;
+	size_t d = stem_length(f);
+	std::ostringstream ss;
+	ss << f.substr(0, d) << "_" << std::setw(z) << std::setfill('0') << t << f.substr(d);
+	return ss.str();
+}
+
+std::string Batch_Renderer::output_prefix() const {
+	// The animation's images are named like the output image, with the cycle before the extension
+	return _output_filename.substr(0, stem_length(_output_filename)) + "_";
+}
+
+Image::Format Batch_Renderer::image_format(const std::string &f) {
+	// Bitmaps are left out, since they take their resolution from the screen
+	if (ends_with(f, ".tga")) { return Image::TGA; }
+	if (ends_with(f, ".ppm")) { return Image::PPM; }
+	return Image::PNG;
+}
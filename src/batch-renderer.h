@@ -0,0 +1,55 @@
+#ifndef BATCH_RENDERER_H
+#define BATCH_RENDERER_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "utils.h"
+#include "draw-options.h"
+#include "image.h"
+
+class Model_Area;
+class Offscreen_Context;
+
+// Opens a model with its simulation data and a saved state, without any windows, and exports images of it drawn into
+// an offscreen context, so that figures can be made on machines with no display server or GPU
+class Batch_Renderer {
+public:
+	static const int DEFAULT_WIDTH = 1920, DEFAULT_HEIGHT = 1080;
+private:
+	std::string _model_filename, _firing_spikes_filename, _voltages_filename, _weights_filename, _state_filename;
+	std::string _output_filename, _trace_filename, _saved_model_filename;
+	unsigned int _sections;
+	int _width, _height;
+	Draw_Options::Display _display;
+	bool _display_chosen;
+	std::vector<size32_t> _cycles;
+	bool _animated, _stop_chosen;
+	size32_t _start, _stop, _step;
+	Image::Compression _compression;
+	Model_Area *_model_area;
+public:
+	Batch_Renderer();
+	~Batch_Renderer();
+	int run(int argc, char **argv);
+	static void usage(std::ostream &os);
+private:
+	bool parse_args(int argc, char **argv);
+	bool open_model(void);
+	bool save_model(void);
+	bool load_firing_spikes(void);
+	bool load_voltages(void);
+	bool load_weights(void);
+	bool load_state(void);
+	bool render(void);
+	bool write_trace(void);
+	bool render_animation(Offscreen_Context &oc, Image::Format m);
+	std::string output_filename(size32_t t) const;
+	std::string output_prefix(void) const;
+	static Image::Format image_format(const std::string &f);
+	Batch_Renderer(const Batch_Renderer &br); // Unimplemented copy constructor
+	Batch_Renderer &operator=(const Batch_Renderer &br); // Unimplemented assignment operator
+};
+
+#endif
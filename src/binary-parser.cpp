@@ -1,4 +1,5 @@
 #include <cctype>
+#include <cstring>
 #include <string>
 #include <limits>
 #include <zlib.h>
@@ -8,6 +9,7 @@
 #include <FL/filename.H>
 #pragma warning(pop)
 
+#include "algebra.h"
 #include "from-file.h"
 #include "coords.h"
 #include "binary-parser.h"
@@ -111,6 +113,12 @@ size64_t Binary_Parser::get_unsigned() {
 	}
 }
 
+size64_t Binary_Parser::get_fixed64() {
+	size64_t v = 0;
+	for (int i = 0; i < 8; i++) { v = (v << 8) | (size64_t)(size8_t)next(); }
+	return v;
+}
+
 int32_t Binary_Parser::get_signed() {
 	size32_t b0 = (size32_t)next();
 	if (b0 == 0xFF) {
@@ -198,6 +206,33 @@ void Binary_Parser::get_chars(size_t n, char *buffer) {
 	}
 }
 
+size_t Binary_Parser::get_bytes(size_t n, unsigned char *buffer) {
+	// Copy whatever is left in the buffer, then read the rest directly
+	size_t k = _buffer && _next < _buffer_size ? _buffer_size - _next : 0;
+	if (k > n) { k = n; }
+	memcpy(buffer, _buffer + _next, k);
+	_next += k;
+	if (k < n && _file) { return k + fread(buffer + k, 1, n - k, _file); }
+	for (int c; k < n && (c = next()) != EOF; k++) { buffer[k] = (unsigned char)c; }
+	return k;
+}
+
+void Binary_Parser::skip(size64_t n) {
+	// Skip whatever is left in the buffer, then seek past the rest
+	size_t k = _buffer && _next < _buffer_size ? _buffer_size - _next : 0;
+	if (k >= n) {
+		_next += (size_t)n;
+		return;
+	}
+	_next = _buffer_size;
+	if (!_file) { return; }
+#ifdef _WIN32
+	_fseeki64(_file, (__int64)(n - k), SEEK_CUR);
+#else
+	fseeko(_file, (off_t)(n - k), SEEK_CUR);
+#endif
+}
+
 Gzip_Binary_Parser::Gzip_Binary_Parser(const char *f, size_t n) : Binary_Parser(), _gzfile(NULL) {
 	_filename = fl_filename_name(f);
 	_filesize = ::filesize(f);
@@ -211,6 +246,35 @@ Gzip_Binary_Parser::~Gzip_Binary_Parser() {
 	if (_gzfile) { gzclose(_gzfile); }
 }
 
+Buffer_Binary_Parser::Buffer_Binary_Parser(const unsigned char *data, size_t n) : Binary_Parser(), _data(data),
+	_overrun(false) {
+	_buffer_size = n;
+	_next = 0;
+}
+
+int Buffer_Binary_Parser::next() {
+	if (_next >= _buffer_size) {
+		_overrun = true;
+		return EOF;
+	}
+	return _data[_next++];
+}
+
+void Gzip_Binary_Parser::skip(size64_t n) {
+	size_t k = _buffer && _next < _buffer_size ? _buffer_size - _next : 0;
+	if (k >= n) {
+		_next += (size_t)n;
+		return;
+	}
+	_next = _buffer_size;
+	// Seek forward in steps that fit in a z_off_t, which may only be 32 bits
+	for (size64_t left = n - k; left > 0;) {
+		size64_t step = MIN(left, (size64_t)1 << 30);
+		if (gzseek(_gzfile, (z_off_t)step, SEEK_CUR) < 0) { return; }
+		left -= step;
+	}
+}
+
 int Gzip_Binary_Parser::next() {
 	if (_next >= _buffer_size) {
 		_next = 0;
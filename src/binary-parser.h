@@ -35,16 +35,34 @@ public:
 	inline size32_t get_size32(void) { return (size32_t)get_unsigned(); }
 	inline size64_t get_size64(void) { return (size64_t)get_unsigned(); }
 	size64_t get_unsigned(void);
+	size64_t get_fixed64(void);
 	inline int16_t get_int16(void) { return (int16_t)get_signed(); }
 	inline int32_t get_int32(void) { return (int32_t)get_signed(); }
 	coord_t get_coord(void);
 	int32_t get_signed(void);
 	std::string get_string(void);
 	void get_chars(size_t n, char *buffer);
+	size_t get_bytes(size_t n, unsigned char *buffer);
+	virtual void skip(size64_t n);
 private:
 	virtual int next(void);
 };
 
+// Parses binary data that has already been read into memory, such as one chunk of a larger file
+class Buffer_Binary_Parser : public Binary_Parser {
+private:
+	const unsigned char *_data;
+	bool _overrun;
+public:
+	Buffer_Binary_Parser(const unsigned char *data, size_t n);
+	inline bool good(void) const { return _data != NULL; }
+	inline bool overrun(void) const { return _overrun; }
+	inline void save_place(void) { _place = (long)_next; }
+	inline void restore_place(void) { _next = (size_t)_place; }
+protected:
+	int next(void);
+};
+
 class Gzip_Binary_Parser : public Binary_Parser {
 private:
 	gzFile _gzfile;
@@ -54,6 +72,7 @@ public:
 	inline bool good(void) const { return _gzfile && _buffer && _buffer_size; }
 	inline void save_place(void) { _place = (long)((size_t)gztell(_gzfile) - _buffer_size + _next); }
 	inline void restore_place(void) { gzseek(_gzfile, _place, SEEK_SET); _next = _buffer_size; }
+	void skip(size64_t n);
 protected:
 	int next(void);
 };
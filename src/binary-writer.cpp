@@ -0,0 +1,160 @@
+#pragma warning(push, 0)
+#include <FL/fl_utf8.h>
+#pragma warning(pop)
+
+#include <cstring>
+
+#include "binary-writer.h"
+
+Binary_Writer::Binary_Writer(const char *f, size_t n) : _file(NULL), _buffer_size(n), _buffer(NULL), _next(0),
+	_error(false) {
+	_file = fl_fopen(f, "wb");
+	_buffer = new(std::nothrow) unsigned char[_buffer_size];
+}
+
+Binary_Writer::Binary_Writer(size_t n) : _file(NULL), _buffer_size(n), _buffer(NULL), _next(0), _error(false) {
+	_buffer = new(std::nothrow) unsigned char[_buffer_size];
+}
+
+Binary_Writer::~Binary_Writer() {
+	close();
+	delete [] _buffer;
+}
+
+void Binary_Writer::flush() {
+	if (!_file) { return; }
+	if (_next && fwrite(_buffer, 1, _next, _file) != _next) { _error = true; }
+	_next = 0;
+}
+
+void Binary_Writer::put_unsigned(size64_t v) {
+	// The inverse of Binary_Parser::get_unsigned: leading one bits give the number of bytes after the first
+	if (v < 0x80ULL) {
+		put_size8((size8_t)v);
+	}
+	else if (v < 0x4000ULL) {
+		v |= 0x8000ULL;
+		for (int s = 8; s >= 0; s -= 8) { put_size8((size8_t)(v >> s)); }
+	}
+	else if (v < 0x200000ULL) {
+		v |= 0xC00000ULL;
+		for (int s = 16; s >= 0; s -= 8) { put_size8((size8_t)(v >> s)); }
+	}
+	else if (v < 0x10000000ULL) {
+		v |= 0xE0000000ULL;
+		for (int s = 24; s >= 0; s -= 8) { put_size8((size8_t)(v >> s)); }
+	}
+	else if (v < 0x800000000ULL) {
+		v |= 0xF000000000ULL;
+		for (int s = 32; s >= 0; s -= 8) { put_size8((size8_t)(v >> s)); }
+	}
+	else if (v < 0x40000000000ULL) {
+		v |= 0xF80000000000ULL;
+		for (int s = 40; s >= 0; s -= 8) { put_size8((size8_t)(v >> s)); }
+	}
+	else if (v < 0x2000000000000ULL) {
+		v |= 0xFC000000000000ULL;
+		for (int s = 48; s >= 0; s -= 8) { put_size8((size8_t)(v >> s)); }
+	}
+	else if (v < 0x100000000000000ULL) {
+		v |= 0xFE00000000000000ULL;
+		for (int s = 56; s >= 0; s -= 8) { put_size8((size8_t)(v >> s)); }
+	}
+	else {
+		put_size8(0xFF);
+		put_fixed64(v);
+	}
+}
+
+void Binary_Writer::put_signed(int32_t v) {
+	// The inverse of Binary_Parser::get_signed: the first byte's leading bits give the sign and number of bytes
+	size32_t n = v < 0 ? (size32_t)(-(int64_t)v) : (size32_t)v;
+	int k = 4;
+	if (v < 0) {
+		if (n < 0x40) { n |= 0x80; k = 1; }
+		else if (n < 0x1000) { n |= 0xE000; k = 2; }
+		else if (n < 0x40000) { n |= 0xF80000; k = 3; }
+		else if (n < 0x1000000) { n |= 0xFE000000; }
+		else { put_size8(0xFF); n |= 0x80000000; }
+	}
+	else {
+		if (n < 0x80) { k = 1; }
+		else if (n < 0x2000) { n |= 0xC000; k = 2; }
+		else if (n < 0x80000) { n |= 0xF00000; k = 3; }
+		else if (n < 0x2000000) { n |= 0xFC000000; }
+		else { put_size8(0xFF); }
+	}
+	for (int s = 8 * (k - 1); s >= 0; s -= 8) { put_size8((size8_t)(n >> s)); }
+}
+
+void Binary_Writer::put_fixed64(size64_t v) {
+	for (int s = 56; s >= 0; s -= 8) { put_size8((size8_t)(v >> s)); }
+}
+
+void Binary_Writer::put_string(const std::string &s) {
+	put_chars(s.length(), s.c_str());
+	put_size8(0);
+}
+
+void Binary_Writer::put_chars(size_t n, const char *buffer) {
+	for (size_t i = 0; i < n; i++) {
+		put_char(buffer[i]);
+	}
+}
+
+void Binary_Writer::put_bytes(size_t n, const unsigned char *buffer) {
+	if (n <= _buffer_size - _next) {
+		memcpy(_buffer + _next, buffer, n);
+		_next += n;
+		return;
+	}
+	// Write large blocks directly instead of through the buffer
+	flush();
+	if (_file) {
+		if (fwrite(buffer, 1, n, _file) != n) { _error = true; }
+		return;
+	}
+	for (size_t i = 0; i < n; i++) {
+		put_size8(buffer[i]);
+	}
+}
+
+size64_t Binary_Writer::tell() {
+	if (!_file) { return 0; }
+#ifdef _WIN32
+	return (size64_t)_ftelli64(_file) + _next;
+#else
+	return (size64_t)ftello(_file) + _next;
+#endif
+}
+
+void Binary_Writer::seek(size64_t offset) {
+	flush();
+	if (!_file) { return; }
+	// Seek with 64-bit offsets, since files over 2 GB are common
+#ifdef _WIN32
+	if (_fseeki64(_file, (__int64)offset, SEEK_SET)) { _error = true; }
+#else
+	if (fseeko(_file, (off_t)offset, SEEK_SET)) { _error = true; }
+#endif
+}
+
+bool Binary_Writer::close() {
+	if (!_file) { return !_error; }
+	flush();
+	if (fclose(_file)) { _error = true; }
+	_file = NULL;
+	return !_error;
+}
+
+Buffer_Binary_Writer::Buffer_Binary_Writer(size_t n) : Binary_Writer(n), _data() {}
+
+void Buffer_Binary_Writer::flush() {
+	_data.insert(_data.end(), _buffer, _buffer + _next);
+	_next = 0;
+}
+
+const std::vector<unsigned char> &Buffer_Binary_Writer::data() {
+	flush();
+	return _data;
+}
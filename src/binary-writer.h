@@ -0,0 +1,54 @@
+#ifndef BINARY_WRITER_H
+#define BINARY_WRITER_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "utils.h"
+
+// Writes values in the variable-length formats read by Binary_Parser
+class Binary_Writer {
+protected:
+	FILE *_file;
+	size_t _buffer_size;
+	unsigned char *_buffer;
+	size_t _next;
+	bool _error;
+public:
+	Binary_Writer(const char *f, size_t n = 65536);
+	virtual ~Binary_Writer();
+	inline virtual bool good(void) const { return _file && _buffer && !_error; }
+	inline void put_bool(bool b) { put_size8(b ? 1 : 0); }
+	inline void put_char(char c) { put_size8((size8_t)c); }
+	inline void put_size8(size8_t b) { if (_next >= _buffer_size) { flush(); } _buffer[_next++] = b; }
+	void put_unsigned(size64_t v);
+	void put_signed(int32_t v);
+	void put_fixed64(size64_t v);
+	void put_string(const std::string &s);
+	void put_chars(size_t n, const char *buffer);
+	void put_bytes(size_t n, const unsigned char *buffer);
+	size64_t tell(void);
+	void seek(size64_t offset);
+	bool close(void);
+protected:
+	Binary_Writer(size_t n);
+	virtual void flush(void);
+private:
+	Binary_Writer(const Binary_Writer &bw); // Unimplemented copy constructor
+	Binary_Writer &operator=(const Binary_Writer &bw); // Unimplemented assignment operator
+};
+
+// Writes values into memory, such as one chunk of a larger file
+class Buffer_Binary_Writer : public Binary_Writer {
+private:
+	std::vector<unsigned char> _data;
+public:
+	Buffer_Binary_Writer(size_t n = 4096);
+	inline bool good(void) const { return _buffer && !_error; }
+	const std::vector<unsigned char> &data(void);
+protected:
+	void flush(void);
+};
+
+#endif
@@ -1,10 +1,13 @@
 #include <cstdlib>
 #include <vector>
 #include <map>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <sstream>
+#include <limits>
+#include <zlib.h>
 
 #pragma warning(push, 0)
 #include <FL/Fl.H>
@@ -21,15 +24,18 @@
 #include "gap-junction.h"
 #include "input-parser.h"
 #include "binary-parser.h"
+#include "binary-writer.h"
 #include "firing-spikes.h"
 #include "voltages.h"
 #include "weights.h"
 #include "progress-dialog.h"
+#include "parallel.h"
 #include "brain-model.h"
 
 Brain_Model::Brain_Model() : From_File(), _num_types(0), _types(NULL), _num_somas(0), _somas(NULL), _num_fields(0),
 	_fields(NULL), _num_synapses(0), _synapses(NULL), _num_gap_junctions(0), _gap_junctions(NULL), _bounds(),
-	_firing_spikes(NULL), _voltages(NULL), _weights(NULL) {}
+	_firing_spikes(NULL), _voltages(NULL), _weights(NULL), _connected(false), _type_starts(), _type_somas(),
+	_axon_syn_counts(), _den_syn_counts(), _conn_stats() {}
 
 Brain_Model::~Brain_Model() {
 	clear();
@@ -54,6 +60,26 @@ size32_t Brain_Model::soma_index(size32_t id) const {
 	return NULL_INDEX;
 }
 
+size64_t Brain_Model::soma_ids_checksum() const {
+	// A CRC-32 of the somas' IDs in index order, which tells whether data stored by soma index fits this model
+	uLong crc = crc32(0L, Z_NULL, 0);
+	unsigned char buffer[4096];
+	size_t n = 0;
+	for (size32_t i = 0; i < _num_somas; i++) {
+		size32_t id = _somas[i].id();
+		buffer[n++] = (unsigned char)id;
+		buffer[n++] = (unsigned char)(id >> 8);
+		buffer[n++] = (unsigned char)(id >> 16);
+		buffer[n++] = (unsigned char)(id >> 24);
+		if (n == sizeof(buffer)) {
+			crc = crc32(crc, buffer, (uInt)n);
+			n = 0;
+		}
+	}
+	if (n) { crc = crc32(crc, buffer, (uInt)n); }
+	return (size64_t)crc;
+}
+
 size32_t Brain_Model::synapse_index(const Synapse *y) const {
 	size32_t low = 0, high = _num_synapses;
 	while (low < high) {
@@ -81,6 +107,74 @@ size32_t Brain_Model::num_gap_junctions(size32_t index) const {
 	return n;
 }
 
+std::pair<const size32_t *, const size32_t *> Brain_Model::somas_of_type(size8_t t_index) const {
+	std::pair<const size32_t *, const size32_t *> found(NULL, NULL);
+	// The somas are only indexed by type once they have all been read
+	if ((size_t)t_index + 1 >= _type_starts.size()) { return found; }
+	const size32_t *data = _type_somas.data();
+	found.first = data + _type_starts[t_index];
+	found.second = data + _type_starts[t_index+1];
+	return found;
+}
+
+std::pair<const size32_t *, const size32_t *> Brain_Model::somas_by_syn_count(size8_t t_index, size_t y_count,
+	bool count_den) const {
+	std::pair<const size32_t *, const size32_t *> found(NULL, NULL);
+	if (t_index >= _num_types || y_count > std::numeric_limits<size32_t>::max()) { return found; }
+	const Syn_Count_Index &sci = (count_den ? _den_syn_counts : _axon_syn_counts)[t_index];
+	std::vector<std::pair<size32_t, size32_t> >::const_iterator it = std::lower_bound(sci.bins.begin(),
+		sci.bins.end(), std::make_pair((size32_t)y_count, (size32_t)0));
+	if (it == sci.bins.end() || it->first != y_count) { return found; }
+	size32_t end = it + 1 == sci.bins.end() ? (size32_t)sci.soma_indices.size() : (it + 1)->second;
+	const size32_t *data = sci.soma_indices.data();
+	found.first = data + it->second;
+	found.second = data + end;
+	return found;
+}
+
+void Brain_Model::index_types() {
+	// Bucket the somas by type, keeping them in index order
+	_type_starts.assign((size_t)_num_types + 1, 0);
+	for (size32_t i = 0; i < _num_somas; i++) {
+		_type_starts[_somas[i].type_index()+1]++;
+	}
+	for (size8_t t_index = 0; t_index < _num_types; t_index++) {
+		_type_starts[t_index+1] += _type_starts[t_index];
+	}
+	_type_somas.resize(_num_somas);
+	std::vector<size32_t> next(_type_starts.begin(), _type_starts.end() - 1);
+	for (size32_t i = 0; i < _num_somas; i++) {
+		_type_somas[next[_somas[i].type_index()]++] = i;
+	}
+}
+
+void Brain_Model::index_syn_counts() {
+	_axon_syn_counts.assign(_num_types, Syn_Count_Index());
+	_den_syn_counts.assign(_num_types, Syn_Count_Index());
+	// Order each type's somas by axonal and by dendritic synapse count on separate threads
+	size_t n_tasks = (size_t)_num_types * 2;
+	parallel_tasks(n_tasks, MIN(num_threads(), n_tasks), [&](size_t task, size_t) {
+		size8_t t_index = (size8_t)(task / 2);
+		bool count_den = (task % 2) == 1;
+		Syn_Count_Index &sci = (count_den ? _den_syn_counts : _axon_syn_counts)[t_index];
+		std::pair<const size32_t *, const size32_t *> typed = somas_of_type(t_index);
+		sci.soma_indices.assign(typed.first, typed.second);
+		const Soma *somas = _somas;
+		std::stable_sort(sci.soma_indices.begin(), sci.soma_indices.end(), [=](size32_t a, size32_t b) {
+			return count_den ? somas[a].num_den_syns() < somas[b].num_den_syns() :
+				somas[a].num_axon_syns() < somas[b].num_axon_syns();
+		});
+		size32_t n = (size32_t)sci.soma_indices.size();
+		for (size32_t i = 0; i < n; i++) {
+			const Soma &s = somas[sci.soma_indices[i]];
+			size32_t y_count = count_den ? s.num_den_syns() : s.num_axon_syns();
+			if (sci.bins.empty() || sci.bins.back().first != y_count) {
+				sci.bins.push_back(std::make_pair(y_count, i));
+			}
+		}
+	}, []() {});
+}
+
 size32_t Brain_Model::start_time(size32_t t) {
 	size32_t time = t;
 	if (_firing_spikes) {
@@ -91,12 +185,12 @@ size32_t Brain_Model::start_time(size32_t t) {
 	return time;
 }
 
-size32_t Brain_Model::step_time(void) {
+size32_t Brain_Model::step_time(size32_t n) {
 	size32_t time = 0;
 	if (_firing_spikes) {
-		time = _firing_spikes->step_time();
-		if (_voltages) { _voltages->step_time(); }
-		if (_weights) { _weights->step_time(); }
+		time = _firing_spikes->step_time(n);
+		if (_voltages) { _voltages->step_time(n); }
+		if (_weights) { _weights->step_time(n); }
 	}
 	return time;
 }
@@ -108,18 +202,153 @@ void Brain_Model::clear() {
 	delete [] _types; _types = NULL;
 	_num_somas = 0;
 	delete [] _somas; _somas = NULL;
-	_num_synapses = 0;
-	delete [] _synapses; _synapses = NULL;
-	_num_gap_junctions = 0;
-	delete [] _gap_junctions; _gap_junctions = NULL;
+	_num_fields = 0;
+	delete [] _fields; _fields = NULL;
+	_type_starts.clear();
+	_type_somas.clear();
+	clear_connections();
 	_bounds.reset();
 	firing_spikes(NULL);
 	voltages(NULL);
 	weights(NULL);
 }
 
+Brain_Model::Conn_Load::Conn_Load() : version(0), sections(ALL_SECTIONS), per_chunk(0), num_synapses(0),
+	num_gap_junctions(0), first_chunk(0), chunks(), synapses(NULL), gap_junctions(NULL), adopted_synapses(false),
+	adopted_gap_junctions(false), synapses_size(0), gap_junctions_size(0), synapses_read(0), gap_junctions_read(0),
+	stop(false) {}
+
+Brain_Model::Conn_Load::~Conn_Load() {
+	if (!adopted_synapses) { delete [] synapses; }
+	if (!adopted_gap_junctions) { delete [] gap_junctions; }
+}
+
+Brain_Model::Type_Styles::Type_Styles() : colors(), display_states() {}
+
+bool Brain_Model::Type_Styles::matches(const Brain_Model &bm) const {
+	size8_t nt = bm.num_types();
+	if (colors.size() != nt) { return false; }
+	for (size8_t i = 0; i < nt; i++) {
+		const Soma_Type *t = bm.type(i);
+		if (t->color() != colors[i] || t->display_state() != display_states[i]) { return false; }
+	}
+	return true;
+}
+
+void Brain_Model::Type_Styles::remember(const Brain_Model &bm) {
+	size8_t nt = bm.num_types();
+	colors.resize(nt);
+	display_states.resize(nt);
+	for (size8_t i = 0; i < nt; i++) {
+		const Soma_Type *t = bm.type(i);
+		colors[i] = t->color();
+		display_states[i] = t->display_state();
+	}
+}
+
+float Brain_Model::Conn_Load::progress() const {
+	size_t n = synapses_size + gap_junctions_size;
+	return n ? (float)(synapses_read + gap_junctions_read) / n : 0.0f;
+}
+
+void Brain_Model::clear_connections() {
+	_num_synapses = 0;
+	delete [] _synapses; _synapses = NULL;
+	_num_gap_junctions = 0;
+	delete [] _gap_junctions; _gap_junctions = NULL;
+	_axon_syn_counts.clear();
+	_den_syn_counts.clear();
+	_conn_stats.clear();
+	_connected = false;
+}
+
+bool Brain_Model::publish_connections(Conn_Load &cl) {
+	// Adopt the arrays once records have been read into them, and maintain the somas' linked lists of synapses
+	// in index order, so only this thread ever modifies the model
+	bool published = false;
+	size32_t ny = (size32_t)cl.synapses_read;
+	if (ny > _num_synapses) {
+		if (!cl.adopted_synapses) {
+			_synapses = cl.synapses;
+			cl.adopted_synapses = true;
+		}
+		for (size32_t i = _num_synapses; i < ny; i++) {
+			Synapse &y = _synapses[i];
+			soma(y.axon_soma_index())->first_axon_syn(&y, i);
+			soma(y.den_soma_index())->first_den_syn(&y, i);
+		}
+		_num_synapses = ny;
+		published = true;
+	}
+	size32_t ng = (size32_t)cl.gap_junctions_read;
+	if (ng > _num_gap_junctions) {
+		if (!cl.adopted_gap_junctions) {
+			_gap_junctions = cl.gap_junctions;
+			cl.adopted_gap_junctions = true;
+		}
+		_num_gap_junctions = ng;
+		published = true;
+	}
+	return published;
+}
+
+void Brain_Model::finish_connections() {
+	// Index the somas by synapse count
+	index_syn_counts();
+	_conn_stats.clear();
+	_connected = true;
+}
+
+// Reads a model's synapses and gap junctions on a worker thread while the calling thread shows progress,
+// then publishes them all at once
+template<typename P>
+static Read_Status read_all_connections(Brain_Model &bm, P &parser, Progress_Dialog *p, Brain_Model::Conn_Load &cl) {
+	// Prepare to show synapse-parsing progress
+	if (p) {
+		p->message("Parsing synapses and gap junctions...");
+		p->progress(0.0f);
+		Fl::check();
+		if (p->canceled()) { return CANCELED; }
+	}
+	Read_Status status = SUCCESS;
+	parallel_tasks(1, 1, [&](size_t, size_t) {
+		status = bm.read_connections_from(parser, cl);
+	}, [&]() {
+		// Update progress
+		if (!p) { return; }
+		p->progress(cl.progress());
+		Fl::check();
+		if (p->canceled()) { cl.stop = true; }
+	});
+	if (status != SUCCESS) { return status; }
+	bm.publish_connections(cl);
+	bm.finish_connections();
+	// Update progress
+	if (p) {
+		p->progress(1.0f);
+		Fl::check();
+		if (p->canceled()) { return CANCELED; }
+	}
+	return SUCCESS;
+}
+
 Read_Status Brain_Model::read_from(Input_Parser &ip, Progress_Dialog *p) {
+	Conn_Load cl;
+	Read_Status status = read_somas_from(ip, p, cl);
+	if (status != SUCCESS) { return status; }
+	return read_all_connections(*this, ip, p, cl);
+}
+
+Read_Status Brain_Model::read_from(Binary_Parser &bp, Progress_Dialog *p, unsigned int sections) {
+	Conn_Load cl;
+	Read_Status status = read_somas_from(bp, p, cl, sections);
+	if (status != SUCCESS) { return status; }
+	return read_all_connections(*this, bp, p, cl);
+}
+
+Read_Status Brain_Model::read_somas_from(Input_Parser &ip, Progress_Dialog *p, Conn_Load &cl) {
 	size_t denom = 1;
+	clear_connections();
 	// Get the file name and size
 	_filename = ip.filename();
 	_filesize = ip.filesize();
@@ -130,6 +359,7 @@ Read_Status Brain_Model::read_from(Input_Parser &ip, Progress_Dialog *p) {
 		version = ip.get_size8();
 	}
 	if (version < 1 || version > 2) { return BAD_VERSION; }
+	cl.version = version;
 	// Get the number of types
 	_num_types = ip.get_size8();
 	if (!_num_types) { return NO_TYPES; }
@@ -167,6 +397,7 @@ Read_Status Brain_Model::read_from(Input_Parser &ip, Progress_Dialog *p) {
 		_num_fields = ip.get_size32();
 	}
 	else {
+		_num_fields = 0;
 		// Prepare to show field-counting progress
 		if (p) {
 			denom = _num_somas / Progress_Dialog::PROGRESS_STEPS;
@@ -240,93 +471,65 @@ Read_Status Brain_Model::read_from(Input_Parser &ip, Progress_Dialog *p) {
 		}
 	}
 	bound(b);
+	index_types();
+	return SUCCESS;
+}
+
+Read_Status Brain_Model::read_connections_from(Input_Parser &ip, Conn_Load &cl) const {
 	// Get the number of synapses
-	_num_synapses = (size32_t)ip.get_size64();
-	// Prepare to show synapse-parsing progress
-	if (p) {
-		denom = _num_synapses / Progress_Dialog::PROGRESS_STEPS;
-		if (!denom) { denom = 1; }
-		p->message("Parsing synapses...");
-		p->progress(0.0f);
-		Fl::check();
-		if (p->canceled()) { return CANCELED; }
-	}
+	size32_t num_synapses = (size32_t)ip.get_size64();
 	// Initialize the array of synapses
-	delete [] _synapses;
-	_synapses = _num_synapses > 0 ? new(std::nothrow) Synapse[_num_synapses] : NULL;
-	if (_num_synapses > 0 && _synapses == NULL) { return NO_MEMORY; }
+	cl.synapses = num_synapses > 0 ? new(std::nothrow) Synapse[num_synapses] : NULL;
+	if (num_synapses > 0 && cl.synapses == NULL) { return NO_MEMORY; }
+	cl.synapses_size = num_synapses;
 	// Get each synapse
-	for (size32_t i = 0; i < _num_synapses; i++) {
-		Synapse &y = _synapses[i];
+	for (size32_t i = 0; i < num_synapses; i++) {
+		Synapse &y = cl.synapses[i];
 		y.read_from(ip, *this);
-		if (ip.done() && i < _num_synapses - 1) { return END_OF_FILE; }
+		if (ip.done() && i < num_synapses - 1) { return END_OF_FILE; }
 #ifdef SHORT_COORDS
 		if (ip.overflow()) { return SIGN_OVERFLOW; }
 #endif
-		// Maintain the axonal soma's linked list of synapses
-		size32_t a_index = y.axon_soma_index();
-		if (a_index >= _num_somas) { return BAD_SYNAPSE_SOMA_ID; }
-		soma(a_index)->first_axon_syn(&y, i);
-		// Maintain the dendritic soma's linked list of synapses
-		size32_t d_index = y.den_soma_index();
-		if (d_index >= _num_somas) { return BAD_SYNAPSE_SOMA_ID; }
-		soma(d_index)->first_den_syn(&y, i);
-		// Update progress
-		if (p && !((i + 1) % denom)) {
-			p->progress((float)(i + 1) / _num_synapses);
-			Fl::check();
-			if (p->canceled()) { return CANCELED; }
+		if (y.axon_soma_index() >= _num_somas || y.den_soma_index() >= _num_somas) { return BAD_SYNAPSE_SOMA_ID; }
+		// Let each batch of synapses be published
+		if (!((i + 1) % RECORDS_PER_BATCH)) {
+			cl.synapses_read = i + 1;
+			if (cl.stop) { return CANCELED; }
 		}
 	}
+	cl.synapses_read = num_synapses;
 	// Get the number of gap junctions (optional for backwards compatibility)
-	_num_gap_junctions = ip.done() ? 0 : ip.get_size32();
-	// Prepare to show gap junction-parsing progress
-	if (p) {
-		denom = _num_gap_junctions / Progress_Dialog::PROGRESS_STEPS;
-		if (!denom) { denom = 1; }
-		p->message("Parsing gap junctions...");
-		p->progress(0.0f);
-		Fl::check();
-		if (p->canceled()) { return CANCELED; }
-	}
+	size32_t num_gap_junctions = ip.done() ? 0 : ip.get_size32();
 	// Initialize the array of gap junctions
-	delete [] _gap_junctions;
-	_gap_junctions = _num_gap_junctions > 0 ? new(std::nothrow) Gap_Junction[_num_gap_junctions] : NULL;
-	if (_num_gap_junctions > 0 && _gap_junctions == NULL) { return NO_MEMORY; }
+	cl.gap_junctions = num_gap_junctions > 0 ? new(std::nothrow) Gap_Junction[num_gap_junctions] : NULL;
+	if (num_gap_junctions > 0 && cl.gap_junctions == NULL) { return NO_MEMORY; }
+	cl.gap_junctions_size = num_gap_junctions;
 	// Get each gap junction
-	for (size32_t i = 0; i < _num_gap_junctions; i++) {
-		Gap_Junction &g = _gap_junctions[i];
+	for (size32_t i = 0; i < num_gap_junctions; i++) {
+		Gap_Junction &g = cl.gap_junctions[i];
 		g.read_from(ip, *this);
-		if (ip.done() && i < _num_gap_junctions - 1) { return END_OF_FILE; }
+		if (ip.done() && i < num_gap_junctions - 1) { return END_OF_FILE; }
 #ifdef SHORT_COORDS
 		if (ip.overflow()) { return SIGN_OVERFLOW; }
 #endif
-		// Maintain the joined somas' counts of gap junctions
-		size32_t s1_index = g.soma1_index();
-		if (s1_index >= _num_somas) { return BAD_GAP_JUNCTION_SOMA_ID; }
-		size32_t s2_index = g.soma2_index();
-		if (s2_index >= _num_somas) { return BAD_GAP_JUNCTION_SOMA_ID; }
-		// Update progress
-		if (p && !((i + 1) % denom)) {
-			p->progress((float)(i + 1) / _num_somas);
-			Fl::check();
-			if (p->canceled()) { return CANCELED; }
+		if (g.soma1_index() >= _num_somas || g.soma2_index() >= _num_somas) { return BAD_GAP_JUNCTION_SOMA_ID; }
+		// Let each batch of gap junctions be published
+		if (!((i + 1) % RECORDS_PER_BATCH)) {
+			cl.gap_junctions_read = i + 1;
+			if (cl.stop) { return CANCELED; }
 		}
 	}
-	// Update progress
-	if (p) {
-		p->progress(1.0f);
-		Fl::check();
-		if (p->canceled()) { return CANCELED; }
-	}
+	cl.gap_junctions_read = num_gap_junctions;
 	return SUCCESS;
 }
 
-Read_Status Brain_Model::read_from(Binary_Parser &bp, Progress_Dialog *p) {
+Read_Status Brain_Model::read_somas_from(Binary_Parser &bp, Progress_Dialog *p, Conn_Load &cl,
+	unsigned int sections) {
 	size_t denom = 1;
 	if (p) {
 		p->canceled(false);
 	}
+	clear_connections();
 	// Get the file name and size
 	_filename = bp.filename();
 	_filesize = bp.filesize();
@@ -338,9 +541,13 @@ Read_Status Brain_Model::read_from(Binary_Parser &bp, Progress_Dialog *p) {
 	}
 	// Get the file format version
 	size8_t version = bp.get_size8();
-	if (version < 1 || version > 2) { return BAD_VERSION; }
+	if (version < 1 || version > BINARY_VERSION) { return BAD_VERSION; }
+	cl.version = version;
+	cl.sections = sections;
 	// Get the comment
 	bp.get_string();
+	// Version 3 files are split into chunks; versions 1 and 2 are one sequence
+	if (version >= 3) { return read_chunked_somas_from(bp, p, cl); }
 	// Get the number of types
 	_num_types = bp.get_size8();
 	if (!_num_types) { return NO_TYPES; }
@@ -452,90 +659,461 @@ Read_Status Brain_Model::read_from(Binary_Parser &bp, Progress_Dialog *p) {
 		}
 	}
 	bound(b);
+	index_types();
+	return SUCCESS;
+}
+
+Read_Status Brain_Model::read_connections_from(Binary_Parser &bp, Conn_Load &cl) const {
+	if (cl.version >= 3) { return read_chunked_connections_from(bp, cl); }
 	// Get the number of synapses
 	size64_t num_synapses = bp.get_size64();
 	if (num_synapses > std::numeric_limits<size32_t>::max()) { return WRONG_NUM_SYNAPSES; }
-	_num_synapses = (size32_t)num_synapses;
-	// Prepare to show synapse-parsing progress
-	if (p) {
-		denom = _num_synapses / Progress_Dialog::PROGRESS_STEPS;
-		if (!denom) { denom = 1; }
-		p->message("Parsing synapses...");
-		p->progress(0.0f);
-		Fl::check();
-		if (p->canceled()) { return CANCELED; }
-	}
+	size32_t ny = (size32_t)num_synapses;
 	// Initialize the array of synapses
-	delete [] _synapses;
-	_synapses = _num_synapses > 0 ? new(std::nothrow) Synapse[_num_synapses] : NULL;
-	if (_num_synapses > 0 && _synapses == NULL) { return NO_MEMORY; }
+	cl.synapses = ny > 0 ? new(std::nothrow) Synapse[ny] : NULL;
+	if (ny > 0 && cl.synapses == NULL) { return NO_MEMORY; }
+	cl.synapses_size = ny;
 	// Get each synapse
-	for (size32_t i = 0; i < _num_synapses; i++) {
-		Synapse &y = _synapses[i];
+	for (size32_t i = 0; i < ny; i++) {
+		Synapse &y = cl.synapses[i];
 		y.read_from(bp, *this);
 		if (bp.done()) { return END_OF_FILE; }
 #ifdef SHORT_COORDS
 		if (bp.overflow()) { return SIGN_OVERFLOW; }
 #endif
-		// Maintain the axonal soma's linked list of synapses
-		size32_t a_index = y.axon_soma_index();
-		if (a_index >= _num_somas) { return BAD_SYNAPSE_SOMA_ID; }
-		soma(a_index)->first_axon_syn(&y, i);
-		// Maintain the dendritic soma's linked list of synapses
-		size32_t d_index = y.den_soma_index();
-		if (d_index >= _num_somas) { return BAD_SYNAPSE_SOMA_ID; }
-		soma(d_index)->first_den_syn(&y, i);
-		// Update progress
-		if (p && !((i + 1) % denom)) {
-			p->progress((float)(i + 1) / _num_synapses);
-			Fl::check();
-			if (p->canceled()) { return CANCELED; }
+		if (y.axon_soma_index() >= _num_somas || y.den_soma_index() >= _num_somas) { return BAD_SYNAPSE_SOMA_ID; }
+		// Let each batch of synapses be published
+		if (!((i + 1) % RECORDS_PER_BATCH)) {
+			cl.synapses_read = i + 1;
+			if (cl.stop) { return CANCELED; }
 		}
 	}
+	cl.synapses_read = ny;
 	// Get the number of gap junctions
-	_num_gap_junctions = bp.get_size32();
-	// Prepare to show gap junction-parsing progress
-	if (p) {
-		denom = _num_gap_junctions / Progress_Dialog::PROGRESS_STEPS;
-		if (!denom) { denom = 1; }
-		p->message("Parsing gap junctions...");
-		p->progress(0.0f);
-		Fl::check();
-		if (p->canceled()) { return CANCELED; }
-	}
+	size32_t num_gap_junctions = bp.get_size32();
 	// Initialize the array of gap junctions
-	delete [] _gap_junctions;
-	_gap_junctions = _num_gap_junctions > 0 ? new(std::nothrow) Gap_Junction[_num_gap_junctions] : NULL;
-	if (_num_gap_junctions > 0 && _gap_junctions == NULL) { return NO_MEMORY; }
+	cl.gap_junctions = num_gap_junctions > 0 ? new(std::nothrow) Gap_Junction[num_gap_junctions] : NULL;
+	if (num_gap_junctions > 0 && cl.gap_junctions == NULL) { return NO_MEMORY; }
+	cl.gap_junctions_size = num_gap_junctions;
 	// Get each gap junction
-	for (size32_t i = 0; i < _num_gap_junctions; i++) {
-		Gap_Junction &g = _gap_junctions[i];
+	for (size32_t i = 0; i < num_gap_junctions; i++) {
+		Gap_Junction &g = cl.gap_junctions[i];
 		g.read_from(bp, *this);
-		if (bp.done() && i < _num_gap_junctions - 1) { return END_OF_FILE; }
+		if (bp.done() && i < num_gap_junctions - 1) { return END_OF_FILE; }
 #ifdef SHORT_COORDS
 		if (bp.overflow()) { return SIGN_OVERFLOW; }
 #endif
-		// Maintain the joined somas' counts of gap junctions
-		size32_t s1_index = g.soma1_index();
-		if (s1_index >= _num_somas) { return BAD_GAP_JUNCTION_SOMA_ID; }
-		size32_t s2_index = g.soma2_index();
-		if (s2_index >= _num_somas) { return BAD_GAP_JUNCTION_SOMA_ID; }
+		if (g.soma1_index() >= _num_somas || g.soma2_index() >= _num_somas) { return BAD_GAP_JUNCTION_SOMA_ID; }
+		// Let each batch of gap junctions be published
+		if (!((i + 1) % RECORDS_PER_BATCH)) {
+			cl.gap_junctions_read = i + 1;
+			if (cl.stop) { return CANCELED; }
+		}
+	}
+	cl.gap_junctions_read = num_gap_junctions;
+	return SUCCESS;
+}
+
+// A version 3 binary model file is formatted as:
+//     signature "\aRJV\xF7", version byte, comment string, num_types, type letters, num_somas, num_fields,
+//     num_synapses, num_gap_junctions, records_per_chunk, each soma chunk's first neuritic field index,
+//     chunk table, chunk table checksum, chunks
+// The somas, neuritic fields, synapses, and gap junctions are each split into chunks of records_per_chunk records,
+// in that order, and each record has the same format as in versions 1 and 2. The chunk table gives each chunk's
+// fixed-size offset, uncompressed size, and CRC-32 checksum, followed by the offset of the end of the last chunk.
+// A chunk whose stored size differs from its uncompressed size is compressed with zlib.
+
+typedef Brain_Model::Model_Chunk Model_Chunk;
+
+static size32_t chunks_for(size32_t n, size32_t per_chunk) {
+	return n ? (n - 1) / per_chunk + 1 : 0;
+}
+
+static size64_t checksum(const std::vector<unsigned char> &data) {
+	uLong crc = crc32(0L, Z_NULL, 0);
+	if (!data.empty()) { crc = crc32(crc, &data[0], (uInt)data.size()); }
+	return (size64_t)crc;
+}
+
+// Shows the progress of read_chunks in a dialog, if any, which can cancel it
+struct Dialog_Poll {
+	Progress_Dialog *p;
+	Dialog_Poll(Progress_Dialog *pd) : p(pd) {}
+	Read_Status operator()(float f) const {
+		if (!p) { return SUCCESS; }
+		p->progress(f);
+		Fl::check();
+		return p->canceled() ? CANCELED : SUCCESS;
+	}
+};
+
+// Cancels read_chunks when a background read is told to stop
+struct Stop_Poll {
+	const shared_bool_t &stop;
+	Stop_Poll(const shared_bool_t &s) : stop(s) {}
+	Read_Status operator()(float) const { return stop ? CANCELED : SUCCESS; }
+private:
+	Stop_Poll &operator=(const Stop_Poll &sp); // Unimplemented assignment operator
+};
+
+template<typename Decode, typename Finish, typename Poll>
+static Read_Status read_chunks(Binary_Parser &bp, const std::vector<Model_Chunk> &chunks, size_t first, size_t n,
+	Decode decode, Finish finish, Poll poll) {
+	// Read the chunks in batches, and check, inflate, and parse each batch's chunks in parallel,
+	// then finish each chunk in order
+	size_t batch_size = num_threads() * 2;
+	std::vector<std::vector<unsigned char> > stored(batch_size), raw(batch_size);
+	std::vector<Read_Status> statuses(batch_size);
+	for (size_t c0 = 0; c0 < n; c0 += batch_size) {
+		size_t nb = MIN(batch_size, n - c0);
+		for (size_t b = 0; b < nb; b++) {
+			size_t c = first + c0 + b;
+			size_t z = (size_t)(chunks[c+1].offset - chunks[c].offset);
+			stored[b].resize(z);
+			if (z && bp.get_bytes(z, &stored[b][0]) < z) { return END_OF_FILE; }
+		}
+		parallel_chunks(nb, nb, [&](size_t begin, size_t end, size_t) {
+			for (size_t b = begin; b < end; b++) {
+				const Model_Chunk &k = chunks[first + c0 + b];
+				std::vector<unsigned char> &data = stored[b];
+				if (checksum(data) != k.checksum) {
+					statuses[b] = BAD_CHECKSUM;
+					continue;
+				}
+				if (k.raw_size != data.size()) {
+					raw[b].resize((size_t)k.raw_size);
+					uLongf raw_size = (uLongf)k.raw_size;
+					if (data.empty() || raw[b].empty() ||
+						uncompress(&raw[b][0], &raw_size, &data[0], (uLong)data.size()) != Z_OK ||
+						raw_size != k.raw_size) {
+						statuses[b] = FAILURE;
+						continue;
+					}
+					data.swap(raw[b]);
+				}
+				Buffer_Binary_Parser bbp(data.empty() ? NULL : &data[0], data.size());
+				statuses[b] = decode(bbp, c0 + b);
+				if (statuses[b] == SUCCESS && bbp.overrun()) { statuses[b] = END_OF_FILE; }
+			}
+		});
+		for (size_t b = 0; b < nb; b++) {
+			if (statuses[b] != SUCCESS) { return statuses[b]; }
+			Read_Status status = finish(c0 + b);
+			if (status != SUCCESS) { return status; }
+		}
 		// Update progress
-		if (p && !((i + 1) % denom)) {
-			p->progress((float)(i + 1) / _num_somas);
-			Fl::check();
-			if (p->canceled()) { return CANCELED; }
+		Read_Status status = poll((float)(c0 + nb) / n);
+		if (status != SUCCESS) { return status; }
+	}
+	return SUCCESS;
+}
+
+static Read_Status no_finish(size_t) {
+	return SUCCESS;
+}
+
+Read_Status Brain_Model::read_chunked_somas_from(Binary_Parser &bp, Progress_Dialog *p, Conn_Load &cl) {
+	// Get each type
+	_num_types = bp.get_size8();
+	if (!_num_types) { return NO_TYPES; }
+	delete [] _types;
+	_types = new(std::nothrow) Soma_Type[_num_types];
+	if (_types == NULL) { return NO_MEMORY; }
+	for (size8_t i = 0; i < _num_types; i++) {
+		Soma_Type &t = _types[i];
+		t.read_from(bp);
+		if (t.letter() < 'A' || t.letter() > 'Z') { return BAD_TYPE_LETTER; }
+	}
+	// Get the number of each kind of record
+	_num_somas = bp.get_size32();
+	if (!_num_somas) { return NO_SOMAS; }
+	size32_t num_fields = bp.get_size32();
+	size64_t num_synapses = bp.get_size64();
+	if (num_synapses > std::numeric_limits<size32_t>::max()) { return WRONG_NUM_SYNAPSES; }
+	cl.num_synapses = (size32_t)num_synapses;
+	cl.num_gap_junctions = bp.get_size32();
+	size32_t per_chunk = bp.get_size32();
+	if (!per_chunk) { return FAILURE; }
+	cl.per_chunk = per_chunk;
+	size32_t soma_chunks = chunks_for(_num_somas, per_chunk);
+	size32_t field_chunks = chunks_for(num_fields, per_chunk);
+	size_t num_chunks = (size_t)soma_chunks + field_chunks + chunks_for(cl.num_synapses, per_chunk) +
+		chunks_for(cl.num_gap_junctions, per_chunk);
+	// Get each soma chunk's first neuritic field index
+	std::vector<size32_t> field_starts(soma_chunks + 1);
+	for (size32_t c = 0; c < soma_chunks; c++) {
+		field_starts[c] = bp.get_size32();
+		if (field_starts[c] > num_fields || (c && field_starts[c] < field_starts[c-1])) { return FAILURE; }
+	}
+	field_starts[soma_chunks] = num_fields;
+	// Get the chunk table, and check it against its checksum
+	std::vector<unsigned char> table((num_chunks * 3 + 1) * 8);
+	if (bp.get_bytes(table.size(), &table[0]) < table.size()) { return END_OF_FILE; }
+	if (bp.get_fixed64() != checksum(table)) { return BAD_CHECKSUM; }
+	Buffer_Binary_Parser tbp(&table[0], table.size());
+	std::vector<Model_Chunk> &chunks = cl.chunks;
+	chunks.assign(num_chunks + 1, Model_Chunk());
+	for (size_t c = 0; c <= num_chunks; c++) {
+		Model_Chunk &k = chunks[c];
+		k.offset = tbp.get_fixed64();
+		if (c < num_chunks) {
+			k.raw_size = tbp.get_fixed64();
+			k.checksum = tbp.get_fixed64();
 		}
+		if (c && k.offset < chunks[c-1].offset) { return FAILURE; }
 	}
-	// Update progress
+	if (bp.done()) { return END_OF_FILE; }
+	// Prepare to show soma-parsing progress
 	if (p) {
-		p->progress(1.0f);
+		p->message("Parsing somas...");
+		p->progress(0.0f);
 		Fl::check();
 		if (p->canceled()) { return CANCELED; }
 	}
+	// Initialize the array of somas
+	delete [] _somas;
+	_somas = new(std::nothrow) Soma[_num_somas];
+	if (_somas == NULL) { return NO_MEMORY; }
+	// Get each chunk of somas, keeping track of each chunk's coordinate bounds
+	std::vector<Bounds> chunk_bounds(soma_chunks);
+	Read_Status status = read_chunks(bp, chunks, 0, soma_chunks,
+		[&](Buffer_Binary_Parser &bbp, size_t c) -> Read_Status {
+		size32_t i0 = (size32_t)c * per_chunk, i1 = MIN(i0 + per_chunk, _num_somas);
+		size32_t next_field_index = field_starts[c];
+		for (size32_t i = i0; i < i1; i++) {
+			Soma &s = _somas[i];
+			s.read_from(bbp, next_field_index);
+			next_field_index += (size32_t)s.num_axon_fields() + s.num_den_fields();
+			chunk_bounds[c].update(s.coords());
+		}
+#ifdef SHORT_COORDS
+		if (bbp.overflow()) { return SIGN_OVERFLOW; }
+#endif
+		// Each chunk's neuritic fields must end where the next chunk's begin
+		return next_field_index == field_starts[c+1] ? SUCCESS : FAILURE;
+	}, no_finish, Dialog_Poll(p));
+	if (status != SUCCESS) { return status; }
+	Bounds b;
+	for (size32_t c = 0; c < soma_chunks; c++) {
+		b.update(chunk_bounds[c].min());
+		b.update(chunk_bounds[c].max());
+	}
+	bound(b);
+	index_types();
+	// Get each chunk of neuritic fields, unless they are not needed
+	delete [] _fields;
+	_fields = NULL;
+	_num_fields = 0;
+	size_t first = soma_chunks;
+	if (cl.sections & FIELDS_SECTION) {
+		if (p) {
+			p->message("Parsing neuritic fields...");
+			p->progress(0.0f);
+			Fl::check();
+			if (p->canceled()) { return CANCELED; }
+		}
+		_num_fields = num_fields;
+		_fields = _num_fields > 0 ? new(std::nothrow) Neuritic_Field[_num_fields] : NULL;
+		if (_num_fields > 0 && _fields == NULL) { return NO_MEMORY; }
+		status = read_chunks(bp, chunks, first, field_chunks,
+			[&](Buffer_Binary_Parser &bbp, size_t c) -> Read_Status {
+			size32_t i0 = (size32_t)c * per_chunk, i1 = MIN(i0 + per_chunk, _num_fields);
+			for (size32_t i = i0; i < i1; i++) {
+				_fields[i].read_from(bbp);
+			}
+#ifdef SHORT_COORDS
+			if (bbp.overflow()) { return SIGN_OVERFLOW; }
+#endif
+			return SUCCESS;
+		}, no_finish, Dialog_Poll(p));
+		if (status != SUCCESS) { return status; }
+	}
+	else {
+		// Without their fields, the somas have none
+		for (size32_t i = 0; i < _num_somas; i++) { _somas[i].clear_fields(); }
+		bp.skip(chunks[first + field_chunks].offset - chunks[first].offset);
+	}
+	cl.first_chunk = first + field_chunks;
 	return SUCCESS;
 }
 
+Read_Status Brain_Model::read_chunked_connections_from(Binary_Parser &bp, Conn_Load &cl) const {
+	const std::vector<Model_Chunk> &chunks = cl.chunks;
+	size32_t per_chunk = cl.per_chunk;
+	size32_t synapse_chunks = chunks_for(cl.num_synapses, per_chunk);
+	size32_t gap_junction_chunks = chunks_for(cl.num_gap_junctions, per_chunk);
+	// Get each chunk of synapses, unless they are not needed
+	size_t first = cl.first_chunk;
+	if (cl.sections & SYNAPSES_SECTION) {
+		size32_t ny = cl.num_synapses;
+		cl.synapses = ny > 0 ? new(std::nothrow) Synapse[ny] : NULL;
+		if (ny > 0 && cl.synapses == NULL) { return NO_MEMORY; }
+		cl.synapses_size = ny;
+		Read_Status status = read_chunks(bp, chunks, first, synapse_chunks,
+			[&](Buffer_Binary_Parser &bbp, size_t c) -> Read_Status {
+			size32_t i0 = (size32_t)c * per_chunk, i1 = MIN(i0 + per_chunk, ny);
+			for (size32_t i = i0; i < i1; i++) {
+				Synapse &y = cl.synapses[i];
+				y.read_from(bbp, *this);
+				if (y.axon_soma_index() >= _num_somas || y.den_soma_index() >= _num_somas) {
+					return BAD_SYNAPSE_SOMA_ID;
+				}
+			}
+#ifdef SHORT_COORDS
+			if (bbp.overflow()) { return SIGN_OVERFLOW; }
+#endif
+			return SUCCESS;
+		}, [&](size_t c) -> Read_Status {
+			// Let the chunks of synapses be published in order
+			cl.synapses_read = MIN(((size32_t)c + 1) * per_chunk, ny);
+			return SUCCESS;
+		}, Stop_Poll(cl.stop));
+		if (status != SUCCESS) { return status; }
+	}
+	else {
+		bp.skip(chunks[first + synapse_chunks].offset - chunks[first].offset);
+	}
+	// Get each chunk of gap junctions, unless they are not needed
+	first += synapse_chunks;
+	if (cl.sections & GAP_JUNCTIONS_SECTION) {
+		size32_t ng = cl.num_gap_junctions;
+		cl.gap_junctions = ng > 0 ? new(std::nothrow) Gap_Junction[ng] : NULL;
+		if (ng > 0 && cl.gap_junctions == NULL) { return NO_MEMORY; }
+		cl.gap_junctions_size = ng;
+		Read_Status status = read_chunks(bp, chunks, first, gap_junction_chunks,
+			[&](Buffer_Binary_Parser &bbp, size_t c) -> Read_Status {
+			size32_t i0 = (size32_t)c * per_chunk, i1 = MIN(i0 + per_chunk, ng);
+			for (size32_t i = i0; i < i1; i++) {
+				Gap_Junction &g = cl.gap_junctions[i];
+				g.read_from(bbp, *this);
+				if (g.soma1_index() >= _num_somas || g.soma2_index() >= _num_somas) {
+					return BAD_GAP_JUNCTION_SOMA_ID;
+				}
+			}
+#ifdef SHORT_COORDS
+			if (bbp.overflow()) { return SIGN_OVERFLOW; }
+#endif
+			return SUCCESS;
+		}, [&](size_t c) -> Read_Status {
+			cl.gap_junctions_read = MIN(((size32_t)c + 1) * per_chunk, ng);
+			return SUCCESS;
+		}, Stop_Poll(cl.stop));
+		if (status != SUCCESS) { return status; }
+	}
+	return SUCCESS;
+}
+
+template<typename Encode>
+static bool write_chunks(Binary_Writer &bw, size32_t n, size32_t per_chunk, bool compressed, Progress_Dialog *p,
+	std::vector<Model_Chunk> &chunks, Encode encode) {
+	// Encode and compress the chunks in parallel batches, then write each batch's chunks in order
+	size32_t nc = chunks_for(n, per_chunk);
+	size32_t batch_size = (size32_t)num_threads() * 2;
+	std::vector<std::vector<unsigned char> > stored(batch_size);
+	std::vector<Model_Chunk> batch(batch_size);
+	for (size32_t c0 = 0; c0 < nc; c0 += batch_size) {
+		size32_t nb = MIN(batch_size, nc - c0);
+		parallel_chunks(nb, nb, [&](size_t begin, size_t end, size_t) {
+			for (size_t b = begin; b < end; b++) {
+				size32_t i0 = (c0 + (size32_t)b) * per_chunk, i1 = MIN(i0 + per_chunk, n);
+				Buffer_Binary_Writer bbw;
+				for (size32_t i = i0; i < i1; i++) {
+					encode(bbw, i);
+				}
+				const std::vector<unsigned char> &raw = bbw.data();
+				std::vector<unsigned char> &data = stored[b];
+				data.clear();
+				// Only keep the compressed data if it is smaller
+				if (compressed && !raw.empty()) {
+					uLongf z = compressBound((uLong)raw.size());
+					data.resize(z);
+					if (compress2(&data[0], &z, &raw[0], (uLong)raw.size(), Z_BEST_SPEED) == Z_OK && z < raw.size()) {
+						data.resize(z);
+					}
+					else {
+						data.clear();
+					}
+				}
+				if (data.empty()) { data = raw; }
+				batch[b].raw_size = raw.size();
+				batch[b].checksum = checksum(data);
+			}
+		});
+		for (size32_t b = 0; b < nb; b++) {
+			batch[b].offset = bw.tell();
+			if (!stored[b].empty()) { bw.put_bytes(stored[b].size(), &stored[b][0]); }
+			chunks.push_back(batch[b]);
+		}
+		if (!bw.good()) { return false; }
+		// Update progress
+		if (p) {
+			p->progress((float)(c0 + nb) / nc);
+			Fl::check();
+			if (p->canceled()) { return false; }
+		}
+	}
+	return true;
+}
+
+bool Brain_Model::write_to(Binary_Writer &bw, bool compressed, Progress_Dialog *p) const {
+	if (!_num_somas || !bw.good()) { return false; }
+	// Write the header
+	bw.put_chars(5, "\aRJV\xF7");
+	bw.put_size8(BINARY_VERSION);
+	bw.put_string("Converted from " + _filename);
+	bw.put_size8(_num_types);
+	for (size8_t i = 0; i < _num_types; i++) {
+		bw.put_char(_types[i].letter());
+	}
+	bw.put_unsigned(_num_somas);
+	bw.put_unsigned(_num_fields);
+	bw.put_unsigned(_num_synapses);
+	bw.put_unsigned(_num_gap_junctions);
+	bw.put_unsigned(RECORDS_PER_CHUNK);
+	for (size32_t i = 0; i < _num_somas; i += RECORDS_PER_CHUNK) {
+		bw.put_unsigned(_somas[i].first_axon_field_index());
+	}
+	// Reserve space for the chunk table and its checksum, to be filled in after the chunks are written
+	size_t num_chunks = (size_t)chunks_for(_num_somas, RECORDS_PER_CHUNK) +
+		chunks_for(_num_fields, RECORDS_PER_CHUNK) + chunks_for(_num_synapses, RECORDS_PER_CHUNK) +
+		chunks_for(_num_gap_junctions, RECORDS_PER_CHUNK);
+	size64_t table_place = bw.tell();
+	for (size_t c = 0; c < num_chunks * 3 + 2; c++) { bw.put_fixed64(0); }
+	// Write each section
+	std::vector<Model_Chunk> chunks;
+	if (p) { p->message("Caching somas..."); }
+	if (!write_chunks(bw, _num_somas, RECORDS_PER_CHUNK, compressed, p, chunks, [&](Binary_Writer &cbw, size32_t i) {
+		_somas[i].write_to(cbw);
+	})) { return false; }
+	if (p) { p->message("Caching neuritic fields..."); }
+	if (!write_chunks(bw, _num_fields, RECORDS_PER_CHUNK, compressed, p, chunks, [&](Binary_Writer &cbw, size32_t i) {
+		_fields[i].write_to(cbw);
+	})) { return false; }
+	if (p) { p->message("Caching synapses..."); }
+	if (!write_chunks(bw, _num_synapses, RECORDS_PER_CHUNK, compressed, p, chunks,
+		[&](Binary_Writer &cbw, size32_t i) {
+		_synapses[i].write_to(cbw, *this, i);
+	})) { return false; }
+	if (p) { p->message("Caching gap junctions..."); }
+	if (!write_chunks(bw, _num_gap_junctions, RECORDS_PER_CHUNK, compressed, p, chunks,
+		[&](Binary_Writer &cbw, size32_t i) {
+		_gap_junctions[i].write_to(cbw, *this);
+	})) { return false; }
+	// Fill in the chunk table
+	Buffer_Binary_Writer tbw;
+	for (size_t c = 0; c < num_chunks; c++) {
+		tbw.put_fixed64(chunks[c].offset);
+		tbw.put_fixed64(chunks[c].raw_size);
+		tbw.put_fixed64(chunks[c].checksum);
+	}
+	tbw.put_fixed64(bw.tell());
+	const std::vector<unsigned char> &table = tbw.data();
+	bw.seek(table_place);
+	bw.put_bytes(table.size(), &table[0]);
+	bw.put_fixed64(checksum(table));
+	return bw.close();
+}
+
 static const std::string whitespace(" \f\n\r\t\v");
 
 static void trim(std::string &s, const std::string &t = whitespace) {
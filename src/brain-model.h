@@ -1,6 +1,8 @@
 #ifndef BRAIN_MODEL_H
 #define BRAIN_MODEL_H
 
+#include <vector>
+
 #include "from-file.h"
 #include "bounds.h"
 #include "soma-type.h"
@@ -10,6 +12,8 @@
 #include "firing-spikes.h"
 #include "voltages.h"
 #include "weights.h"
+#include "conn-stats.h"
+#include "parallel.h"
 
 #define CONFIG_SEPARATOR ':'
 #define CONFIG_COMMENT '#'
@@ -17,8 +21,59 @@
 class Progress_Dialog;
 class Input_Parser;
 class Binary_Parser;
+class Binary_Writer;
 
 class Brain_Model : public From_File {
+public:
+	// Sections of a version 3 binary model that can be skipped when they are not needed
+	// (text models and earlier binary versions are always read whole)
+	enum Section { FIELDS_SECTION = 1, SYNAPSES_SECTION = 2, GAP_JUNCTIONS_SECTION = 4, ALL_SECTIONS = 7 };
+	// A version 3 binary model's chunk table entry
+	struct Model_Chunk {
+		size64_t offset, raw_size, checksum;
+		Model_Chunk() : offset(0), raw_size(0), checksum(0) {}
+	};
+	// The state of reading a model's synapses and gap junctions after its somas, possibly on another thread;
+	// the reading thread fills in each array and advances its count of records read, and the model's thread
+	// publishes the records read so far to the model
+	struct Conn_Load {
+		size8_t version;
+		unsigned int sections;
+		size32_t per_chunk, num_synapses, num_gap_junctions;
+		size_t first_chunk;
+		std::vector<Model_Chunk> chunks;
+		Synapse *synapses;
+		Gap_Junction *gap_junctions;
+		bool adopted_synapses, adopted_gap_junctions;
+		shared_size_t synapses_size, gap_junctions_size, synapses_read, gap_junctions_read;
+		shared_bool_t stop;
+		Conn_Load();
+		~Conn_Load();
+		float progress(void) const;
+	private:
+		Conn_Load(const Conn_Load &cl); // Unimplemented copy constructor
+		Conn_Load &operator=(const Conn_Load &cl); // Unimplemented assignment operator
+	};
+	// The soma types' colors and display states at some point, to tell whether anything drawn with them is stale
+	struct Type_Styles {
+		std::vector<const Color *> colors;
+		std::vector<Soma_Type::Display_State> display_states;
+		Type_Styles();
+		bool matches(const Brain_Model &bm) const;
+		void remember(const Brain_Model &bm);
+	};
+private:
+	static const size8_t BINARY_VERSION = 3;
+	static const size32_t RECORDS_PER_CHUNK = 65536;
+	// How many text or version 1 or 2 binary records to read before publishing them
+	static const size32_t RECORDS_PER_BATCH = 16384;
+private:
+	// One type's soma indexes ordered by axonal or dendritic synapse count (then by index), and the
+	// histogram of those counts as (count, first position) bins in ascending order of count
+	struct Syn_Count_Index {
+		std::vector<size32_t> soma_indices;
+		std::vector<std::pair<size32_t, size32_t> > bins;
+	};
 private:
 	size8_t _num_types;
 	Soma_Type *_types;
@@ -34,6 +89,11 @@ private:
 	Firing_Spikes *_firing_spikes;
 	Voltages *_voltages;
 	Weights *_weights;
+	bool _connected;
+	// Soma indexes grouped by type (in index order within each type), with each type's starting position
+	std::vector<size32_t> _type_starts, _type_somas;
+	std::vector<Syn_Count_Index> _axon_syn_counts, _den_syn_counts;
+	mutable Conn_Stats _conn_stats;
 public:
 	Brain_Model();
 	virtual ~Brain_Model();
@@ -41,7 +101,13 @@ public:
 	inline Soma_Type *type(size8_t index) const { return &_types[index]; }
 	inline size32_t num_somas(void) const { return _num_somas; }
 	size32_t soma_index(size32_t id) const;
+	size64_t soma_ids_checksum(void) const;
 	inline Soma *soma(size32_t index) const { return &_somas[index]; }
+	std::pair<const size32_t *, const size32_t *> somas_of_type(size8_t t_index) const;
+	inline size32_t num_somas_of_type(size8_t t_index) const {
+		std::pair<const size32_t *, const size32_t *> typed = somas_of_type(t_index);
+		return (size32_t)(typed.second - typed.first);
+	}
 	inline size32_t num_fields(void) const { return _num_fields; }
 	inline const Neuritic_Field *field(size32_t index) const { return &_fields[index]; }
 	inline size32_t num_synapses(void) const { return _num_synapses; }
@@ -50,6 +116,8 @@ public:
 	inline size32_t num_gap_junctions(void) const { return _num_gap_junctions; }
 	size32_t num_gap_junctions(size32_t index) const;
 	inline Gap_Junction *gap_junction(size32_t index) const { return &_gap_junctions[index]; }
+	std::pair<const size32_t *, const size32_t *> somas_by_syn_count(size8_t t_index, size_t y_count,
+		bool count_den) const;
 	const Bounds &bounds(void) const { return _bounds; }
 	inline void bound(Bounds b) { b.recenter(); _bounds = b; }
 	inline Firing_Spikes *firing_spikes(void) { return _firing_spikes; }
@@ -64,14 +132,30 @@ public:
 	inline const Weights *const_weights(void) const { return _weights; }
 	inline bool has_weights(void) const { return _weights != NULL; }
 	inline void weights(Weights *w) { delete _weights; _weights = w; }
+	inline const Conn_Counts &conn_counts(const Clip_Volume *v) const { return _conn_stats.counts(*this, v); }
 	size32_t start_time(size32_t t);
-	size32_t step_time(void);
+	size32_t step_time(size32_t n = 1);
 	inline bool empty(void) const { return !_num_somas; }
+	inline bool connected(void) const { return _connected; }
 	void clear(void);
 	Read_Status read_from(Input_Parser &ip, Progress_Dialog *p = NULL);
-	Read_Status read_from(Binary_Parser &bp, Progress_Dialog *p = NULL);
+	Read_Status read_from(Binary_Parser &bp, Progress_Dialog *p = NULL, unsigned int sections = ALL_SECTIONS);
+	Read_Status read_somas_from(Input_Parser &ip, Progress_Dialog *p, Conn_Load &cl);
+	Read_Status read_somas_from(Binary_Parser &bp, Progress_Dialog *p, Conn_Load &cl,
+		unsigned int sections = ALL_SECTIONS);
+	Read_Status read_connections_from(Input_Parser &ip, Conn_Load &cl) const;
+	Read_Status read_connections_from(Binary_Parser &bp, Conn_Load &cl) const;
+	bool publish_connections(Conn_Load &cl);
+	void finish_connections(void);
+	bool write_to(Binary_Writer &bw, bool compress, Progress_Dialog *p = NULL) const;
 	Read_Status read_config_from(std::ifstream &ifs) const;
 	void write_config_to(std::ofstream &ofs) const;
+private:
+	void clear_connections(void);
+	Read_Status read_chunked_somas_from(Binary_Parser &bp, Progress_Dialog *p, Conn_Load &cl);
+	Read_Status read_chunked_connections_from(Binary_Parser &bp, Conn_Load &cl) const;
+	void index_types(void);
+	void index_syn_counts(void);
 };
 
 #endif
@@ -55,6 +55,15 @@ void Clip_Volume::copy(const Clip_Volume &v) {
 	_left[0] = v._left[0]; _left[1] = v._left[1]; _left[2] = v._left[2]; _left[3] = v._left[3];
 }
 
+bool Clip_Volume::equals(const Clip_Volume &v) const {
+	for (int i = 0; i < 4; i++) {
+		if (_top[i] != v._top[i] || _right[i] != v._right[i] || _bottom[i] != v._bottom[i] || _left[i] != v._left[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
 void Clip_Volume::reset() {
 	_top[0] = _right[0] = _bottom[0] = _left[0] = 0.0;
 	_top[1] = _right[1] = _bottom[1] = _left[1] = 0.0;
@@ -23,6 +23,7 @@ public:
 	void specify(void) const;
 	void acquire(void);
 	void copy(const Clip_Volume &v);
+	bool equals(const Clip_Volume &v) const;
 	void reset(void);
 	bool contains(const coord_t c[3]) const;
 };
@@ -9,6 +9,24 @@
 #include "algebra.h"
 #include "color-maps.h"
 
+void Color_Map::lookup(const float *s, size_t n, float *cv) const {
+	const float *lut = &_lut[0];
+	for (size_t i = 0; i < n; i++) {
+		float si = s[i];
+		size_t j = si > 0.0f ? si < 1.0f ? (size_t)(si * (LUT_SIZE - 1) + 0.5f) : LUT_SIZE - 1 : 0;
+		cv[i * 3] = lut[j * 3];
+		cv[i * 3 + 1] = lut[j * 3 + 1];
+		cv[i * 3 + 2] = lut[j * 3 + 2];
+	}
+}
+
+void Color_Map::bake() {
+	_lut.resize(LUT_SIZE * 3);
+	for (size_t i = 0; i < LUT_SIZE; i++) {
+		map((float)i / (LUT_SIZE - 1), &_lut[i * 3]);
+	}
+}
+
 void Gradient_Map::initialize(const float (*cs)[3], size_t n) {
 	_color_stops.resize(n);
 	for (size_t i = 0; i < n; i++) {
@@ -16,6 +34,7 @@ void Gradient_Map::initialize(const float (*cs)[3], size_t n) {
 		_color_stops[i].push_back(cs[i][1]);
 		_color_stops[i].push_back(cs[i][2]);
 	}
+	bake();
 }
 
 void Gradient_Map::map(float s, float *cv) const {
@@ -106,7 +125,9 @@ Opposed_Map::Opposed_Map() : Gradient_Map() {
 
 // Adapted from "A colour scheme for the display of astronomical intensity images" (D. A. Green, 2011)
 CubeHelix_Map::CubeHelix_Map(float h, float r, float s, float g) : Color_Map(), _start_hue(h), _rotations(r),
-	_saturation(s), _gamma(g) {}
+	_saturation(s), _gamma(g) {
+	bake();
+}
 
 void CubeHelix_Map::map(float s, float *cv) const {
 	float angle = (float)TWO_PI * (_start_hue / 3.0f + 1.0f + _rotations * s);
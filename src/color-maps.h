@@ -12,10 +12,24 @@ typedef std::vector<float> color_stop_t;
 
 class Color_Map {
 public:
+	static const size_t LUT_SIZE = 4096;
+protected:
+	// The map's colors at LUT_SIZE evenly spaced points, three floats each
+	std::vector<float> _lut;
+public:
+	Color_Map() : _lut() {}
 	virtual ~Color_Map() {}
 	virtual void map(float s, float *cv) const = 0;
 	inline void map_glColor(float s) const { float cv[3]; map(s, cv); glColor3fv(cv); }
+	inline void lookup(float s, float *cv) const { // 0 <= s <= 1
+		size_t i = s > 0.0f ? s < 1.0f ? (size_t)(s * (LUT_SIZE - 1) + 0.5f) : LUT_SIZE - 1 : 0;
+		const float *c = &_lut[i * 3];
+		cv[0] = c[0]; cv[1] = c[1]; cv[2] = c[2];
+	}
+	void lookup(const float *s, size_t n, float *cv) const;
 	virtual void draw(int x, int y, int w, int h) const = 0;
+protected:
+	void bake(void);
 };
 
 class Gradient_Map : public Color_Map {
@@ -0,0 +1,163 @@
+#include <cstddef>
+#include <sstream>
+
+#pragma warning(push, 0)
+#include <FL/Fl.H>
+#pragma warning(pop)
+
+#include "brain-model.h"
+#include "waiting-dialog.h"
+#include "conn-paths.h"
+
+Conn_Paths::Conn_Paths(const Brain_Model &bm, size32_t a_index, size32_t d_index, bool include_disabled) :
+	_model(bm), _a_index(a_index), _d_index(d_index), _include_disabled(include_disabled), _reaches(),
+	_syn_indices(), _path_ends(), _canceled(false) {}
+
+bool Conn_Paths::enabled(size32_t index) const {
+	if (_include_disabled) { return true; }
+	const Soma_Type *t = _model.type(_model.soma(index)->type_index());
+	return t->display_state() != Soma_Type::DISABLED;
+}
+
+void Conn_Paths::find_reaching() {
+	// Breadth-first search backward along dendritic synapses from the destination, so that the path search
+	// only enters somas that can still reach it
+	size32_t n = _model.num_somas();
+	size32_t ny = _model.num_synapses();
+	_reaches.assign(n, false);
+	_reaches[_d_index] = true;
+	std::vector<size32_t> queue(1, _d_index);
+	for (size_t i = 0; i < queue.size(); i++) {
+		const Soma *x = _model.soma(queue[i]);
+		const Synapse *y = NULL;
+		for (size32_t y_index = x->first_den_syn_index(); y_index < ny; y_index = y->next_den_syn_index()) {
+			y = _model.synapse(y_index);
+			size32_t p_index = y->axon_soma_index();
+			if (_reaches[p_index] || !enabled(p_index)) { continue; }
+			_reaches[p_index] = true;
+			queue.push_back(p_index);
+		}
+	}
+}
+
+void Conn_Paths::find_along(size32_t y_index, size_t limit, const shared_bool_t &stop, shared_size_t &n_found,
+	Branch &b, Scratch &s) const {
+	size32_t ny = _model.num_synapses();
+	s.path.assign(1, y_index);
+	size32_t b_index = _model.synapse(y_index)->den_soma_index();
+	if (b_index == _d_index) {
+		b.syn_indices.push_back(y_index);
+		b.path_ends.push_back(b.syn_indices.size());
+		n_found++;
+		return;
+	}
+	if (!_reaches[b_index] || s.on_path[b_index]) { return; }
+	s.on_path[b_index] = true;
+	s.frames.push_back(Frame(b_index, _model.soma(b_index)->first_axon_syn_index()));
+	while (!s.frames.empty()) {
+		if (stop || (limit > 0 && b.path_ends.size() >= limit)) { break; }
+		Frame &f = s.frames.back();
+		size32_t z_index = f.next_syn_index;
+		if (z_index >= ny) {
+			s.on_path[f.soma_index] = false;
+			s.frames.pop_back();
+			s.path.pop_back();
+			continue;
+		}
+		const Synapse *z = _model.synapse(z_index);
+		f.next_syn_index = z->next_axon_syn_index();
+		size32_t c_index = z->den_soma_index();
+		if (c_index == _d_index) {
+			b.syn_indices.insert(b.syn_indices.end(), s.path.begin(), s.path.end());
+			b.syn_indices.push_back(z_index);
+			b.path_ends.push_back(b.syn_indices.size());
+			n_found++;
+		}
+		else if (_reaches[c_index] && !s.on_path[c_index]) {
+			s.on_path[c_index] = true;
+			s.path.push_back(z_index);
+			s.frames.push_back(Frame(c_index, _model.soma(c_index)->first_axon_syn_index()));
+		}
+	}
+	for (std::vector<Frame>::const_iterator it = s.frames.begin(); it != s.frames.end(); ++it) {
+		s.on_path[it->soma_index] = false;
+	}
+	s.frames.clear();
+}
+
+size_t Conn_Paths::find(size_t limit, Waiting_Dialog *w) {
+	_syn_indices.clear();
+	_path_ends.clear();
+	_canceled = false;
+	if (_a_index == _d_index) {
+		_path_ends.push_back(0);
+		return 1;
+	}
+	find_reaching();
+	if (!_reaches[_a_index]) { return 0; }
+	// Each synapse from the source soma starts an independent branch of the search
+	std::vector<size32_t> branch_syns;
+	size32_t ny = _model.num_synapses();
+	const Synapse *y = NULL;
+	for (size32_t y_index = _model.soma(_a_index)->first_axon_syn_index(); y_index < ny;
+		y_index = y->next_axon_syn_index()) {
+		y = _model.synapse(y_index);
+		branch_syns.push_back(y_index);
+	}
+	size_t nb = branch_syns.size();
+	size_t nt = num_threads();
+	if (nt > nb) { nt = nb; }
+	std::vector<Branch> branches(nb);
+	std::vector<Scratch> scratches(nt);
+	for (size_t t = 0; t < nt; t++) {
+		scratches[t].on_path.assign(_model.num_somas(), false);
+		scratches[t].on_path[_a_index] = true;
+	}
+	// A finished branch records its path count plus one, so the paths in a finished prefix of branches
+	// can be counted against the limit
+	std::vector<shared_size_t> finished(nb);
+	for (size_t i = 0; i < nb; i++) { finished[i] = 0; }
+	shared_bool_t stop(false);
+	shared_size_t n_found(0);
+	size_t n_prefix = 0, n_prefix_paths = 0, n_reported = 0;
+	parallel_tasks(nb, nt, [&](size_t i, size_t t) {
+		if (stop) { return; }
+		find_along(branch_syns[i], limit, stop, n_found, branches[i], scratches[t]);
+		if (!stop) { finished[i] = branches[i].path_ends.size() + 1; }
+	}, [&]() {
+		for (; n_prefix < nb && finished[n_prefix] > 0; n_prefix++) {
+			n_prefix_paths += finished[n_prefix] - 1;
+		}
+		if (limit > 0 && n_prefix_paths >= limit) { stop = true; }
+		if (!w) { return; }
+		size_t n = n_found;
+		if (limit > 0 && n > limit) { n = limit; }
+		if (n != n_reported) {
+			std::ostringstream ss;
+			ss.imbue(std::locale(""));
+			ss.setf(std::ios::fixed, std::ios::floatfield);
+			ss << "Synapse paths found: " << n;
+			w->message(ss.str().c_str());
+			n_reported = n;
+		}
+		Fl::check();
+		if (w->canceled()) {
+			_canceled = true;
+			stop = true;
+		}
+	});
+	// Concatenate the branches' paths in depth-first order, up to the limit
+	for (size_t i = 0; i < nb; i++) {
+		const Branch &b = branches[i];
+		size_t np = b.path_ends.size();
+		if (limit > 0 && _path_ends.size() + np > limit) { np = limit - _path_ends.size(); }
+		size_t offset = _syn_indices.size();
+		size_t end = np ? b.path_ends[np-1] : 0;
+		_syn_indices.insert(_syn_indices.end(), b.syn_indices.begin(), b.syn_indices.begin() + (std::ptrdiff_t)end);
+		for (size_t j = 0; j < np; j++) {
+			_path_ends.push_back(offset + b.path_ends[j]);
+		}
+		if (limit > 0 && _path_ends.size() >= limit) { break; }
+	}
+	return _path_ends.size();
+}
@@ -0,0 +1,52 @@
+#ifndef CONN_PATHS_H
+#define CONN_PATHS_H
+
+#include <vector>
+
+#include "utils.h"
+#include "parallel.h"
+
+class Brain_Model;
+class Waiting_Dialog;
+
+// Finds the simple synapse paths from one soma to another, in depth-first order
+class Conn_Paths {
+private:
+	struct Frame {
+		size32_t soma_index, next_syn_index;
+		Frame(size32_t s, size32_t y) : soma_index(s), next_syn_index(y) {}
+	};
+	struct Branch {
+		std::vector<size32_t> syn_indices;
+		std::vector<size_t> path_ends;
+	};
+	struct Scratch {
+		std::vector<bool> on_path;
+		std::vector<Frame> frames;
+		std::vector<size32_t> path;
+	};
+private:
+	const Brain_Model &_model;
+	size32_t _a_index, _d_index;
+	bool _include_disabled;
+	std::vector<bool> _reaches;
+	std::vector<size32_t> _syn_indices;
+	std::vector<size_t> _path_ends;
+	bool _canceled;
+public:
+	Conn_Paths(const Brain_Model &bm, size32_t a_index, size32_t d_index, bool include_disabled);
+	size_t find(size_t limit, Waiting_Dialog *w = NULL);
+	inline size_t num_paths(void) const { return _path_ends.size(); }
+	inline size_t path_length(size_t i) const { return _path_ends[i] - path_begin(i); }
+	inline size32_t path_syn_index(size_t i, size_t j) const { return _syn_indices[path_begin(i) + j]; }
+	inline const std::vector<size32_t> &syn_indices(void) const { return _syn_indices; }
+	inline bool canceled(void) const { return _canceled; }
+private:
+	inline size_t path_begin(size_t i) const { return i ? _path_ends[i-1] : 0; }
+	bool enabled(size32_t index) const;
+	void find_reaching(void);
+	void find_along(size32_t y_index, size_t limit, const shared_bool_t &stop, shared_size_t &n_found, Branch &b,
+		Scratch &s) const;
+};
+
+#endif
@@ -0,0 +1,214 @@
+#include "brain-model.h"
+#include "parallel.h"
+#include "conn-stats.h"
+
+Conn_Counts::Conn_Counts() : num_types(0), num_somas(0), num_synapses(0), soma_counts(), syn_counts() {}
+
+void Conn_Counts::reset(size8_t nt) {
+	num_types = nt;
+	num_somas = num_synapses = 0;
+	soma_counts.assign(nt, 0);
+	syn_counts.assign((size_t)nt * nt, 0);
+}
+
+void Conn_Counts::add(const Conn_Counts &c) {
+	num_somas += c.num_somas;
+	num_synapses += c.num_synapses;
+	for (size_t i = 0; i < soma_counts.size(); i++) { soma_counts[i] += c.soma_counts[i]; }
+	for (size_t i = 0; i < syn_counts.size(); i++) { syn_counts[i] += c.syn_counts[i]; }
+}
+
+Conn_Stats::Conn_Stats() : _has_model_counts(false), _has_clip_counts(false), _model_counts(), _clip_counts(),
+	_clip_volume(), _cells_per_axis(0), _cell_min(), _cell_size(), _cell_starts(), _cell_somas(), _cell_soma_counts(),
+	_cell_syn_counts() {}
+
+void Conn_Stats::clear() {
+	_has_model_counts = _has_clip_counts = false;
+	_model_counts.reset(0);
+	_clip_counts.reset(0);
+	_cells_per_axis = 0;
+	_cell_starts.clear();
+	_cell_somas.clear();
+	_cell_soma_counts.clear();
+	_cell_syn_counts.clear();
+}
+
+const Conn_Counts &Conn_Stats::counts(const Brain_Model &bm, const Clip_Volume *v) {
+	if (!v) {
+		if (!_has_model_counts) {
+			count_model(bm);
+			_has_model_counts = true;
+		}
+		return _model_counts;
+	}
+	if (!_has_clip_counts || !_clip_volume.equals(*v)) {
+		if (!_cells_per_axis) { build_cells(bm); }
+		count_clipped(bm, *v);
+		_clip_volume.copy(*v);
+		_has_clip_counts = true;
+	}
+	return _clip_counts;
+}
+
+void Conn_Stats::count_model(const Brain_Model &bm) {
+	size8_t nt = bm.num_types();
+	size32_t ns = bm.num_somas();
+	size32_t ny = bm.num_synapses();
+	// Count synapses in chunks, each with its own histogram
+	size_t nc = num_chunks(ny, 65536);
+	std::vector<Conn_Counts> partial(nc);
+	parallel_chunks(nc, nc, [&](size_t, size_t, size_t c) {
+		Conn_Counts &cc = partial[c];
+		cc.reset(nt);
+		for (size32_t i = (size32_t)chunk_begin(ny, nc, c); i < (size32_t)chunk_begin(ny, nc, c + 1); i++) {
+			const Synapse *y = bm.synapse(i);
+			size8_t a_type = bm.soma(y->axon_soma_index())->type_index();
+			size8_t d_type = bm.soma(y->den_soma_index())->type_index();
+			cc.syn_counts[(size_t)a_type * nt + d_type]++;
+		}
+		cc.num_synapses = chunk_begin(ny, nc, c + 1) - chunk_begin(ny, nc, c);
+	});
+	_model_counts.reset(nt);
+	for (size_t c = 0; c < nc; c++) { _model_counts.add(partial[c]); }
+	// The somas are already bucketed by type
+	for (size8_t t_index = 0; t_index < nt; t_index++) {
+		_model_counts.soma_counts[t_index] = bm.num_somas_of_type(t_index);
+	}
+	_model_counts.num_somas = ns;
+}
+
+void Conn_Stats::build_cells(const Brain_Model &bm) {
+	size8_t nt = bm.num_types();
+	size32_t ns = bm.num_somas();
+	size32_t ny = bm.num_synapses();
+	// Use about SOMAS_PER_CELL somas per cell, within limits on the grid size and the cells' total histogram size
+	size32_t g = 1;
+	while (g < MAX_CELLS_PER_AXIS && (size_t)(g + 1) * (g + 1) * (g + 1) * SOMAS_PER_CELL <= ns &&
+		(size_t)(g + 1) * (g + 1) * (g + 1) * nt * nt <= MAX_CELL_COUNTS) {
+		g++;
+	}
+	_cells_per_axis = g;
+	size_t ncells = (size_t)g * g * g;
+	double lo[3] = {0.0, 0.0, 0.0}, hi[3] = {0.0, 0.0, 0.0};
+	for (size32_t i = 0; i < ns; i++) {
+		const coord_t *c = bm.soma(i)->coords();
+		for (int k = 0; k < 3; k++) {
+			if (!i || c[k] < lo[k]) { lo[k] = c[k]; }
+			if (!i || c[k] > hi[k]) { hi[k] = c[k]; }
+		}
+	}
+	for (int k = 0; k < 3; k++) {
+		_cell_min[k] = lo[k];
+		_cell_size[k] = hi[k] > lo[k] ? (hi[k] - lo[k]) / g : 1.0;
+	}
+	// Bucket the somas by cell, keeping them in index order
+	std::vector<size32_t> soma_cells(ns);
+	_cell_starts.assign(ncells + 1, 0);
+	for (size32_t i = 0; i < ns; i++) {
+		const coord_t *c = bm.soma(i)->coords();
+		size32_t cell = 0;
+		for (int k = 2; k >= 0; k--) {
+			size32_t ck = (size32_t)((c[k] - _cell_min[k]) / _cell_size[k]);
+			if (ck >= g) { ck = g - 1; }
+			cell = cell * g + ck;
+		}
+		soma_cells[i] = cell;
+		_cell_starts[cell + 1]++;
+	}
+	for (size_t cell = 0; cell < ncells; cell++) { _cell_starts[cell + 1] += _cell_starts[cell]; }
+	_cell_somas.resize(ns);
+	std::vector<size32_t> next(_cell_starts.begin(), _cell_starts.end() - 1);
+	for (size32_t i = 0; i < ns; i++) {
+		_cell_somas[next[soma_cells[i]]++] = i;
+	}
+	// Count each cell's somas and their axonal synapses
+	_cell_soma_counts.assign(ncells * nt, 0);
+	_cell_syn_counts.assign(ncells * nt * nt, 0);
+	parallel_chunks(ncells, num_chunks(ncells, 1), [&](size_t begin, size_t end, size_t) {
+		for (size_t cell = begin; cell < end; cell++) {
+			size32_t *soma_counts = &_cell_soma_counts[cell * nt];
+			size32_t *syn_counts = &_cell_syn_counts[cell * nt * nt];
+			for (size32_t j = _cell_starts[cell]; j < _cell_starts[cell + 1]; j++) {
+				const Soma *s = bm.soma(_cell_somas[j]);
+				size8_t a_type = s->type_index();
+				soma_counts[a_type]++;
+				const Synapse *y = NULL;
+				for (size32_t y_index = s->first_axon_syn_index(); y_index < ny; y_index = y->next_axon_syn_index()) {
+					y = bm.synapse(y_index);
+					syn_counts[a_type * nt + bm.soma(y->den_soma_index())->type_index()]++;
+				}
+			}
+		}
+	});
+}
+
+int Conn_Stats::classify_cell(size32_t cell, const Clip_Volume &v) const {
+	size32_t g = _cells_per_axis;
+	size32_t ck[3] = {cell % g, (cell / g) % g, cell / g / g};
+	double lo[3], hi[3];
+	for (int k = 0; k < 3; k++) {
+		lo[k] = _cell_min[k] + ck[k] * _cell_size[k];
+		hi[k] = lo[k] + _cell_size[k];
+	}
+	// A cell is inside the clip volume if all its corners are inside every plane,
+	// and outside if all its corners are outside any one plane
+	const double *planes[4] = {v.top(), v.right(), v.bottom(), v.left()};
+	bool inside = true;
+	for (int p = 0; p < 4; p++) {
+		const double *e = planes[p];
+		int n_in = 0;
+		for (int i = 0; i < 8; i++) {
+			double x = i & 1 ? hi[0] : lo[0], y = i & 2 ? hi[1] : lo[1], z = i & 4 ? hi[2] : lo[2];
+			if (x * e[0] + y * e[1] + z * e[2] + e[3] >= 0.0) { n_in++; }
+		}
+		if (!n_in) { return -1; }
+		if (n_in < 8) { inside = false; }
+	}
+	return inside ? 1 : 0;
+}
+
+void Conn_Stats::count_clipped(const Brain_Model &bm, const Clip_Volume &v) {
+	size8_t nt = bm.num_types();
+	size32_t ny = bm.num_synapses();
+	size_t ncells = (size_t)_cells_per_axis * _cells_per_axis * _cells_per_axis;
+	// Cells entirely inside the clip volume contribute their counts directly;
+	// only the somas in cells on its boundary need to be checked individually
+	size_t nc = num_chunks(ncells, 1);
+	std::vector<Conn_Counts> partial(nc);
+	parallel_chunks(ncells, nc, [&](size_t begin, size_t end, size_t c) {
+		Conn_Counts &cc = partial[c];
+		cc.reset(nt);
+		for (size_t cell = begin; cell < end; cell++) {
+			int k = classify_cell((size32_t)cell, v);
+			if (k < 0) { continue; }
+			if (k > 0) {
+				const size32_t *soma_counts = &_cell_soma_counts[cell * nt];
+				for (size8_t t = 0; t < nt; t++) {
+					cc.soma_counts[t] += soma_counts[t];
+					cc.num_somas += soma_counts[t];
+				}
+				const size32_t *syn_counts = &_cell_syn_counts[cell * nt * nt];
+				for (size_t t = 0; t < (size_t)nt * nt; t++) {
+					cc.syn_counts[t] += syn_counts[t];
+					cc.num_synapses += syn_counts[t];
+				}
+				continue;
+			}
+			for (size32_t j = _cell_starts[cell]; j < _cell_starts[cell + 1]; j++) {
+				const Soma *s = bm.soma(_cell_somas[j]);
+				if (!v.contains(s->coords())) { continue; }
+				size8_t a_type = s->type_index();
+				cc.soma_counts[a_type]++;
+				cc.num_somas++;
+				const Synapse *y = NULL;
+				for (size32_t y_index = s->first_axon_syn_index(); y_index < ny; y_index = y->next_axon_syn_index()) {
+					y = bm.synapse(y_index);
+					cc.syn_counts[(size_t)a_type * nt + bm.soma(y->den_soma_index())->type_index()]++;
+					cc.num_synapses++;
+				}
+			}
+		}
+	});
+	_clip_counts.reset(nt);
+	for (size_t c = 0; c < nc; c++) { _clip_counts.add(partial[c]); }
+}
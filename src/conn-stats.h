@@ -0,0 +1,51 @@
+#ifndef CONN_STATS_H
+#define CONN_STATS_H
+
+#include <vector>
+
+#include "utils.h"
+#include "clip-volume.h"
+
+class Brain_Model;
+
+// Soma counts by type and axonal synapse counts by pair of types (row = axonal soma's type)
+struct Conn_Counts {
+	size8_t num_types;
+	size_t num_somas, num_synapses;
+	std::vector<size_t> soma_counts, syn_counts;
+	Conn_Counts();
+	void reset(size8_t nt);
+	void add(const Conn_Counts &c);
+	inline size_t syn_count(size8_t a_type, size8_t d_type) const {
+		return syn_counts[(size_t)a_type * num_types + d_type];
+	}
+};
+
+// Counts the connections between soma types in the whole model or in a clip volume, caching the results
+// until the model or clip volume changes
+class Conn_Stats {
+private:
+	static const size32_t MAX_CELLS_PER_AXIS = 16;
+	static const size32_t SOMAS_PER_CELL = 256;
+	static const size_t MAX_CELL_COUNTS = 1 << 24;
+private:
+	bool _has_model_counts, _has_clip_counts;
+	Conn_Counts _model_counts, _clip_counts;
+	Clip_Volume _clip_volume;
+	// Somas bucketed into a uniform grid of cells, with each cell's own counts
+	size32_t _cells_per_axis;
+	double _cell_min[3], _cell_size[3];
+	std::vector<size32_t> _cell_starts, _cell_somas;
+	std::vector<size32_t> _cell_soma_counts, _cell_syn_counts;
+public:
+	Conn_Stats();
+	void clear(void);
+	const Conn_Counts &counts(const Brain_Model &bm, const Clip_Volume *v);
+private:
+	void count_model(const Brain_Model &bm);
+	void build_cells(const Brain_Model &bm);
+	void count_clipped(const Brain_Model &bm, const Clip_Volume &v);
+	int classify_cell(size32_t cell, const Clip_Volume &v) const;
+};
+
+#endif
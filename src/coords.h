@@ -17,6 +17,7 @@ typedef int16_t coord_t;
 #define UNIT_COORD 1
 #define MIN_COORD ((std::numeric_limits<coord_t>::min)())
 #define MAX_COORD ((std::numeric_limits<coord_t>::max)())
+#define GL_COORD GL_SHORT
 #define glVertex3c glVertex3s
 #define glVertex3cv glVertex3sv
 #define glRasterPos3c glRasterPos3s
@@ -28,6 +29,7 @@ typedef int32_t coord_t;
 #define UNIT_COORD 1
 #define MIN_COORD ((std::numeric_limits<coord_t>::min)())
 #define MAX_COORD ((std::numeric_limits<coord_t>::max)())
+#define GL_COORD GL_INT
 #define glVertex3c glVertex3i
 #define glVertex3cv glVertex3iv
 #define glRasterPos3c glRasterPos3i
@@ -39,6 +41,7 @@ typedef float coord_t;
 #define UNIT_COORD 1.0f
 #define MIN_COORD (-(std::numeric_limits<coord_t>::max)())
 #define MAX_COORD ((std::numeric_limits<coord_t>::max)())
+#define GL_COORD GL_FLOAT
 #define glVertex3c glVertex3f
 #define glVertex3cv glVertex3fv
 #define glRasterPos3c glRasterPos3f
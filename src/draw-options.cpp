@@ -5,5 +5,20 @@ Draw_Options::Draw_Options() : _axon_conns(true), _den_conns(false), _gap_juncti
 	_allow_letters(false), _only_show_selected(false), _only_conn_selected(false), _only_show_marked(false),
 	_only_show_clipped(true), _only_enable_clipped(false), _orthographic(false), _left_handed(false),
 	_show_rotation_guide(true), _show_axes(true), _show_axis_labels(true), _show_bulletin(false), _show_fps(false),
-	_invert_background(false), _display(STATIC_MODEL), _display_value_for_somas(false), _show_inactive_somas(true),
-	_show_color_scale(true), _weights_color_after(true) {}
+	_show_profiler(false), _invert_background(false), _display(STATIC_MODEL), _display_value_for_somas(false),
+	_show_inactive_somas(true), _show_color_scale(true), _weights_color_after(true) {}
+
+bool Draw_Options::equals(const Draw_Options &o) const {
+	return _axon_conns == o._axon_conns && _den_conns == o._den_conns && _gap_junctions == o._gap_junctions &&
+		_neur_fields == o._neur_fields && _conn_fields == o._conn_fields && _syn_dots == o._syn_dots &&
+		_to_axon == o._to_axon && _to_via == o._to_via && _to_synapse == o._to_synapse && _to_den == o._to_den &&
+		_allow_letters == o._allow_letters && _only_show_selected == o._only_show_selected &&
+		_only_conn_selected == o._only_conn_selected && _only_show_marked == o._only_show_marked &&
+		_only_show_clipped == o._only_show_clipped && _only_enable_clipped == o._only_enable_clipped &&
+		_orthographic == o._orthographic && _left_handed == o._left_handed &&
+		_show_rotation_guide == o._show_rotation_guide && _show_axes == o._show_axes &&
+		_show_axis_labels == o._show_axis_labels && _show_bulletin == o._show_bulletin && _show_fps == o._show_fps &&
+		_show_profiler == o._show_profiler && _invert_background == o._invert_background && _display == o._display &&
+		_display_value_for_somas == o._display_value_for_somas && _show_inactive_somas == o._show_inactive_somas &&
+		_show_color_scale == o._show_color_scale && _weights_color_after == o._weights_color_after;
+}
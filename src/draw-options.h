@@ -10,12 +10,14 @@ private:
 	bool _allow_letters, _only_show_selected, _only_conn_selected, _only_show_marked;
 	bool _only_show_clipped, _only_enable_clipped;
 	bool _orthographic, _left_handed;
-	bool _show_rotation_guide, _show_axes, _show_axis_labels, _show_bulletin, _show_fps, _invert_background;
+	bool _show_rotation_guide, _show_axes, _show_axis_labels, _show_bulletin, _show_fps, _show_profiler;
+	bool _invert_background;
 	Display _display;
 	bool _display_value_for_somas, _show_inactive_somas, _show_color_scale;
 	bool _weights_color_after;
 public:
 	Draw_Options();
+	bool equals(const Draw_Options &o) const;
 	inline bool axon_conns(void) const { return _axon_conns; }
 	inline void axon_conns(bool b) { _axon_conns = b; }
 	inline bool den_conns(void) const { return _den_conns; }
@@ -62,6 +64,8 @@ public:
 	inline void show_bulletin(bool b) { _show_bulletin = b; }
 	inline bool show_fps(void) const { return _show_fps; }
 	inline void show_fps(bool b) { _show_fps = b; }
+	inline bool show_profiler(void) const { return _show_profiler; }
+	inline void show_profiler(bool b) { _show_profiler = b; }
 	inline bool invert_background(void) const { return _invert_background; }
 	inline void invert_background(bool b) { _invert_background = b; }
 	inline Display display(void) const { return _display; }
@@ -3,6 +3,8 @@
 #include <string>
 #include <sstream>
 #include <cmath>
+#include <cstddef>
+#include <algorithm>
 
 #pragma warning(push, 0)
 #include <FL/Fl.H>
@@ -12,19 +14,25 @@
 #include "algebra.h"
 #include "color-maps.h"
 #include "input-parser.h"
+#include "binary-parser.h"
+#include "binary-writer.h"
 #include "progress-dialog.h"
 #include "soma.h"
 #include "brain-model.h"
+#include "parallel.h"
 #include "firing-spikes.h"
 
 const float Firing_Spikes::FADE_ALPHA = 0.96f;
+const float Firing_Spikes::MAX_HERTZ = 1000.0f;
 
 Firing_Spikes::Firing_Spikes(const Brain_Model *bm) : Sim_Data(bm, new Rainbow_Map()), _timescale(1.0f),
-	_spike_counts(NULL), _fade_strengths(NULL), _suppression_strengths(NULL), _spikes(NULL) {
+	_spike_counts(NULL), _fade_strengths(NULL), _suppression_strengths(NULL), _spikes(NULL), _spike_starts(), _spike_times() {
 	size32_t n = num_somas();
 	_spike_counts = new(std::nothrow) size16_t[n]();
 	_fade_strengths = new(std::nothrow) float[n]();
 	_suppression_strengths = new(std::nothrow) size8_t[n]();
+	_spike_starts.assign((size_t)n + 1, 0);
+	bake_scale(0.0f, MAX_HERTZ);
 }
 
 Firing_Spikes::~Firing_Spikes() {
@@ -58,38 +66,66 @@ size32_t Firing_Spikes::start_time(size32_t t) {
 	return new_time;
 }
 
-size32_t Firing_Spikes::step_time() {
+size32_t Firing_Spikes::step_time(size32_t n) {
 	size32_t prev_time = _time;
-	size32_t new_time = Sim_Data::step_time();
+	size32_t new_time = Sim_Data::step_time(n);
 	if (new_time == prev_time) { return new_time; }
-	// Decay fade and suppression strengths for all somas
+	step_strengths(prev_time, new_time, _spike_counts, _fade_strengths, _suppression_strengths);
+	return new_time;
+}
+
+void Firing_Spikes::copy_window(Window &w) const {
+	size32_t n = num_somas();
+	w.time = _time;
+	w.spike_counts.assign(_spike_counts, _spike_counts + n);
+	w.fade_strengths.assign(_fade_strengths, _fade_strengths + n);
+	w.suppression_strengths.assign(_suppression_strengths, _suppression_strengths + n);
+}
+
+void Firing_Spikes::step_window(Window &w, size32_t n) const {
+	size32_t new_time = n < max_time() - w.time ? w.time + n : max_time();
+	if (new_time <= w.time || w.spike_counts.empty()) { return; }
+	step_strengths(w.time, new_time, &w.spike_counts[0], &w.fade_strengths[0], &w.suppression_strengths[0]);
+	w.time = new_time;
+}
+
+void Firing_Spikes::step_strengths(size32_t prev_time, size32_t new_time, size16_t *counts, float *fades,
+	size8_t *suppressions) const {
+	// Decay fade and suppression strengths for all somas by all the cycles stepped at once
+	size32_t k = new_time - prev_time;
+	std::vector<float> powers(1, 1.0f);
+	while (powers.size() <= k && powers.back() > 0.0f) { powers.push_back(powers.back() * FADE_ALPHA); }
+	float fade = powers.size() > k ? powers[k] : 0.0f;
+	size8_t suppression = (size8_t)MIN(k, (size32_t)SUPPRESSION_DURATION);
 	for (size32_t i = 0; i < num_somas(); i++) {
-		_fade_strengths[i] *= FADE_ALPHA;
-		if (_suppression_strengths[i] > 0) { _suppression_strengths[i]--; }
+		fades[i] *= fade;
+		suppressions[i] = suppressions[i] > suppression ? suppressions[i] - suppression : 0;
 	}
-	// Increment spike counts for somas fired now
-	const spikes_instance_t &firing = _spikes[_time];
-	for (spikes_instance_t::const_iterator f = firing.begin(); f != firing.end(); ++f) {
-		size32_t i = f->first;
-		if (f->second & SUPPRESSED) {
-			_suppression_strengths[i] = SUPPRESSION_DURATION;
-		}
-		else {
-			_spike_counts[i]++;
-			_fade_strengths[i] = 1.0f;
-			_suppression_strengths[i] = 0;
+	for (size32_t t = prev_time + 1; t <= new_time; t++) {
+		// Increment spike counts for somas fired at each cycle, with the strengths they decayed to since then
+		size32_t age = new_time - t;
+		const spikes_instance_t &firing = _spikes[t];
+		for (spikes_instance_t::const_iterator f = firing.begin(); f != firing.end(); ++f) {
+			size32_t i = f->first;
+			if (f->second & SUPPRESSED) {
+				suppressions[i] = age < SUPPRESSION_DURATION ? (size8_t)(SUPPRESSION_DURATION - age) : 0;
+			}
+			else {
+				counts[i]++;
+				fades[i] = age < powers.size() ? powers[age] : 0.0f;
+				suppressions[i] = 0;
+			}
 		}
-	}
-	if (_time - _start_time >= WINDOW_SIZE) {
-		// Decrement spike counts for somas fired just outside the window
-		const spikes_instance_t &fired = _spikes[_time - WINDOW_SIZE];
-		for (spikes_instance_t::const_iterator f = fired.begin(); f != fired.end(); ++f) {
-			if (f->second & UNSUPPRESSED) {
-				_spike_counts[f->first]--;
+		if (t - _start_time >= WINDOW_SIZE) {
+			// Decrement spike counts for somas fired just outside the window
+			const spikes_instance_t &fired = _spikes[t - WINDOW_SIZE];
+			for (spikes_instance_t::const_iterator f = fired.begin(); f != fired.end(); ++f) {
+				if (!(f->second & SUPPRESSED)) {
+					counts[f->first]--;
+				}
 			}
 		}
 	}
-	return new_time;
 }
 
 bool Firing_Spikes::firing_or_suppressing(size32_t index) const {
@@ -97,6 +133,11 @@ bool Firing_Spikes::firing_or_suppressing(size32_t index) const {
 	return it != _spikes[_time].end();
 }
 
+bool Firing_Spikes::window_firing_or_suppressing(const Window &w, size32_t index) const {
+	spikes_instance_t::const_iterator it = _spikes[w.time].find(index);
+	return it != _spikes[w.time].end();
+}
+
 bool Firing_Spikes::firing(size32_t index) const {
 	spikes_instance_t::const_iterator it = _spikes[_time].find(index);
 	return it != _spikes[_time].end() && (it->second & UNSUPPRESSED);
@@ -108,7 +149,67 @@ bool Firing_Spikes::suppressing(size32_t index) const {
 }
 
 float Firing_Spikes::hertz(size32_t index) const {
-	return _spike_counts[index] * _timescale * 1000.0f / MIN(WINDOW_SIZE, MAX(_time - _start_time + 1, MIN_WINDOW_SIZE));
+	return hertz_at(_spike_counts[index], _time, _start_time);
+}
+
+float Firing_Spikes::hertz_at(size16_t count, size32_t time, size32_t start) const {
+	return count * _timescale * 1000.0f / MIN(WINDOW_SIZE, MAX(time - start + 1, MIN_WINDOW_SIZE));
+}
+
+size_t Firing_Spikes::num_spikes(size32_t index, size32_t a, size32_t b) const {
+	if (a > b || _spike_times.empty()) { return 0; }
+	const size32_t *begin = &_spike_times[0] + _spike_starts[index];
+	const size32_t *end = &_spike_times[0] + _spike_starts[index+1];
+	return (size_t)(std::upper_bound(begin, end, b) - std::lower_bound(begin, end, a));
+}
+
+float Firing_Spikes::hertz(size32_t index, size32_t a, size32_t b) const {
+	if (a > b) { return 0.0f; }
+	return num_spikes(index, a, b) * _timescale * 1000.0f / (b - a + 1);
+}
+
+bool Firing_Spikes::average_hertz(size32_t index, size32_t start, size32_t stop, size32_t step,
+	std::vector<float> &averages) const {
+	size_t n = num_spikes(index);
+	if (start > stop || !step || !n) { return false; }
+	const size32_t *times = spike_times(index);
+	const size32_t *first = std::lower_bound(times, times + n, start);
+	const size32_t *last = std::upper_bound(first, times + n, stop);
+	if (first == last) { return false; }
+	size32_t n_intervals = (stop - start + 1) / step;
+	averages.assign(n_intervals, 0.0f);
+	// The window holds the spikes in [lo, hi), which only change at spike times and when they fall out of the window,
+	// so the cycles with an empty window (and zero frequency) are skipped
+	const size32_t *lo = first, *hi = first;
+	for (size32_t t = *first; t <= stop; t++) {
+		while (hi != last && *hi <= t) { ++hi; }
+		while (lo != hi && *lo + WINDOW_SIZE <= t) { ++lo; }
+		if (lo == hi) {
+			if (hi == last) { break; }
+			t = *hi - 1;
+			continue;
+		}
+		size32_t i = (t - start) / step;
+		if (i >= n_intervals) { break; }
+		averages[i] += hertz_at((size16_t)(hi - lo), t, start);
+	}
+	for (size32_t i = 0; i < n_intervals; i++) { averages[i] /= step; }
+	return true;
+}
+
+size32_t Firing_Spikes::prev_spike_time(size32_t index) const {
+	const size32_t *begin = spike_times(index);
+	if (begin == NULL) { return _time; }
+	const size32_t *it = std::lower_bound(begin, begin + num_spikes(index), _time);
+	return it == begin ? _time : *(it - 1);
+}
+
+size32_t Firing_Spikes::next_spike_time(size32_t index) const {
+	const size32_t *begin = spike_times(index);
+	if (begin == NULL) { return _time; }
+	const size32_t *end = begin + num_spikes(index);
+	const size32_t *it = std::upper_bound(begin, end, _time);
+	return it == end ? _time : *it;
 }
 
 float Firing_Spikes::scale(float hz) const { // 1 <= hz <= 1000
@@ -129,10 +230,15 @@ float Firing_Spikes::quantity(float s) const { // 0 <= s <= 1
 }
 
 void Firing_Spikes::color(size32_t index, const Soma_Type *, float *cv, bool invert) const {
+	color_at(_spike_counts[index], _fade_strengths[index], _suppression_strengths[index], _time, cv, invert);
+}
+
+void Firing_Spikes::color_at(size16_t count, float fade, size8_t suppression, size32_t time, float *cv,
+	bool invert) const {
 	const float *incv = invert ? INVERT_INACTIVE_SOMA_COLOR : INACTIVE_SOMA_COLOR;
-	if (active(index)) {
+	if (count || suppression) {
 		float strength = 0.0f;
-		if (_suppression_strengths[index] > 0) {
+		if (suppression > 0) {
 			// Color suppressing somas purple
 			float intensity = (incv[0] + incv[1] + incv[2]) / 3.0f;
 			if (intensity < 0.5f) {
@@ -141,14 +247,12 @@ void Firing_Spikes::color(size32_t index, const Soma_Type *, float *cv, bool inv
 			else {
 				cv[0] = 1.0f; cv[1] = 0.6875f; cv[2] = 0.875f;
 			}
-			strength = (float)_suppression_strengths[index] / SUPPRESSION_DURATION;
+			strength = (float)suppression / SUPPRESSION_DURATION;
 		}
 		else {
 			// Color firing somas by frequency
-			float hz = hertz(index);
-			float s = scale(hz);
-			_color_map->map(s, cv);
-			strength = _fade_strengths[index];
+			map_color(hertz_at(count, time, _start_time), cv);
+			strength = fade;
 		}
 		cv[0] = cv[0] * strength + incv[0] * (1.0f - strength);
 		cv[1] = cv[1] * strength + incv[1] * (1.0f - strength);
@@ -160,6 +264,56 @@ void Firing_Spikes::color(size32_t index, const Soma_Type *, float *cv, bool inv
 	}
 }
 
+void Firing_Spikes::colors(const size32_t *indexes, size_t n, float *cv, bool invert) const {
+	colors_at(_spike_counts, _fade_strengths, _suppression_strengths, _time, indexes, n, cv, invert);
+}
+
+void Firing_Spikes::window_colors(const Window &w, float *cv, bool invert) const {
+	size32_t n = num_somas();
+	if (!n) { return; }
+	colors_at(&w.spike_counts[0], &w.fade_strengths[0], &w.suppression_strengths[0], w.time, NULL, n, cv, invert);
+}
+
+void Firing_Spikes::colors_at(const size16_t *counts, const float *fades, const size8_t *suppressions, size32_t time,
+	const size32_t *indexes, size_t n, float *cv, bool invert) const {
+	// Color the somas like color_at() does, with NULL indexes meaning the first n somas in order
+	const float *incv = invert ? INVERT_INACTIVE_SOMA_COLOR : INACTIVE_SOMA_COLOR;
+	// Suppressing somas are purple
+	static const float DARK_PURPLE[3] = {0.21875f, 0.0f, 0.15625f}, LIGHT_PURPLE[3] = {1.0f, 0.6875f, 0.875f};
+	const float *sucv = (incv[0] + incv[1] + incv[2]) / 3.0f < 0.5f ? DARK_PURPLE : LIGHT_PURPLE;
+	float hz[BATCH_SIZE];
+	for (size_t i0 = 0; i0 < n; i0 += BATCH_SIZE) {
+		size_t k = MIN(n - i0, BATCH_SIZE);
+		// Map a block of frequencies to colors at once
+		for (size_t j = 0; j < k; j++) {
+			size_t index = indexes ? indexes[i0 + j] : i0 + j;
+			hz[j] = hertz_at(counts[index], time, _start_time);
+		}
+		float *block = cv + i0 * 3;
+		map_colors(hz, k, block);
+		// Then blend each soma's fade or suppression strength into its color
+		for (size_t j = 0; j < k; j++) {
+			size_t index = indexes ? indexes[i0 + j] : i0 + j;
+			float *c = block + j * 3;
+			float strength;
+			if (suppressions[index] > 0) {
+				c[0] = sucv[0]; c[1] = sucv[1]; c[2] = sucv[2];
+				strength = (float)suppressions[index] / SUPPRESSION_DURATION;
+			}
+			else if (counts[index]) {
+				strength = fades[index];
+			}
+			else {
+				c[0] = incv[0]; c[1] = incv[1]; c[2] = incv[2];
+				continue;
+			}
+			c[0] = c[0] * strength + incv[0] * (1.0f - strength);
+			c[1] = c[1] * strength + incv[1] * (1.0f - strength);
+			c[2] = c[2] * strength + incv[2] * (1.0f - strength);
+		}
+	}
+}
+
 void Firing_Spikes::bright_color(size32_t index, const Soma_Type *, float *cv, bool invert) const {
 	const float *incv = invert ? INVERT_INACTIVE_SOMA_COLOR : INACTIVE_SOMA_COLOR;
 	if (active(index)) {
@@ -175,9 +329,7 @@ void Firing_Spikes::bright_color(size32_t index, const Soma_Type *, float *cv, b
 		}
 		else {
 			// Color firing somas by frequency
-			float hz = hertz(index);
-			float s = scale(hz);
-			_color_map->map(s, cv);
+			map_color(hertz(index), cv);
 		}
 	}
 	else {
@@ -186,6 +338,43 @@ void Firing_Spikes::bright_color(size32_t index, const Soma_Type *, float *cv, b
 	}
 }
 
+void Firing_Spikes::count_spikes() {
+	// Count each soma's spikes in _spike_starts[index+1], as the text read_from does while parsing
+	size32_t n = num_somas();
+	size_t nc = num_chunks(n, 4096);
+	_spike_starts.assign((size_t)n + 1, 0);
+	parallel_chunks(n, nc, [&](size_t lo, size_t hi, size_t) {
+		for (size32_t t = 0; t < _num_cycles; t++) {
+			const spikes_instance_t &firing = _spikes[t];
+			spikes_instance_t::const_iterator f = firing.lower_bound((size32_t)lo);
+			for (; f != firing.end() && f->first < hi; ++f) {
+				if (!(f->second & SUPPRESSED)) { _spike_starts[f->first+1]++; }
+			}
+		}
+	});
+}
+
+void Firing_Spikes::index_spikes() {
+	// A counting sort by soma: each soma's spikes have been counted in _spike_starts[index+1],
+	// so their offsets are a prefix sum away, and one more pass over the cycles fills in the times.
+	// Each thread handles a range of somas, so each soma's times are filled in order without contention.
+	size32_t n = num_somas();
+	size_t nc = num_chunks(n, 4096);
+	for (size32_t i = 0; i < n; i++) { _spike_starts[i+1] += _spike_starts[i]; }
+	_spike_times.resize(_spike_starts[n]);
+	parallel_chunks(n, nc, [&](size_t lo, size_t hi, size_t) {
+		std::vector<size_t> next(_spike_starts.begin() + (std::ptrdiff_t)lo,
+			_spike_starts.begin() + (std::ptrdiff_t)hi);
+		for (size32_t t = 0; t < _num_cycles; t++) {
+			const spikes_instance_t &firing = _spikes[t];
+			spikes_instance_t::const_iterator f = firing.lower_bound((size32_t)lo);
+			for (; f != firing.end() && f->first < hi; ++f) {
+				if (!(f->second & SUPPRESSED)) { _spike_times[next[f->first-lo]++] = t; }
+			}
+		}
+	});
+}
+
 Read_Status Firing_Spikes::read_from(Input_Parser &ip, Progress_Dialog *p) {
 	if (_spike_counts == NULL || _fade_strengths == NULL) { return NO_MEMORY; }
 	size_t denom = 1;
@@ -221,6 +410,8 @@ Read_Status Firing_Spikes::read_from(Input_Parser &ip, Progress_Dialog *p) {
 	delete [] _spikes;
 	_spikes = new(std::nothrow) spikes_instance_t[_num_cycles];
 	if (_spikes == NULL) { return NO_MEMORY; }
+	_spike_starts.assign((size_t)num_somas() + 1, 0);
+	_spike_times.clear();
 	// Get each cycle
 	for (size32_t i = 0; i < _num_cycles; i++) {
 		// A line defining a cycle is formatted as:
@@ -236,7 +427,13 @@ Read_Status Firing_Spikes::read_from(Input_Parser &ip, Progress_Dialog *p) {
 			if (state == NOTHING) { continue; }
 			size32_t index = _model->soma_index(id);
 			if (index >= num_somas()) { return BAD_SOMA_ID; }
-			firing_somas[index] = state;
+			// Count each soma's spikes for indexing them later
+			std::pair<spikes_instance_t::iterator, bool> f = firing_somas.insert(std::make_pair(index, state));
+			if (!f.second) {
+				if (!(f.first->second & SUPPRESSED)) { _spike_starts[index+1]--; }
+				f.first->second = state;
+			}
+			if (!(state & SUPPRESSED)) { _spike_starts[index+1]++; }
 		}
 		// Update progress
 		if (p && !((i + 1) % denom)) {
@@ -245,6 +442,144 @@ Read_Status Firing_Spikes::read_from(Input_Parser &ip, Progress_Dialog *p) {
 			if (p->canceled()) { return CANCELED; }
 		}
 	}
+	// Index the spikes by soma
+	index_spikes();
+	if (p) {
+		p->progress(1.0f);
+		Fl::check();
+		if (p->canceled()) { return CANCELED; }
+	}
+	return SUCCESS;
+}
+
+// A binary firing spikes file is formatted as:
+//     signature "\aRJF\xF7", version byte, comment string, micros_per_cycle, num_somas, fixed-size soma_ids_checksum,
+//     num_cycles, cycles_per_chunk, num_chunks + 1 fixed-size chunk offsets, chunks
+// The checksum of the model's soma IDs in index order keeps the soma indices from being read against another model
+// with as many somas.
+// Each chunk holds cycles_per_chunk cycles, and each cycle is formatted as:
+//     (num_spikes << 2 | state_format) soma_index_delta_1 ... soma_index_delta_n [states]
+// where the soma indices ascend and each is stored as the difference from the previous one, and the states are
+// all NORMAL and omitted (format 0), packed two to a byte (format 1), or one to a byte (format 2).
+
+Read_Status Firing_Spikes::read_chunk(const unsigned char *data, size_t n, size32_t t0, size32_t t1) {
+	Buffer_Binary_Parser bbp(data, n);
+	size32_t ns = num_somas();
+	std::vector<size32_t> indices;
+	for (size32_t t = t0; t < t1; t++) {
+		spikes_instance_t &firing_somas = _spikes[t];
+		size64_t h = bbp.get_unsigned();
+		size64_t num_spikes = h >> 2;
+		size8_t format = (size8_t)(h & 0x3);
+		if (bbp.overrun()) { return END_OF_FILE; }
+		if (num_spikes > ns || format > 2) { return FAILURE; }
+		indices.resize((size_t)num_spikes);
+		size64_t index = 0;
+		for (size_t j = 0; j < num_spikes; j++) {
+			index += bbp.get_unsigned();
+			if (index >= ns) { return BAD_SOMA_ID; }
+			indices[j] = (size32_t)index;
+		}
+		size8_t packed = 0;
+		for (size_t j = 0; j < num_spikes; j++) {
+			Firing_State state = NORMAL;
+			if (format == 1) {
+				if (!(j & 1)) { packed = bbp.get_size8(); }
+				state = (Firing_State)(j & 1 ? packed & 0xF : packed >> 4);
+			}
+			else if (format == 2) {
+				state = (Firing_State)bbp.get_size8();
+			}
+			// The indices ascend, so each insertion goes at the end
+			firing_somas.insert(firing_somas.end(), std::make_pair(indices[j], state));
+		}
+		if (bbp.overrun()) { return END_OF_FILE; }
+	}
+	return SUCCESS;
+}
+
+Read_Status Firing_Spikes::read_from(Binary_Parser &bp, Progress_Dialog *p) {
+	if (_spike_counts == NULL || _fade_strengths == NULL) { return NO_MEMORY; }
+	// Get the file name and size
+	_filename = bp.filename();
+	_filesize = bp.filesize();
+	// Get the file signature
+	char sig[5];
+	bp.get_chars(5, sig);
+	if (sig[0] != '\a' || sig[1] != 'R' || sig[2] != 'J' || sig[3] != 'F' || sig[4] != '\xF7') {
+		return BAD_SIGNATURE;
+	}
+	// Get the file format version
+	size8_t version = bp.get_size8();
+	if (version != 1) { return BAD_VERSION; }
+	// Get the comment
+	bp.get_string();
+	// Get the microseconds per cycle
+	size32_t micros_per_cycle = bp.get_size32();
+	if (!micros_per_cycle) { return FAILURE; }
+	_timescale = 1000.0f / micros_per_cycle;
+	// Get the number of somas
+	size32_t somas_in_model = bp.get_size32();
+	if (somas_in_model != num_somas()) { return WRONG_NUM_SOMAS; }
+	// Check that the soma indices refer to this model's somas
+	if (bp.get_fixed64() != _model->soma_ids_checksum()) { return WRONG_MODEL; }
+	// Get the number of cycles
+	_num_cycles = bp.get_size32();
+	if (!_num_cycles) { return NO_CYCLES; }
+	// Get the chunk offsets
+	size32_t cycles_per_chunk = bp.get_size32();
+	if (!cycles_per_chunk) { return FAILURE; }
+	size32_t num_chunks = (_num_cycles - 1) / cycles_per_chunk + 1;
+	std::vector<size64_t> offsets(num_chunks + 1);
+	for (size32_t c = 0; c <= num_chunks; c++) {
+		offsets[c] = bp.get_fixed64();
+		if (c && offsets[c] < offsets[c-1]) { return FAILURE; }
+	}
+	if (bp.done() && offsets[num_chunks] > offsets[0]) { return END_OF_FILE; }
+	// Prepare to show spike-parsing progress
+	if (p) {
+		p->message("Parsing firing spikes...");
+		p->progress(0.0f);
+		Fl::check();
+		if (p->canceled()) { return CANCELED; }
+	}
+	// Initialize the array of firing spikes
+	delete [] _spikes;
+	_spikes = new(std::nothrow) spikes_instance_t[_num_cycles];
+	if (_spikes == NULL) { return NO_MEMORY; }
+	_spike_times.clear();
+	// Read the chunks in batches, and parse each batch's chunks in parallel
+	size32_t batch_size = (size32_t)num_threads() * 2;
+	std::vector<std::vector<unsigned char> > batch(batch_size);
+	std::vector<Read_Status> statuses(batch_size);
+	for (size32_t c0 = 0; c0 < num_chunks; c0 += batch_size) {
+		size32_t nb = MIN(batch_size, num_chunks - c0);
+		for (size32_t b = 0; b < nb; b++) {
+			size_t n = (size_t)(offsets[c0+b+1] - offsets[c0+b]);
+			batch[b].resize(n);
+			if (n && bp.get_bytes(n, &batch[b][0]) < n) { return END_OF_FILE; }
+		}
+		parallel_chunks(nb, nb, [&](size_t begin, size_t end, size_t) {
+			for (size_t b = begin; b < end; b++) {
+				size32_t c = c0 + (size32_t)b;
+				size32_t t0 = c * cycles_per_chunk, t1 = MIN(t0 + cycles_per_chunk, _num_cycles);
+				const std::vector<unsigned char> &data = batch[b];
+				statuses[b] = read_chunk(data.empty() ? NULL : &data[0], data.size(), t0, t1);
+			}
+		});
+		for (size32_t b = 0; b < nb; b++) {
+			if (statuses[b] != SUCCESS) { return statuses[b]; }
+		}
+		// Update progress
+		if (p) {
+			p->progress((float)(c0 + nb) / num_chunks);
+			Fl::check();
+			if (p->canceled()) { return CANCELED; }
+		}
+	}
+	// Index the spikes by soma
+	count_spikes();
+	index_spikes();
 	if (p) {
 		p->progress(1.0f);
 		Fl::check();
@@ -252,3 +587,70 @@ Read_Status Firing_Spikes::read_from(Input_Parser &ip, Progress_Dialog *p) {
 	}
 	return SUCCESS;
 }
+
+bool Firing_Spikes::write_to(Binary_Writer &bw, Progress_Dialog *p) const {
+	if (_spikes == NULL || !bw.good()) { return false; }
+	size_t denom = 1;
+	// Write the header
+	bw.put_chars(5, "\aRJF\xF7");
+	bw.put_size8(1);
+	bw.put_string("Converted from " + _filename);
+	bw.put_unsigned((size32_t)(1000.0f / _timescale + 0.5f));
+	bw.put_unsigned(num_somas());
+	bw.put_fixed64(_model->soma_ids_checksum());
+	bw.put_unsigned(_num_cycles);
+	bw.put_unsigned(CYCLES_PER_CHUNK);
+	// Reserve space for the chunk offsets, to be filled in after the chunks are written
+	size32_t num_chunks = (_num_cycles - 1) / CYCLES_PER_CHUNK + 1;
+	std::vector<size64_t> offsets(num_chunks + 1);
+	size64_t offsets_place = bw.tell();
+	for (size32_t c = 0; c <= num_chunks; c++) { bw.put_fixed64(0); }
+	// Prepare to show spike-writing progress
+	if (p) {
+		denom = _num_cycles / Progress_Dialog::PROGRESS_STEPS;
+		if (!denom) { denom = 1; }
+		p->message("Caching firing spikes...");
+		p->progress(0.0f);
+		Fl::check();
+		if (p->canceled()) { return false; }
+	}
+	// Write each cycle
+	for (size32_t t = 0; t < _num_cycles; t++) {
+		if (!(t % CYCLES_PER_CHUNK)) { offsets[t / CYCLES_PER_CHUNK] = bw.tell(); }
+		const spikes_instance_t &firing = _spikes[t];
+		size8_t format = 0;
+		for (spikes_instance_t::const_iterator f = firing.begin(); f != firing.end(); ++f) {
+			if (f->second > 0xF) { format = 2; break; }
+			if (f->second != NORMAL) { format = 1; }
+		}
+		bw.put_unsigned((size64_t)firing.size() << 2 | format);
+		size32_t prev_index = 0;
+		for (spikes_instance_t::const_iterator f = firing.begin(); f != firing.end(); ++f) {
+			bw.put_unsigned(f->first - prev_index);
+			prev_index = f->first;
+		}
+		size_t j = 0;
+		size8_t packed = 0;
+		for (spikes_instance_t::const_iterator f = firing.begin(); f != firing.end(); ++f, j++) {
+			if (format == 1) {
+				if (j & 1) { bw.put_size8(packed | (size8_t)f->second); }
+				else { packed = (size8_t)(f->second << 4); }
+			}
+			else if (format == 2) {
+				bw.put_size8((size8_t)f->second);
+			}
+		}
+		if (format == 1 && (j & 1)) { bw.put_size8(packed); }
+		// Update progress
+		if (p && !((t + 1) % denom)) {
+			p->progress((float)(t + 1) / _num_cycles);
+			Fl::check();
+			if (p->canceled()) { return false; }
+		}
+	}
+	offsets[num_chunks] = bw.tell();
+	// Fill in the chunk offsets
+	bw.seek(offsets_place);
+	for (size32_t c = 0; c <= num_chunks; c++) { bw.put_fixed64(offsets[c]); }
+	return bw.close();
+}
@@ -2,6 +2,7 @@
 #define FIRING_SPIKES_H
 
 #include <map>
+#include <vector>
 
 #include "utils.h"
 #include "algebra.h"
@@ -11,35 +12,83 @@ typedef std::map<size32_t, Firing_State> spikes_instance_t;
 
 class Progress_Dialog;
 class Input_Parser;
+class Binary_Parser;
+class Binary_Writer;
 
 class Firing_Spikes : public virtual Sim_Data {
+public:
+	// A copy of the spike window's state, which can be stepped and colored apart from the shown time
+	struct Window {
+		size32_t time;
+		std::vector<size16_t> spike_counts;
+		std::vector<float> fade_strengths;
+		std::vector<size8_t> suppression_strengths;
+	};
 private:
 	static const size32_t WINDOW_SIZE = 1000;
 	static const size32_t MIN_WINDOW_SIZE = 5;
 	static const float FADE_ALPHA;
+	static const float MAX_HERTZ;
 	static const size8_t SUPPRESSION_DURATION = 10;
+	static const size32_t CYCLES_PER_CHUNK = 1000;
 private:
 	float _timescale;
 	size16_t *_spike_counts;
 	float *_fade_strengths;
 	size8_t *_suppression_strengths;
 	spikes_instance_t *_spikes;
+	// Each soma's firing times in ascending order, with the somas' runs of times concatenated
+	std::vector<size_t> _spike_starts;
+	std::vector<size32_t> _spike_times;
 public:
 	Firing_Spikes(const Brain_Model *bm);
 	~Firing_Spikes();
 	inline float timescale(void) const { return _timescale; }
 	virtual size32_t start_time(size32_t t);
-	virtual size32_t step_time(void);
+	virtual size32_t step_time(size32_t n = 1);
 	inline virtual bool active(size32_t index) const { return _spike_counts[index] || _suppression_strengths[index]; }
 	bool firing_or_suppressing(size32_t index) const;
 	bool firing(size32_t index) const;
 	bool suppressing(size32_t index) const;
 	float hertz(size32_t index) const;
+	inline size_t num_spikes(size32_t index) const { return _spike_starts[index+1] - _spike_starts[index]; }
+	size_t num_spikes(size32_t index, size32_t a, size32_t b) const;
+	inline const size32_t *spike_times(size32_t index) const {
+		return _spike_times.empty() ? NULL : &_spike_times[0] + _spike_starts[index];
+	}
+	float hertz(size32_t index, size32_t a, size32_t b) const;
+	// Averages the frequency that hertz() would give over each interval of step cycles while stepping from start
+	// to stop, or returns false if the soma has no spikes in that time
+	bool average_hertz(size32_t index, size32_t start, size32_t stop, size32_t step,
+		std::vector<float> &averages) const;
+	size32_t prev_spike_time(size32_t index) const;
+	size32_t next_spike_time(size32_t index) const;
 	virtual float scale(float hz) const;
 	virtual float quantity(float s) const;
 	virtual void color(size32_t index, const Soma_Type *t, float *cv, bool invert) const;
 	virtual void bright_color(size32_t index, const Soma_Type *t, float *cv, bool invert) const;
+	// Colors n somas like color() does, three floats each
+	void colors(const size32_t *indexes, size_t n, float *cv, bool invert) const;
+	void copy_window(Window &w) const;
+	void step_window(Window &w, size32_t n) const;
+	inline bool window_active(const Window &w, size32_t index) const {
+		return w.spike_counts[index] || w.suppression_strengths[index];
+	}
+	bool window_firing_or_suppressing(const Window &w, size32_t index) const;
+	void window_colors(const Window &w, float *cv, bool invert) const;
 	Read_Status read_from(Input_Parser &ip, Progress_Dialog *p);
+	Read_Status read_from(Binary_Parser &bp, Progress_Dialog *p);
+	bool write_to(Binary_Writer &bw, Progress_Dialog *p) const;
+private:
+	void step_strengths(size32_t prev_time, size32_t new_time, size16_t *counts, float *fades,
+		size8_t *suppressions) const;
+	float hertz_at(size16_t count, size32_t time, size32_t start) const;
+	void color_at(size16_t count, float fade, size8_t suppression, size32_t time, float *cv, bool invert) const;
+	void colors_at(const size16_t *counts, const float *fades, const size8_t *suppressions, size32_t time,
+		const size32_t *indexes, size_t n, float *cv, bool invert) const;
+	Read_Status read_chunk(const unsigned char *data, size_t n, size32_t t0, size32_t t1);
+	void count_spikes(void);
+	void index_spikes(void);
 };
 
 #endif
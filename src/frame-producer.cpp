@@ -0,0 +1,77 @@
+#include "frame-producer.h"
+
+Frame_Producer::Frame_Producer(const Firing_Spikes &fd, bool invert) : _firing_spikes(fd), _invert(invert), _window(),
+	_frames(NUM_FRAMES), _produced(0), _consumed(0), _next_time(0), _stop(false)
+#ifdef __THREADS__
+	, _thread()
+#endif
+	{}
+
+Frame_Producer::~Frame_Producer() {
+	stop();
+}
+
+void Frame_Producer::start() {
+	stop();
+	// Start from a copy of the window at the shown time
+	_firing_spikes.copy_window(_window);
+	_produced = _consumed = 0;
+	_next_time = (size_t)_window.time + 1;
+	_stop = false;
+	// Produce frames on another thread
+	// (Visual Studio 2010 has no C++11 threads, so no frames are produced there and playback colors the somas itself)
+#ifdef __THREADS__
+	if (_firing_spikes.num_somas()) { _thread = std::thread(&Frame_Producer::run, this); }
+#endif
+}
+
+void Frame_Producer::stop() {
+	_stop = true;
+#ifdef __THREADS__
+	if (_thread.joinable()) { _thread.join(); }
+#endif
+}
+
+void Frame_Producer::run() {
+#ifdef __THREADS__
+	size32_t max_time = _firing_spikes.max_time();
+	while (!_stop) {
+		if (_produced - _consumed >= NUM_FRAMES || _window.time >= max_time) {
+			// Wait for playback to catch up
+			std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+			continue;
+		}
+		// Step to the next cycle, or skip ahead to just after the cycle that playback is showing
+		size_t t = _next_time;
+		_firing_spikes.step_window(_window, t > _window.time ? (size32_t)(t - _window.time) : 1);
+		produce(_frames[_produced % NUM_FRAMES]);
+		_produced++;
+	}
+#endif
+}
+
+void Frame_Producer::produce(Frame &f) {
+	size32_t n = _firing_spikes.num_somas();
+	f.time = _window.time;
+	f.colors.resize((size_t)n * 3);
+	f.states.resize(n);
+	for (size32_t i = 0; i < n; i++) {
+		if (!_firing_spikes.window_active(_window, i)) {
+			f.states[i] = INACTIVE;
+			continue;
+		}
+		bool firing = _firing_spikes.window_firing_or_suppressing(_window, i);
+		f.states[i] = firing ? ACTIVE | FIRING_OR_SUPPRESSING : ACTIVE;
+	}
+	// Color all the somas at once; inactive ones get the inactive color, though they are not drawn
+	if (n) { _firing_spikes.window_colors(_window, &f.colors[0], _invert); }
+}
+
+const Frame_Producer::Frame *Frame_Producer::frame(size32_t t) {
+	_next_time = (size_t)t + 1;
+	// Skip the frames that playback has already passed; the frame returned is not reused until the next call
+	while (_consumed < _produced && _frames[_consumed % NUM_FRAMES].time < t) { _consumed++; }
+	if (_consumed == _produced) { return NULL; }
+	const Frame &f = _frames[_consumed % NUM_FRAMES];
+	return f.time == t ? &f : NULL;
+}
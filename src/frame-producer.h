@@ -0,0 +1,51 @@
+#ifndef FRAME_PRODUCER_H
+#define FRAME_PRODUCER_H
+
+#include <vector>
+
+#include "utils.h"
+#include "parallel.h"
+#include "firing-spikes.h"
+
+// Steps a copy of the firing spikes' window ahead of the shown time on a background thread, computing the somas'
+// colors for the next few cycles into a ring of frames, so that playback only has to draw them; the firing spikes
+// must not be seeked or deleted until the producer is stopped
+class Frame_Producer {
+public:
+	static const size_t NUM_FRAMES = 8;
+	enum Soma_State { INACTIVE = 0x0, ACTIVE = 0x1, FIRING_OR_SUPPRESSING = 0x2 };
+	struct Frame {
+		size32_t time;
+		std::vector<float> colors;
+		std::vector<size8_t> states;
+		inline const float *color(size32_t index) const { return &colors[(size_t)index * 3]; }
+		inline bool active(size32_t index) const { return (states[index] & ACTIVE) != 0; }
+		inline bool firing_or_suppressing(size32_t index) const {
+			return (states[index] & FIRING_OR_SUPPRESSING) != 0;
+		}
+	};
+private:
+	const Firing_Spikes &_firing_spikes;
+	bool _invert;
+	Firing_Spikes::Window _window;
+	std::vector<Frame> _frames;
+	shared_size_t _produced, _consumed, _next_time;
+	shared_bool_t _stop;
+#ifdef __THREADS__
+	std::thread _thread;
+#endif
+public:
+	Frame_Producer(const Firing_Spikes &fd, bool invert);
+	~Frame_Producer();
+	inline bool invert(void) const { return _invert; }
+	void start(void);
+	void stop(void);
+	const Frame *frame(size32_t t);
+private:
+	void run(void);
+	void produce(Frame &f);
+	Frame_Producer(const Frame_Producer &fp); // Unimplemented copy constructor
+	Frame_Producer &operator=(const Frame_Producer &fp); // Unimplemented assignment operator
+};
+
+#endif
@@ -38,6 +38,12 @@ size_t filesize(const char *f) {
 	return r ? 0 : (size_t)s.st_size;
 }
 
+time_t modified_time(const char *f) {
+	struct stat64 s;
+	int r = stat64(f, &s);
+	return r ? 0 : (time_t)s.st_mtime;
+}
+
 std::string read_status_message(Read_Status status, const char *filename) {
 	std::string msg;
 	switch (status) {
@@ -74,9 +80,15 @@ std::string read_status_message(Read_Status status, const char *filename) {
 		return msg + "Could not parse " + filename + "!\nInvalid soma ID for synapse.";
 	case BAD_GAP_JUNCTION_SOMA_ID:
 		return msg + "Could not parse " + filename + "!\nInvalid soma ID for gap junction.";
+	case BAD_SYNAPSE_INDEX:
+		return msg + "Could not parse " + filename + "!\nInvalid synapse index.";
 	case BAD_SIGNATURE:
 		return msg + "Could not parse " + filename + "!\nInvalid file signature.";
 	case BAD_VERSION:
 		return msg + "Could not parse " + filename + "!\nUnsupported file format version.";
+	case BAD_CHECKSUM:
+		return msg + "Could not parse " + filename + "!\nThe file is corrupted.";
+	case WRONG_MODEL:
+		return msg + "Could not parse " + filename + "!\nThe file belongs to a different model.";
 	}
 }
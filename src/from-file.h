@@ -2,11 +2,12 @@
 #define FROM_FILE_H
 
 #include <string>
+#include <ctime>
 
 enum Read_Status {
 	SUCCESS, FAILURE, CANCELED, END_OF_FILE, SIGN_OVERFLOW, NO_MEMORY, NO_TYPES, NO_SOMAS, NO_CYCLES, WRONG_NUM_SOMAS,
 	WRONG_NUM_SYNAPSES, WRONG_NUM_CYCLES, BAD_TYPE_LETTER, BAD_SOMA_ID, BAD_SYNAPSE_SOMA_ID, BAD_GAP_JUNCTION_SOMA_ID,
-	BAD_SIGNATURE, BAD_VERSION
+	BAD_SYNAPSE_INDEX, BAD_SIGNATURE, BAD_VERSION, BAD_CHECKSUM, WRONG_MODEL
 };
 
 class From_File {
@@ -24,6 +25,7 @@ public:
 };
 
 size_t filesize(const char *f);
+time_t modified_time(const char *f);
 std::string read_status_message(Read_Status status, const char *filename);
 
 #endif
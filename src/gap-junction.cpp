@@ -1,13 +1,10 @@
-#pragma warning(push, 0)
-#include <FL/gl.h>
-#include <FL/glu.h>
-#pragma warning(pop)
-
 #include "coords.h"
 #include "utils.h"
 #include "input-parser.h"
 #include "binary-parser.h"
+#include "binary-writer.h"
 #include "brain-model.h"
+#include "geometry-batch.h"
 #include "gap-junction.h"
 
 Gap_Junction::Gap_Junction() : _soma1_index(NULL_INDEX), _soma2_index(NULL_INDEX), _coords() {}
@@ -16,15 +13,10 @@ Gap_Junction::~Gap_Junction() {
 	_soma1_index = _soma2_index = NULL_INDEX;
 }
 
-void Gap_Junction::draw(const Soma *s1, const Soma *s2) const {
-	glBegin(GL_POINTS);
-	glVertex3cv(_coords);
-	glEnd();
-	glBegin(GL_LINE_STRIP);
-	glVertex3cv(s1->coords());
-	glVertex3cv(_coords);
-	glVertex3cv(s2->coords());
-	glEnd();
+void Gap_Junction::draw(Geometry_Batch &b, const Soma *s1, const Soma *s2) const {
+	b.point(_coords);
+	b.line(s1->coords(), _coords);
+	b.line(_coords, s2->coords());
 }
 
 void Gap_Junction::read_from(Input_Parser &ip, const Brain_Model &bm) {
@@ -42,3 +34,9 @@ void Gap_Junction::read_from(Binary_Parser &bp, const Brain_Model &bm) {
 	_soma2_index = bm.soma_index(bp.get_size32());
 	_coords[0] = bp.get_coord(); _coords[1] = bp.get_coord(); _coords[2] = bp.get_coord();
 }
+
+void Gap_Junction::write_to(Binary_Writer &bw, const Brain_Model &bm) const {
+	bw.put_unsigned(bm.soma(_soma1_index)->id());
+	bw.put_unsigned(bm.soma(_soma2_index)->id());
+	bw.put_signed((int32_t)_coords[0]); bw.put_signed((int32_t)_coords[1]); bw.put_signed((int32_t)_coords[2]);
+}
@@ -6,7 +6,9 @@
 
 class Input_Parser;
 class Binary_Parser;
+class Binary_Writer;
 class Brain_Model;
+class Geometry_Batch;
 
 class Gap_Junction {
 private:
@@ -21,9 +23,10 @@ public:
 	inline size32_t soma1_index(void) const { return _soma1_index; }
 	inline size32_t soma2_index(void) const { return _soma2_index; }
 	inline const coord_t *coords(void) const { return _coords; }
-	void draw(const Soma *s1, const Soma *s2) const;
+	void draw(Geometry_Batch &b, const Soma *s1, const Soma *s2) const;
 	void read_from(Input_Parser &ip, const Brain_Model &bm);
 	void read_from(Binary_Parser &bp, const Brain_Model &bm);
+	void write_to(Binary_Writer &bw, const Brain_Model &bm) const;
 };
 
 #endif
@@ -0,0 +1,98 @@
+#pragma warning(push, 0)
+#include <FL/gl.h>
+#pragma warning(pop)
+
+#include "geometry-batch.h"
+
+Geometry_Batch::Geometry_Batch() : _batches(), _color(), _point_size(1.0f), _dotted(false), _current(0) {}
+
+bool Geometry_Batch::empty() const {
+	for (std::vector<Batch>::const_iterator it = _batches.begin(); it != _batches.end(); ++it) {
+		if (!it->vertices.empty()) { return false; }
+	}
+	return true;
+}
+
+void Geometry_Batch::clear() {
+	// Keep the batches and their capacity, since the same kinds of shapes are likely to be added again
+	for (std::vector<Batch>::iterator it = _batches.begin(); it != _batches.end(); ++it) {
+		it->vertices.clear();
+		it->colors.clear();
+	}
+	_point_size = 1.0f;
+	_dotted = false;
+}
+
+Geometry_Batch::Batch &Geometry_Batch::batch(Primitive p) {
+	// Consecutive shapes usually go in the same batch as the previous one
+	if (_current < _batches.size()) {
+		Batch &b = _batches[_current];
+		if (b.primitive == p && (p == LINES ? b.dotted == _dotted : b.point_size == _point_size)) { return b; }
+	}
+	for (_current = 0; _current < _batches.size(); _current++) {
+		Batch &b = _batches[_current];
+		if (b.primitive == p && (p == LINES ? b.dotted == _dotted : b.point_size == _point_size)) { return b; }
+	}
+	Batch b;
+	b.primitive = p;
+	b.point_size = p == POINTS ? _point_size : 1.0f;
+	b.dotted = p == LINES && _dotted;
+	_batches.push_back(b);
+	return _batches.back();
+}
+
+void Geometry_Batch::vertex(Batch &b, coord_t x, coord_t y, coord_t z) {
+	b.vertices.push_back(x);
+	b.vertices.push_back(y);
+	b.vertices.push_back(z);
+	b.colors.insert(b.colors.end(), _color, _color + 3);
+}
+
+void Geometry_Batch::point(const coord_t *p) {
+	Batch &b = batch(POINTS);
+	vertex(b, p[0], p[1], p[2]);
+}
+
+void Geometry_Batch::line(const coord_t *p, const coord_t *q) {
+	Batch &b = batch(LINES);
+	vertex(b, p[0], p[1], p[2]);
+	vertex(b, q[0], q[1], q[2]);
+}
+
+void Geometry_Batch::box(const coord_t *min, const coord_t *max) {
+	Batch &b = batch(LINES);
+	// Draw the four edges parallel to each axis
+	for (int i = 0; i < 4; i++) {
+		coord_t y = i & 1 ? max[1] : min[1], z = i & 2 ? max[2] : min[2];
+		vertex(b, min[0], y, z);
+		vertex(b, max[0], y, z);
+	}
+	for (int i = 0; i < 4; i++) {
+		coord_t x = i & 1 ? max[0] : min[0], z = i & 2 ? max[2] : min[2];
+		vertex(b, x, min[1], z);
+		vertex(b, x, max[1], z);
+	}
+	for (int i = 0; i < 4; i++) {
+		coord_t x = i & 1 ? max[0] : min[0], y = i & 2 ? max[1] : min[1];
+		vertex(b, x, y, min[2]);
+		vertex(b, x, y, max[2]);
+	}
+}
+
+void Geometry_Batch::draw() const {
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glLineStipple(1, 0xAAAA); // dotted lines - 1010101010101010
+	for (std::vector<Batch>::const_iterator it = _batches.begin(); it != _batches.end(); ++it) {
+		if (it->vertices.empty()) { continue; }
+		if (it->primitive == POINTS) { glPointSize(it->point_size); }
+		if (it->dotted) { glEnable(GL_LINE_STIPPLE); }
+		glVertexPointer(3, GL_COORD, 0, &it->vertices[0]);
+		glColorPointer(3, GL_FLOAT, 0, &it->colors[0]);
+		glDrawArrays(it->primitive == POINTS ? GL_POINTS : GL_LINES, 0, (GLsizei)(it->vertices.size() / 3));
+		if (it->dotted) { glDisable(GL_LINE_STIPPLE); }
+	}
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glPointSize(1.0f);
+}
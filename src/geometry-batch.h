@@ -0,0 +1,42 @@
+#ifndef GEOMETRY_BATCH_H
+#define GEOMETRY_BATCH_H
+
+#include <vector>
+
+#include "coords.h"
+
+// Accumulates colored points and line segments into contiguous vertex and color arrays, one batch for each kind of
+// primitive, point size, and line style, so that many small shapes can be drawn with one call per batch; the current
+// color, point size, and line style are set the same way as OpenGL's, and apply to everything added after them
+class Geometry_Batch {
+private:
+	enum Primitive { POINTS, LINES };
+	struct Batch {
+		Primitive primitive;
+		float point_size;
+		bool dotted;
+		std::vector<coord_t> vertices;
+		std::vector<float> colors;
+	};
+	std::vector<Batch> _batches;
+	float _color[3];
+	float _point_size;
+	bool _dotted;
+	size_t _current;
+public:
+	Geometry_Batch();
+	inline void color(const float *cv) { _color[0] = cv[0]; _color[1] = cv[1]; _color[2] = cv[2]; }
+	inline void point_size(float s) { _point_size = s; }
+	inline void dotted(bool d) { _dotted = d; }
+	bool empty(void) const;
+	void clear(void);
+	void point(const coord_t *p);
+	void line(const coord_t *p, const coord_t *q);
+	void box(const coord_t *min, const coord_t *max);
+	void draw(void) const;
+private:
+	Batch &batch(Primitive p);
+	void vertex(Batch &b, coord_t x, coord_t y, coord_t z);
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include <cstring>
+
+#pragma warning(push, 0)
+#include <FL/gl.h>
+#include <FL/glut.H>
+#include <FL/fl_draw.H>
+#pragma warning(pop)
+
+#include "clip-volume.h"
+#include "gl-text.h"
+
+bool GL_Text::_stroked = false;
+Fl_Font GL_Text::_font = FL_HELVETICA;
+Fl_Fontsize GL_Text::_size = 12;
+
+void GL_Text::font(Fl_Font f, Fl_Fontsize s) {
+	_font = f;
+	_size = s;
+	if (!_stroked) { gl_font(f, s); }
+}
+
+int GL_Text::height() {
+	// A stroked line is as tall as the font size, plus some leading
+	return _stroked ? _size + _size / 6 : fl_height();
+}
+
+void GL_Text::draw(const char *s, int n) {
+	if (_stroked) { stroke(s, n); }
+	else { gl_draw(s, n); }
+}
+
+void GL_Text::draw(const char *s, int x, int y, int w, int h, Fl_Align a) {
+	if (!_stroked) {
+		gl_draw(s, x, y, w, h, a);
+		return;
+	}
+	// Lay out each line from the top of the box, in the coordinates that y grows downward in
+	int lh = height();
+	int i = 0;
+	for (const char *p = s; *p && (i + 1) * lh <= h; i++) {
+		const char *e = strchr(p, '\n');
+		int n = e ? (int)(e - p) : (int)strlen(p);
+		int lx = x;
+		if (a & FL_ALIGN_RIGHT) { lx = x + w - (int)stroke_width(p, n); }
+		glRasterPos2i(lx, y + (i + 1) * lh - _size / 4);
+		stroke(p, n);
+		p += e ? n + 1 : n;
+	}
+}
+
+float GL_Text::stroke_scale() {
+	return (float)_size / glutStrokeHeight(GLUT_STROKE_ROMAN);
+}
+
+float GL_Text::stroke_width(const char *s, int n) {
+	int w = 0;
+	for (int i = 0; i < n; i++) { w += glutStrokeWidth(GLUT_STROKE_ROMAN, (uchar)s[i]); }
+	return w * stroke_scale();
+}
+
+void GL_Text::stroke(const char *s, int n) {
+	// Start from the current raster position and take its color, the same as FLTK's bitmap text
+	GLboolean valid;
+	glGetBooleanv(GL_CURRENT_RASTER_POSITION_VALID, &valid);
+	if (!valid) { return; }
+	GLfloat pos[4], color[4];
+	glGetFloatv(GL_CURRENT_RASTER_POSITION, pos);
+	glGetFloatv(GL_CURRENT_RASTER_COLOR, color);
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glPushAttrib(GL_CURRENT_BIT | GL_ENABLE_BIT | GL_LINE_BIT | GL_TRANSFORM_BIT);
+	// Window coordinates, with the raster position's depth, so that the text is hidden behind what it would be
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0.0, viewport[2], 0.0, viewport[3], 0.0, -1.0);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	glTranslatef(pos[0] - viewport[0], pos[1] - viewport[1], pos[2]);
+	float scale = stroke_scale();
+	glScalef(scale, scale, 1.0f);
+	Clip_Volume::disable();
+	glColor4fv(color);
+	glLineWidth(_font & FL_BOLD ? 2.0f : 1.0f);
+	for (int i = 0; i < n; i++) { glutStrokeCharacter(GLUT_STROKE_ROMAN, (uchar)s[i]); }
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glPopAttrib();
+}
@@ -0,0 +1,28 @@
+#ifndef GL_TEXT_H
+#define GL_TEXT_H
+
+#pragma warning(push, 0)
+#include <FL/Enumerations.H>
+#pragma warning(pop)
+
+// Draws text into the current OpenGL context with FLTK's fonts, or, when the text is stroked, with GLUT's stroke font
+// drawn as lines; an offscreen context has no display to get FLTK's fonts from, so its text has to be stroked
+class GL_Text {
+private:
+	static bool _stroked;
+	static Fl_Font _font;
+	static Fl_Fontsize _size;
+public:
+	inline static bool stroked(void) { return _stroked; }
+	inline static void stroked(bool s) { _stroked = s; }
+	static void font(Fl_Font f, Fl_Fontsize s);
+	static int height(void);
+	static void draw(const char *s, int n);
+	static void draw(const char *s, int x, int y, int w, int h, Fl_Align a);
+private:
+	static float stroke_scale(void);
+	static float stroke_width(const char *s, int n);
+	static void stroke(const char *s, int n);
+};
+
+#endif
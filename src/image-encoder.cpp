@@ -0,0 +1,91 @@
+#include <cerrno>
+#include <new>
+
+#include "image-encoder.h"
+
+Image_Encoder::Image_Encoder(const Image::Compression &c, size_t nt) : _compression(c), _jobs(2 * nt), _busy(2 * nt),
+	_added(0), _claimed(0), _error(0), _stop(false)
+#ifdef __THREADS__
+	, _threads()
+#endif
+	{
+	for (size_t i = 0; i < _busy.size(); i++) { _busy[i] = false; }
+#ifdef __THREADS__
+	for (size_t i = 0; i < nt; i++) { _threads.push_back(std::thread(&Image_Encoder::run, this)); }
+#endif
+}
+
+Image_Encoder::~Image_Encoder() {
+	finish();
+}
+
+void Image_Encoder::add(const std::string &f, size_t w, size_t h, uchar *pixels, Image::Format m) {
+	Job j;
+	j.filename = f;
+	j.width = w;
+	j.height = h;
+	j.pixels = pixels;
+	j.format = m;
+#ifdef __THREADS__
+	if (!_stop && !_threads.empty()) {
+		// Wait for the oldest image to be written, if every slot is still taken
+		size_t slot = _added % _jobs.size();
+		while (_busy[slot]) { std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS)); }
+		_jobs[slot] = j;
+		_busy[slot] = true;
+		_added++;
+		return;
+	}
+#endif
+	encode(j);
+}
+
+int Image_Encoder::finish() {
+	_stop = true;
+#ifdef __THREADS__
+	for (size_t i = 0; i < _threads.size(); i++) {
+		if (_threads[i].joinable()) { _threads[i].join(); }
+	}
+#endif
+	return (int)_error;
+}
+
+void Image_Encoder::run() {
+#ifdef __THREADS__
+	for (;;) {
+		// Check for stopping first, so that no image added before then is missed
+		bool stopping = _stop;
+		// Claim the oldest image that has not been claimed yet
+		size_t c = _claimed;
+		if (c < _added) {
+			if (!_claimed.compare_exchange_weak(c, c + 1)) { continue; }
+			size_t slot = c % _jobs.size();
+			encode(_jobs[slot]);
+			_busy[slot] = false;
+			continue;
+		}
+		// Stop once every image has been written
+		if (stopping) { return; }
+		std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+	}
+#endif
+}
+
+void Image_Encoder::encode(Job &j) {
+	// The image takes ownership of the pixels
+	Image *image = new(std::nothrow) Image(j.filename.c_str(), j.width, j.height, j.pixels);
+	int r = ENOMEM;
+	if (image) {
+		image->compression(_compression);
+		image->write(j.format);
+		r = image->error();
+		image->close();
+		delete image;
+	}
+	else {
+		delete [] j.pixels;
+	}
+	j.pixels = NULL;
+	// Keep the first error
+	if (r && !_error) { _error = (size_t)r; }
+}
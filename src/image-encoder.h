@@ -0,0 +1,46 @@
+#ifndef IMAGE_ENCODER_H
+#define IMAGE_ENCODER_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#pragma warning(push, 0)
+#include <FL/Fl_Widget.H>
+#pragma warning(pop)
+
+#include "parallel.h"
+#include "image.h"
+
+// Compresses and writes images on a pool of threads, so that encoding frames overlaps with drawing the next ones; only
+// a few images wait to be encoded at once, and adding another one waits until there is room for it
+// (Visual Studio 2010 has no C++11 threads, so images are written as soon as they are added there)
+class Image_Encoder {
+private:
+	struct Job {
+		std::string filename;
+		size_t width, height;
+		uchar *pixels;
+		Image::Format format;
+	};
+	Image::Compression _compression;
+	std::vector<Job> _jobs;
+	std::vector<shared_bool_t> _busy;
+	shared_size_t _added, _claimed, _error;
+	shared_bool_t _stop;
+#ifdef __THREADS__
+	std::vector<std::thread> _threads;
+#endif
+public:
+	Image_Encoder(const Image::Compression &c, size_t nt = num_threads());
+	~Image_Encoder();
+	void add(const std::string &f, size_t w, size_t h, uchar *pixels, Image::Format m);
+	int finish(void);
+private:
+	void run(void);
+	void encode(Job &j);
+	Image_Encoder(const Image_Encoder &ie); // Unimplemented copy constructor
+	Image_Encoder &operator=(const Image_Encoder &ie); // Unimplemented assignment operator
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include <cstdio>
+#include <cstring>
 #include <string>
 #include <sstream>
 #include <png.h>
@@ -17,7 +18,42 @@
 const char *Image::FILE_CHOOSER_FILTER = "Portable Network Graphics File\t*.png\nBitmap File\t*.bmp\n"
 	"Truevision TGA File\t*.tga\nPortable Pixmap File\t*.ppm\n";
 
-Image::Image(const char *f, size_t w, size_t h, Fl_Widget *wgt) : _file(NULL), _buffer(NULL), _width(w), _height(h), _error(0) {
+Image::Compression::Compression() : level(Z_BEST_COMPRESSION), strategy(Z_DEFAULT_STRATEGY), filters(PNG_ALL_FILTERS) {}
+
+Image::Compression Image::Compression::fast() {
+	// Only differencing each pixel from its left neighbor, instead of trying every filter on every row, compresses the
+	// model's sparse dots on a flat background nearly as well at the fastest level, and about 30 times faster than the
+	// best compression
+	Compression c;
+	c.level = Z_BEST_SPEED;
+	c.strategy = Z_DEFAULT_STRATEGY;
+	c.filters = PNG_FILTER_SUB;
+	return c;
+}
+
+bool Image::Compression::strategy_named(const char *s) {
+	if (!strcmp(s, "default")) { strategy = Z_DEFAULT_STRATEGY; }
+	else if (!strcmp(s, "filtered")) { strategy = Z_FILTERED; }
+	else if (!strcmp(s, "huffman")) { strategy = Z_HUFFMAN_ONLY; }
+	else if (!strcmp(s, "rle")) { strategy = Z_RLE; }
+	else if (!strcmp(s, "fixed")) { strategy = Z_FIXED; }
+	else { return false; }
+	return true;
+}
+
+bool Image::Compression::filters_named(const char *s) {
+	if (!strcmp(s, "none")) { filters = PNG_FILTER_NONE; }
+	else if (!strcmp(s, "sub")) { filters = PNG_FILTER_SUB; }
+	else if (!strcmp(s, "up")) { filters = PNG_FILTER_UP; }
+	else if (!strcmp(s, "avg")) { filters = PNG_FILTER_AVG; }
+	else if (!strcmp(s, "paeth")) { filters = PNG_FILTER_PAETH; }
+	else if (!strcmp(s, "all")) { filters = PNG_ALL_FILTERS; }
+	else { return false; }
+	return true;
+}
+
+Image::Image(const char *f, size_t w, size_t h, Fl_Widget *wgt) : _file(NULL), _buffer(NULL), _width(w), _height(h),
+	_compression(), _error(0) {
 	// Images require a writable file
 	_file = fl_fopen(f, "wb");
 	if (_file == NULL) { return; }
@@ -44,13 +80,32 @@ Image::Image(const char *f, size_t w, size_t h, Fl_Widget *wgt) : _file(NULL), _
 	}
 }
 
+Image::Image(const char *f, size_t w, size_t h, uchar *pixels) : _file(NULL), _buffer(pixels), _width(w), _height(h),
+	_compression(), _error(0) {
+	_file = fl_fopen(f, "wb");
+}
+
 Image::~Image() {
 	if (_file) { fclose(_file); }
-	delete _buffer;
+	delete [] _buffer;
+}
+
+const char *Image::extension(Image::Format f) {
+	switch (f) {
+	case PNG:
+	default:
+		return ".png";
+	case BMP:
+		return ".bmp";
+	case TGA:
+		return ".tga";
+	case PPM:
+		return ".ppm";
+	}
 }
 
 size_t Image::write(Image::Format f) {
-	if (error()) { return 0; }
+	if (error() || _buffer == NULL) { return 0; }
 	switch (f) {
 	case PNG:
 	default:
@@ -80,37 +135,25 @@ size_t Image::write_png() {
 	}
 	png_init_io(png, _file);
 	// Set compression options
-	png_set_compression_level(png, Z_BEST_COMPRESSION);
+	png_set_compression_level(png, _compression.level);
 	png_set_compression_mem_level(png, Z_BEST_COMPRESSION);
-	png_set_compression_strategy(png, Z_DEFAULT_STRATEGY);
+	png_set_compression_strategy(png, _compression.strategy);
 	png_set_compression_window_bits(png, 15);
 	png_set_compression_method(png, Z_DEFLATED);
-	png_set_compression_buffer_size(png, 8192);
+	png_set_compression_buffer_size(png, 65536);
+	png_set_filter(png, PNG_FILTER_TYPE_BASE, _compression.filters);
 	// Write the PNG IHDR chunk
 	png_set_IHDR(png, info, (png_uint_32)_width, (png_uint_32)_height, 8, PNG_COLOR_TYPE_RGB,
 		PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
 	// Write the other PNG header chunks
 	png_write_info(png, info);
-	// Write the RGB pixels in row-major order from top to bottom
+	// Write the RGB pixels in row-major order from top to bottom, straight from the buffer
 	size_t row_size = 3 * _width;
-	png_bytep png_row = new(std::nothrow) png_byte[row_size];
-	if (png_row) {
-		for (size_t i = _height; i-- > 0;) {
-			size_t row = row_size * i;
-			for (size_t j = 0; j < _width; j++) {
-				size_t col = 3 * j;
-				size_t px = row + col;
-				// False positive "C6386: Write overrun" error with Visual Studio 2013 code analysis
-				png_row[col] = _buffer[px];
-				png_row[col+1] = _buffer[px+1];
-				png_row[col+2] = _buffer[px+2];
-				n += 3;
-			}
-			png_write_row(png, png_row);
-		}
-		png_write_end(png, NULL);
+	for (size_t i = _height; i-- > 0;) {
+		png_write_row(png, (png_bytep)(_buffer + row_size * i));
+		n += row_size;
 	}
-	delete [] png_row;
+	png_write_end(png, NULL);
 	png_destroy_write_struct(&png, &info);
 	png_free_data(png, info, PNG_FREE_ALL, -1);
 	return n;
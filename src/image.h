@@ -10,17 +10,32 @@ class Image {
 public:
 	enum Format { PNG, BMP, TGA, PPM };
 	static const char *FILE_CHOOSER_FILTER;
+	// How PNG images are compressed: a zlib level from 0 (none) to 9 (best), a zlib strategy, and the PNG row filters
+	// to choose from; faster settings are worth it for animations, where compressing can take longer than drawing
+	struct Compression {
+		int level, strategy, filters;
+		Compression();
+		static Compression fast(void);
+		bool strategy_named(const char *s);
+		bool filters_named(const char *s);
+	};
 private:
 	FILE *_file;
 	uchar *_buffer;
 	size_t _width, _height;
+	Compression _compression;
 	int _error;
 public:
 	Image(const char *f, size_t w, size_t h, Fl_Widget *wgt = NULL);
+	// The image takes ownership of the pixels, which must have been allocated with new[] and be in row-major order
+	// from bottom to top, the same as OpenGL reads them
+	Image(const char *f, size_t w, size_t h, uchar *pixels);
 	~Image();
+	inline void compression(const Compression &c) { _compression = c; }
 	size_t write(Format f);
-	inline int error(void) { return ferror(_file) | _error; }
-	inline void close(void) { fclose(_file); _file = NULL; }
+	inline int error(void) { return (_file ? ferror(_file) : 1) | _error; }
+	inline void close(void) { if (_file) { fclose(_file); } _file = NULL; }
+	static const char *extension(Format f);
 private:
 	Image(const Image &image); // Unimplemented copy constructor
 	Image &operator=(const Image &image); // Unimplemented assignment operator
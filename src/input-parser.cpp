@@ -48,6 +48,12 @@ int Input_Parser::next() {
 	return _buffer[_next++];
 }
 
+void Input_Parser::skip_field() {
+	int c = first();
+	while (!IS_SPACE(c) && c != EOF && c != INPUT_COMMENT_START) { c = next(); }
+	if (c == INPUT_COMMENT_START) { _next--; }
+}
+
 size8_t Input_Parser::get_size8() {
 	size8_t s = 0;
 	int c = first();
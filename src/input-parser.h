@@ -35,6 +35,8 @@ public:
 	inline bool overflow(void) const { return _overflow; }
 	inline virtual void save_place(void) { _place = (long)((size_t)ftell(_file) - _buffer_size + _next); }
 	inline virtual void restore_place(void) { fseek(_file, _place, SEEK_SET); _next = _buffer_size; }
+	inline virtual size_t position(void) const { return (size_t)ftell(_file) - _buffer_size + _next; }
+	void skip_field(void);
 	inline bool get_bool(void) { return get_size32() > 0; }
 	inline char get_char(void) { return (char)first(); }
 	size8_t get_size8(void);
@@ -59,6 +61,7 @@ public:
 	inline bool good(void) const { return _gzfile && _buffer && _buffer_size; }
 	inline void save_place(void) { _place = (long)((size_t)gztell(_gzfile) - _buffer_size + _next); }
 	inline void restore_place(void) { gzseek(_gzfile, _place, SEEK_SET); _next = _buffer_size; }
+	inline size_t position(void) const { return (size_t)gzoffset(_gzfile); }
 protected:
 	int next(void);
 };
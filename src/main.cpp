@@ -7,6 +7,7 @@
 
 #include "os-themes.h"
 #include "viz-window.h"
+#include "batch-renderer.h"
 
 #ifdef _WIN32
 
@@ -69,6 +70,11 @@ static void use_theme(int &argc, char **&argv) {
 
 int main(int argc, char **argv) {
 	std::ios::sync_with_stdio(false);
+	// Export images without opening any windows
+	if (argc > 1 && !strcmp(argv[1], "--render")) {
+		Batch_Renderer br;
+		return br.run(argc - 2, argv + 2);
+	}
 #ifdef _WIN32
 	SetCurrentProcessExplicitAppUserModelID(MAKE_WSTR(PROGRAM_NAME));
 	// Fix for Ctrl+Shift+0 keyboard shortcut being used as input method editor switch
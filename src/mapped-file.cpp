@@ -0,0 +1,94 @@
+#include <cstdio>
+#include <cstring>
+
+#pragma warning(push, 0)
+#include <FL/fl_utf8.h>
+#include <FL/filename.H>
+#pragma warning(pop)
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "mapped-file.h"
+
+#ifdef _WIN32
+Mapped_File::Mapped_File(const char *f) : From_File(), _data(NULL), _buffer(NULL), _file_handle(INVALID_HANDLE_VALUE),
+	_mapping_handle(NULL) {
+#else
+Mapped_File::Mapped_File(const char *f) : From_File(), _data(NULL), _buffer(NULL), _fd(-1) {
+#endif
+	_filename = fl_filename_name(f);
+	_filesize = ::filesize(f);
+	if (!_filesize || map(f)) { return; }
+	// Fall back to reading the whole file, e.g. if there is not enough address space to map it
+	FILE *file = fl_fopen(f, "rb");
+	if (file == NULL) { return; }
+	_buffer = new(std::nothrow) unsigned char[_filesize];
+	if (_buffer != NULL && fread(_buffer, 1, _filesize, file) == _filesize) { _data = _buffer; }
+	fclose(file);
+}
+
+Mapped_File::~Mapped_File() {
+	unmap();
+	delete [] _buffer;
+}
+
+#ifdef _WIN32
+
+bool Mapped_File::map(const char *f) {
+	unsigned int n = fl_utf8towc(f, (unsigned int)strlen(f), NULL, 0);
+	wchar_t *wf = new(std::nothrow) wchar_t[n + 1];
+	if (wf == NULL) { return false; }
+	fl_utf8towc(f, (unsigned int)strlen(f), wf, n + 1);
+	_file_handle = CreateFileW(wf, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	delete [] wf;
+	if (_file_handle == INVALID_HANDLE_VALUE) { return false; }
+	_mapping_handle = CreateFileMappingW(_file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (_mapping_handle == NULL) {
+		unmap();
+		return false;
+	}
+	_data = (const unsigned char *)MapViewOfFile(_mapping_handle, FILE_MAP_READ, 0, 0, 0);
+	if (_data == NULL) {
+		unmap();
+		return false;
+	}
+	return true;
+}
+
+void Mapped_File::unmap() {
+	if (_data != NULL && _buffer == NULL) { UnmapViewOfFile(_data); }
+	if (_mapping_handle != NULL) { CloseHandle(_mapping_handle); }
+	if (_file_handle != INVALID_HANDLE_VALUE) { CloseHandle(_file_handle); }
+	if (_buffer == NULL) { _data = NULL; }
+	_mapping_handle = NULL;
+	_file_handle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool Mapped_File::map(const char *f) {
+	_fd = open(f, O_RDONLY);
+	if (_fd < 0) { return false; }
+	void *p = mmap(NULL, _filesize, PROT_READ, MAP_SHARED, _fd, 0);
+	if (p == MAP_FAILED) {
+		unmap();
+		return false;
+	}
+	_data = (const unsigned char *)p;
+	return true;
+}
+
+void Mapped_File::unmap() {
+	if (_data != NULL && _buffer == NULL) { munmap((void *)_data, _filesize); }
+	if (_fd >= 0) { close(_fd); }
+	if (_buffer == NULL) { _data = NULL; }
+	_fd = -1;
+}
+
+#endif
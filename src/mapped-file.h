@@ -0,0 +1,31 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include "utils.h"
+#include "from-file.h"
+
+// A read-only view of a whole file, memory-mapped if possible, or else read into memory
+class Mapped_File : public From_File {
+private:
+	const unsigned char *_data;
+	unsigned char *_buffer;
+#ifdef _WIN32
+	void *_file_handle, *_mapping_handle;
+#else
+	int _fd;
+#endif
+public:
+	Mapped_File(const char *f);
+	~Mapped_File();
+	inline bool good(void) const { return _data != NULL; }
+	inline bool mapped(void) const { return _data != NULL && _buffer == NULL; }
+	inline const unsigned char *data(void) const { return _data; }
+	inline size_t size(void) const { return _filesize; }
+private:
+	bool map(const char *f);
+	void unmap(void);
+	Mapped_File(const Mapped_File &mf); // Unimplemented copy constructor
+	Mapped_File &operator=(const Mapped_File &mf); // Unimplemented assignment operator
+};
+
+#endif
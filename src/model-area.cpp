@@ -1,5 +1,6 @@
 #include <cmath>
 #include <cerrno>
+#include <cstddef>
 #include <vector>
 #include <deque>
 #include <unordered_set>
@@ -8,6 +9,7 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
 
 #pragma warning(push, 0)
 #include <FL/gl.h>
@@ -33,7 +35,16 @@
 #include "progress-dialog.h"
 #include "waiting-dialog.h"
 #include "model-state.h"
+#include "model-loader.h"
+#include "conn-paths.h"
+#include "spike-stats.h"
+#include "parallel.h"
 #include "widgets.h"
+#include "gl-text.h"
+#include "offscreen-context.h"
+#include "pixel-readback.h"
+#include "image-encoder.h"
+#include "profiler.h"
 #include "model-area.h"
 
 const float Model_Area::BACKGROUND_COLOR[3] = {0.0f, 0.0f, 0.0f}; // black
@@ -67,14 +78,22 @@ const double Model_Area::ROTATE_AXIS_TOLERANCE = 0.2;
 
 Model_Area::Model_Area(int x, int y, int w, int h, const char *l) : Fl_Gl_Window(x, y, w, h, l), _model(),
 	_overview_area(NULL), _dnd_receiver(NULL), _state(), _prev_state(), _saved_state(), _history(MAX_HISTORY),
-	_future(MAX_HISTORY), _draw_opts(), _fps(), _opened(false), _initialized(false), _dragging(false),
-	_click_coords(), _drag_coords(), _rotation_mode(ARCBALL_3D), _scale_rotation(false), _invert_zoom(false) {
+	_future(MAX_HISTORY), _draw_opts(), _fps(), _frame_producer(NULL), _model_version(0), _sim_colors(), _selected_batch(),
+	_selected_fields_batch(), _weights_batch(), _selected_letters(), _batched_state(), _batched_opts(),
+	_batched_styles(), _batched_synapses(0), _batched_gap_junctions(0), _batched_version(0), _batched(false),
+	_static_list(0), _static_styles(), _static_version(0), _static_compiled(false), _offscreen(NULL),
+	_drawing_offscreen(false), _opened(false), _initialized(false), _dragging(false), _click_coords(), _drag_coords(),
+	_rotation_mode(ARCBALL_3D), _scale_rotation(false), _invert_zoom(false) {
 	mode(FL_RGB | FL_ALPHA | FL_DEPTH | FL_DOUBLE);
 	action(SELECT);
 	resizable(NULL);
 	end();
 }
 
+Model_Area::~Model_Area() {
+	stop_producing();
+}
+
 void Model_Area::action(Model_Area::Action a) {
 	type((uchar)a);
 	if (Fl::event_inside(this)) {
@@ -105,17 +124,31 @@ void Model_Area::refresh() {
 	flush();
 }
 
+void Model_Area::start_producing() {
+	// Color the somas for the next cycles of playback in the background
+	stop_producing();
+	if (!_model.has_firing_spikes()) { return; }
+	_frame_producer = new(std::nothrow) Frame_Producer(*_model.const_firing_spikes(), _draw_opts.invert_background());
+	if (_frame_producer) { _frame_producer->start(); }
+}
+
+void Model_Area::stop_producing() {
+	delete _frame_producer;
+	_frame_producer = NULL;
+}
+
 void Model_Area::refresh_gl() {
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LEQUAL);
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	gl_font(FL_SCREEN, 12); // fix font-drawing bug in Windows
+	GL_Text::font(FL_SCREEN, 12); // fix font-drawing bug in Windows
 }
 
 void Model_Area::refresh_selected() const {
+	// A model area that is only drawn offscreen has no window around it
 	Viz_Window *vw = static_cast<Viz_Window *>(parent());
-	vw->refresh_selected();
+	if (vw) { vw->refresh_selected(); }
 }
 
 void Model_Area::refresh_cursor() const {
@@ -201,7 +234,10 @@ void Model_Area::refresh_view() {
 }
 
 void Model_Area::clear() {
+	stop_producing();
+	_selected_letters.clear();
 	_model.clear();
+	_model_version++;
 	_opened = false;
 	prepare();
 }
@@ -394,30 +430,52 @@ void Model_Area::pivot_ith(size_t i) {
 	refresh();
 }
 
+static bool hotter(const std::pair<float, size32_t> &a, const std::pair<float, size32_t> &b) {
+	return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
 void Model_Area::select_top(int n) {
 	remember(_state);
 	_prev_state = _state;
 	_state.deselect_all();
-	std::unordered_set<size32_t> top;
+	if (n <= 0) {
+		refresh_selected();
+		refresh();
+		return;
+	}
 	const Firing_Spikes *fd = _model.const_firing_spikes();
 	size32_t n_somas = _model.num_somas();
-	for (int i = 0; i < n; i++) {
-		size32_t max_index = n_somas;
-		float max_hz = -1.0f;
-		for (size32_t j = 0; j < n_somas; j++) {
-			const Soma *s = _model.soma(j);
+	size_t nc = num_chunks(n_somas, 65536);
+	// Each chunk keeps a bounded heap of its n hottest somas, with the coolest of them on top
+	std::vector<std::vector<std::pair<float, size32_t> > > heaps(nc);
+	parallel_chunks(n_somas, nc, [&](size_t begin, size_t end, size_t c) {
+		std::vector<std::pair<float, size32_t> > &heap = heaps[c];
+		heap.reserve(MIN((size_t)n, end - begin));
+		for (size_t j = begin; j < end; j++) {
+			const Soma *s = _model.soma((size32_t)j);
 			const Soma_Type *t = _model.type(s->type_index());
 			if (t->display_state() == Soma_Type::DISABLED) { continue; }
-			float hz = fd->hertz(j);
-			if (hz > max_hz && top.find(j) == top.end()) {
-				max_index = j;
-				max_hz = hz;
+			std::pair<float, size32_t> h(fd->hertz((size32_t)j), (size32_t)j);
+			if (heap.size() < (size_t)n) {
+				heap.push_back(h);
+				std::push_heap(heap.begin(), heap.end(), hotter);
+			}
+			else if (hotter(h, heap.front())) {
+				std::pop_heap(heap.begin(), heap.end(), hotter);
+				heap.back() = h;
+				std::push_heap(heap.begin(), heap.end(), hotter);
 			}
 		}
-		if (max_index < n_somas) {
-			_state.select(_model.soma(max_index), max_index);
-			top.insert(max_index);
-		}
+	});
+	std::vector<std::pair<float, size32_t> > top;
+	for (size_t c = 0; c < nc; c++) {
+		top.insert(top.end(), heaps[c].begin(), heaps[c].end());
+	}
+	size_t nt = MIN((size_t)n, top.size());
+	std::partial_sort(top.begin(), top.begin() + (std::ptrdiff_t)nt, top.end(), hotter);
+	for (size_t i = 0; i < nt; i++) {
+		size32_t index = top[i].second;
+		_state.select(_model.soma(index), index);
 	}
 	refresh_selected();
 	refresh();
@@ -439,8 +497,7 @@ void Model_Area::deselect_id(size32_t id) {
 	if (index >= _model.num_somas()) { return; }
 	remember(_state);
 	_prev_state = _state;
-	const Soma *s = _model.soma(index);
-	_state.deselect(s);
+	_state.deselect(index);
 	refresh_selected();
 	refresh();
 }
@@ -449,87 +506,36 @@ void Model_Area::deselect_ith(size_t i) {
 	if (i >= _state.num_selected()) { return; }
 	remember(_state);
 	_prev_state = _state;
-	const Soma *s = _state.selected(i);
-	_state.deselect(s);
+	_state.deselect(_state.selected_index(i));
 	refresh_selected();
 	refresh();
 }
 
 size32_t Model_Area::select_syn_count(size8_t t_index, size_t y_count, bool count_den, Progress_Dialog *p) {
+	std::pair<const size32_t *, const size32_t *> found = _model.somas_by_syn_count(t_index, y_count, count_den);
+	size32_t n_found = (size32_t)(found.second - found.first);
 	size_t denom = 1;
-	size32_t n = _model.num_somas();
 	if (p) {
-		denom = n / Progress_Dialog::PROGRESS_STEPS;
+		denom = n_found / Progress_Dialog::PROGRESS_STEPS;
 		if (!denom) { denom = 1; }
-		p->message("Somas found: 0");
+		std::ostringstream ss;
+		ss.imbue(std::locale(""));
+		ss.setf(std::ios::fixed, std::ios::floatfield);
+		ss << "Somas found: " << n_found;
+		p->message(ss.str().c_str());
 		p->progress(0.0f);
 		Fl::check();
 		if (p->canceled()) { return 0; }
 	}
 	remember(_state);
 	_prev_state = _state;
-	size32_t n_found = 0;
-	std::ostringstream ss;
-	ss.imbue(std::locale(""));
-	ss.setf(std::ios::fixed, std::ios::floatfield);
-	if (count_den) {
-		for (size32_t index = 0; index < n; index++) {
-			const Soma *s = _model.soma(index);
-			if (s->type_index() == t_index) {
-				size_t d_count = 0;
-				size32_t ny = _model.num_synapses();
-				const Synapse *y = NULL;
-				for (size32_t y_index = s->first_den_syn_index(); y_index < ny; y_index = y->next_den_syn_index()) {
-					y = _model.synapse(y_index);
-					d_count++;
-				}
-				if (d_count == y_count) {
-					_state.reselect(s, index);
-					n_found++;
-					if (p) {
-						ss.str("");
-						ss << "Somas found: " << n_found;
-						p->message(ss.str().c_str());
-						Fl::check();
-						if (p->canceled()) { return 0; }
-					}
-				}
-			}
-			if (p && !((index + 1) % denom)) {
-				p->progress((float)(index + 1) / n);
-				Fl::check();
-				if (p->canceled()) { return n_found; }
-			}
-		}
-	}
-	else {
-		for (size32_t index = 0; index < n; index++) {
-			const Soma *s = _model.soma(index);
-			if (s->type_index() == t_index) {
-				size_t a_count = 0;
-				size32_t ny = _model.num_synapses();
-				const Synapse *y = NULL;
-				for (size32_t y_index = s->first_axon_syn_index(); y_index < ny; y_index = y->next_axon_syn_index()) {
-					y = _model.synapse(y_index);
-					a_count++;
-				}
-				if (a_count == y_count) {
-					_state.reselect(s, index);
-					n_found++;
-					if (p) {
-						ss.str("");
-						ss << "Somas found: " << n_found;
-						p->message(ss.str().c_str());
-						Fl::check();
-						if (p->canceled()) { return 0; }
-					}
-				}
-			}
-			if (p && !((index + 1) % denom)) {
-				p->progress((float)(index + 1) / n);
-				Fl::check();
-				if (p->canceled()) { return n_found; }
-			}
+	for (size32_t i = 0; i < n_found; i++) {
+		size32_t index = found.first[i];
+		_state.reselect(_model.soma(index), index);
+		if (p && !((i + 1) % denom)) {
+			p->progress((float)(i + 1) / n_found);
+			Fl::check();
+			if (p->canceled()) { return i + 1; }
 		}
 	}
 	if (p) {
@@ -542,12 +548,17 @@ size32_t Model_Area::select_syn_count(size8_t t_index, size_t y_count, bool coun
 
 size32_t Model_Area::report_syn_count(std::ofstream &ofs, size8_t t_index, size_t y_count, bool count_den,
 	Progress_Dialog *p) {
+	std::pair<const size32_t *, const size32_t *> found = _model.somas_by_syn_count(t_index, y_count, count_den);
+	size32_t n_found = (size32_t)(found.second - found.first);
 	size_t denom = 1;
-	size32_t n = _model.num_somas();
 	if (p) {
-		denom = n / Progress_Dialog::PROGRESS_STEPS;
+		denom = n_found / Progress_Dialog::PROGRESS_STEPS;
 		if (!denom) { denom = 1; }
-		p->message("Somas found: 0");
+		std::ostringstream ss;
+		ss.imbue(std::locale(""));
+		ss.setf(std::ios::fixed, std::ios::floatfield);
+		ss << "Somas found: " << n_found;
+		p->message(ss.str().c_str());
 		p->progress(0.0f);
 		Fl::check();
 		if (p->canceled()) { return 0; }
@@ -559,70 +570,14 @@ size32_t Model_Area::report_syn_count(std::ofstream &ofs, size8_t t_index, size_
 	ofs << "# <type> <id> <x> <y> <z>\n";
 	remember(_state);
 	_prev_state = _state;
-	size32_t n_found = 0;
-	std::ostringstream ss;
-	ss.imbue(std::locale(""));
-	ss.setf(std::ios::fixed, std::ios::floatfield);
-	if (count_den) {
-		for (size32_t index = 0; index < n; index++) {
-			const Soma *s = _model.soma(index);
-			if (s->type_index() == t_index) {
-				size_t d_count = 0;
-				size32_t ny = _model.num_synapses();
-				const Synapse *y = NULL;
-				for (size32_t y_index = s->first_den_syn_index(); y_index < ny; y_index = y->next_den_syn_index()) {
-					y = _model.synapse(y_index);
-					d_count++;
-				}
-				if (d_count == y_count) {
-					const coord_t *c = s->coords();
-					ofs << (size32_t)s->type_index() << " " << s->id() << " " << c[0] << " " << c[1] << " " << c[2] << "\n";
-					n_found++;
-					if (p) {
-						ss.str("");
-						ss << "Somas found: " << n_found;
-						p->message(ss.str().c_str());
-						Fl::check();
-						if (p->canceled()) { return 0; }
-					}
-				}
-			}
-			if (p && !((index + 1) % denom)) {
-				p->progress((float)(index + 1) / n);
-				Fl::check();
-				if (p->canceled()) { return n_found; }
-			}
-		}
-	}
-	else {
-		for (size32_t index = 0; index < n; index++) {
-			const Soma *s = _model.soma(index);
-			if (s->type_index() == t_index) {
-				size_t a_count = 0;
-				size32_t ny = _model.num_synapses();
-				const Synapse *y = NULL;
-				for (size32_t y_index = s->first_axon_syn_index(); y_index < ny; y_index = y->next_axon_syn_index()) {
-					y = _model.synapse(y_index);
-					a_count++;
-				}
-				if (a_count == y_count) {
-					const coord_t *c = s->coords();
-					ofs << (size32_t)s->type_index() << " " << s->id() << " " << c[0] << " " << c[1] << " " << c[2] << "\n";
-					n_found++;
-					if (p) {
-						ss.str("");
-						ss << "Somas found: " << n_found;
-						p->message(ss.str().c_str());
-						Fl::check();
-						if (p->canceled()) { return 0; }
-					}
-				}
-			}
-			if (p && !((index + 1) % denom)) {
-				p->progress((float)(index + 1) / n);
-				Fl::check();
-				if (p->canceled()) { return n_found; }
-			}
+	for (size32_t i = 0; i < n_found; i++) {
+		const Soma *s = _model.soma(found.first[i]);
+		const coord_t *c = s->coords();
+		ofs << (size32_t)s->type_index() << " " << s->id() << " " << c[0] << " " << c[1] << " " << c[2] << "\n";
+		if (p && !((i + 1) % denom)) {
+			p->progress((float)(i + 1) / n_found);
+			Fl::check();
+			if (p->canceled()) { return i + 1; }
 		}
 	}
 	ofs << "# Total: " << n_found << "\n";
@@ -634,49 +589,6 @@ size32_t Model_Area::report_syn_count(std::ofstream &ofs, size8_t t_index, size_
 	return n_found;
 }
 
-bool Model_Area::mark_conn_paths(size32_t a_index, size32_t d_index, size_t limit, bool include_disabled,
-	std::deque<size32_t> &path_syns, size_t &n_paths, std::deque<soma_syn_t> &stack, Waiting_Dialog *w) {
-	if (a_index == d_index) {
-		for (std::deque<soma_syn_t>::const_iterator it = stack.begin(); it != stack.end(); ++it) {
-			path_syns.push_back(it->second);
-		}
-		n_paths++;
-		if (w) {
-			std::ostringstream ss;
-			ss.imbue(std::locale(""));
-			ss.setf(std::ios::fixed, std::ios::floatfield);
-			ss << "Synapse paths found: " << n_paths;
-			w->message(ss.str().c_str());
-		}
-		return true;
-	}
-	if (w) {
-		Fl::check();
-		if (w->canceled()) { return false; }
-	}
-	for (std::deque<soma_syn_t>::const_iterator it = stack.begin(); it != stack.end(); ++it) {
-		if (it->first == a_index) { return true; }
-	}
-	const Soma *a = _model.soma(a_index);
-	if (!include_disabled) {
-		const Soma_Type *t = _model.type(a->type_index());
-		if (t->display_state() == Soma_Type::DISABLED) { return true; }
-	}
-	size32_t ny = _model.num_synapses();
-	const Synapse *y = NULL;
-	for (size32_t y_index = a->first_axon_syn_index(); y_index < ny; y_index = y->next_axon_syn_index()) {
-		stack.push_back(std::make_pair(a_index, y_index));
-		y = _model.synapse(y_index);
-		size32_t b_index = y->den_soma_index();
-		if (!mark_conn_paths(b_index, d_index, limit, include_disabled, path_syns, n_paths, stack, w)) {
-			return false;
-		}
-		stack.pop_back();
-		if (limit > 0 && n_paths >= limit) { break; }
-	}
-	return true;
-}
-
 size_t Model_Area::mark_conn_paths(size32_t a_id, size32_t d_id, size_t limit, bool include_disabled,
 	Waiting_Dialog *w) {
 	if (w) {
@@ -687,66 +599,18 @@ size_t Model_Area::mark_conn_paths(size32_t a_id, size32_t d_id, size_t limit, b
 	size32_t d_index = _model.soma_index(d_id);
 	size32_t n = _model.num_somas();
 	if (a_index >= n || d_index >= n) { return 0; }
-	std::deque<size32_t> path_syns;
-	std::deque<soma_syn_t> stack;
-	size_t n_paths = 0;
-	mark_conn_paths(a_index, d_index, limit, include_disabled, path_syns, n_paths, stack, w);
+	Conn_Paths paths(_model, a_index, d_index, include_disabled);
+	size_t n_paths = paths.find(limit, w);
 	if (n_paths > 0) {
 		remember(_state);
 		_prev_state = _state;
-		while (!path_syns.empty()) {
-			size32_t index = path_syns.front();
-			const Synapse *y = _model.synapse(index);
-			_state.mark(y, index);
-			path_syns.pop_front();
-		}
+		_state.mark(paths.syn_indices());
 		refresh_selected();
 		refresh();
 	}
 	return n_paths;
 }
 
-bool Model_Area::select_conn_paths(size32_t a_index, size32_t d_index, size_t limit, bool include_disabled,
-	std::deque<size32_t> &path_somas, size_t &n_paths, std::deque<size32_t> &stack, Waiting_Dialog *w) {
-	if (a_index == d_index) {
-		for (std::deque<size32_t>::const_iterator it = stack.begin(); it != stack.end(); ++it) {
-			path_somas.push_back(*it);
-		}
-		n_paths++;
-		if (w) {
-			std::ostringstream ss;
-			ss.imbue(std::locale(""));
-			ss.setf(std::ios::fixed, std::ios::floatfield);
-			ss << "Synapse paths found: " << n_paths;
-			w->message(ss.str().c_str());
-		}
-		return true;
-	}
-	if (w) {
-		Fl::check();
-		if (w->canceled()) { return false; }
-	}
-	if (std::find(stack.begin(), stack.end(), a_index) != stack.end()) { return true; }
-	const Soma *a = _model.soma(a_index);
-	if (!include_disabled) {
-		const Soma_Type *t = _model.type(a->type_index());
-		if (t->display_state() == Soma_Type::DISABLED) { return true; }
-	}
-	stack.push_back(a_index);
-	size32_t ny = _model.num_synapses();
-	const Synapse *y = NULL;
-	for (size32_t y_index = a->first_axon_syn_index(); y_index < ny; y_index = y->next_axon_syn_index()) {
-		y = _model.synapse(y_index);
-		size32_t b_index = y->den_soma_index();
-		if (!select_conn_paths(b_index, d_index, limit, include_disabled, path_somas, n_paths, stack, w)) {
-			return false;
-		}
-		if (limit > 0 && n_paths >= limit) { break; }
-	}
-	stack.pop_back();
-	return true;
-}
-
 size_t Model_Area::select_conn_paths(size32_t a_id, size32_t d_id, size_t limit, bool include_disabled,
 	Waiting_Dialog *w) {
 	if (w) {
@@ -757,78 +621,26 @@ size_t Model_Area::select_conn_paths(size32_t a_id, size32_t d_id, size_t limit,
 	size32_t d_index = _model.soma_index(d_id);
 	size32_t n = _model.num_somas();
 	if (a_index >= n || d_index >= n) { return 0; }
-	std::deque<size32_t> path_somas, stack;
-	size_t n_paths = 0;
-	path_somas.push_back(a_index);
-	path_somas.push_back(d_index);
-	select_conn_paths(a_index, d_index, limit, include_disabled, path_somas, n_paths, stack, w);
+	Conn_Paths paths(_model, a_index, d_index, include_disabled);
+	size_t n_paths = paths.find(limit, w);
 	if (n_paths > 0) {
 		remember(_state);
 		_prev_state = _state;
-		while (!path_somas.empty()) {
-			size32_t index = path_somas.front();
-			const Soma *s = _model.soma(index);
-			_state.reselect(s, index);
-			path_somas.pop_front();
-		}
+		const std::vector<size32_t> &syn_indices = paths.syn_indices();
+		std::vector<size32_t> indices;
+		indices.reserve(syn_indices.size() + 2);
+		indices.push_back(a_index);
+		indices.push_back(d_index);
+		for (std::vector<size32_t>::const_iterator it = syn_indices.begin(); it != syn_indices.end(); ++it) {
+			indices.push_back(_model.synapse(*it)->axon_soma_index());
+		}
+		_state.reselect(indices, _model);
 		refresh_selected();
 		refresh();
 	}
 	return n_paths;
 }
 
-bool Model_Area::report_conn_paths(std::ofstream &ofs, size32_t a_index, size32_t d_index, size_t limit,
-	bool include_disabled, size_t &n_paths, std::deque<soma_syn_t> &stack, Waiting_Dialog *w) {
-	if (a_index == d_index) {
-		for (std::deque<soma_syn_t>::const_iterator it = stack.begin(); it != stack.end(); ++it) {
-			size32_t s_index = it->first;
-			size32_t y_index = it->second;
-			const Soma *s = _model.soma(s_index);
-			const Soma_Type *t = _model.type(s->type_index());
-			const Synapse *y = _model.synapse(y_index);
-			const coord_t *c = y->coords();
-			ofs << t->letter() << " #" << s->id() << " --(" << c[0] << ", " << c[1] << ", " << c[2] << ")-> ";
-		}
-		const Soma *d = _model.soma(d_index);
-		const Soma_Type *u = _model.type(d->type_index());
-		ofs << u->letter() << " #" << d->id() << "\n";
-		n_paths++;
-		if (w) {
-			std::ostringstream ss;
-			ss.imbue(std::locale(""));
-			ss.setf(std::ios::fixed, std::ios::floatfield);
-			ss << "Synapse paths found: " << n_paths;
-			w->message(ss.str().c_str());
-		}
-		return true;
-	}
-	if (w) {
-		Fl::check();
-		if (w->canceled()) { return false; }
-	}
-	for (std::deque<soma_syn_t>::const_iterator it = stack.begin(); it != stack.end(); ++it) {
-		if (it->first == a_index) { return true; }
-	}
-	const Soma *a = _model.soma(a_index);
-	if (!include_disabled) {
-		const Soma_Type *t = _model.type(a->type_index());
-		if (t->display_state() == Soma_Type::DISABLED) { return true; }
-	}
-	size32_t ny = _model.num_synapses();
-	const Synapse *y = NULL;
-	for (size32_t y_index = a->first_axon_syn_index(); y_index < ny; y_index = y->next_axon_syn_index()) {
-		stack.push_back(std::make_pair(a_index, y_index));
-		y = _model.synapse(y_index);
-		size32_t b_index = y->den_soma_index();
-		if (!report_conn_paths(ofs, b_index, d_index, limit, include_disabled, n_paths, stack, w)) {
-			return false;
-		}
-		stack.pop_back();
-		if (limit > 0 && n_paths >= limit) { break; }
-	}
-	return true;
-}
-
 size_t Model_Area::report_conn_paths(std::ofstream &ofs, size32_t a_id, size32_t d_id, size_t limit,
 	bool include_disabled, Waiting_Dialog *w) {
 	if (w) {
@@ -847,24 +659,30 @@ size_t Model_Area::report_conn_paths(std::ofstream &ofs, size32_t a_id, size32_t
 	ofs << "Synapse paths from soma #" << a_id << " to #" << d_id;
 	if (limit > 0) { ofs << " (limit " << limit << ")"; }
 	ofs << ":\n";
-	std::deque<soma_syn_t> stack;
-	size_t n_paths = 0;
-	report_conn_paths(ofs, a_index, d_index, limit, include_disabled, n_paths, stack, w);
+	Conn_Paths paths(_model, a_index, d_index, include_disabled);
+	size_t n_paths = paths.find(limit, w);
+	const Soma *d = _model.soma(d_index);
+	const Soma_Type *u = _model.type(d->type_index());
+	for (size_t i = 0; i < n_paths; i++) {
+		size_t len = paths.path_length(i);
+		for (size_t j = 0; j < len; j++) {
+			const Synapse *y = _model.synapse(paths.path_syn_index(i, j));
+			const Soma *s = _model.soma(y->axon_soma_index());
+			const Soma_Type *t = _model.type(s->type_index());
+			const coord_t *c = y->coords();
+			ofs << t->letter() << " #" << s->id() << " --(" << c[0] << ", " << c[1] << ", " << c[2] << ")-> ";
+		}
+		ofs << u->letter() << " #" << d->id() << "\n";
+	}
 	ofs << "Total: " << n_paths << " paths\n";
 	return n_paths;
 }
 
-Read_Status Model_Area::read_model_from(Input_Parser &ip, Progress_Dialog *p) {
-	_opened = false;
-	Read_Status status = _model.read_from(ip, p);
-	if (p && p->canceled()) { status = CANCELED; }
-	if (status == SUCCESS) { _opened = true; }
-	return status;
-}
-
-Read_Status Model_Area::read_model_from(Binary_Parser &bp, Progress_Dialog *p) {
+Read_Status Model_Area::read_model_from(Model_Loader &ml, Progress_Dialog *p) {
+	// The model is opened once its somas are read, while its synapses and gap junctions are still loading
 	_opened = false;
-	Read_Status status = _model.read_from(bp, p);
+	_model_version++;
+	Read_Status status = ml.start(p);
 	if (p && p->canceled()) { status = CANCELED; }
 	if (status == SUCCESS) { _opened = true; }
 	return status;
@@ -894,6 +712,127 @@ int Model_Area::write_image(const char *f, Image::Format m) {
 	return r;
 }
 
+int Model_Area::write_image(const char *f, Image::Format m, Offscreen_Context &oc) {
+	if (!make_offscreen_current(oc)) { return EIO; }
+	draw_offscreen(oc);
+	int r = ENOMEM;
+	Image *image = new(std::nothrow) Image(f, (size_t)oc.w(), (size_t)oc.h());
+	if (image != NULL) {
+		image->write(m);
+		r = image->error();
+		image->close();
+		delete image;
+	}
+	leave_offscreen();
+	return r;
+}
+
+int Model_Area::write_animation(const std::string &prefix, size32_t start, size32_t stop, size32_t step,
+	Image::Format m, const Image::Compression &c, Offscreen_Context *oc, Progress_Dialog *p) {
+	if (stop < start || !step) { return EINVAL; }
+	size32_t n = (stop - start) / step + 1;
+	size_t denom = 1;
+	if (p) {
+		denom = n / Progress_Dialog::PROGRESS_STEPS;
+		if (!denom) { denom = 1; }
+		p->message("Exporting animation...");
+		p->progress(0.0f);
+		Fl::check();
+		if (p->canceled()) { return 0; }
+	}
+	if (oc) {
+		if (!make_offscreen_current(*oc)) { return EIO; }
+	}
+	else {
+		make_current();
+	}
+	size_t width = oc ? (size_t)oc->w() : (size_t)w(), height = oc ? (size_t)oc->h() : (size_t)h();
+	// Each frame is read back while the next one is drawn, and written while later ones are drawn
+	Pixel_Readback readback(width, height);
+	Image_Encoder encoder(c);
+	stop_producing();
+	// Number the frames by cycle, padded to the same width
+	int z = (int)ceil(log10((float)stop + 1.0f));
+	std::ostringstream ss;
+	std::string prev;
+	int err = 0;
+	bool canceled = false;
+	for (size32_t i = 0; i < n; i++) {
+		size32_t t = i ? _model.step_time(step) : _model.start_time(start);
+		// Checking for events may have drawn another window, so make this one current again
+		if (oc) {
+			oc->make_current();
+			draw_offscreen(*oc);
+		}
+		else {
+			make_current();
+			draw();
+		}
+		uchar *pixels;
+		{
+			Profiler::Scope scope("read back");
+			pixels = readback.read();
+		}
+		if (!oc) { swap_buffers(); }
+		if (i) {
+			if (pixels == NULL) { err = ENOMEM; break; }
+			// Waits for an encoder to be free, if they are all busy
+			Profiler::Scope scope("queue image");
+			encoder.add(prev, width, height, pixels, m);
+		}
+		ss.str("");
+		ss << prefix << std::setw(z) << std::setfill('0') << t << Image::extension(m);
+		prev = ss.str();
+		if (p) {
+			if (!((i + 1) % denom)) { p->progress((float)(i + 1) / n); }
+			Fl::check();
+			if (p->canceled()) { canceled = true; break; }
+		}
+	}
+	// The readback's buffers belong to this context
+	if (oc) { oc->make_current(); }
+	else { make_current(); }
+	uchar *pixels = readback.finish();
+	if (pixels && !err && !canceled) { encoder.add(prev, width, height, pixels, m); }
+	else { delete [] pixels; }
+	int r = encoder.finish();
+	if (oc) { leave_offscreen(); }
+	else { refresh(); }
+	return err ? err : r;
+}
+
+bool Model_Area::make_offscreen_current(Offscreen_Context &oc) {
+	if (!oc.make_current()) { return false; }
+	if (&oc != _offscreen) {
+		// A new context has none of the old one's state or display lists
+		_offscreen = &oc;
+		_initialized = false;
+		_static_list = 0;
+		_static_compiled = false;
+	}
+	return true;
+}
+
+void Model_Area::draw_offscreen(const Offscreen_Context &oc) {
+	// Draw a frame at the context's size, with text stroked since there are no fonts without a display
+	size(oc.w(), oc.h());
+	valid(0);
+	_drawing_offscreen = true;
+	GL_Text::stroked(true);
+	draw();
+	GL_Text::stroked(false);
+	_drawing_offscreen = false;
+}
+
+void Model_Area::leave_offscreen() {
+	// The context may be destroyed and another one made at the same address, and the window's own context has none
+	// of this one's state or display lists either
+	_offscreen = NULL;
+	_initialized = false;
+	_static_list = 0;
+	_static_compiled = false;
+}
+
 void Model_Area::write_selected_somas_to(std::ofstream &ofs, bool bounding_box, bool relations) const {
 	size_t ns = _state.num_selected();
 	Bounds b;
@@ -907,7 +846,7 @@ void Model_Area::write_selected_somas_to(std::ofstream &ofs, bool bounding_box,
 	for (size32_t index = 0; index < nm; index++) {
 		const Soma *s = _model.soma(index);
 		const coord_t *c = s->coords();
-		if (b.contains(c) && !_state.is_selected(s)) { nr++; }
+		if (b.contains(c) && !_state.is_selected(index)) { nr++; }
 	}
 	ofs.setf(std::ios::fixed, std::ios::floatfield);
 	ofs.precision(0);
@@ -938,7 +877,7 @@ void Model_Area::write_selected_somas_to(std::ofstream &ofs, bool bounding_box,
 		for (size32_t i = 0; i < nm; i++) {
 			const Soma *s = _model.soma(i);
 			const coord_t *c = s->coords();
-			if (b.contains(c) && !_state.is_selected(s)) {
+			if (b.contains(c) && !_state.is_selected(i)) {
 				ofs << (size32_t)s->type_index() << " " << s->id() << " " << c[0] << " " << c[1] << " " << c[2] << "\n";
 			}
 		}
@@ -989,8 +928,9 @@ void Model_Area::write_marked_synapses_to(std::ofstream &ofs) const {
 	ofs << "# " << _model.filename() << "\n";
 	ofs << _state.num_marked() << " # number of marked synapses\n";
 	ofs << "# <axonal letter> #<axonal id> [via (<vx>, <vy>, <vz>)] thru (<x>, <y>, <z>) to <dendritic letter> #<dendritic id>\n";
-	for (marked_syns_t::const_iterator it = _state.begin_marked_synapses(); it != _state.end_marked_synapses(); ++it) {
-		const Synapse *y = it->first;
+	size_t nm = _state.num_marked();
+	for (size_t i = 0; i < nm; i++) {
+		const Synapse *y = _model.synapse(_state.marked_index(i));
 		const coord_t *c = y->coords();
 		const Soma *a = _model.soma(y->axon_soma_index());
 		const Soma_Type *t = _model.type(a->type_index());
@@ -1019,7 +959,7 @@ void Model_Area::write_current_frequencies_to(std::ofstream &ofs) const {
 	size_t n_selected = _state.num_selected();
 	for (size32_t index = 0; index < n; index++) {
 		const Soma *s = _model.soma(index);
-		if (n_selected > 0 && !_state.is_selected(s)) { continue; }
+		if (n_selected > 0 && !_state.is_selected(index)) { continue; }
 		const Soma_Type *t = _model.type(s->type_index());
 		if (t->display_state() == Soma_Type::DISABLED) { continue; }
 		if (!fd->active(index)) { continue; }
@@ -1032,23 +972,24 @@ void Model_Area::write_current_frequencies_to(std::ofstream &ofs) const {
 
 void Model_Area::write_average_frequencies_to(std::ofstream &ofs, size32_t start, size32_t stop, size32_t step, Progress_Dialog *p) {
 	size_t denom = 1;
-	size32_t n = stop - start + 1;
+	size32_t n_somas = _model.num_somas();
 	if (p) {
-		denom = n / Progress_Dialog::PROGRESS_STEPS;
+		denom = n_somas / Progress_Dialog::PROGRESS_STEPS;
 		if (!denom) { denom = 1; }
-		p->message("Calculating frequencies...");
+		p->message("Averaging frequencies...");
 		p->progress(0.0f);
 		Fl::check();
 		if (p->canceled()) { return; }
 	}
 	ofs.setf(std::ios::fixed, std::ios::floatfield);
 	ofs.precision(0);
-	Firing_Spikes *fd = _model.firing_spikes();
+	const Firing_Spikes *fd = _model.const_firing_spikes();
 	ofs << "# " << fd->filename() << "\n";
 	ofs << "# " << fd->duration() << " cycles (" << fd->const_start_time() << " to " << fd->max_time() << ") at ";
 	ofs.precision(1);
 	ofs << (1.0f / fd->timescale()) << " ms/cycle\n";
 	ofs << "# Averaging every " << step << " cycles from " << start << " to " << stop << "\n";
+	size32_t n = stop - start + 1;
 	size32_t n_intervals = n / step;
 	ofs << "# <type> <id> <x> <y> <z>";
 	for (size32_t i = 0; i < n_intervals; i++) {
@@ -1056,60 +997,83 @@ void Model_Area::write_average_frequencies_to(std::ofstream &ofs, size32_t start
 	}
 	ofs << "\n";
 	ofs.precision(2);
-	size32_t n_somas = _model.num_somas();
+	// Average each soma's windowed frequency per interval straight from its sorted spike times
 	size_t n_selected = _state.num_selected();
-	std::map<size32_t, std::vector<float>> averages;
-	fd->start_time(start);
-	for (size32_t i = 0; i < n; i++) {
-		for (size32_t index = 0; index < n_somas; index++) {
-			const Soma *s = _model.soma(index);
-			if (n_selected > 0 && !_state.is_selected(s)) { continue; }
-			const Soma_Type *t = _model.type(s->type_index());
-			if (t->display_state() == Soma_Type::DISABLED) { continue; }
-			if (!fd->active(index)) { continue; }
-			float hz = fd->hertz(index);
-			if (hz == 0.0f) { continue; }
-			averages[index].resize(n);
-			averages[index][i] = hz;
-		}
-		fd->step_time();
-		if (p && !((i + 1) % denom)) {
-			p->progress((float)(i + 1) / n);
+	std::vector<float> averages;
+	for (size32_t index = 0; index < n_somas; index++) {
+		if (p && !((index + 1) % denom)) {
+			p->progress((float)(index + 1) / n_somas);
 			Fl::check();
 			if (p->canceled()) { return; }
 		}
-	}
-	if (p) {
-		denom = averages.size() / Progress_Dialog::PROGRESS_STEPS;
-		if (!denom) { denom = 1; }
-		p->message("Averaging frequencies...");
-		p->progress(0.0f);
-		Fl::check();
-		if (p->canceled()) { return; }
-	}
-	size_t n_written = 0;
-	for (std::map<size32_t, std::vector<float>>::const_iterator it = averages.begin(); it != averages.end(); ++it) {
-		size32_t index = it->first;
-		const std::vector<float> &freqs = it->second;
+		if (n_selected > 0 && !_state.is_selected(index)) { continue; }
 		const Soma *s = _model.soma(index);
+		const Soma_Type *t = _model.type(s->type_index());
+		if (t->display_state() == Soma_Type::DISABLED) { continue; }
+		if (!fd->average_hertz(index, start, stop, step, averages)) { continue; }
 		const coord_t *c = s->coords();
 		ofs << (size32_t)s->type_index() << " " << s->id() << " " << c[0] << " " << c[1] << " " << c[2];
 		for (size32_t i = 0; i < n_intervals; i++) {
-			float avg = 0.0f;
-			for (size32_t j = 0; j < step; j++) {
-				avg += freqs[i*step+j];
-			}
-			avg /= step;
-			ofs << " " << avg;
+			ofs << " " << averages[i];
 		}
 		ofs << "\n";
-		n_written++;
-		if (p && !(n_written % denom)) {
-			p->progress((float)n_written / n);
-			Fl::check();
-			if (p->canceled()) { return; }
+	}
+	if (p) {
+		p->progress(1.0f);
+		Fl::check();
+		if (p->canceled()) { return; }
+	}
+}
+
+void Model_Area::write_spike_stats_to(std::ofstream &ofs, size32_t start, size32_t stop, size32_t step,
+	Progress_Dialog *p) {
+	if (p) {
+		p->message("Calculating spike statistics...");
+		p->progress(0.0f);
+		Fl::check();
+		if (p->canceled()) { return; }
+	}
+	// Use the selected somas, or else all enabled somas
+	std::vector<size32_t> indices;
+	size_t n_selected = _state.num_selected();
+	for (size_t i = 0; i < n_selected; i++) {
+		indices.push_back(_state.selected_index(i));
+	}
+	if (indices.empty()) {
+		size32_t n_somas = _model.num_somas();
+		for (size32_t index = 0; index < n_somas; index++) {
+			const Soma_Type *t = _model.type(_model.soma(index)->type_index());
+			if (t->display_state() != Soma_Type::DISABLED) { indices.push_back(index); }
 		}
 	}
+	Spike_Stats stats(_model, indices, start, stop, step);
+	stats.compute_spike_stats();
+	if (p) {
+		p->progress(0.25f);
+		Fl::check();
+		if (p->canceled()) { return; }
+	}
+	stats.compute_voltage_synchrony();
+	if (p) {
+		p->progress(0.5f);
+		Fl::check();
+		if (p->canceled()) { return; }
+	}
+	if (n_selected > 0) { stats.compute_correlograms(); }
+	if (p) {
+		p->progress(0.75f);
+		Fl::check();
+		if (p->canceled()) { return; }
+	}
+	const Firing_Spikes *fd = _model.const_firing_spikes();
+	ofs.setf(std::ios::fixed, std::ios::floatfield);
+	ofs.precision(0);
+	ofs << "# " << fd->filename() << "\n";
+	ofs << "# " << stats.num_somas() << (n_selected > 0 ? " selected" : " enabled") << " somas from cycle " << start <<
+		" to " << stop << " at ";
+	ofs.precision(1);
+	ofs << (1.0f / fd->timescale()) << " ms/cycle\n";
+	stats.write_to(ofs);
 	if (p) {
 		p->progress(1.0f);
 		Fl::check();
@@ -1123,28 +1087,44 @@ void Model_Area::redraw() {
 }
 
 void Model_Area::draw() {
+	Profiler::Scope scope("draw");
 	_fps.start();
-	if (!_initialized) {
+	{
+		Profiler::Scope setup("setup");
+		if (!_initialized) {
 #ifdef __APPLE__
-		if (!context_valid()) { return; } // temporary fix for some OpenGL crashes
+			if (!context_valid()) { return; } // temporary fix for some OpenGL crashes
 #endif
-		refresh_gl();
-		_initialized = true;
-	}
-	if (!valid()) {
-		refresh_projection(DRAWING);
-		valid(1);
+			refresh_gl();
+			_initialized = true;
+		}
+		if (!_drawing_offscreen && !context_valid()) {
+			// A new context has none of the old one's display lists
+			_static_list = 0;
+			_static_compiled = false;
+		}
+		if (!valid()) {
+			refresh_projection(DRAWING);
+			valid(1);
+		}
+		refresh_view();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		// Fix for erratic FLTK font drawing <http://www.fltk.org/newsgroups.php?gfltk.opengl+v:17>
+		GL_Text::draw(" ", 1);
 	}
-	refresh_view();
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	gl_draw(" ", 1); // fix for erratic FLTK font drawing <http://www.fltk.org/newsgroups.php?gfltk.opengl+v:17>
 	if (_opened && _draw_opts.display() == Draw_Options::STATIC_MODEL) {
 		draw_static_model();
 		draw_selected();
 	}
 	else if (_model.has_firing_spikes() && _draw_opts.display() == Draw_Options::FIRING_SPIKES) {
 		const Firing_Spikes *fd = _model.const_firing_spikes();
-		draw_firing_spikes();
+		const Frame_Producer::Frame *f = NULL;
+		if (_frame_producer) {
+			// Draw the colors produced ahead of time for this cycle, if they are ready and still valid
+			if (_frame_producer->invert() != _draw_opts.invert_background()) { start_producing(); }
+			if (_frame_producer) { f = _frame_producer->frame(fd->time()); }
+		}
+		draw_firing_spikes(f);
 		draw_selected(fd);
 		draw_scale(fd, "Hz:");
 	}
@@ -1161,118 +1141,168 @@ void Model_Area::draw() {
 		draw_scale(w, "mV:", 2);
 	}
 	draw_bulletin();
-	draw_clip_rect();
-	draw_rotation_guide();
-	draw_axes();
+	{
+		Profiler::Scope guides("guides");
+		draw_clip_rect();
+		draw_rotation_guide();
+		draw_axes();
+	}
 	_fps.stop();
 	draw_fps();
+	draw_profiler();
 }
 
 void Model_Area::draw_static_model() const {
 	if (_draw_opts.only_show_selected()) { return; }
+	Profiler::Scope scope("static model");
 	glPointSize(3.0f);
-	size32_t n = _model.num_somas();
+	size8_t nt = _model.num_types();
 	if (_draw_opts.allow_letters()) {
-		// Draw somas as letters colored by type
-		gl_font(SOMA_FONT, Soma::soma_letter_size());
-		for (size32_t i = 0; i < n; i++) {
-			const Soma *s = _model.soma(i);
-			const Soma_Type *t = _model.type(s->type_index());
+		// Draw somas of visible types as letters colored by type
+		GL_Text::font(SOMA_FONT, Soma::soma_letter_size());
+		for (size8_t t_index = 0; t_index < nt; t_index++) {
+			const Soma_Type *t = _model.type(t_index);
 			if (!t->visible()) { continue; }
 			glColor3fv(t->color()->rgb());
-			s->draw_letter(t);
+			std::pair<const size32_t *, const size32_t *> typed = _model.somas_of_type(t_index);
+			for (const size32_t *it = typed.first; it != typed.second; ++it) {
+				_model.soma(*it)->draw_letter(t);
+			}
 		}
 	}
 	else {
-		// Draw somas as small dots colored by type
+		// Compile the dots into a display list the first time, and replay it as long as they look the same
+		if (!_static_list) { _static_list = glGenLists(1); }
+		if (_static_compiled && _static_version == _model_version && _static_styles.matches(_model)) {
+			glCallList(_static_list);
+			return;
+		}
+		if (_static_list) { glNewList(_static_list, GL_COMPILE_AND_EXECUTE); }
+		// Draw somas of visible types as small dots colored by type
 		glBegin(GL_POINTS);
-		for (size32_t i = 0; i < n; i++) {
-			const Soma *s = _model.soma(i);
-			const Soma_Type *t = _model.type(s->type_index());
+		for (size8_t t_index = 0; t_index < nt; t_index++) {
+			const Soma_Type *t = _model.type(t_index);
 			if (!t->visible()) { continue; }
 			glColor3fv(t->color()->rgb());
-			s->draw();
+			std::pair<const size32_t *, const size32_t *> typed = _model.somas_of_type(t_index);
+			for (const size32_t *it = typed.first; it != typed.second; ++it) {
+				_model.soma(*it)->draw();
+			}
 		}
 		glEnd();
+		if (_static_list) {
+			glEndList();
+			_static_styles.remember(_model);
+			_static_version = _model_version;
+			_static_compiled = true;
+		}
 	}
 }
 
 void Model_Area::draw_inactive() const {
 	if (!_draw_opts.show_inactive_somas()) { return; }
+	Profiler::Scope scope("inactive somas");
 	// Draw inactive somas as tiny gray dots
 	glPointSize(1.0f);
-	size32_t n = _model.num_somas();
+	size8_t nt = _model.num_types();
 	glColor3fv(_draw_opts.invert_background() ? Sim_Data::INVERT_INACTIVE_SOMA_COLOR : Sim_Data::INACTIVE_SOMA_COLOR);
 	glBegin(GL_POINTS);
-	for (size32_t i = 0; i < n; i++) {
-		const Soma *s = _model.soma(i);
-		const Soma_Type *t = _model.type(s->type_index());
-		if (!t->visible()) { continue; }
-		glVertex3cv(s->coords());
+	for (size8_t t_index = 0; t_index < nt; t_index++) {
+		if (!_model.type(t_index)->visible()) { continue; }
+		std::pair<const size32_t *, const size32_t *> typed = _model.somas_of_type(t_index);
+		for (const size32_t *it = typed.first; it != typed.second; ++it) {
+			glVertex3cv(_model.soma(*it)->coords());
+		}
 	}
 	glEnd();
 }
 
-void Model_Area::draw_firing_spikes() const {
+void Model_Area::draw_firing_spikes(const Frame_Producer::Frame *f) const {
 	if (_draw_opts.only_show_selected()) { return; }
+	Profiler::Scope scope("firing spikes");
 	draw_inactive();
 	const Firing_Spikes *fd = _model.const_firing_spikes();
 	float cv[3];
-	size32_t n = fd->num_somas();
-	if (_draw_opts.display_value_for_somas()) {
-		// Draw active somas as Hertz values colored by firing frequency (highlighted if firing)
-		std::ostringstream ss;
-		ss.setf(std::ios::fixed, std::ios::floatfield);
-		ss.precision(0);
-		for (size32_t index = 0; index < n; index++) {
-			const Soma *s = _model.soma(index);
-			const Soma_Type *t = _model.type(s->type_index());
-			if (!fd->active(index) || _state.is_selected(s) || !t->visible()) { continue; }
-			if (t->display_state() == Soma_Type::LETTER) {
-				fd->bright_color(index, t, cv, _draw_opts.invert_background());
-				glColor3fv(cv);
-				ss.str("");
-				ss << fd->hertz(index);
-				s->draw_firing_value(ss.str(), fd->firing_or_suppressing(index));
-			}
-			else {
-				fd->color(index, t, cv, _draw_opts.invert_background());
-				glColor3fv(cv);
-				s->draw_firing(fd->firing_or_suppressing(index));
+	size8_t nt = _model.num_types();
+	for (size8_t t_index = 0; t_index < nt; t_index++) {
+		const Soma_Type *t = _model.type(t_index);
+		if (!t->visible()) { continue; }
+		std::pair<const size32_t *, const size32_t *> typed = _model.somas_of_type(t_index);
+		// Color the type's somas all at once, unless a produced frame already has
+		size_t n = (size_t)(typed.second - typed.first);
+		const float *colors = NULL;
+		if (!f && n && !(_draw_opts.display_value_for_somas() && t->display_state() == Soma_Type::LETTER)) {
+			_sim_colors.resize(n * 3);
+			fd->colors(typed.first, n, &_sim_colors[0], _draw_opts.invert_background());
+			colors = &_sim_colors[0];
+		}
+		if (_draw_opts.display_value_for_somas()) {
+			// Draw active somas as Hertz values colored by firing frequency (highlighted if firing)
+			std::ostringstream ss;
+			ss.setf(std::ios::fixed, std::ios::floatfield);
+			ss.precision(0);
+			for (const size32_t *it = typed.first; it != typed.second; ++it) {
+				size32_t index = *it;
+				if (!fd->active(index) || _state.is_selected(index)) { continue; }
+				const Soma *s = _model.soma(index);
+				if (t->display_state() == Soma_Type::LETTER) {
+					fd->bright_color(index, t, cv, _draw_opts.invert_background());
+					glColor3fv(cv);
+					ss.str("");
+					ss << fd->hertz(index);
+					s->draw_firing_value(ss.str(), fd->firing_or_suppressing(index));
+				}
+				else {
+					glColor3fv(colors + (it - typed.first) * 3);
+					s->draw_firing(fd->firing_or_suppressing(index));
+				}
 			}
 		}
-	}
-	else if (_draw_opts.allow_letters()) {
-		// Draw active somas as letters colored by firing frequency (highlighted if firing)
-		for (size32_t index = 0; index < n; index++) {
-			const Soma *s = _model.soma(index);
-			const Soma_Type *t = _model.type(s->type_index());
-			if (!fd->active(index) || _state.is_selected(s) || !t->visible()) { continue; }
-			fd->color(index, t, cv, _draw_opts.invert_background());
-			glColor3fv(cv);
-			s->draw_firing_letter(t, fd->firing_or_suppressing(index));
+		else if (_draw_opts.allow_letters()) {
+			// Draw active somas as letters colored by firing frequency (highlighted if firing)
+			for (const size32_t *it = typed.first; it != typed.second; ++it) {
+				size32_t index = *it;
+				const Soma *s = _model.soma(index);
+				if (f) {
+					if (!f->active(index) || _state.is_selected(index)) { continue; }
+					glColor3fv(f->color(index));
+					s->draw_firing_letter(t, f->firing_or_suppressing(index));
+					continue;
+				}
+				if (!fd->active(index) || _state.is_selected(index)) { continue; }
+				glColor3fv(colors + (it - typed.first) * 3);
+				s->draw_firing_letter(t, fd->firing_or_suppressing(index));
+			}
 		}
-	}
-	else {
-		// Draw active somas as large dots colored by firing frequency (highlighted if firing)
-		for (size32_t index = 0; index < n; index++) {
-			const Soma *s = _model.soma(index);
-			const Soma_Type *t = _model.type(s->type_index());
-			if (!fd->active(index) || _state.is_selected(s) || !t->visible()) { continue; }
-			fd->color(index, t, cv, _draw_opts.invert_background());
-			glColor3fv(cv);
-			s->draw_firing(fd->firing_or_suppressing(index));
+		else {
+			// Draw active somas as large dots colored by firing frequency (highlighted if firing)
+			for (const size32_t *it = typed.first; it != typed.second; ++it) {
+				size32_t index = *it;
+				const Soma *s = _model.soma(index);
+				if (f) {
+					if (!f->active(index) || _state.is_selected(index)) { continue; }
+					glColor3fv(f->color(index));
+					s->draw_firing(f->firing_or_suppressing(index));
+					continue;
+				}
+				if (!fd->active(index) || _state.is_selected(index)) { continue; }
+				glColor3fv(colors + (it - typed.first) * 3);
+				s->draw_firing(fd->firing_or_suppressing(index));
+			}
 		}
 	}
 }
 
 void Model_Area::draw_voltages() const {
 	if (_draw_opts.only_show_selected()) { return; }
+	Profiler::Scope scope("voltages");
 	draw_inactive();
 	const Firing_Spikes *fd = _model.const_firing_spikes();
 	const Voltages *vt = _model.const_voltages();
-	float cv[3];
 	size32_t n = vt->num_active_somas();
+	// Color the active somas all at once
+	_sim_colors.resize((size_t)n * 3);
+	if (n) { vt->active_colors(&_sim_colors[0]); }
 	if (_draw_opts.display_value_for_somas()) {
 		// Draw active somas as mV values colored by voltage (highlighted if firing)
 		std::ostringstream ss;
@@ -1282,9 +1312,8 @@ void Model_Area::draw_voltages() const {
 			size32_t index = vt->active_soma_index(i);
 			const Soma *s = _model.soma(index);
 			const Soma_Type *t = _model.type(s->type_index());
-			if (_state.is_selected(s) || !t->visible()) { continue; }
-			vt->color(index, t, cv, _draw_opts.invert_background());
-			glColor3fv(cv);
+			if (_state.is_selected(index) || !t->visible()) { continue; }
+			glColor3fv(&_sim_colors[(size_t)i * 3]);
 			if (t->display_state() == Soma_Type::LETTER) {
 				ss.str("");
 				ss << vt->voltage(index);
@@ -1301,9 +1330,8 @@ void Model_Area::draw_voltages() const {
 			size32_t index = vt->active_soma_index(i);
 			const Soma *s = _model.soma(index);
 			const Soma_Type *t = _model.type(s->type_index());
-			if (_state.is_selected(s) || !t->visible()) { continue; }
-			vt->color(index, t, cv, _draw_opts.invert_background());
-			glColor3fv(cv);
+			if (_state.is_selected(index) || !t->visible()) { continue; }
+			glColor3fv(&_sim_colors[(size_t)i * 3]);
 			s->draw_firing_letter(t, fd->firing(index));
 		}
 	}
@@ -1313,9 +1341,8 @@ void Model_Area::draw_voltages() const {
 			size32_t index = vt->active_soma_index(i);
 			const Soma *s = _model.soma(index);
 			const Soma_Type *t = _model.type(s->type_index());
-			if (_state.is_selected(s) || !t->visible()) { continue; }
-			vt->color(index, t, cv, _draw_opts.invert_background());
-			glColor3fv(cv);
+			if (_state.is_selected(index) || !t->visible()) { continue; }
+			glColor3fv(&_sim_colors[(size_t)i * 3]);
 			s->draw_firing(fd->firing(index));
 		}
 	}
@@ -1323,6 +1350,7 @@ void Model_Area::draw_voltages() const {
 
 void Model_Area::draw_weights() const {
 	if (_draw_opts.only_show_selected()) { return; }
+	Profiler::Scope scope("weights");
 	draw_inactive();
 	const Weights *wt = _model.const_weights();
 	const weights_instance_t &wcs = wt->weight_changes();
@@ -1337,7 +1365,7 @@ void Model_Area::draw_weights() const {
 				size32_t a_index = y->axon_soma_index();
 				const Soma *a = _model.soma(a_index);
 				const Soma_Type *t = _model.type(a->type_index());
-				if (!_state.is_selected(a) && t->visible()) {
+				if (!_state.is_selected(a_index) && t->visible()) {
 					glColor3fv(t->color()->rgb());
 					a->draw_firing_letter(t, fd->firing(a_index));
 				}
@@ -1345,7 +1373,7 @@ void Model_Area::draw_weights() const {
 				size32_t d_index = y->den_soma_index();
 				const Soma *d = _model.soma(d_index);
 				const Soma_Type *u = _model.type(d->type_index());
-				if (!_state.is_selected(d) && u->visible()) {
+				if (!_state.is_selected(d_index) && u->visible()) {
 					glColor3fv(u->color()->rgb());
 					d->draw_firing_letter(u, fd->firing(d_index));
 				}
@@ -1360,7 +1388,7 @@ void Model_Area::draw_weights() const {
 				size32_t a_index = y->axon_soma_index();
 				const Soma *a = _model.soma(a_index);
 				const Soma_Type *t = _model.type(a->type_index());
-				if (!_state.is_selected(a) && t->visible()) {
+				if (!_state.is_selected(a_index) && t->visible()) {
 					glColor3fv(t->color()->rgb());
 					a->draw_firing(fd->firing(a_index));
 				}
@@ -1368,7 +1396,7 @@ void Model_Area::draw_weights() const {
 				size32_t d_index = y->den_soma_index();
 				const Soma *d = _model.soma(d_index);
 				const Soma_Type *u = _model.type(d->type_index());
-				if (!_state.is_selected(d) && u->visible()) {
+				if (!_state.is_selected(d_index) && u->visible()) {
 					glColor3fv(u->color()->rgb());
 					d->draw_firing(fd->firing(d_index));
 				}
@@ -1378,10 +1406,16 @@ void Model_Area::draw_weights() const {
 	if (_draw_opts.axon_conns() || _draw_opts.den_conns() || _draw_opts.syn_dots()) {
 		// Draw active synapses colored by weight
 		const float *bgcv = _draw_opts.invert_background() ? INVERT_BACKGROUND_COLOR : BACKGROUND_COLOR;
-		for (weights_instance_t::const_iterator ys = wcs.begin(); ys != wcs.end(); ++ys) {
+		_weights_batch.clear();
+		_weights_batch.point_size(5.0f);
+		// Color the active synapses all at once
+		_sim_colors.resize(wcs.size() * 3);
+		if (!wcs.empty()) { wt->synapse_colors(&_sim_colors[0], _draw_opts.weights_color_after()); }
+		const float *cv = _sim_colors.empty() ? NULL : &_sim_colors[0];
+		for (weights_instance_t::const_iterator ys = wcs.begin(); ys != wcs.end(); ++ys, cv += 3) {
 			size32_t y_index = ys->first;
 			const Synapse *y = _model.synapse(y_index);
-			bool y_marked = _state.is_marked(y, y_index);
+			bool y_marked = _state.is_marked(y_index);
 			if (_draw_opts.only_show_marked() && !y_marked) { continue; }
 			// Get axonal soma
 			size32_t a_index = y->axon_soma_index();
@@ -1394,169 +1428,175 @@ void Model_Area::draw_weights() const {
 			const Soma_Type *u = _model.type(d->type_index());
 			if (!u->visible()) { continue; }
 			// Draw synapse
-			float cv[3];
-			wt->synapse_color(y_index, cv, _draw_opts.weights_color_after());
-			glColor3fv(cv);
-			bool conn_unsel = _draw_opts.only_conn_selected() && (!_state.is_selected(a) || !_state.is_selected(d));
+			_weights_batch.color(cv);
+			bool conn_unsel = _draw_opts.only_conn_selected() && (!_state.is_selected(a_index) || !_state.is_selected(d_index));
 			if ((_draw_opts.axon_conns() || _draw_opts.den_conns()) && !conn_unsel) {
-				y->draw_conn(a, d, _draw_opts.to_axon(), _draw_opts.to_via(), _draw_opts.to_synapse(), _draw_opts.to_den());
+				y->draw_conn(_weights_batch, a, d, _draw_opts.to_axon(), _draw_opts.to_via(), _draw_opts.to_synapse(),
+					_draw_opts.to_den());
 			}
 			if (_draw_opts.syn_dots()) {
 				if (y_marked) {
 					y->draw_marked(cv, bgcv);
 				}
 				else {
-					glPointSize(5.0f);
-					glBegin(GL_POINTS);
-					y->draw();
-					glEnd();
+					_weights_batch.point(y->coords());
 				}
 			}
 		}
+		_weights_batch.draw();
 	}
 }
 
-void Model_Area::draw_selected() const {
+bool Model_Area::selected_batched() const {
+	if (!_batched || _batched_version != _model_version) { return false; }
+	if (!_state.same_selection(_batched_state) || !_draw_opts.equals(_batched_opts)) { return false; }
+	if (_state.clipped() != _batched_state.clipped() ||
+		!_state.const_clip_volume().equals(_batched_state.const_clip_volume())) { return false; }
+	// Synapses and gap junctions may still be loading
+	if (_model.num_synapses() != _batched_synapses || _model.num_gap_junctions() != _batched_gap_junctions) {
+		return false;
+	}
+	return _batched_styles.matches(_model);
+}
+
+void Model_Area::batch_selected() const {
+	_selected_batch.clear();
+	_selected_fields_batch.clear();
+	_selected_letters.clear();
 	bool only_show_clipped = _state.clipped() && _draw_opts.only_show_clipped();
 	bool only_enable_clipped = _state.clipped() && _draw_opts.only_enable_clipped();
-	if (only_show_clipped) { Clip_Volume::disable(); }
 	const Clip_Volume &clip_volume = _state.const_clip_volume();
-	const float *bgcv = _draw_opts.invert_background() ? INVERT_BACKGROUND_COLOR : BACKGROUND_COLOR;
 	size_t n = _state.num_selected();
 	size32_t ny = _model.num_synapses();
-	glPointSize(3.0f);
-	// Draw selected somas with their synapses and neuritic fields
-	gl_font(SOMA_FONT, Soma::soma_letter_size());
+	Geometry_Batch &b = _selected_batch, &fb = _selected_fields_batch;
+	b.point_size(3.0f);
+	// Batch selected somas' synapses and neuritic fields
 	for (size_t i = 0; i < n; i++) {
 		const Soma *s = _state.selected(i);
 		const Soma_Type *t = _model.type(s->type_index());
 		const Synapse *y = NULL;
 		if (_draw_opts.axon_conns()) {
-			// Draw axonal connections
+			// Batch axonal connections
 			for (size32_t a_index = s->first_axon_syn_index(); a_index < ny; a_index = y->next_axon_syn_index()) {
 				y = _model.synapse(a_index);
-				if (_draw_opts.only_show_marked() && !_state.is_marked(y, a_index)) { continue; }
+				if (_draw_opts.only_show_marked() && !_state.is_marked(a_index)) { continue; }
 				const Soma *d = _model.soma(y->den_soma_index());
-				if (_draw_opts.only_conn_selected() && !_state.is_selected(d)) { continue; }
+				if (_draw_opts.only_conn_selected() && !_state.is_selected(y->den_soma_index())) { continue; }
 				const Soma_Type *u = _model.type(d->type_index());
 				bool outside = !clip_volume.contains(d->coords());
 				if (u->display_state() == Soma_Type::DISABLED || (only_enable_clipped && outside)) { continue; }
 				if (u->display_state() == Soma_Type::HIDDEN || (only_show_clipped && outside) ||
 					_draw_opts.only_show_selected()) {
 					// Draw dendritic soma as a letter or dot colored by type
-					glColor3fv(u->color()->rgb());
 					if (_draw_opts.allow_letters()) {
-						d->draw_letter(u);
+						_selected_letters.push_back(d);
 					}
 					else {
-						glBegin(GL_POINTS);
-						d->draw();
-						glEnd();
+						b.color(u->color()->rgb());
+						b.point(d->coords());
 					}
 				}
 				// Draw synapse colored by axonal soma type
-				glColor3fv(t->color()->rgb());
-				y->draw_conn(s, d, _draw_opts.to_axon(), _draw_opts.to_via(), _draw_opts.to_synapse(), _draw_opts.to_den());
+				b.color(t->color()->rgb());
+				y->draw_conn(b, s, d, _draw_opts.to_axon(), _draw_opts.to_via(), _draw_opts.to_synapse(),
+					_draw_opts.to_den());
 			}
 		}
 		if (_draw_opts.den_conns()) {
-			// Draw dendritic connections
+			// Batch dendritic connections
 			for (size32_t d_index = s->first_den_syn_index(); d_index < ny; d_index = y->next_den_syn_index()) {
 				y = _model.synapse(d_index);
-				if (_draw_opts.only_show_marked() && !_state.is_marked(y, d_index)) { continue; }
+				if (_draw_opts.only_show_marked() && !_state.is_marked(d_index)) { continue; }
 				const Soma *a = _model.soma(y->axon_soma_index());
-				if (_draw_opts.only_conn_selected() && !_state.is_selected(a)) { continue; }
+				if (_draw_opts.only_conn_selected() && !_state.is_selected(y->axon_soma_index())) { continue; }
 				const Soma_Type *u = _model.type(a->type_index());
 				bool outside = !clip_volume.contains(a->coords());
 				if (u->display_state() == Soma_Type::DISABLED || (only_enable_clipped && outside)) { continue; }
 				if (u->display_state() == Soma_Type::HIDDEN || (only_show_clipped && outside) ||
 					_draw_opts.only_show_selected()) {
 					// Draw axonal soma as a letter or dot colored by type
-					glColor3fv(u->color()->rgb());
 					if (_draw_opts.allow_letters()) {
-						a->draw_letter(u);
+						_selected_letters.push_back(a);
 					}
 					else {
-						glBegin(GL_POINTS);
-						a->draw();
-						glEnd();
+						b.color(u->color()->rgb());
+						b.point(a->coords());
 					}
 				}
 				// Draw synapse colored by axonal soma type
-				glColor3fv(u->color()->rgb());
-				y->draw_conn(a, s, _draw_opts.to_axon(), _draw_opts.to_via(), _draw_opts.to_synapse(), _draw_opts.to_den());
+				b.color(u->color()->rgb());
+				y->draw_conn(b, a, s, _draw_opts.to_axon(), _draw_opts.to_via(), _draw_opts.to_synapse(),
+					_draw_opts.to_den());
 			}
 		}
 		if (_draw_opts.neur_fields() && (s->num_axon_fields() || s->num_den_fields())) {
-			// Draw neuritic fields
+			// Batch neuritic fields
 			if (_draw_opts.conn_fields()) {
-				// Draw connected fields for axonal synapses
+				// Batch connected fields for axonal synapses
 				for (size32_t a_index = s->first_axon_syn_index(); a_index < ny; a_index = y->next_axon_syn_index()) {
 					y = _model.synapse(a_index);
-					if (_draw_opts.only_show_marked() && !_state.is_marked(y, a_index)) { continue; }
+					if (_draw_opts.only_show_marked() && !_state.is_marked(a_index)) { continue; }
 					const Soma *o = _model.soma(y->den_soma_index());
-					if (_draw_opts.only_conn_selected() && !_state.is_selected(o)) { continue; }
+					if (_draw_opts.only_conn_selected() && !_state.is_selected(y->den_soma_index())) { continue; }
 					const Soma_Type *u = _model.type(o->type_index());
 					bool outside = !clip_volume.contains(o->coords());
 					if (u->display_state() == Soma_Type::DISABLED || (only_enable_clipped && outside)) { continue; }
-					o->draw_fields(true, _model);
+					o->draw_fields(fb, true, _model);
 				}
-				// Draw connected fields for dendritic synapses
+				// Batch connected fields for dendritic synapses
 				for (size32_t d_index = s->first_den_syn_index(); d_index < ny; d_index = y->next_den_syn_index()) {
 					y = _model.synapse(d_index);
-					if (_draw_opts.only_show_marked() && !_state.is_marked(y, d_index)) { continue; }
+					if (_draw_opts.only_show_marked() && !_state.is_marked(d_index)) { continue; }
 					const Soma *o = _model.soma(y->axon_soma_index());
-					if (_draw_opts.only_conn_selected() && !_state.is_selected(o)) { continue; }
+					if (_draw_opts.only_conn_selected() && !_state.is_selected(y->axon_soma_index())) { continue; }
 					const Soma_Type *u = _model.type(o->type_index());
 					bool outside = !clip_volume.contains(o->coords());
 					if (u->display_state() == Soma_Type::DISABLED || (only_enable_clipped && outside)) { continue; }
-					o->draw_fields(true, _model);
+					o->draw_fields(fb, true, _model);
 				}
 			}
-			// Draw fields as boxes
-			s->draw_fields(false, _model);
+			// Batch fields as boxes
+			s->draw_fields(fb, false, _model);
 		}
 		if (_draw_opts.syn_dots() && !_draw_opts.only_show_marked()) {
-			// Draw synapse dots
-			glPointSize(5.0f);
-			glBegin(GL_POINTS);
+			// Batch synapse dots
+			b.point_size(5.0f);
 			// Draw axonal synapses as large red dots
-			glColor3fv(AXON_SYN_COLOR);
+			b.color(AXON_SYN_COLOR);
 			for (size32_t a_index = s->first_axon_syn_index(); a_index < ny; a_index = y->next_axon_syn_index()) {
 				y = _model.synapse(a_index);
-				if (_state.is_marked(y, a_index)) { continue; }
+				if (_state.is_marked(a_index)) { continue; }
 				const coord_t *c = y->coords();
 				if (only_enable_clipped && !clip_volume.contains(c)) { continue; }
 				const Soma *d = _model.soma(y->den_soma_index());
-				if (_draw_opts.only_conn_selected() && !_state.is_selected(d)) { continue; }
+				if (_draw_opts.only_conn_selected() && !_state.is_selected(y->den_soma_index())) { continue; }
 				const Soma_Type *u = _model.type(d->type_index());
 				bool outside = !clip_volume.contains(d->coords());
 				if (u->display_state() == Soma_Type::DISABLED || (only_enable_clipped && outside)) { continue; }
-				y->draw();
+				b.point(c);
 			}
 			// Draw dendritic synapses as large purple dots
-			glColor3fv(DEN_SYN_COLOR);
+			b.color(DEN_SYN_COLOR);
 			for (size32_t d_index = s->first_den_syn_index(); d_index < ny; d_index = y->next_den_syn_index()) {
 				y = _model.synapse(d_index);
-				if (_state.is_marked(y, d_index)) { continue; }
+				if (_state.is_marked(d_index)) { continue; }
 				const coord_t *c = y->coords();
 				if (only_enable_clipped && !clip_volume.contains(c)) { continue; }
 				const Soma *a = _model.soma(y->axon_soma_index());
-				if (_draw_opts.only_conn_selected() && !_state.is_selected(a)) { continue; }
+				if (_draw_opts.only_conn_selected() && !_state.is_selected(y->axon_soma_index())) { continue; }
 				const Soma_Type *u = _model.type(a->type_index());
 				bool outside = !clip_volume.contains(a->coords());
 				if (u->display_state() == Soma_Type::DISABLED || (only_enable_clipped && outside)) { continue; }
-				y->draw();
+				b.point(c);
 			}
-			glEnd();
+			b.point_size(3.0f);
 		}
-		// Draw selected soma as circled dot colored by type
-		const float *cv = t->color()->rgb();
-		s->draw_circled(cv, bgcv);
 	}
-	for (marked_syns_t::const_iterator it = _state.begin_marked_synapses(); it != _state.end_marked_synapses(); ++it) {
-		const Synapse *y = it->first;
-		if ((_draw_opts.axon_conns() || _draw_opts.den_conns()) && !_draw_opts.only_conn_selected()) {
+	size_t nm = _state.num_marked();
+	if ((_draw_opts.axon_conns() || _draw_opts.den_conns()) && !_draw_opts.only_conn_selected()) {
+		// Batch marked synapses
+		for (size_t i = 0; i < nm; i++) {
+			const Synapse *y = _model.synapse(_state.marked_index(i));
 			const Soma *a = _model.soma(y->axon_soma_index());
 			const Soma_Type *t = _model.type(a->type_index());
 			bool a_outside = !clip_volume.contains(a->coords());
@@ -1566,47 +1606,36 @@ void Model_Area::draw_selected() const {
 			if (t->display_state() == Soma_Type::HIDDEN || (only_show_clipped && a_outside) ||
 				_draw_opts.only_show_selected()) {
 				// Draw axonal soma as a letter or dot colored by type
-				glColor3fv(t->color()->rgb());
 				if (_draw_opts.allow_letters()) {
-					a->draw_letter(t);
+					_selected_letters.push_back(a);
 				}
 				else {
-					glPointSize(3.0f);
-					glBegin(GL_POINTS);
-					a->draw();
-					glEnd();
+					b.color(t->color()->rgb());
+					b.point(a->coords());
 				}
 			}
 			if (u->display_state() == Soma_Type::HIDDEN || (only_show_clipped && d_outside) ||
 				_draw_opts.only_show_selected()) {
 				// Draw dendritic soma as a letter or dot colored by type
-				glColor3fv(u->color()->rgb());
 				if (_draw_opts.allow_letters()) {
-					d->draw_letter(u);
+					_selected_letters.push_back(d);
 				}
 				else {
-					glPointSize(3.0f);
-					glBegin(GL_POINTS);
-					d->draw();
-					glEnd();
+					b.color(u->color()->rgb());
+					b.point(d->coords());
 				}
 			}
 			// Draw synapse colored by axonal soma type
-			glColor3fv(t->color()->rgb());
-			y->draw_conn(a, d, _draw_opts.to_axon(), _draw_opts.to_via(), _draw_opts.to_synapse(), _draw_opts.to_den());
-		}
-		if (_draw_opts.syn_dots()) {
-			// Draw marked synapses as circled orange dots
-			y->draw_marked(MARKED_SYN_COLOR, bgcv);
+			b.color(t->color()->rgb());
+			y->draw_conn(b, a, d, _draw_opts.to_axon(), _draw_opts.to_via(), _draw_opts.to_synapse(),
+				_draw_opts.to_den());
 		}
 	}
 	if (_draw_opts.gap_junctions()) {
-		// Draw gap junctions involving selected somas as dotted lines with dots at the junctions
+		// Batch gap junctions involving selected somas as dotted lines with dots at the junctions
 		size32_t ng = _model.num_gap_junctions();
-		glPointSize(3.0f);
-		glColor3fv(GAP_JUNCTION_COLOR);
-		glEnable(GL_LINE_STIPPLE);
-		glLineStipple(1, 0xAAAA); // dotted lines - 1010101010101010
+		b.color(GAP_JUNCTION_COLOR);
+		b.dotted(true);
 		for (size32_t i = 0; i < ng; i++) {
 			const Gap_Junction *g = _model.gap_junction(i);
 			const Soma *s1 = _model.soma(g->soma1_index());
@@ -1614,22 +1643,62 @@ void Model_Area::draw_selected() const {
 			const Soma *s2 = _model.soma(g->soma2_index());
 			const Soma_Type *t2 = _model.type(s2->type_index());
 			if (t1->display_state() == Soma_Type::DISABLED || t2->display_state() == Soma_Type::DISABLED) { continue; }
-			if (_draw_opts.only_conn_selected() ? _state.is_selected(s1) && _state.is_selected(s2) :
-				_state.is_selected(s1) || _state.is_selected(s2)) {
-				g->draw(s1, s2);
+			if (_draw_opts.only_conn_selected() ? _state.is_selected(g->soma1_index()) && _state.is_selected(g->soma2_index()) :
+				_state.is_selected(g->soma1_index()) || _state.is_selected(g->soma2_index())) {
+				g->draw(b, s1, s2);
 			}
 		}
-		glDisable(GL_LINE_STIPPLE);
-		glPointSize(1.0f);
+		b.dotted(false);
+	}
+	// Remember what the batches show
+	_batched_state = _state;
+	_batched_opts = _draw_opts;
+	_batched_styles.remember(_model);
+	_batched_synapses = ny;
+	_batched_gap_junctions = _model.num_gap_junctions();
+	_batched_version = _model_version;
+	_batched = true;
+}
+
+void Model_Area::draw_selected() const {
+	Profiler::Scope scope("selection");
+	bool only_show_clipped = _state.clipped() && _draw_opts.only_show_clipped();
+	if (only_show_clipped) { Clip_Volume::disable(); }
+	const float *bgcv = _draw_opts.invert_background() ? INVERT_BACKGROUND_COLOR : BACKGROUND_COLOR;
+	if (!selected_batched()) { batch_selected(); }
+	// Draw selected somas' synapses, neuritic fields, and gap junctions
+	_selected_fields_batch.draw();
+	_selected_batch.draw();
+	// Draw connected somas as letters colored by type
+	GL_Text::font(SOMA_FONT, Soma::soma_letter_size());
+	size_t nl = _selected_letters.size();
+	for (size_t i = 0; i < nl; i++) {
+		const Soma *s = _selected_letters[i];
+		const Soma_Type *t = _model.type(s->type_index());
+		glColor3fv(t->color()->rgb());
+		s->draw_letter(t);
+	}
+	// Draw selected somas as circled dots colored by type
+	size_t n = _state.num_selected();
+	for (size_t i = 0; i < n; i++) {
+		const Soma *s = _state.selected(i);
+		const Soma_Type *t = _model.type(s->type_index());
+		s->draw_circled(t->color()->rgb(), bgcv);
+	}
+	if (_draw_opts.syn_dots()) {
+		// Draw marked synapses as circled orange dots
+		size_t nm = _state.num_marked();
+		for (size_t i = 0; i < nm; i++) {
+			_model.synapse(_state.marked_index(i))->draw_marked(MARKED_SYN_COLOR, bgcv);
+		}
 	}
 	if (only_show_clipped) { Clip_Volume::enable(); }
 }
 
 void Model_Area::draw_selected(const Sim_Data *sd) const {
+	Profiler::Scope scope("selection");
 	bool only_show_clipped = _state.clipped() && _draw_opts.only_show_clipped();
-	bool only_enable_clipped = _state.clipped() && _draw_opts.only_enable_clipped();
 	if (only_show_clipped) { Clip_Volume::disable(); }
-	const Clip_Volume &clip_volume = _state.const_clip_volume();
 	const float *bgcv = _draw_opts.invert_background() ? INVERT_BACKGROUND_COLOR : BACKGROUND_COLOR;
 	double model_view[16], projection[16];
 	int viewport[4];
@@ -1638,42 +1707,14 @@ void Model_Area::draw_selected(const Sim_Data *sd) const {
 	glGetIntegerv(GL_VIEWPORT, viewport);
 	const Firing_Spikes *fd = _model.const_firing_spikes();
 	size_t n = _state.num_selected();
-	size32_t ny = _model.num_synapses();
+	// Draw selected somas' neuritic fields
+	if (!selected_batched()) { batch_selected(); }
+	_selected_fields_batch.draw();
 	// Draw selected somas as circled letters colored by the active set (highlighted if firing)
 	for (size_t i = 0; i < n; i++) {
 		const Soma *s = _state.selected(i);
 		size32_t index = _state.selected_index(i);
 		const Soma_Type *t = _model.type(s->type_index());
-		const Synapse *y = NULL;
-		if (_draw_opts.neur_fields() && (s->num_axon_fields() || s->num_den_fields())) {
-			// Draw neuritic fields
-			if (_draw_opts.conn_fields()) {
-				// Draw connected fields for axonal synapses
-				for (size32_t a_index = s->first_axon_syn_index(); a_index < ny; a_index = y->next_axon_syn_index()) {
-					y = _model.synapse(a_index);
-					if (_draw_opts.only_show_marked() && !_state.is_marked(y, a_index)) { continue; }
-					const Soma *o = _model.soma(y->den_soma_index());
-					if (_draw_opts.only_conn_selected() && !_state.is_selected(o)) { continue; }
-					const Soma_Type *u = _model.type(o->type_index());
-					bool outside = !clip_volume.contains(o->coords());
-					if (u->display_state() == Soma_Type::DISABLED || (only_enable_clipped && outside)) { continue; }
-					o->draw_fields(true, _model);
-				}
-				// Draw connected fields for dendritic synapses
-				for (size32_t d_index = s->first_den_syn_index(); d_index < ny; d_index = y->next_den_syn_index()) {
-					y = _model.synapse(d_index);
-					if (_draw_opts.only_show_marked() && !_state.is_marked(y, d_index)) { continue; }
-					const Soma *o = _model.soma(y->axon_soma_index());
-					if (_draw_opts.only_conn_selected() && !_state.is_selected(o)) { continue; }
-					const Soma_Type *u = _model.type(o->type_index());
-					bool outside = !clip_volume.contains(o->coords());
-					if (u->display_state() == Soma_Type::DISABLED || (only_enable_clipped && outside)) { continue; }
-					o->draw_fields(true, _model);
-				}
-			}
-			// Draw fields as boxes
-			s->draw_fields(false, _model);
-		}
 		bool firing = fd->firing(index);
 		float cv[3];
 		sd->color(index, t, cv, _draw_opts.invert_background());
@@ -1683,37 +1724,37 @@ void Model_Area::draw_selected(const Sim_Data *sd) const {
 	if (sd == wt && _draw_opts.only_show_selected() && (_draw_opts.axon_conns() || _draw_opts.den_conns() || _draw_opts.syn_dots())) {
 		const weights_instance_t &wcs = wt->weight_changes();
 		float cv[3];
+		_weights_batch.clear();
+		_weights_batch.point_size(5.0f);
 		// Draw selected somas' synapses colored by weight
 		for (weights_instance_t::const_iterator ys = wcs.begin(); ys != wcs.end(); ++ys) {
 			size32_t y_index = ys->first;
 			const Synapse *y = _model.synapse(y_index);
-			bool y_marked = _state.is_marked(y, y_index);
+			bool y_marked = _state.is_marked(y_index);
 			// Get axonal soma
 			size32_t a_index = y->axon_soma_index();
 			const Soma *a = _model.soma(a_index);
 			const Soma_Type *t = _model.type(a->type_index());
 			if (t->display_state() == Soma_Type::DISABLED) { continue; }
-			bool a_sel = _state.is_selected(a);
+			bool a_sel = _state.is_selected(a_index);
 			// Get dendritic soma
 			size32_t d_index = y->den_soma_index();
 			const Soma *d = _model.soma(d_index);
 			const Soma_Type *u = _model.type(d->type_index());
 			if (u->display_state() == Soma_Type::DISABLED) { continue; }
-			bool d_sel = _state.is_selected(d);
+			bool d_sel = _state.is_selected(d_index);
 			if (((!a_sel && !d_sel) || _draw_opts.only_show_marked()) && !y_marked) { continue; }
 			// Draw synapse
 			if (_draw_opts.axon_conns() || _draw_opts.den_conns()) {
 				wt->synapse_color(y_index, cv, _draw_opts.weights_color_after());
-				glColor3fv(cv);
-				y->draw_conn(a, d, _draw_opts.to_axon(), _draw_opts.to_via(), _draw_opts.to_synapse(), _draw_opts.to_den());
+				_weights_batch.color(cv);
+				y->draw_conn(_weights_batch, a, d, _draw_opts.to_axon(), _draw_opts.to_via(), _draw_opts.to_synapse(),
+					_draw_opts.to_den());
 				if (y_marked) {
 					y->draw_marked(cv, bgcv);
 				}
 				else {
-					glPointSize(5.0f);
-					glBegin(GL_POINTS);
-					y->draw();
-					glEnd();
+					_weights_batch.point(y->coords());
 				}
 				if (!a_sel) {
 					glColor3fv(t->color()->rgb());
@@ -1740,20 +1781,19 @@ void Model_Area::draw_selected(const Sim_Data *sd) const {
 					y->draw_marked(cv, bgcv);
 				}
 				else {
-					glColor3fv(cv);
-					glPointSize(5.0f);
-					glBegin(GL_POINTS);
-					y->draw();
-					glEnd();
+					_weights_batch.color(cv);
+					_weights_batch.point(y->coords());
 				}
 			}
 		}
+		_weights_batch.draw();
 	}
 	if (only_show_clipped) { Clip_Volume::enable(); }
 }
 
 void Model_Area::draw_scale(const Sim_Data *sd, const char *l, std::streamsize p) const {
 	if (!_draw_opts.show_color_scale()) { return; }
+	Profiler::Scope scope("scale");
 	// Push projection matrix
 	glMatrixMode(GL_PROJECTION);
 	glPushMatrix();
@@ -1785,10 +1825,10 @@ void Model_Area::draw_scale(const Sim_Data *sd, const char *l, std::streamsize p
 	// Draw labels
 #ifdef LARGE_INTERFACE
 	int cw = 9, ch = 5, ld = 6;
-	gl_font(FL_HELVETICA, 16);
+	GL_Text::font(FL_HELVETICA, 16);
 #else
 	int cw = 7, ch = 3, ld = 5;
-	gl_font(FL_HELVETICA, 12);
+	GL_Text::font(FL_HELVETICA, 12);
 #endif
 	glColor3fv(_draw_opts.invert_background() ? BACKGROUND_COLOR : INVERT_BACKGROUND_COLOR);
 	std::ostringstream ss;
@@ -1803,12 +1843,12 @@ void Model_Area::draw_scale(const Sim_Data *sd, const char *l, std::streamsize p
 		if (q < 0.0f) { tlw -= 0.5f; } // half-width "-"
 		if (p > 0) { tlw -= 0.5f; } // half-width "."
 		glRasterPos2i((int)(xc-sw-ld-cw*tlw), yc+ch-shi*dsh);
-		gl_draw(ss.str().c_str(), tll);
+		GL_Text::draw(ss.str().c_str(), tll);
 	}
 	// Draw heading
 	int ll = (int)strlen(l);
 	glRasterPos2i(xc-sw-ld-cw*ll, yc+ch-shi*11);
-	gl_draw(l, ll);
+	GL_Text::draw(l, ll);
 	// Re-enable depth test
 	glEnable(GL_DEPTH_TEST);
 	// Pop matrices
@@ -1820,6 +1860,7 @@ void Model_Area::draw_scale(const Sim_Data *sd, const char *l, std::streamsize p
 
 void Model_Area::draw_bulletin() const {
 	if (!_draw_opts.show_bulletin()) { return; }
+	Profiler::Scope scope("bulletin");
 	// Push projection matrix
 	glMatrixMode(GL_PROJECTION);
 	glPushMatrix();
@@ -1832,20 +1873,31 @@ void Model_Area::draw_bulletin() const {
 	// Disable depth test and clip planes
 	glDisable(GL_DEPTH_TEST);
 	Clip_Volume::disable();
+#ifdef LARGE_INTERFACE
+	GL_Text::font(FL_HELVETICA, 16);
+#else
+	GL_Text::font(FL_HELVETICA, 12);
+#endif
 	// Prepare bulletin
 	std::ostringstream ss;
 	ss.imbue(std::locale(""));
 	ss.setf(std::ios::fixed, std::ios::floatfield);
-	// Add lines in reverse order
+	// Add lines in reverse order, only listing as many selected somas as fit
 	size_t nl = 0;
 	size_t ns = _state.num_selected();
 	if (ns) {
-		for (size_t i = ns; i > 0; i--) {
+		size_t max_nl = (size_t)(h() / GL_Text::height());
+		size_t nsl = max_nl > 2 ? std::min(ns, max_nl - 2) : 0;
+		for (size_t i = ns; i > ns - nsl; i--) {
 			const Soma *s = _state.selected(i - 1);
 			const Soma_Type *t = _model.type(s->type_index());
 			ss << t->letter() << " #" << s->id() << "\n";
 			nl++;
 		}
+		if (nsl < ns) {
+			ss << "...\n";
+			nl++;
+		}
 		ss << ns << " selected:\n";
 		nl++;
 	}
@@ -1855,12 +1907,7 @@ void Model_Area::draw_bulletin() const {
 	}
 	// Draw bulletin
 	glColor3fv(_draw_opts.invert_background() ? BACKGROUND_COLOR : INVERT_BACKGROUND_COLOR);
-#ifdef LARGE_INTERFACE
-	gl_font(FL_HELVETICA, 16);
-#else
-	gl_font(FL_HELVETICA, 12);
-#endif
-	gl_draw(ss.str().c_str(), 2, 2, 200, (int)nl * fl_height() + fl_height() / 2, FL_ALIGN_TOP_LEFT);
+	GL_Text::draw(ss.str().c_str(), 2, 2, 200, (int)nl * GL_Text::height() + GL_Text::height() / 2, FL_ALIGN_TOP_LEFT);
 	// Re-enable depth test
 	glEnable(GL_DEPTH_TEST);
 	// Pop matrices
@@ -2009,7 +2056,7 @@ void Model_Area::draw_axes() const {
 	Clip_Volume::disable();
 	// Draw axes
 	glLineWidth(2.0f);
-	gl_font(FL_HELVETICA, 12);
+	GL_Text::font(FL_HELVETICA, 12);
 	char l;
 	glColor3fv(X_AXIS_COLOR);
 	glBegin(GL_LINES);
@@ -2019,7 +2066,7 @@ void Model_Area::draw_axes() const {
 	if (_draw_opts.show_axis_labels()) {
 		l = 'X';
 		glRasterPos3d(1.1, 0.0, 0.0);
-		gl_draw(&l, 1);
+		GL_Text::draw(&l, 1);
 	}
 	glColor3fv(Y_AXIS_COLOR);
 	glBegin(GL_LINES);
@@ -2029,7 +2076,7 @@ void Model_Area::draw_axes() const {
 	if (_draw_opts.show_axis_labels()) {
 		l = 'Y';
 		glRasterPos3d(0.0, 1.1, 0.0);
-		gl_draw(&l, 1);
+		GL_Text::draw(&l, 1);
 	}
 	glColor3fv(Z_AXIS_COLOR);
 	glBegin(GL_LINES);
@@ -2039,7 +2086,7 @@ void Model_Area::draw_axes() const {
 	if (_draw_opts.show_axis_labels()) {
 		l = 'Z';
 		glRasterPos3d(0.0, 0.0, 1.1);
-		gl_draw(&l, 1);
+		GL_Text::draw(&l, 1);
 	}
 	glLineWidth(1.0f);
 	// Re-enable depth test
@@ -2080,11 +2127,77 @@ void Model_Area::draw_fps() const {
 	// Draw FPS
 	glColor3fv(_draw_opts.invert_background() ? BACKGROUND_COLOR : INVERT_BACKGROUND_COLOR);
 #ifdef LARGE_INTERFACE
-	gl_font(FL_HELVETICA, 16);
+	GL_Text::font(FL_HELVETICA, 16);
 #else
-	gl_font(FL_HELVETICA, 12);
+	GL_Text::font(FL_HELVETICA, 12);
 #endif
-	gl_draw(ss.str().c_str(), 2, 2, w() - 4, fl_height() + fl_height() / 2, FL_ALIGN_TOP_RIGHT);
+	GL_Text::draw(ss.str().c_str(), 2, 2, w() - 4, GL_Text::height() + GL_Text::height() / 2, FL_ALIGN_TOP_RIGHT);
+	// Re-enable depth test
+	glEnable(GL_DEPTH_TEST);
+	// Pop matrices
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopMatrix();
+}
+
+void Model_Area::draw_profiler() const {
+	if (!_draw_opts.show_profiler()) { return; }
+	// Push projection matrix
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	gluOrtho2D(0.0, w(), h(), 0.0);
+	// Push model view matrix
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	// Disable depth test and clip planes
+	glDisable(GL_DEPTH_TEST);
+	Clip_Volume::disable();
+#ifdef LARGE_INTERFACE
+	GL_Text::font(FL_HELVETICA, 16);
+	int name_w = 200, stat_w = 60;
+#else
+	GL_Text::font(FL_HELVETICA, 12);
+	int name_w = 150, stat_w = 45;
+#endif
+	// Prepare a column of section names, indented by nesting, and columns of their durations, only listing as many
+	// sections as fit below the FPS
+	std::vector<Profiler::Stats> stats;
+	Profiler::stats(stats);
+	int lh = GL_Text::height();
+	int y = 2 + lh;
+	size_t max_nl = h() > y + lh ? (size_t)((h() - y) / lh) - 1 : 0;
+	size_t nl = std::min(stats.size(), max_nl);
+	std::ostringstream names, mins, avgs, p99s;
+	names << "ms\n";
+	mins << "min\n";
+	avgs << "avg\n";
+	p99s << "p99\n";
+	mins.setf(std::ios::fixed, std::ios::floatfield);
+	mins.precision(2);
+	avgs.setf(std::ios::fixed, std::ios::floatfield);
+	avgs.precision(2);
+	p99s.setf(std::ios::fixed, std::ios::floatfield);
+	p99s.precision(2);
+	for (size_t i = 0; i < nl; i++) {
+		const Profiler::Stats &s = stats[i];
+		names << std::string(s.depth * 2, ' ') << s.name << "\n";
+		mins << s.min << "\n";
+		avgs << s.avg << "\n";
+		p99s << s.p99 << "\n";
+	}
+	// Draw profiler
+	glColor3fv(_draw_opts.invert_background() ? BACKGROUND_COLOR : INVERT_BACKGROUND_COLOR);
+	int x = w() - 2 - name_w - 3 * stat_w, ch = (int)(nl + 1) * lh + lh / 2;
+	GL_Text::draw(names.str().c_str(), x, y, name_w, ch, FL_ALIGN_TOP_LEFT);
+	x += name_w;
+	GL_Text::draw(mins.str().c_str(), x, y, stat_w, ch, FL_ALIGN_TOP_RIGHT);
+	x += stat_w;
+	GL_Text::draw(avgs.str().c_str(), x, y, stat_w, ch, FL_ALIGN_TOP_RIGHT);
+	x += stat_w;
+	GL_Text::draw(p99s.str().c_str(), x, y, stat_w, ch, FL_ALIGN_TOP_RIGHT);
 	// Re-enable depth test
 	glEnable(GL_DEPTH_TEST);
 	// Pop matrices
@@ -2235,12 +2348,13 @@ void Model_Area::select() {
 		if (!_draw_opts.only_show_selected()) {
 			if (_draw_opts.show_inactive_somas()) {
 				// Imitate drawing the inactive somas
-				size32_t n = _model.num_somas();
-				for (size32_t index = 0; index < n; index++) {
-					const Soma *s = _model.soma(index);
-					const Soma_Type *t = _model.type(s->type_index());
-					if (!t->visible()) { continue; }
-					s->draw_for_selection(index);
+				size8_t nt = _model.num_types();
+				for (size8_t t_index = 0; t_index < nt; t_index++) {
+					if (!_model.type(t_index)->visible()) { continue; }
+					std::pair<const size32_t *, const size32_t *> typed = _model.somas_of_type(t_index);
+					for (const size32_t *it = typed.first; it != typed.second; ++it) {
+						_model.soma(*it)->draw_for_selection(*it);
+					}
 				}
 			}
 			if (_draw_opts.axon_conns() || _draw_opts.den_conns()) {
@@ -2251,13 +2365,13 @@ void Model_Area::select() {
 					size32_t a_index = y->axon_soma_index();
 					const Soma *a = _model.soma(a_index);
 					const Soma_Type *t = _model.type(a->type_index());
-					if (!_state.is_selected(a) && t->visible()) {
+					if (!_state.is_selected(a_index) && t->visible()) {
 						a->draw_for_selection(a_index);
 					}
 					size32_t d_index = y->den_soma_index();
 					const Soma *d = _model.soma(d_index);
 					const Soma_Type *u = _model.type(d->type_index());
-					if (!_state.is_selected(d) && u->visible()) {
+					if (!_state.is_selected(d_index) && u->visible()) {
 						d->draw_for_selection(d_index);
 					}
 				}
@@ -2276,10 +2390,10 @@ void Model_Area::select() {
 				const Soma *d = _model.soma(d_index);
 				const Soma_Type *u = _model.type(d->type_index());
 				if (u->display_state() == Soma_Type::DISABLED) { continue; }
-				if (_draw_opts.axon_conns() && _state.is_selected(a) && !_state.is_selected(d)) {
+				if (_draw_opts.axon_conns() && _state.is_selected(a_index) && !_state.is_selected(d_index)) {
 					d->draw_for_selection(d_index);
 				}
-				else if (_draw_opts.den_conns() && _state.is_selected(d) && !_state.is_selected(a)) {
+				else if (_draw_opts.den_conns() && _state.is_selected(d_index) && !_state.is_selected(a_index)) {
 					a->draw_for_selection(a_index);
 				}
 			}
@@ -2299,21 +2413,13 @@ void Model_Area::select() {
 		const Sim_Data *sd = active_sim_data();
 		// Imitate drawing the inactive somas or just the active set
 		if (!_draw_opts.only_show_selected()) {
-			size32_t n = _model.num_somas();
-			if (_draw_opts.show_inactive_somas()) {
-				for (size32_t i = 0; i < n; i++) {
-					const Soma *s = _model.soma(i);
-					const Soma_Type *t = _model.type(s->type_index());
-					if (!t->visible()) { continue; }
-					s->draw_for_selection(i);
-				}
-			}
-			else {
-				for (size32_t i = 0; i < n; i++) {
-					const Soma *s = _model.soma(i);
-					const Soma_Type *t = _model.type(s->type_index());
-					if (!t->visible() || !sd->active(i)) { continue; }
-					s->draw_for_selection(i);
+			size8_t nt = _model.num_types();
+			for (size8_t t_index = 0; t_index < nt; t_index++) {
+				if (!_model.type(t_index)->visible()) { continue; }
+				std::pair<const size32_t *, const size32_t *> typed = _model.somas_of_type(t_index);
+				for (const size32_t *it = typed.first; it != typed.second; ++it) {
+					if (!_draw_opts.show_inactive_somas() && !sd->active(*it)) { continue; }
+					_model.soma(*it)->draw_for_selection(*it);
 				}
 			}
 		}
@@ -2331,12 +2437,13 @@ void Model_Area::select() {
 	else {
 		// Imitate drawing the static model
 		if (!_draw_opts.only_show_selected()) {
-			size32_t n = _model.num_somas();
-			for (size32_t i = 0; i < n; i++) {
-				const Soma *s = _model.soma(i);
-				const Soma_Type *t = _model.type(s->type_index());
-				if (!t->visible()) { continue; }
-				s->draw_for_selection(i);
+			size8_t nt = _model.num_types();
+			for (size8_t t_index = 0; t_index < nt; t_index++) {
+				if (!_model.type(t_index)->visible()) { continue; }
+				std::pair<const size32_t *, const size32_t *> typed = _model.somas_of_type(t_index);
+				for (const size32_t *it = typed.first; it != typed.second; ++it) {
+					_model.soma(*it)->draw_for_selection(*it);
+				}
 			}
 		}
 		// Imitate drawing the selected somas
@@ -2352,7 +2459,7 @@ void Model_Area::select() {
 			if (_draw_opts.axon_conns()) {
 				for (size32_t a_index = sel->first_axon_syn_index(); a_index < ny; a_index = y->next_axon_syn_index()) {
 					y = _model.synapse(a_index);
-					if (_draw_opts.only_show_marked() && !_state.is_marked(y, a_index)) { continue; }
+					if (_draw_opts.only_show_marked() && !_state.is_marked(a_index)) { continue; }
 					size32_t d_index = y->den_soma_index();
 					const Soma *d = _model.soma(d_index);
 					const Soma_Type *u = _model.type(d->type_index());
@@ -2367,7 +2474,7 @@ void Model_Area::select() {
 			if (_draw_opts.den_conns()) {
 				for (size32_t d_index = sel->first_den_syn_index(); d_index < ny; d_index = y->next_den_syn_index()) {
 					y = _model.synapse(d_index);
-					if (_draw_opts.only_show_marked() && !_state.is_marked(y, d_index)) { continue; }
+					if (_draw_opts.only_show_marked() && !_state.is_marked(d_index)) { continue; }
 					size32_t a_index = y->axon_soma_index();
 					const Soma *a = _model.soma(a_index);
 					const Soma_Type *u = _model.type(a->type_index());
@@ -2383,8 +2490,9 @@ void Model_Area::select() {
 			sel->draw_for_selection(sel_index);
 		}
 		// Imitate drawing the somas of marked synapses
-		for (marked_syns_t::const_iterator it = _state.begin_marked_synapses(); it != _state.end_marked_synapses(); ++it) {
-			const Synapse *y = it->first;
+		size_t nm = _state.num_marked();
+		for (size_t i = 0; i < nm; i++) {
+			const Synapse *y = _model.synapse(_state.marked_index(i));
 			if ((_draw_opts.axon_conns() || _draw_opts.den_conns()) && !_draw_opts.only_conn_selected()) {
 				size32_t a_index = y->axon_soma_index();
 				const Soma *a = _model.soma(a_index);
@@ -2395,11 +2503,11 @@ void Model_Area::select() {
 				const Soma_Type *u = _model.type(d->type_index());
 				bool d_outside = !clip_volume.contains(d->coords());
 				if (t->display_state() == Soma_Type::HIDDEN || (only_show_clipped && a_outside) ||
-					(_draw_opts.only_show_selected() && !_state.is_selected(a) && !_draw_opts.axon_conns())) {
+					(_draw_opts.only_show_selected() && !_state.is_selected(a_index) && !_draw_opts.axon_conns())) {
 					a->draw_for_selection(a_index);
 				}
 				if (u->display_state() == Soma_Type::HIDDEN || (only_show_clipped && d_outside) ||
-					(_draw_opts.only_show_selected() && !_state.is_selected(d) && !_draw_opts.den_conns())) {
+					(_draw_opts.only_show_selected() && !_state.is_selected(d_index) && !_draw_opts.den_conns())) {
 					d->draw_for_selection(d_index);
 				}
 			}
@@ -2451,8 +2559,8 @@ void Model_Area::select() {
 			return;
 		}
 	}
-	if (_state.is_selected(sel)) {
-		_state.deselect(sel);
+	if (_state.is_selected(sel_index)) {
+		_state.deselect(sel_index);
 		refresh_selected();
 	}
 	else if (_state.select(sel, sel_index)) {
@@ -2471,15 +2579,16 @@ void Model_Area::clip() {
 	v.acquire();
 	Bounds b;
 	size_t hits = 0;
-	size32_t n = _model.num_somas();
-	for (size32_t i = 0; i < n; i++) {
-		const Soma *s = _model.soma(i);
-		const Soma_Type *t = _model.type(s->type_index());
-		if (!t->visible()) { continue; }
-		const coord_t *c = s->coords();
-		if (!v.contains(c)) { continue; }
-		hits++;
-		b.update(c);
+	size8_t nt = _model.num_types();
+	for (size8_t t_index = 0; t_index < nt; t_index++) {
+		if (!_model.type(t_index)->visible()) { continue; }
+		std::pair<const size32_t *, const size32_t *> typed = _model.somas_of_type(t_index);
+		for (const size32_t *it = typed.first; it != typed.second; ++it) {
+			const coord_t *c = _model.soma(*it)->coords();
+			if (!v.contains(c)) { continue; }
+			hits++;
+			b.update(c);
+		}
 	}
 	if (hits >= 2) {
 		tv.copy(v);
@@ -2604,7 +2713,7 @@ void Model_Area::mark() {
 			for (weights_instance_t::const_iterator ys = wcs.begin(); ys != wcs.end(); ++ys) {
 				size32_t y_index = ys->first;
 				const Synapse *y = _model.synapse(y_index);
-				if (_draw_opts.only_show_marked() && !_state.is_marked(y, y_index)) { continue; }
+				if (_draw_opts.only_show_marked() && !_state.is_marked(y_index)) { continue; }
 				size32_t a_index = y->axon_soma_index();
 				const Soma *a = _model.soma(a_index);
 				const Soma_Type *t = _model.type(a->type_index());
@@ -2627,13 +2736,13 @@ void Model_Area::mark() {
 				const Soma *a = _model.soma(a_index);
 				const Soma_Type *t = _model.type(a->type_index());
 				if (t->display_state() == Soma_Type::DISABLED) { continue; }
-				bool a_sel = _state.is_selected(a);
+				bool a_sel = _state.is_selected(a_index);
 				size32_t d_index = y->den_soma_index();
 				const Soma *d = _model.soma(d_index);
 				const Soma_Type *u = _model.type(d->type_index());
 				if (u->display_state() == Soma_Type::DISABLED) { continue; }
-				bool d_sel = _state.is_selected(d);
-				if (((!a_sel && !d_sel) || _draw_opts.only_show_marked()) && !_state.is_marked(y, y_index)) { continue; }
+				bool d_sel = _state.is_selected(d_index);
+				if (((!a_sel && !d_sel) || _draw_opts.only_show_marked()) && !_state.is_marked(y_index)) { continue; }
 				if (_draw_opts.axon_conns() || _draw_opts.den_conns() || _draw_opts.syn_dots()) {
 					y->draw_for_selection(y_i++);
 				}
@@ -2656,11 +2765,11 @@ void Model_Area::mark() {
 			// Imitate drawing the axonal synapses
 			for (size32_t a_index = s->first_axon_syn_index(); a_index < ny; a_index = y->next_axon_syn_index()) {
 				y = _model.synapse(a_index);
-				if (_state.is_marked(y, a_index)) { continue; }
+				if (_state.is_marked(a_index)) { continue; }
 				const coord_t *c = y->coords();
 				if (only_enable_clipped && !clip_volume.contains(c)) { continue; }
 				const Soma *d = _model.soma(y->den_soma_index());
-				if (_draw_opts.only_conn_selected() && !_state.is_selected(d)) { continue; }
+				if (_draw_opts.only_conn_selected() && !_state.is_selected(y->den_soma_index())) { continue; }
 				const Soma_Type *u = _model.type(d->type_index());
 				bool outside = !clip_volume.contains(d->coords());
 				if (u->display_state() == Soma_Type::DISABLED || (only_enable_clipped && outside)) { continue; }
@@ -2669,11 +2778,11 @@ void Model_Area::mark() {
 			// Imitate drawing the dendritic synapses
 			for (size32_t d_index = s->first_den_syn_index(); d_index < ny; d_index = y->next_den_syn_index()) {
 				y = _model.synapse(d_index);
-				if (_state.is_marked(y, d_index)) { continue; }
+				if (_state.is_marked(d_index)) { continue; }
 				const coord_t *c = y->coords();
 				if (only_enable_clipped && !clip_volume.contains(c)) { continue; }
 				const Soma *a = _model.soma(y->axon_soma_index());
-				if (_draw_opts.only_conn_selected() && !_state.is_selected(a)) { continue; }
+				if (_draw_opts.only_conn_selected() && !_state.is_selected(y->axon_soma_index())) { continue; }
 				const Soma_Type *u = _model.type(a->type_index());
 				bool outside = !clip_volume.contains(a->coords());
 				if (u->display_state() == Soma_Type::DISABLED || (only_enable_clipped && outside)) { continue; }
@@ -2681,8 +2790,9 @@ void Model_Area::mark() {
 			}
 		}
 		// Imitate drawing the marked synapses
-		for (marked_syns_t::const_iterator it = _state.begin_marked_synapses(); it != _state.end_marked_synapses(); ++it) {
-			const Synapse *y = it->first;
+		size_t nm = _state.num_marked();
+		for (size_t i = 0; i < nm; i++) {
+			const Synapse *y = _model.synapse(_state.marked_index(i));
 			y->draw_for_selection(y_i++);
 		}
 		if (only_show_clipped) { Clip_Volume::enable(); }
@@ -2711,7 +2821,7 @@ void Model_Area::mark() {
 				for (weights_instance_t::const_iterator ys = wcs.begin(); ys != wcs.end(); ++ys) {
 					size32_t y_index = ys->first;
 					const Synapse *y = _model.synapse(y_index);
-					if (_draw_opts.only_show_marked() && !_state.is_marked(y, y_index)) { continue; }
+					if (_draw_opts.only_show_marked() && !_state.is_marked(y_index)) { continue; }
 					size32_t a_index = y->axon_soma_index();
 					const Soma *a = _model.soma(a_index);
 					const Soma_Type *t = _model.type(a->type_index());
@@ -2734,13 +2844,13 @@ void Model_Area::mark() {
 					const Soma *a = _model.soma(a_index);
 					const Soma_Type *t = _model.type(a->type_index());
 					if (t->display_state() == Soma_Type::DISABLED) { continue; }
-					bool a_sel = _state.is_selected(a);
+					bool a_sel = _state.is_selected(a_index);
 					size32_t d_index = y->den_soma_index();
 					const Soma *d = _model.soma(d_index);
 					const Soma_Type *u = _model.type(d->type_index());
 					if (u->display_state() == Soma_Type::DISABLED) { continue; }
-					bool d_sel = _state.is_selected(d);
-					if (((!a_sel && !d_sel) || _draw_opts.only_show_marked()) && !_state.is_marked(y, y_index)) { continue; }
+					bool d_sel = _state.is_selected(d_index);
+					if (((!a_sel && !d_sel) || _draw_opts.only_show_marked()) && !_state.is_marked(y_index)) { continue; }
 					if (_draw_opts.axon_conns() || _draw_opts.den_conns() || _draw_opts.syn_dots()) {
 						if (search_i++ == sel_i) { sel = y; break; }
 					}
@@ -2763,7 +2873,7 @@ void Model_Area::mark() {
 				// Search the axonal synapses
 				for (size32_t a_index = s->first_axon_syn_index(); a_index < ny; a_index = y->next_axon_syn_index()) {
 					y = _model.synapse(a_index);
-					if (_state.is_marked(y, a_index) || _draw_opts.only_show_marked()) { continue; }
+					if (_state.is_marked(a_index) || _draw_opts.only_show_marked()) { continue; }
 					const coord_t *c = y->coords();
 					if (only_enable_clipped && !clip_volume.contains(c)) { continue; }
 					const Soma *d = _model.soma(y->den_soma_index());
@@ -2777,7 +2887,7 @@ void Model_Area::mark() {
 				for (size32_t d_index = s->first_den_syn_index(); d_index < ny; d_index = y->next_den_syn_index()) {
 					// False positive "C28182: Dereferencing a copy of a null pointer" error with Visual Studio 2013 code analysis
 					y = _model.synapse(d_index);
-					if (_state.is_marked(y, d_index) || _draw_opts.only_show_marked()) { continue; }
+					if (_state.is_marked(d_index) || _draw_opts.only_show_marked()) { continue; }
 					const coord_t *c = y->coords();
 					if (only_enable_clipped && !clip_volume.contains(c)) { continue; }
 					const Soma *a = _model.soma(y->axon_soma_index());
@@ -2788,9 +2898,10 @@ void Model_Area::mark() {
 				}
 				if (sel) { break; }
 			}
-			for (marked_syns_t::const_iterator it = _state.begin_marked_synapses(); it != _state.end_marked_synapses(); ++it) {
-				const Synapse *y = it->first;
-				if (search_i++ == sel_i) { sel = y; break; }
+			size_t nm = _state.num_marked();
+			for (size_t i = 0; i < nm && !sel; i++) {
+				const Synapse *y = _model.synapse(_state.marked_index(i));
+				if (search_i++ == sel_i) { sel = y; }
 			}
 			if (only_show_clipped) { Clip_Volume::enable(); }
 		}
@@ -2828,11 +2939,11 @@ void Model_Area::mark() {
 			return;
 		}
 	}
-	if (_state.is_marked(sel, sel_index)) {
-		_state.unmark(sel, sel_index);
+	if (_state.is_marked(sel_index)) {
+		_state.unmark(sel_index);
 		refresh_selected();
 	}
-	else if (_state.mark(sel, sel_index)) {
+	else if (_state.mark(sel_index)) {
 		refresh_selected();
 	}
 	refresh();
@@ -14,17 +14,18 @@
 #include "draw-options.h"
 #include "image.h"
 #include "fps.h"
+#include "frame-producer.h"
+#include "geometry-batch.h"
 
 class Overview_Area;
+class Offscreen_Context;
 class DnD_Receiver;
 class Sim_Data;
 class Input_Parser;
-class Binary_Parser;
+class Model_Loader;
 class Progress_Dialog;
 class Waiting_Dialog;
 
-typedef std::pair<size32_t, size32_t> soma_syn_t;
-
 class Model_Area : public Fl_Gl_Window {
 private:
 	enum Mode { DRAWING, SELECTING, CLIPPING };
@@ -52,16 +53,43 @@ private:
 	std::deque<Model_State> _history, _future;
 	Draw_Options _draw_opts;
 	FPS _fps;
+	Frame_Producer *_frame_producer;
+	// Counts the models read or cleared, so that anything drawn from an earlier one can be told apart
+	size_t _model_version;
+	// The colors of a span of simulated somas or synapses, which are mapped together before any are drawn
+	mutable std::vector<float> _sim_colors;
+	// The selected somas' connections, dots, fields, and gap junctions are batched once and redrawn as long as the
+	// state, options, types, and loaded synapses that they were batched for stay the same
+	mutable Geometry_Batch _selected_batch, _selected_fields_batch, _weights_batch;
+	mutable std::vector<const Soma *> _selected_letters;
+	mutable Model_State _batched_state;
+	mutable Draw_Options _batched_opts;
+	mutable Brain_Model::Type_Styles _batched_styles;
+	mutable size32_t _batched_synapses, _batched_gap_junctions;
+	mutable size_t _batched_version;
+	mutable bool _batched;
+	// The static model's soma dots are compiled into a display list, which is replayed until the model or the
+	// types' colors or display states change
+	mutable GLuint _static_list;
+	mutable Brain_Model::Type_Styles _static_styles;
+	mutable size_t _static_version;
+	mutable bool _static_compiled;
+	// The offscreen context that was last drawn into, whose display lists are the ones kept, and whether it is
+	// being drawn into now instead of the window
+	const Offscreen_Context *_offscreen;
+	bool _drawing_offscreen;
 	bool _opened, _initialized, _dragging;
 	int _click_coords[2], _drag_coords[2];
 	Rotation_Mode _rotation_mode;
 	bool _scale_rotation, _invert_zoom;
 public:
 	Model_Area(int x, int y, int w, int h, const char *l = NULL);
+	~Model_Area();
 	inline Action action(void) const { return (Action)type(); }
 	void action(Action a);
 	inline Brain_Model &model(void) { return _model; }
 	inline const Brain_Model &const_model(void) const { return _model; }
+	inline size_t model_version(void) const { return _model_version; }
 	inline void overview_area(Overview_Area *o) { _overview_area = o; }
 	inline void dnd_receiver(DnD_Receiver *dndr) { _dnd_receiver = dndr; }
 	inline Model_State &state(void) { return _state; }
@@ -77,6 +105,8 @@ public:
 	inline void invert_zoom(bool z) { _invert_zoom = z; }
 	inline void resize(int x, int y, int w, int h) { Fl_Gl_Window::resize(x, y, w, h); if (shown()) { refresh(); } }
 	void refresh(void);
+	void start_producing(void);
+	void stop_producing(void);
 	void clear(void);
 	void prepare(void);
 	void undo(void);
@@ -99,16 +129,20 @@ public:
 		Waiting_Dialog *w = NULL);
 	size_t report_conn_paths(std::ofstream &ofs, size32_t a_id, size32_t d_id, size_t limit, bool include_disabled,
 		Waiting_Dialog *w = NULL);
-	Read_Status read_model_from(Input_Parser &ip, Progress_Dialog *p = NULL);
-	Read_Status read_model_from(Binary_Parser &bp, Progress_Dialog *p = NULL);
+	Read_Status read_model_from(Model_Loader &ml, Progress_Dialog *p = NULL);
 	Read_Status read_state_from(Input_Parser &ip);
 	int write_image(const char *f, Image::Format m);
+	int write_image(const char *f, Image::Format m, Offscreen_Context &oc);
+	int write_animation(const std::string &prefix, size32_t start, size32_t stop, size32_t step, Image::Format m,
+		const Image::Compression &c, Offscreen_Context *oc = NULL, Progress_Dialog *p = NULL);
 	void write_selected_somas_to(std::ofstream &ofs, bool bounding_box, bool relations) const;
 	void write_selected_synapses_to(std::ofstream &ofs) const;
 	void write_marked_synapses_to(std::ofstream &ofs) const;
 	void write_current_frequencies_to(std::ofstream &ofs) const;
 	void write_average_frequencies_to(std::ofstream &ofs, size32_t start, size32_t stop, size32_t step,
 		Progress_Dialog *p = NULL);
+	void write_spike_stats_to(std::ofstream &ofs, size32_t start, size32_t stop, size32_t step,
+		Progress_Dialog *p = NULL);
 protected:
 	void redraw(void);
 	void draw(void);
@@ -117,13 +151,10 @@ private:
 	static void refresh_gl(void);
 private:
 	const Sim_Data *active_sim_data(void) const;
-	bool mark_conn_paths(size32_t a_index, size32_t d_index, size_t limit, bool include_disabled,
-		std::deque<size32_t> &path_syns, size_t &n_paths, std::deque<soma_syn_t> &stack, Waiting_Dialog *w = NULL);
-	bool select_conn_paths(size32_t a_index, size32_t d_index, size_t limit, bool include_disabled,
-		std::deque<size32_t> &path_somas, size_t &n_paths, std::deque<size32_t> &stack, Waiting_Dialog *w = NULL);
-	bool report_conn_paths(std::ofstream &ofs, size32_t a_index, size32_t d_index, size_t limit, bool include_disabled,
-		size_t &n_paths, std::deque<soma_syn_t> &stack, Waiting_Dialog *w = NULL);
 	void refresh_selected(void) const;
+	bool make_offscreen_current(Offscreen_Context &oc);
+	void draw_offscreen(const Offscreen_Context &oc);
+	void leave_offscreen(void);
 	void refresh_cursor(void) const;
 	void refresh_view(void);
 	void refresh_projection(Mode mode);
@@ -131,9 +162,11 @@ private:
 	void remember(const Model_State &s);
 	void draw_static_model(void) const;
 	void draw_inactive(void) const;
-	void draw_firing_spikes(void) const;
+	void draw_firing_spikes(const Frame_Producer::Frame *f) const;
 	void draw_voltages(void) const;
 	void draw_weights(void) const;
+	bool selected_batched(void) const;
+	void batch_selected(void) const;
 	void draw_selected(void) const;
 	void draw_selected(const Sim_Data *sd) const;
 	void draw_scale(const Sim_Data *sd, const char *l, std::streamsize p = 0) const;
@@ -142,6 +175,7 @@ private:
 	void draw_rotation_guide(void);
 	void draw_axes(void) const;
 	void draw_fps(void) const;
+	void draw_profiler(void) const;
 	int handle_focus(int event) const;
 	int handle_click(int event);
 	int handle_drag(int event);
@@ -0,0 +1,70 @@
+#include "input-parser.h"
+#include "binary-parser.h"
+#include "progress-dialog.h"
+#include "model-loader.h"
+
+Model_Loader::Model_Loader(Brain_Model &bm, Input_Parser *ip) : _model(bm), _input_parser(ip), _binary_parser(NULL),
+	_load(), _sections(Brain_Model::ALL_SECTIONS), _done(false), _status(SUCCESS)
+#ifdef __THREADS__
+	, _thread()
+#endif
+	{}
+
+Model_Loader::Model_Loader(Brain_Model &bm, Binary_Parser *bp, unsigned int sections) : _model(bm),
+	_input_parser(NULL), _binary_parser(bp), _load(), _sections(sections), _done(false), _status(SUCCESS)
+#ifdef __THREADS__
+	, _thread()
+#endif
+	{}
+
+Model_Loader::~Model_Loader() {
+	stop();
+	delete _input_parser;
+	delete _binary_parser;
+}
+
+Read_Status Model_Loader::start(Progress_Dialog *p) {
+	// Read the types, somas, and neuritic fields on this thread
+	_status = _input_parser ? _model.read_somas_from(*_input_parser, p, _load) :
+		_model.read_somas_from(*_binary_parser, p, _load, _sections);
+	if (_status != SUCCESS) {
+		_done = true;
+		return _status;
+	}
+	// Read the synapses and gap junctions on another thread
+	// (Visual Studio 2010 has no C++11 threads, so they are read right away there)
+#ifdef __THREADS__
+	_thread = std::thread(&Model_Loader::run, this);
+#else
+	run();
+#endif
+	return SUCCESS;
+}
+
+void Model_Loader::run() {
+	_status = _input_parser ? _model.read_connections_from(*_input_parser, _load) :
+		_model.read_connections_from(*_binary_parser, _load);
+	_done = true;
+}
+
+bool Model_Loader::publish() {
+	return _model.publish_connections(_load);
+}
+
+Read_Status Model_Loader::finish() {
+	// Wait for the rest of the model, then publish and index it
+#ifdef __THREADS__
+	if (_thread.joinable()) { _thread.join(); }
+#endif
+	if (_status != SUCCESS) { return _status; }
+	_model.publish_connections(_load);
+	_model.finish_connections();
+	return SUCCESS;
+}
+
+void Model_Loader::stop() {
+	_load.stop = true;
+#ifdef __THREADS__
+	if (_thread.joinable()) { _thread.join(); }
+#endif
+}
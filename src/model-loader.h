@@ -0,0 +1,45 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include "utils.h"
+#include "from-file.h"
+#include "parallel.h"
+#include "brain-model.h"
+
+class Input_Parser;
+class Binary_Parser;
+class Progress_Dialog;
+
+// Reads a model's types and somas, then its synapses and gap junctions on a background thread, so the somas
+// can be shown while the rest of the model is read; the model must not be cleared until the loader is deleted
+class Model_Loader {
+private:
+	Brain_Model &_model;
+	Input_Parser *_input_parser;
+	Binary_Parser *_binary_parser;
+	Brain_Model::Conn_Load _load;
+	unsigned int _sections;
+	shared_bool_t _done;
+	Read_Status _status;
+#ifdef __THREADS__
+	std::thread _thread;
+#endif
+public:
+	// The loader takes ownership of the parser; a binary model's unneeded sections may be skipped
+	Model_Loader(Brain_Model &bm, Input_Parser *ip);
+	Model_Loader(Brain_Model &bm, Binary_Parser *bp, unsigned int sections = Brain_Model::ALL_SECTIONS);
+	~Model_Loader();
+	inline bool done(void) const { return _done; }
+	inline float progress(void) const { return _load.progress(); }
+	inline size32_t num_synapses(void) const { return (size32_t)_load.synapses_size; }
+	Read_Status start(Progress_Dialog *p = NULL);
+	bool publish(void);
+	Read_Status finish(void);
+	void stop(void);
+private:
+	void run(void);
+	Model_Loader(const Model_Loader &ml); // Unimplemented copy constructor
+	Model_Loader &operator=(const Model_Loader &ml); // Unimplemented assignment operator
+};
+
+#endif
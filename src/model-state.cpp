@@ -1,5 +1,9 @@
 #include <cstdlib>
+#include <cstddef>
 #include <fstream>
+#include <vector>
+#include <memory>
+#include <algorithm>
 
 #pragma warning(push, 0)
 #include <FL/Fl.H>
@@ -17,7 +21,8 @@ const double Model_State::MIN_ZOOM = 0.0001; // 0.0045 degrees
 const double Model_State::MAX_ZOOM = 4.0;    // 180 degrees
 
 Model_State::Model_State() : _rotate_matrix(), _pan_vector(), _zoom_factor(1.0), _pivot(), _clip_volume(),
-	_clipped(false), _bounds(), _num_selected(0), _selected(), _selected_indices(), _marked_syns() {
+	_clipped(false), _bounds(), _selection(std::make_shared<Selection>()),
+	_marking(std::make_shared<Marking>()) {
 	reset();
 }
 
@@ -41,52 +46,118 @@ void Model_State::reclip(Bounds &b) {
 	bound(b);
 }
 
-bool Model_State::is_selected(const Soma *s) const {
-	for (size_t i = 0; i < _num_selected; i++) {
-		if (_selected[i] == s) {
-			return true;
-		}
-	}
-	return false;
+Model_State::Selection &Model_State::own_selection() {
+	if (_selection.use_count() > 1) { _selection = std::make_shared<Selection>(*_selection); }
+	return *_selection;
+}
+
+Model_State::Marking &Model_State::own_marking() {
+	if (_marking.use_count() > 1) { _marking = std::make_shared<Marking>(*_marking); }
+	return *_marking;
 }
 
 bool Model_State::select(const Soma *s, size32_t index) {
-	if (_num_selected >= MAX_SELECTED) { return false; }
-	_selected[_num_selected] = s;
-	_selected_indices[_num_selected] = index;
-	_num_selected++;
+	if (is_selected(index)) { return false; }
+	Selection &sel = own_selection();
+	if (index >= sel.set.size()) { sel.set.resize((size_t)index + 1, false); }
+	sel.set[index] = true;
+	sel.somas.push_back(s);
+	sel.indices.push_back(index);
 	return true;
 }
 
-bool Model_State::deselect(const Soma *s) {
-	for (size_t i = 0; i < _num_selected; i++) {
-		if (_selected[i] == s) {
-			_num_selected--;
-			for (size_t j = i; j < _num_selected; j++) {
-				_selected[j] = _selected[j + 1];
-			}
-			return true;
+bool Model_State::deselect(size32_t index) {
+	if (!is_selected(index)) { return false; }
+	Selection &sel = own_selection();
+	sel.set[index] = false;
+	// Search from the back, since recently selected somas are the likeliest to be deselected
+	size_t i = sel.indices.size();
+	while (i-- > 0) {
+		if (sel.indices[i] == index) {
+			sel.somas.erase(sel.somas.begin() + (std::ptrdiff_t)i);
+			sel.indices.erase(sel.indices.begin() + (std::ptrdiff_t)i);
+			break;
 		}
 	}
-	return false;
+	return true;
+}
+
+size_t Model_State::reselect(const std::vector<size32_t> &indices, const Brain_Model &bm) {
+	if (indices.empty()) { return 0; }
+	Selection &sel = own_selection();
+	// Keep only the last occurrence of each index, so that the reselected somas end up in the same order as when
+	// reselecting them one at a time
+	std::vector<bool> moved(bm.num_somas(), false);
+	std::vector<size32_t> order;
+	for (std::vector<size32_t>::const_reverse_iterator it = indices.rbegin(); it != indices.rend(); ++it) {
+		size32_t index = *it;
+		if (moved[index]) { continue; }
+		moved[index] = true;
+		order.push_back(index);
+	}
+	std::reverse(order.begin(), order.end());
+	// Drop the reselected somas from the selection in one pass, then append them
+	size_t n = 0;
+	for (size_t i = 0; i < sel.indices.size(); i++) {
+		if (moved[sel.indices[i]]) { continue; }
+		sel.somas[n] = sel.somas[i];
+		sel.indices[n] = sel.indices[i];
+		n++;
+	}
+	size_t n_reselected = sel.indices.size() - n;
+	sel.somas.resize(n);
+	sel.indices.resize(n);
+	if (sel.set.size() < moved.size()) { sel.set.resize(moved.size(), false); }
+	for (std::vector<size32_t>::const_iterator it = order.begin(); it != order.end(); ++it) {
+		size32_t index = *it;
+		sel.set[index] = true;
+		sel.somas.push_back(bm.soma(index));
+		sel.indices.push_back(index);
+	}
+	return order.size() - n_reselected;
 }
 
-bool Model_State::is_marked(const Synapse *y, size32_t index) const {
-	marked_syn_t p = std::make_pair(y, index);
-	return _marked_syns.find(p) != _marked_syns.end();
+void Model_State::deselect_all() {
+	if (!_selection->set.empty()) { _selection = std::make_shared<Selection>(); }
 }
 
-bool Model_State::mark(const Synapse *y, size32_t index) {
-	size_t n = _marked_syns.size();
-	_marked_syns.emplace(y, index);
-	return _marked_syns.size() > n;
+bool Model_State::mark(size32_t index) {
+	if (is_marked(index)) { return false; }
+	Marking &m = own_marking();
+	if (index >= m.set.size()) { m.set.resize((size_t)index + 1, false); }
+	m.set[index] = true;
+	m.indices.insert(std::lower_bound(m.indices.begin(), m.indices.end(), index), index);
+	return true;
+}
+
+size_t Model_State::mark(const std::vector<size32_t> &indices) {
+	if (indices.empty()) { return 0; }
+	Marking &m = own_marking();
+	size_t n = m.indices.size();
+	// Append the newly marked indexes, then merge them into the sorted list all at once
+	for (std::vector<size32_t>::const_iterator it = indices.begin(); it != indices.end(); ++it) {
+		size32_t index = *it;
+		if (index >= m.set.size()) { m.set.resize((size_t)index + 1, false); }
+		if (m.set[index]) { continue; }
+		m.set[index] = true;
+		m.indices.push_back(index);
+	}
+	std::vector<size32_t>::iterator mid = m.indices.begin() + (std::ptrdiff_t)n;
+	std::sort(mid, m.indices.end());
+	std::inplace_merge(m.indices.begin(), mid, m.indices.end());
+	return m.indices.size() - n;
+}
+
+bool Model_State::unmark(size32_t index) {
+	if (!is_marked(index)) { return false; }
+	Marking &m = own_marking();
+	m.set[index] = false;
+	m.indices.erase(std::lower_bound(m.indices.begin(), m.indices.end(), index));
+	return true;
 }
 
-bool Model_State::unmark(const Synapse *y, size32_t index) {
-	size_t n = _marked_syns.size();
-	marked_syn_t p = std::make_pair(y, index);
-	_marked_syns.erase(p);
-	return _marked_syns.size() < n;
+void Model_State::unmark_all() {
+	if (!_marking->set.empty()) { _marking = std::make_shared<Marking>(); }
 }
 
 void Model_State::reset() {
@@ -131,19 +202,24 @@ Read_Status Model_State::read_from(Input_Parser &ip, const Brain_Model &bm) {
 	_bounds.update(p);
 	_bounds.recenter();
 	// Get the selected soma IDs
-	_num_selected = ip.get_size32();
-	for (size_t i = 0; i < _num_selected; i++) {
+	deselect_all();
+	size_t ns = ip.get_size32();
+	for (size_t i = 0; i < ns; i++) {
 		size32_t index = bm.soma_index(ip.get_size32());
 		if (index >= bm.num_somas()) { return BAD_SOMA_ID; }
-		_selected[i] = bm.soma(index);
-		_selected_indices[i] = index;
+		select(bm.soma(index), index);
 	}
 	// Get the marked synapse indexes
+	unmark_all();
 	size_t n = ip.get_size32();
+	std::vector<size32_t> marked;
+	marked.reserve(n);
 	for (size_t i = 0; i < n; i++) {
 		size32_t index = ip.get_size32();
-		_marked_syns.emplace(bm.synapse(index), index);
+		if (index >= bm.num_synapses()) { return BAD_SYNAPSE_INDEX; }
+		marked.push_back(index);
 	}
+	mark(marked);
 	return SUCCESS;
 }
 
@@ -186,17 +262,18 @@ void Model_State::write_to(std::ofstream &ofs) const {
 	ofs << p[0] << " " << p[1] << " " << p[2] << "\n";
 	// Write the selected soma IDs
 	ofs << "# selected somas\n";
-	ofs << _num_selected << " # number of selected somas\n";
-	for (size_t i = 0; i < _num_selected; i++) {
-		ofs << _selected[i]->id();
-		if (i == _num_selected - 1) { ofs << "\n"; }
+	size_t ns = num_selected();
+	ofs << ns << " # number of selected somas\n";
+	for (size_t i = 0; i < ns; i++) {
+		ofs << selected(i)->id();
+		if (i == ns - 1) { ofs << "\n"; }
 		else { ofs << " "; }
 	}
 	// Write the marked synapse indexes
 	ofs << "# marked synapses\n";
-	size_t n = _marked_syns.size();
+	size_t n = num_marked();
 	ofs << n << " # number of marked synapses\n";
-	for (marked_syns_t::const_iterator it = _marked_syns.begin(); it != _marked_syns.end(); ++it) {
-		ofs << it->second << "\n";
+	for (size_t i = 0; i < n; i++) {
+		ofs << marked_index(i) << "\n";
 	}
 }
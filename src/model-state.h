@@ -2,7 +2,8 @@
 #define MODEL_STATE_H
 
 #include <fstream>
-#include <unordered_set>
+#include <vector>
+#include <memory>
 
 #include "utils.h"
 #include "clip-volume.h"
@@ -11,21 +12,22 @@ class Soma;
 class Input_Parser;
 class Brain_Model;
 
-struct marked_syn_hash {
-	inline size_t operator()(const std::pair<const Synapse *, size32_t> &v) const {
-		return (size_t)v.first ^ (size_t)v.second;
-	}
-};
-
-typedef std::pair<const Synapse *, size32_t> marked_syn_t;
-typedef std::unordered_set<marked_syn_t, marked_syn_hash> marked_syns_t;
-
 class Model_State {
 public:
 	static const double MIN_ZOOM;
 	static const double MAX_ZOOM;
-	static const size_t MAX_SELECTED = 1000;
 private:
+	// Selected somas and marked synapses are shared between copies (e.g. in the undo history)
+	// until one of the copies modifies them
+	struct Selection {
+		std::vector<const Soma *> somas;
+		std::vector<size32_t> indices;
+		std::vector<bool> set;
+	};
+	struct Marking {
+		std::vector<size32_t> indices; // sorted
+		std::vector<bool> set;
+	};
 	double _rotate_matrix[16];
 	double _pan_vector[2];
 	double _zoom_factor;
@@ -33,10 +35,8 @@ private:
 	Clip_Volume _clip_volume;
 	bool _clipped;
 	Bounds _bounds;
-	size_t _num_selected;
-	const Soma *_selected[MAX_SELECTED];
-	size32_t _selected_indices[MAX_SELECTED];
-	marked_syns_t _marked_syns;
+	std::shared_ptr<Selection> _selection;
+	std::shared_ptr<Marking> _marking;
 public:
 	Model_State();
 	inline const double *rotate(void) const { return _rotate_matrix; }
@@ -61,24 +61,35 @@ public:
 	inline const coord_t *range(void) const { return _bounds.range(); }
 	inline coord_t max_range(void) const { return _bounds.max_range(); }
 	inline void bound(const Bounds &b) { _bounds = b; pivot(center()); }
-	inline size_t num_selected(void) const { return _num_selected; }
-	inline const Soma *selected(size_t i) const { return _selected[i]; }
-	inline size32_t selected_index(size_t i) const { return _selected_indices[i]; }
-	bool is_selected(const Soma *s) const;
+	inline size_t num_selected(void) const { return _selection->somas.size(); }
+	inline const Soma *selected(size_t i) const { return _selection->somas[i]; }
+	inline size32_t selected_index(size_t i) const { return _selection->indices[i]; }
+	inline bool is_selected(size32_t index) const {
+		return index < _selection->set.size() && _selection->set[index];
+	}
 	bool select(const Soma *s, size32_t index);
-	bool deselect(const Soma *s);
-	inline bool reselect(const Soma *s, size32_t index) { deselect(s); return select(s, index); }
-	inline void deselect_all(void) { _num_selected = 0; }
-	inline size_t num_marked(void) const { return _marked_syns.size(); }
-	inline marked_syns_t::const_iterator begin_marked_synapses(void) const { return _marked_syns.begin(); }
-	inline marked_syns_t::const_iterator end_marked_synapses(void) const { return _marked_syns.end(); }
-	bool is_marked(const Synapse *y, size32_t index) const;
-	bool mark(const Synapse *y, size32_t index);
-	bool unmark(const Synapse *y, size32_t index);
-	inline void unmark_all(void) { _marked_syns.clear(); }
+	bool deselect(size32_t index);
+	inline bool reselect(const Soma *s, size32_t index) { deselect(index); return select(s, index); }
+	// Reselects the somas with the given indexes all at once, in the order of their last occurrences
+	size_t reselect(const std::vector<size32_t> &indices, const Brain_Model &bm);
+	void deselect_all(void);
+	// Copies that share selected somas and marked synapses have the same ones, since sharing ends with any change
+	inline bool same_selection(const Model_State &s) const {
+		return _selection == s._selection && _marking == s._marking;
+	}
+	inline size_t num_marked(void) const { return _marking->indices.size(); }
+	inline size32_t marked_index(size_t i) const { return _marking->indices[i]; }
+	inline bool is_marked(size32_t index) const { return index < _marking->set.size() && _marking->set[index]; }
+	bool mark(size32_t index);
+	size_t mark(const std::vector<size32_t> &indices);
+	bool unmark(size32_t index);
+	void unmark_all(void);
 	void reset(void);
 	Read_Status read_from(Input_Parser &ip, const Brain_Model &bm);
 	void write_to(std::ofstream &ofs) const;
+private:
+	Selection &own_selection(void);
+	Marking &own_marking(void);
 };
 
 #endif
@@ -1,11 +1,8 @@
-#pragma warning(push, 0)
-#include <FL/gl.h>
-#include <FL/glu.h>
-#pragma warning(pop)
-
 #include "coords.h"
 #include "input-parser.h"
 #include "binary-parser.h"
+#include "binary-writer.h"
+#include "geometry-batch.h"
 #include "neuritic-field.h"
 
 Neuritic_Field::Neuritic_Field() {
@@ -13,29 +10,8 @@ Neuritic_Field::Neuritic_Field() {
 	_max[0] = _max[1] = _max[2] = ZERO_COORD;
 }
 
-void Neuritic_Field::draw() const {
-	glBegin(GL_LINE_LOOP);
-	glVertex3c(_min[0], _min[1], _min[2]);
-	glVertex3c(_min[0], _max[1], _min[2]);
-	glVertex3c(_max[0], _max[1], _min[2]);
-	glVertex3c(_max[0], _min[1], _min[2]);
-	glEnd();
-	glBegin(GL_LINE_LOOP);
-	glVertex3c(_min[0], _min[1], _max[2]);
-	glVertex3c(_min[0], _max[1], _max[2]);
-	glVertex3c(_max[0], _max[1], _max[2]);
-	glVertex3c(_max[0], _min[1], _max[2]);
-	glEnd();
-	glBegin(GL_LINES);
-	glVertex3c(_min[0], _min[1], _min[2]);
-	glVertex3c(_min[0], _min[1], _max[2]);
-	glVertex3c(_min[0], _max[1], _min[2]);
-	glVertex3c(_min[0], _max[1], _max[2]);
-	glVertex3c(_max[0], _max[1], _min[2]);
-	glVertex3c(_max[0], _max[1], _max[2]);
-	glVertex3c(_max[0], _min[1], _min[2]);
-	glVertex3c(_max[0], _min[1], _max[2]);
-	glEnd();
+void Neuritic_Field::draw(Geometry_Batch &b) const {
+	b.box(_min, _max);
 }
 
 void Neuritic_Field::read_from(Input_Parser &ip) {
@@ -53,3 +29,9 @@ void Neuritic_Field::read_from(Binary_Parser &bp) {
 	_min[1] = bp.get_coord(); _max[1] = bp.get_coord();
 	_min[2] = bp.get_coord(); _max[2] = bp.get_coord();
 }
+
+void Neuritic_Field::write_to(Binary_Writer &bw) const {
+	bw.put_signed((int32_t)_min[0]); bw.put_signed((int32_t)_max[0]);
+	bw.put_signed((int32_t)_min[1]); bw.put_signed((int32_t)_max[1]);
+	bw.put_signed((int32_t)_min[2]); bw.put_signed((int32_t)_max[2]);
+}
@@ -5,15 +5,18 @@
 
 class Input_Parser;
 class Binary_Parser;
+class Binary_Writer;
+class Geometry_Batch;
 
 class Neuritic_Field {
 private:
 	coord_t _min[3], _max[3];
 public:
 	Neuritic_Field();
-	void draw(void) const;
+	void draw(Geometry_Batch &b) const;
 	void read_from(Input_Parser &ip);
 	void read_from(Binary_Parser &bp);
+	void write_to(Binary_Writer &bw) const;
 };
 
 #endif
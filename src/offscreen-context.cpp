@@ -0,0 +1,59 @@
+#include <cstdlib>
+
+#include "offscreen-context.h"
+
+#if defined(__EGL__) && !defined(EGL_PLATFORM_SURFACELESS_MESA)
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+Offscreen_Context::Offscreen_Context(int w, int h) :
+#ifdef __EGL__
+	_display(EGL_NO_DISPLAY), _surface(EGL_NO_SURFACE), _context(EGL_NO_CONTEXT),
+#endif
+	_width(w), _height(h), _good(false) {
+#ifdef __EGL__
+	// Use the surfaceless platform, since the default one would look for a display server
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (get_platform_display == NULL) { return; }
+	_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (_display == EGL_NO_DISPLAY) { return; }
+	EGLint major, minor;
+	if (!eglInitialize(_display, &major, &minor)) {
+		_display = EGL_NO_DISPLAY;
+		return;
+	}
+	// Match the model area's RGB, alpha, and depth buffers
+	const EGLint config_attribs[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8, EGL_DEPTH_SIZE, 24, EGL_NONE};
+	EGLConfig config;
+	EGLint num_configs = 0;
+	if (!eglChooseConfig(_display, config_attribs, &config, 1, &num_configs) || num_configs < 1) { return; }
+	const EGLint surface_attribs[] = {EGL_WIDTH, w, EGL_HEIGHT, h, EGL_NONE};
+	_surface = eglCreatePbufferSurface(_display, config, surface_attribs);
+	if (_surface == EGL_NO_SURFACE) { return; }
+	// The model is drawn with legacy OpenGL, not OpenGL ES
+	if (!eglBindAPI(EGL_OPENGL_API)) { return; }
+	_context = eglCreateContext(_display, config, EGL_NO_CONTEXT, NULL);
+	if (_context == EGL_NO_CONTEXT) { return; }
+	_good = true;
+#endif
+}
+
+Offscreen_Context::~Offscreen_Context() {
+#ifdef __EGL__
+	if (_display == EGL_NO_DISPLAY) { return; }
+	eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (_context != EGL_NO_CONTEXT) { eglDestroyContext(_display, _context); }
+	if (_surface != EGL_NO_SURFACE) { eglDestroySurface(_display, _surface); }
+	eglTerminate(_display);
+#endif
+}
+
+bool Offscreen_Context::make_current() {
+#ifdef __EGL__
+	return _good && eglMakeCurrent(_display, _surface, _surface, _context);
+#else
+	return false;
+#endif
+}
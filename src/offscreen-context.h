@@ -0,0 +1,39 @@
+#ifndef OFFSCREEN_CONTEXT_H
+#define OFFSCREEN_CONTEXT_H
+
+#if defined(__linux__)
+#define __EGL__
+#else
+#undef __EGL__
+#endif
+
+#ifdef __EGL__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// An OpenGL context that renders into an offscreen buffer instead of a window, using Mesa's surfaceless EGL platform,
+// which needs neither a display server nor a GPU (Mesa falls back to software rendering)
+// (Only Linux has EGL, so offscreen contexts cannot be created on other platforms)
+class Offscreen_Context {
+private:
+#ifdef __EGL__
+	EGLDisplay _display;
+	EGLSurface _surface;
+	EGLContext _context;
+#endif
+	int _width, _height;
+	bool _good;
+public:
+	Offscreen_Context(int w, int h);
+	~Offscreen_Context();
+	inline bool good(void) const { return _good; }
+	inline int w(void) const { return _width; }
+	inline int h(void) const { return _height; }
+	bool make_current(void);
+private:
+	Offscreen_Context(const Offscreen_Context &oc); // Unimplemented copy constructor
+	Offscreen_Context &operator=(const Offscreen_Context &oc); // Unimplemented assignment operator
+};
+
+#endif
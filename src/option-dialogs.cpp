@@ -140,8 +140,8 @@ int Report_Somas_Dialog::refresh_content(int ww, int dy) {
 	return ch;
 }
 
-Report_Averages_Dialog::Report_Averages_Dialog(const char *t) : Option_Dialog(t), _start_spinner(NULL),
-	_stop_spinner(NULL), _step_spinner(NULL), _num_cycles(0) {}
+Report_Averages_Dialog::Report_Averages_Dialog(const char *t, const char *step_label) : Option_Dialog(t),
+	_step_label(step_label), _start_spinner(NULL), _stop_spinner(NULL), _step_spinner(NULL), _num_cycles(0) {}
 
 Report_Averages_Dialog::~Report_Averages_Dialog() {
 	delete _start_spinner;
@@ -153,7 +153,7 @@ void Report_Averages_Dialog::initialize_content() {
 	// Populate content group
 	_start_spinner = new OS_Spinner(0, 0, 0, 0, "From:");
 	_stop_spinner = new OS_Spinner(0, 0, 0, 0, "To:");
-	_step_spinner = new OS_Spinner(0, 0, 0, 0, "Average interval:");
+	_step_spinner = new OS_Spinner(0, 0, 0, 0, _step_label);
 	// Initialize content group's children
 	_start_spinner->type(FL_INT_INPUT);
 	_start_spinner->range(0.0, (double)(std::numeric_limits<size32_t>::max() - 1));
@@ -195,7 +195,78 @@ int Report_Averages_Dialog::refresh_content(int ww, int dy) {
 	txt_w = text_width("To:", 3);
 	_stop_spinner->resize(_start_spinner->x()+_start_spinner->w()+10+txt_w, dy, wgt_w, wgt_h);
 	dy += _stop_spinner->h() + 5;
-	txt_w = text_width("Average interval:", 3);
+	txt_w = text_width(_step_label, 3);
 	_step_spinner->resize(10+txt_w, dy, wgt_w, wgt_h);
 	return ch;
 }
+
+Export_Animation_Dialog::Export_Animation_Dialog(const char *t) : Option_Dialog(t), _start_spinner(NULL),
+	_stop_spinner(NULL), _step_spinner(NULL), _format_choice(NULL), _level_spinner(NULL), _num_cycles(0) {}
+
+Export_Animation_Dialog::~Export_Animation_Dialog() {
+	delete _start_spinner;
+	delete _stop_spinner;
+	delete _step_spinner;
+	delete _format_choice;
+	delete _level_spinner;
+}
+
+Image::Compression Export_Animation_Dialog::compression() const {
+	Image::Compression c = Image::Compression::fast();
+	c.level = (int)_level_spinner->value();
+	return c;
+}
+
+void Export_Animation_Dialog::initialize_content() {
+	// Populate content group
+	_start_spinner = new OS_Spinner(0, 0, 0, 0, "From:");
+	_stop_spinner = new OS_Spinner(0, 0, 0, 0, "To:");
+	_step_spinner = new OS_Spinner(0, 0, 0, 0, "Stride:");
+	_format_choice = new Dropdown(0, 0, 0, 0, "Format:");
+	_level_spinner = new OS_Spinner(0, 0, 0, 0, "Compression:");
+	// Initialize content group's children
+	_start_spinner->type(FL_INT_INPUT);
+	_start_spinner->step(1.0);
+	_stop_spinner->type(FL_INT_INPUT);
+	_stop_spinner->step(1.0);
+	_step_spinner->type(FL_INT_INPUT);
+	_step_spinner->step(1.0);
+	_format_choice->add("PNG", 0, (Fl_Callback *)NULL, NULL, 0);
+	_format_choice->add("PPM", 0, (Fl_Callback *)NULL, NULL, 0);
+	_format_choice->value(0);
+	_level_spinner->type(FL_INT_INPUT);
+	_level_spinner->range(0.0, 9.0);
+	_level_spinner->step(1.0);
+	_level_spinner->value((double)Image::Compression::fast().level);
+	_level_spinner->tooltip("PNG compression level, from 0 (fastest) to 9 (smallest)");
+}
+
+int Export_Animation_Dialog::refresh_content(int ww, int dy) {
+	_start_spinner->range(0.0, _num_cycles - 1);
+	_start_spinner->value(0.0);
+	_stop_spinner->range(0.0, _num_cycles - 1);
+	_stop_spinner->value(_num_cycles - 1);
+	_step_spinner->range(1.0, _num_cycles);
+	_step_spinner->value(1.0);
+#ifdef LARGE_INTERFACE
+	int wgt_h = 28;
+#else
+	int wgt_h = 22;
+#endif
+	int ch = wgt_h * 3 + 10;
+	_content->resize(10, dy, ww, ch);
+	int wgt_w = text_width("10000", 2) + wgt_h;
+	int txt_w = text_width("From:", 3);
+	_start_spinner->resize(10+txt_w, dy, wgt_w, wgt_h);
+	txt_w = text_width("To:", 3);
+	_stop_spinner->resize(_start_spinner->x()+_start_spinner->w()+10+txt_w, dy, wgt_w, wgt_h);
+	dy += _stop_spinner->h() + 5;
+	txt_w = text_width("Stride:", 3);
+	_step_spinner->resize(10+txt_w, dy, wgt_w, wgt_h);
+	dy += _step_spinner->h() + 5;
+	txt_w = text_width("Format:", 3);
+	_format_choice->resize(10+txt_w, dy, text_width("PNG", 2) + wgt_h + 10, wgt_h);
+	txt_w = text_width("Compression:", 3);
+	_level_spinner->resize(_format_choice->x()+_format_choice->w()+10+txt_w, dy, text_width("9", 2) + wgt_h, wgt_h);
+	return ch;
+}
@@ -4,6 +4,7 @@
 #include "utils.h"
 #include "widgets.h"
 #include "firing-spikes.h"
+#include "image.h"
 
 class Fl_Double_Window;
 class Fl_Box;
@@ -50,10 +51,11 @@ protected:
 
 class Report_Averages_Dialog : public Option_Dialog {
 private:
+	const char *_step_label;
 	OS_Spinner *_start_spinner, *_stop_spinner, *_step_spinner;
 	size32_t _num_cycles;
 public:
-	Report_Averages_Dialog(const char *t);
+	Report_Averages_Dialog(const char *t, const char *step_label = "Average interval:");
 	~Report_Averages_Dialog();
 	inline void limit_spinners(const Firing_Spikes *fs) { _num_cycles = fs->num_cycles(); }
 	inline size32_t start_time(void) const { return (size32_t)_start_spinner->value(); }
@@ -64,4 +66,24 @@ protected:
 	int refresh_content(int ww, int dy);
 };
 
+class Export_Animation_Dialog : public Option_Dialog {
+private:
+	OS_Spinner *_start_spinner, *_stop_spinner, *_step_spinner;
+	Dropdown *_format_choice;
+	OS_Spinner *_level_spinner;
+	size32_t _num_cycles;
+public:
+	Export_Animation_Dialog(const char *t);
+	~Export_Animation_Dialog();
+	inline void limit_spinners(const Firing_Spikes *fs) { _num_cycles = fs->num_cycles(); }
+	inline size32_t start_time(void) const { return (size32_t)_start_spinner->value(); }
+	inline size32_t stop_time(void) const { return (size32_t)_stop_spinner->value(); }
+	inline size32_t step_time(void) const { return (size32_t)_step_spinner->value(); }
+	inline Image::Format format(void) const { return _format_choice->value() == 1 ? Image::PPM : Image::PNG; }
+	Image::Compression compression(void) const;
+protected:
+	void initialize_content(void);
+	int refresh_content(int ww, int dy);
+};
+
 #endif
@@ -18,6 +18,7 @@
 #include "color.h"
 #include "os-themes.h"
 #include "widgets.h"
+#include "profiler.h"
 #include "overview-area.h"
 
 const double Overview_Area::FOV_Y = 30.0;
@@ -27,8 +28,12 @@ const double Overview_Area::FAR_PLANE = 120.0;
 
 const double Overview_Area::FOCAL_LENGTH = 5.0;
 
+const double Overview_Area::DEFAULT_MAX_RATE = 20.0;
+
 Overview_Area::Overview_Area(int x, int y, int w, int h, const char *l) : Fl_Gl_Window(x, y, w, h, l),
-	_model_area(NULL), _dnd_receiver(NULL), _zoom(0.0), _initialized(false) {
+	_model_area(NULL), _dnd_receiver(NULL), _zoom(0.0), _initialized(false), _model_list(0), _listed_styles(),
+	_shown_styles(), _listed_version(0), _listed(false), _shown_view(), _max_rate(DEFAULT_MAX_RATE),
+	_throttled(false), _pending(false) {
 	mode(FL_RGB | FL_ALPHA | FL_DEPTH | FL_DOUBLE);
 	labelfont(OS_FONT);
 	labelsize(OS_FONT_SIZE);
@@ -37,9 +42,60 @@ Overview_Area::Overview_Area(int x, int y, int w, int h, const char *l) : Fl_Gl_
 	end();
 }
 
+Overview_Area::~Overview_Area() {
+	Fl::remove_timeout((Fl_Timeout_Handler)throttle_cb, this);
+}
+
 void Overview_Area::refresh() {
+	// Skip redrawing when nothing that the overview shows has changed (e.g. on every cycle of playback)
+	std::vector<double> view;
+	current_view(view);
+	bool styled = !_model_area || _shown_styles.matches(_model_area->const_model());
+	if (styled && view == _shown_view) { return; }
+	// Wait to redraw when the overview was redrawn too recently (e.g. while rotating the model)
+	if (_throttled) {
+		_pending = true;
+		return;
+	}
 	invalidate();
-	if (visible()) { flush(); }
+	if (!visible()) { return; }
+	flush();
+	_shown_view.swap(view);
+	if (_model_area) { _shown_styles.remember(_model_area->const_model()); }
+	if (_max_rate > 0.0) {
+		_throttled = true;
+		Fl::add_timeout(1.0 / _max_rate, (Fl_Timeout_Handler)throttle_cb, this);
+	}
+}
+
+void Overview_Area::throttle_cb(Overview_Area *oa) {
+	oa->_throttled = false;
+	if (oa->_pending) {
+		oa->_pending = false;
+		oa->refresh();
+	}
+}
+
+void Overview_Area::current_view(std::vector<double> &v) const {
+	// Everything that the projection, view, and model drawn depend on
+	v.clear();
+	v.push_back(active() ? 1.0 : 0.0);
+	v.push_back(_zoom);
+	v.push_back(w());
+	v.push_back(h());
+	if (!_model_area) { return; }
+	const Draw_Options &draw_opts = _model_area->const_draw_options();
+	v.push_back(_model_area->opened() ? 1.0 : 0.0);
+	v.push_back((double)_model_area->model_version());
+	v.push_back(draw_opts.invert_background() ? 1.0 : 0.0);
+	v.push_back(draw_opts.left_handed() ? 1.0 : 0.0);
+	const Model_State &state = _model_area->const_state();
+	const Bounds &base = _model_area->const_model().bounds();
+	v.insert(v.end(), state.rotate(), state.rotate() + 16);
+	v.insert(v.end(), state.center(), state.center() + 3);
+	v.insert(v.end(), base.center(), base.center() + 3);
+	v.push_back((double)state.max_range());
+	v.push_back((double)base.max_range());
 }
 
 void Overview_Area::refresh_gl() {
@@ -101,6 +157,7 @@ void Overview_Area::refresh_view() {
 }
 
 void Overview_Area::draw() {
+	Profiler::Scope scope("overview");
 	if (!_initialized) {
 #ifdef __APPLE__
 		if (!context_valid()) { return; } // fix some OpenGL crashes
@@ -112,21 +169,45 @@ void Overview_Area::draw() {
 		refresh_projection();
 		valid(1);
 	}
+	if (!context_valid()) {
+		// A new context has none of the old one's display lists
+		_model_list = 0;
+		_listed = false;
+	}
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	if (!_model_area || !active() || !_model_area->opened()) { return; }
 	Clip_Volume::disable();
 	refresh_view();
-	const Brain_Model &m = _model_area->const_model();
 	glPointSize(2.0f);
+	draw_model();
+}
+
+void Overview_Area::draw_model() {
+	const Brain_Model &m = _model_area->const_model();
+	// Compile the somas into a display list the first time, and replay it as long as they look the same
+	if (!_model_list) { _model_list = glGenLists(1); }
+	if (_listed && _listed_version == _model_area->model_version() && _listed_styles.matches(m)) {
+		glCallList(_model_list);
+		return;
+	}
+	if (_model_list) { glNewList(_model_list, GL_COMPILE_AND_EXECUTE); }
+	// Draw somas as small dots colored by type
 	glBegin(GL_POINTS);
-	size32_t n = m.num_somas();
-	for (size32_t i = 0; i < n; i++) {
-		const Soma *s = m.soma(i);
-		const Soma_Type *t = m.type(s->type_index());
-		glColor3fv(t->color()->rgb());
-		s->draw();
+	size8_t nt = m.num_types();
+	for (size8_t t_index = 0; t_index < nt; t_index++) {
+		glColor3fv(m.type(t_index)->color()->rgb());
+		std::pair<const size32_t *, const size32_t *> typed = m.somas_of_type(t_index);
+		for (const size32_t *it = typed.first; it != typed.second; ++it) {
+			m.soma(*it)->draw();
+		}
 	}
 	glEnd();
+	if (_model_list) {
+		glEndList();
+		_listed_styles.remember(m);
+		_listed_version = _model_area->model_version();
+		_listed = true;
+	}
 }
 
 int Overview_Area::handle(int event) {
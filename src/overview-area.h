@@ -1,29 +1,52 @@
 #ifndef OVERVIEW_AREA_H
 #define OVERVIEW_AREA_H
 
+#include <vector>
+
 #pragma warning(push, 0)
+#include <FL/gl.h>
 #include <FL/Fl_Gl_Window.H>
 #pragma warning(pop)
 
+#include "brain-model.h"
+
 class Model_Area;
+class DnD_Receiver;
 
 class Overview_Area : public Fl_Gl_Window {
 private:
 	static const double FOV_Y;
 	static const double NEAR_PLANE, FAR_PLANE;
 	static const double FOCAL_LENGTH;
+public:
+	static const double DEFAULT_MAX_RATE;
 private:
 	const Model_Area *_model_area;
 	DnD_Receiver *_dnd_receiver;
 	double _zoom;
 	bool _initialized;
+	// The model's somas are compiled into a display list, which is replayed until the model or the types' colors
+	// change; the overview is only redrawn when its view changes, and at most max_rate times per second
+	GLuint _model_list;
+	Brain_Model::Type_Styles _listed_styles, _shown_styles;
+	size_t _listed_version;
+	bool _listed;
+	std::vector<double> _shown_view;
+	double _max_rate;
+	bool _throttled, _pending;
 private:
 	static void refresh_gl(void);
+	static void throttle_cb(Overview_Area *oa);
 private:
 	void refresh_view(void);
 	void refresh_projection(void);
+	void current_view(std::vector<double> &v) const;
+	void draw_model(void);
 public:
 	Overview_Area(int x, int y, int w, int h, const char *l = NULL);
+	~Overview_Area();
+	inline double max_rate(void) const { return _max_rate; }
+	inline void max_rate(double r) { _max_rate = r; }
 	inline void model_area(const Model_Area *m) { _model_area = m; }
 	inline void dnd_receiver(DnD_Receiver *dndr) { _dnd_receiver = dndr; }
 	inline double zoom(void) const { return _zoom; }
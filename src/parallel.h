@@ -0,0 +1,107 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstdlib>
+#include <vector>
+
+#if !defined(_MSC_VER) || _MSC_VER >= 1700
+#define __THREADS__
+#else
+#undef __THREADS__
+#endif
+
+#ifdef __THREADS__
+#include <thread>
+#include <atomic>
+#include <chrono>
+#endif
+
+// Counters and flags that are shared between worker threads
+// (Visual Studio 2010 has no C++11 threads, so everything runs serially there)
+#ifdef __THREADS__
+typedef std::atomic<size_t> shared_size_t;
+typedef std::atomic<bool> shared_bool_t;
+#else
+typedef size_t shared_size_t;
+typedef bool shared_bool_t;
+#endif
+
+const int POLL_INTERVAL_MS = 20;
+
+inline size_t num_threads(void) {
+#ifdef __THREADS__
+	size_t nt = (size_t)std::thread::hardware_concurrency();
+	return nt ? nt : 1;
+#else
+	return 1;
+#endif
+}
+
+// Returns how many chunks of at least min_size items to split n items into, at most one per thread
+inline size_t num_chunks(size_t n, size_t min_size) {
+	size_t nc = min_size ? n / min_size : n;
+	size_t nt = num_threads();
+	return nc < 1 ? 1 : nc > nt ? nt : nc;
+}
+
+// Returns the first item of the i-th of nc near-equal contiguous chunks of n items
+inline size_t chunk_begin(size_t n, size_t nc, size_t i) {
+	size_t q = n / nc, r = n % nc;
+	return i * q + (i < r ? i : r);
+}
+
+// Calls f(begin, end, i) for each i-th of nc contiguous chunks [begin, end) of [0, n), each on its own thread
+// (the calling thread handles the first chunk), and returns when they are all done
+template<typename F>
+void parallel_chunks(size_t n, size_t nc, F f) {
+	if (nc < 1) { nc = 1; }
+#ifdef __THREADS__
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < nc; i++) {
+		threads.push_back(std::thread(f, chunk_begin(n, nc, i), chunk_begin(n, nc, i + 1), i));
+	}
+	f((size_t)0, chunk_begin(n, nc, 1), (size_t)0);
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i].join();
+	}
+#else
+	for (size_t i = 0; i < nc; i++) {
+		f(chunk_begin(n, nc, i), chunk_begin(n, nc, i + 1), i);
+	}
+#endif
+}
+
+// Calls f(task, thread) for each task in [0, n), handing the tasks out in order to nt worker threads,
+// while the calling thread calls poll() every POLL_INTERVAL_MS (e.g. to keep the GUI responsive);
+// f is expected to return early if poll() decides to stop
+template<typename F, typename P>
+void parallel_tasks(size_t n, size_t nt, F f, P poll) {
+	if (nt < 1) { nt = 1; }
+#ifdef __THREADS__
+	shared_size_t next_task(0), n_done(0);
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < nt; t++) {
+		threads.push_back(std::thread([&, t]() {
+			for (size_t task = next_task++; task < n; task = next_task++) {
+				f(task, t);
+			}
+			n_done++;
+		}));
+	}
+	while (n_done < nt) {
+		poll();
+		std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+	}
+	for (size_t t = 0; t < nt; t++) {
+		threads[t].join();
+	}
+#else
+	for (size_t task = 0; task < n; task++) {
+		f(task, (size_t)0);
+		poll();
+	}
+#endif
+	poll();
+}
+
+#endif
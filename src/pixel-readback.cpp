@@ -0,0 +1,134 @@
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
+
+#pragma warning(push, 0)
+#include <FL/gl.h>
+#pragma warning(pop)
+
+#include "pixel-readback.h"
+
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_READ_ONLY
+#define GL_READ_ONLY 0x88B8
+#endif
+
+static void *gl_proc(const char *name) {
+#ifdef _WIN32
+	return (void *)wglGetProcAddress(name);
+#else
+	return dlsym(RTLD_DEFAULT, name);
+#endif
+}
+
+Pixel_Readback::Pixel_Readback(size_t w, size_t h) : _width(w), _height(h), _buffers(), _num_reads(0),
+	_pending(NULL), _async(false), _gen_buffers(NULL), _delete_buffers(NULL), _bind_buffer(NULL), _buffer_data(NULL),
+	_map_buffer(NULL), _unmap_buffer(NULL) {
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	if (!load()) { return; }
+	// Allocate both buffers up front, since every frame is the same size
+	_gen_buffers(2, _buffers);
+	for (size_t i = 0; i < 2; i++) {
+		_bind_buffer(GL_PIXEL_PACK_BUFFER, _buffers[i]);
+		_buffer_data(GL_PIXEL_PACK_BUFFER, (ptrdiff_t)(3 * w * h), NULL, GL_STREAM_READ);
+	}
+	_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+	_async = glGetError() == GL_NO_ERROR;
+	if (!_async) { _delete_buffers(2, _buffers); }
+}
+
+Pixel_Readback::~Pixel_Readback() {
+	if (_async) { _delete_buffers(2, _buffers); }
+	delete [] _pending;
+}
+
+bool Pixel_Readback::load() {
+	// Pixel buffer objects are core in OpenGL 2.1, and an extension before that
+	const char *version = (const char *)glGetString(GL_VERSION);
+	const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+	if (version == NULL) { return false; }
+	int major = atoi(version);
+	const char *dot = strchr(version, '.');
+	int minor = dot ? atoi(dot + 1) : 0;
+	bool core = major > 2 || (major == 2 && minor >= 1);
+	bool ext = extensions && strstr(extensions, "GL_ARB_pixel_buffer_object") != NULL;
+	if (!core && !ext) { return false; }
+	// The extension's entry points have the same signatures as the core ones, with an "ARB" suffix
+	const char *suffix = core ? "" : "ARB";
+	const char *names[6] = {"glGenBuffers", "glDeleteBuffers", "glBindBuffer", "glBufferData", "glMapBuffer",
+		"glUnmapBuffer"};
+	void *procs[6];
+	for (size_t i = 0; i < 6; i++) {
+		char name[32];
+		strcpy(name, names[i]);
+		strcat(name, suffix);
+		procs[i] = gl_proc(name);
+		if (procs[i] == NULL) { return false; }
+	}
+	_gen_buffers = (gen_buffers_t)procs[0];
+	_delete_buffers = (delete_buffers_t)procs[1];
+	_bind_buffer = (bind_buffer_t)procs[2];
+	_buffer_data = (buffer_data_t)procs[3];
+	_map_buffer = (map_buffer_t)procs[4];
+	_unmap_buffer = (unmap_buffer_t)procs[5];
+	return true;
+}
+
+uchar *Pixel_Readback::read_now() const {
+	uchar *pixels = new(std::nothrow) uchar[3 * _width * _height];
+	if (pixels) { glReadPixels(0, 0, (GLsizei)_width, (GLsizei)_height, GL_RGB, GL_UNSIGNED_BYTE, pixels); }
+	return pixels;
+}
+
+uchar *Pixel_Readback::take(size_t i) const {
+	// Mapping waits for the buffer's read to finish, which it usually has while the next frame was drawn
+	_bind_buffer(GL_PIXEL_PACK_BUFFER, _buffers[i]);
+	const uchar *mapped = (const uchar *)_map_buffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+	uchar *pixels = NULL;
+	if (mapped) {
+		pixels = new(std::nothrow) uchar[3 * _width * _height];
+		if (pixels) { memcpy(pixels, mapped, 3 * _width * _height); }
+		_unmap_buffer(GL_PIXEL_PACK_BUFFER);
+	}
+	_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+	return pixels;
+}
+
+uchar *Pixel_Readback::read() {
+	uchar *prev;
+	if (_async) {
+		size_t i = _num_reads % 2;
+		_bind_buffer(GL_PIXEL_PACK_BUFFER, _buffers[i]);
+		glReadPixels(0, 0, (GLsizei)_width, (GLsizei)_height, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+		_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+		prev = _num_reads ? take(1 - i) : NULL;
+	}
+	else {
+		prev = _pending;
+		_pending = read_now();
+	}
+	_num_reads++;
+	return prev;
+}
+
+uchar *Pixel_Readback::finish() {
+	uchar *last = NULL;
+	if (_async) {
+		if (_num_reads) { last = take((_num_reads - 1) % 2); }
+	}
+	else {
+		last = _pending;
+		_pending = NULL;
+	}
+	_num_reads = 0;
+	return last;
+}
@@ -0,0 +1,55 @@
+#ifndef PIXEL_READBACK_H
+#define PIXEL_READBACK_H
+
+#include <cstddef>
+
+#pragma warning(push, 0)
+#include <FL/gl.h>
+#pragma warning(pop)
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+// Reads drawn frames back from OpenGL through two pixel buffer objects in turn, so that copying one frame out of
+// video memory overlaps with drawing the next one; where pixel buffer objects are missing (before OpenGL 2.1), frames
+// are read right away instead
+// Each read starts reading the frame just drawn and returns the pixels of the one before it, and finishing returns the
+// last one; either returns NULL if there was no such frame, and otherwise the caller must delete [] the pixels, which
+// are in row-major order from bottom to top (the context that the readback is created in must be current whenever it
+// is used or destroyed)
+class Pixel_Readback {
+private:
+	typedef void (APIENTRY *gen_buffers_t)(GLsizei n, GLuint *buffers);
+	typedef void (APIENTRY *delete_buffers_t)(GLsizei n, const GLuint *buffers);
+	typedef void (APIENTRY *bind_buffer_t)(GLenum target, GLuint buffer);
+	typedef void (APIENTRY *buffer_data_t)(GLenum target, ptrdiff_t size, const void *data, GLenum usage);
+	typedef void *(APIENTRY *map_buffer_t)(GLenum target, GLenum access);
+	typedef GLboolean (APIENTRY *unmap_buffer_t)(GLenum target);
+private:
+	size_t _width, _height;
+	GLuint _buffers[2];
+	size_t _num_reads;
+	uchar *_pending;
+	bool _async;
+	gen_buffers_t _gen_buffers;
+	delete_buffers_t _delete_buffers;
+	bind_buffer_t _bind_buffer;
+	buffer_data_t _buffer_data;
+	map_buffer_t _map_buffer;
+	unmap_buffer_t _unmap_buffer;
+public:
+	Pixel_Readback(size_t w, size_t h);
+	~Pixel_Readback();
+	inline bool async(void) const { return _async; }
+	uchar *read(void);
+	uchar *finish(void);
+private:
+	bool load(void);
+	uchar *read_now(void) const;
+	uchar *take(size_t i) const;
+	Pixel_Readback(const Pixel_Readback &pr); // Unimplemented copy constructor
+	Pixel_Readback &operator=(const Pixel_Readback &pr); // Unimplemented assignment operator
+};
+
+#endif
@@ -0,0 +1,67 @@
+#include <limits>
+
+#include "algebra.h"
+#include "playback-scheduler.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+const double Playback_Scheduler::RATE_INTERVAL = 1.0;
+
+Playback_Scheduler::Playback_Scheduler() : _rate(1.0), _origin(0.0), _cycles(0), _dropped(0), _window_start(0.0),
+	_window_cycles(0), _cycle_rate(0.0), _measured(false) {}
+
+double Playback_Scheduler::now() {
+#ifdef _WIN32
+	LARGE_INTEGER freq, counter;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / (double)freq.QuadPart;
+#else
+	struct timeval time;
+	gettimeofday(&time, NULL);
+	return (double)time.tv_sec + (double)time.tv_usec / 1000000.0;
+#endif
+}
+
+void Playback_Scheduler::start(double rate) {
+	_rate = rate;
+	_origin = _window_start = now();
+	_cycles = _dropped = 0;
+	_window_cycles = 0;
+	_cycle_rate = 0.0;
+	_measured = false;
+}
+
+void Playback_Scheduler::rate(double rate) {
+	if (rate == _rate) { return; }
+	// Keep the cycles already played, and pace the rest at the new rate
+	_origin = now() - _cycles / rate;
+	_rate = rate;
+}
+
+size32_t Playback_Scheduler::due() {
+	double t = now();
+	size_t target = (size_t)((t - _origin) * _rate);
+	if (target <= _cycles) { return 0; }
+	size_t n = target - _cycles;
+	_cycles = target;
+	// Only the last of the cycles due gets drawn
+	_dropped += n - 1;
+	_window_cycles += n;
+	if (t - _window_start >= RATE_INTERVAL) {
+		_cycle_rate = _window_cycles / (t - _window_start);
+		_window_start = t;
+		_window_cycles = 0;
+		_measured = true;
+	}
+	return (size32_t)MIN(n, (size_t)(std::numeric_limits<size32_t>::max)());
+}
+
+double Playback_Scheduler::wait() const {
+	double w = _origin + (_cycles + 1) / _rate - now();
+	return w > 0.0 ? w : 0.0;
+}
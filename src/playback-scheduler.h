@@ -0,0 +1,34 @@
+#ifndef PLAYBACK_SCHEDULER_H
+#define PLAYBACK_SCHEDULER_H
+
+#include <cstdlib>
+
+#include "utils.h"
+
+// Paces playback at a target rate of cycles per second by wall time: each frame advances by every cycle
+// that has come due since the last one, so slow frames skip cycles instead of slowing playback down
+class Playback_Scheduler {
+private:
+	static const double RATE_INTERVAL;
+private:
+	double _rate;
+	double _origin;
+	size_t _cycles, _dropped;
+	double _window_start;
+	size_t _window_cycles;
+	double _cycle_rate;
+	bool _measured;
+public:
+	Playback_Scheduler();
+	void start(double rate);
+	void rate(double rate);
+	size32_t due(void);
+	double wait(void) const;
+	inline size_t dropped(void) const { return _dropped; }
+	inline bool measured(void) const { return _measured; }
+	inline double cycle_rate(void) const { return _cycle_rate; }
+private:
+	static double now(void);
+};
+
+#endif
@@ -0,0 +1,127 @@
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+#include "algebra.h"
+#include "profiler.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+std::vector<Profiler::Section> Profiler::_sections;
+std::vector<Profiler::Event> Profiler::_events;
+size_t Profiler::_num_events = 0;
+size_t Profiler::_current = Profiler::NO_SECTION;
+
+Profiler::Scope::Scope(const char *name) : _section(enter(name)), _start(now()) {}
+
+Profiler::Scope::~Scope() {
+	leave(_section, _start, now());
+}
+
+double Profiler::now() {
+	// Unlike the time of day, these clocks never jump when the system time is changed
+#ifdef _WIN32
+	LARGE_INTEGER freq, counter;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / (double)freq.QuadPart;
+#elif defined(__APPLE__)
+	static mach_timebase_info_data_t timebase = {0, 0};
+	if (!timebase.denom) { mach_timebase_info(&timebase); }
+	return (double)mach_absolute_time() * timebase.numer / timebase.denom / 1000000000.0;
+#else
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (double)time.tv_sec + (double)time.tv_nsec / 1000000000.0;
+#endif
+}
+
+size_t Profiler::enter(const char *name) {
+	// A section is told apart by its name and the section it is nested in
+	size_t n = _sections.size();
+	size_t i = 0;
+	for (; i < n; i++) {
+		const Section &s = _sections[i];
+		if (s.parent == _current && (s.name == name || !strcmp(s.name, name))) { break; }
+	}
+	if (i == n) {
+		Section s;
+		s.name = name;
+		s.parent = _current;
+		s.depth = _current == NO_SECTION ? 0 : _sections[_current].depth + 1;
+		s.durations.resize(WINDOW_SIZE);
+		s.count = 0;
+		_sections.push_back(s);
+	}
+	_current = i;
+	return i;
+}
+
+void Profiler::leave(size_t section, double start, double stop) {
+	Section &s = _sections[section];
+	_current = s.parent;
+	double d = stop - start;
+	s.durations[s.count % WINDOW_SIZE] = d;
+	s.count++;
+	if (_events.empty()) { _events.resize(MAX_EVENTS); }
+	Event &e = _events[_num_events % MAX_EVENTS];
+	e.section = section;
+	e.start = start;
+	e.duration = d;
+	_num_events++;
+}
+
+void Profiler::stats(std::vector<Stats> &s) {
+	s.clear();
+	add_stats(s, NO_SECTION);
+}
+
+void Profiler::add_stats(std::vector<Stats> &s, size_t parent) {
+	// List each section followed by the ones nested in it, in the order they were first timed
+	std::vector<double> sorted;
+	for (size_t i = 0; i < _sections.size(); i++) {
+		const Section &sec = _sections[i];
+		if (sec.parent != parent) { continue; }
+		size_t n = MIN(sec.count, WINDOW_SIZE);
+		sorted.assign(sec.durations.begin(), sec.durations.begin() + (std::ptrdiff_t)n);
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0.0;
+		for (size_t j = 0; j < n; j++) { sum += sorted[j]; }
+		Stats st;
+		st.name = sec.name;
+		st.depth = sec.depth;
+		st.count = sec.count;
+		st.min = n ? sorted[0] * 1000.0 : 0.0;
+		st.avg = n ? sum / n * 1000.0 : 0.0;
+		st.p99 = n ? sorted[(n * 99 + 99) / 100 - 1] * 1000.0 : 0.0;
+		s.push_back(st);
+		add_stats(s, i);
+	}
+}
+
+void Profiler::write_trace_to(std::ofstream &ofs) {
+	// Complete events with times in microseconds from the oldest one kept; the trace viewer nests them by time
+	size_t n = MIN(_num_events, MAX_EVENTS);
+	size_t first = _num_events - n;
+	double origin = n ? _events[first % MAX_EVENTS].start : 0.0;
+	ofs.setf(std::ios::fixed, std::ios::floatfield);
+	ofs.precision(3);
+	ofs << "{\"traceEvents\":[\n";
+	for (size_t i = first; i < _num_events; i++) {
+		const Event &e = _events[i % MAX_EVENTS];
+		ofs << "{\"name\":\"";
+		for (const char *c = _sections[e.section].name; *c; c++) {
+			if (*c == '"' || *c == '\\') { ofs << '\\'; }
+			ofs << *c;
+		}
+		ofs << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << ((e.start - origin) * 1000000.0) << ",\"dur\":" <<
+			(e.duration * 1000000.0) << "}" << (i + 1 < _num_events ? ",\n" : "\n");
+	}
+	ofs << "],\"displayTimeUnit\":\"ms\"}\n";
+}
@@ -0,0 +1,59 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdlib>
+#include <vector>
+#include <fstream>
+
+// Times nested sections of the program on a monotonic clock: each section keeps its last few durations for the
+// on-screen breakdown, and the last many runs of every section are kept as a timeline that can be saved in the Chrome
+// trace format (for chrome://tracing or Perfetto); sections are only timed on the main thread
+class Profiler {
+public:
+	static const size_t WINDOW_SIZE = 120, MAX_EVENTS = 65536;
+	// Times a section from when it is constructed until it is destroyed, nested inside the section timed around it;
+	// the name must last as long as the program, as string literals do
+	class Scope {
+	private:
+		size_t _section;
+		double _start;
+	public:
+		Scope(const char *name);
+		~Scope();
+	private:
+		Scope(const Scope &s); // Unimplemented copy constructor
+		Scope &operator=(const Scope &s); // Unimplemented assignment operator
+	};
+	// A section's durations in milliseconds over its last few runs
+	struct Stats {
+		const char *name;
+		size_t depth, count;
+		double min, avg, p99;
+	};
+private:
+	static const size_t NO_SECTION = (size_t)-1;
+	struct Section {
+		const char *name;
+		size_t parent, depth;
+		std::vector<double> durations;
+		size_t count;
+	};
+	struct Event {
+		size_t section;
+		double start, duration;
+	};
+	static std::vector<Section> _sections;
+	static std::vector<Event> _events;
+	static size_t _num_events;
+	static size_t _current;
+public:
+	static double now(void);
+	static void stats(std::vector<Stats> &s);
+	static void write_trace_to(std::ofstream &ofs);
+private:
+	static size_t enter(const char *name);
+	static void leave(size_t section, double start, double stop);
+	static void add_stats(std::vector<Stats> &s, size_t parent);
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include <iostream>
 
+#include "algebra.h"
 #include "color-maps.h"
 #include "brain-model.h"
 #include "sim-data.h"
@@ -8,7 +9,7 @@ const float Sim_Data::INACTIVE_SOMA_COLOR[3] = {0.2f, 0.2f, 0.2f}; // dark gray
 const float Sim_Data::INVERT_INACTIVE_SOMA_COLOR[3] = {0.8f, 0.8f, 0.8f}; // light gray
 
 Sim_Data::Sim_Data(const Brain_Model *bm, const Color_Map *m) : From_File(), _model(bm), _num_cycles(0),
-	_start_time(0), _time(0), _color_map(m) {}
+	_start_time(0), _time(0), _color_map(m), _scale_min(0.0f), _scale_density(1.0f), _scale_lut() {}
 
 Sim_Data::~Sim_Data() {
 	_model = NULL;
@@ -18,3 +19,40 @@ Sim_Data::~Sim_Data() {
 }
 
 size32_t Sim_Data::num_somas(void) const { return _model->num_somas(); }
+
+void Sim_Data::scale_lookup(const float *q, size_t n, float *s) const {
+	const float *lut = &_scale_lut[0];
+	float min_q = _scale_min, density = _scale_density;
+	for (size_t i = 0; i < n; i++) {
+		float x = (q[i] - min_q) * density;
+		if (!(x > 0.0f)) { s[i] = lut[0]; continue; }
+		if (x >= (float)(SCALE_LUT_SIZE - 1)) { s[i] = lut[SCALE_LUT_SIZE - 1]; continue; }
+		size_t j = (size_t)x;
+		s[i] = lut[j] + (lut[j + 1] - lut[j]) * (x - (float)j);
+	}
+}
+
+void Sim_Data::map_color(float q, float *cv) const {
+	_color_map->lookup(scale_lookup(q), cv);
+}
+
+void Sim_Data::map_colors(const float *q, size_t n, float *cv) const {
+	// Scale a block of quantities at a time, then look up all their colors
+	float s[BATCH_SIZE];
+	for (size_t i = 0; i < n; i += BATCH_SIZE) {
+		size_t k = MIN(n - i, BATCH_SIZE);
+		scale_lookup(q + i, k, s);
+		_color_map->lookup(s, k, cv + i * 3);
+	}
+}
+
+void Sim_Data::bake_scale(float min_q, float max_q) {
+	// Subclasses call this when constructed and whenever their scale changes
+	float step = (max_q - min_q) / (SCALE_LUT_SIZE - 1);
+	_scale_min = min_q;
+	_scale_density = 1.0f / step;
+	_scale_lut.resize(SCALE_LUT_SIZE);
+	for (size_t i = 0; i < SCALE_LUT_SIZE; i++) {
+		_scale_lut[i] = scale(min_q + step * i);
+	}
+}
@@ -2,6 +2,7 @@
 #define ACTIVE_SET_H
 
 #include <iostream>
+#include <vector>
 
 #include "utils.h"
 #include "from-file.h"
@@ -16,11 +17,17 @@ enum Firing_State { NOTHING = 0x0, NORMAL = 0x1, FORCED = 0x2, BINARY = 0x4, UNS
 class Sim_Data : public virtual From_File {
 public:
 	static const float INACTIVE_SOMA_COLOR[3], INVERT_INACTIVE_SOMA_COLOR[3];
+	static const size_t SCALE_LUT_SIZE = 4096;
 protected:
+	// Quantities are scaled and mapped to colors this many at a time
+	static const size_t BATCH_SIZE = 256;
 	const Brain_Model *_model;
 	size32_t _num_cycles;
 	size32_t _start_time, _time;
 	const Color_Map *_color_map;
+	// scale(q) at SCALE_LUT_SIZE evenly spaced quantities, so coloring needs no transcendental functions
+	float _scale_min, _scale_density;
+	std::vector<float> _scale_lut;
 public:
 	Sim_Data(const Brain_Model *bm, const Color_Map *m);
 	virtual ~Sim_Data();
@@ -30,13 +37,29 @@ public:
 	inline size32_t const_start_time(void) const { return _start_time; }
 	inline virtual size32_t start_time(size32_t t) { if (t < _num_cycles) { _start_time = _time = t; } return _time; }
 	inline size32_t time(void) const { return _time; }
-	inline virtual size32_t step_time(void) { if (_time < _num_cycles - 1) { _time++; } return _time; }
+	inline virtual size32_t step_time(size32_t n = 1) {
+		if (_time < _num_cycles - 1) { _time = n < _num_cycles - 1 - _time ? _time + n : _num_cycles - 1; }
+		return _time;
+	}
 	inline size32_t duration(void) const { return _time - _start_time + 1; }
 	inline const Color_Map *color_map(void) const { return _color_map; }
 	virtual bool active(size32_t index) const = 0;
 	virtual float scale(float q) const = 0;
 	virtual float quantity(float s) const = 0;
 	virtual void color(size32_t index, const Soma_Type *t, float *cv, bool invert) const = 0;
+	inline float scale_lookup(float q) const {
+		// Interpolate between the nearest quantities in the table; quantities outside it are clamped
+		float x = (q - _scale_min) * _scale_density;
+		if (!(x > 0.0f)) { return _scale_lut[0]; }
+		if (x >= (float)(SCALE_LUT_SIZE - 1)) { return _scale_lut[SCALE_LUT_SIZE - 1]; }
+		size_t i = (size_t)x;
+		return _scale_lut[i] + (_scale_lut[i + 1] - _scale_lut[i]) * (x - (float)i);
+	}
+	void scale_lookup(const float *q, size_t n, float *s) const;
+	void map_color(float q, float *cv) const;
+	void map_colors(const float *q, size_t n, float *cv) const;
+protected:
+	void bake_scale(float min_q, float max_q);
 };
 
 #endif
@@ -14,6 +14,9 @@
 #include "utils.h"
 #include "input-parser.h"
 #include "binary-parser.h"
+#include "binary-writer.h"
+#include "geometry-batch.h"
+#include "gl-text.h"
 #include "soma.h"
 
 const float Soma::AXON_COLOR[3] = {0.0f, 0.5f, 1.0f}; // blue
@@ -71,7 +74,7 @@ void Soma::draw_letter(const Soma_Type *t) const {
 	if (t->display_state() == Soma_Type::LETTER) {
 		char l = t->letter();
 		glRasterPos3cv(_coords);
-		gl_draw(&l, 1);
+		GL_Text::draw(&l, 1);
 	}
 	else {
 		glBegin(GL_POINTS);
@@ -90,9 +93,9 @@ void Soma::draw_firing(bool firing) const {
 void Soma::draw_firing_letter(const Soma_Type *t, bool firing) const {
 	if (t->display_state() == Soma_Type::LETTER) {
 		char l = t->letter();
-		gl_font(firing ? SOMA_FIRING_FONT : SOMA_FONT, _soma_font_size);
+		GL_Text::font(firing ? SOMA_FIRING_FONT : SOMA_FONT, _soma_font_size);
 		glRasterPos3cv(coords());
-		gl_draw(&l, 1);
+		GL_Text::draw(&l, 1);
 	}
 	else {
 		glPointSize(firing ? 5.0f : 3.0f);
@@ -103,9 +106,9 @@ void Soma::draw_firing_letter(const Soma_Type *t, bool firing) const {
 }
 
 void Soma::draw_firing_value(std::string s, bool firing) const {
-	gl_font(firing ? SOMA_FIRING_FONT : SOMA_FONT, _soma_font_size);
+	GL_Text::font(firing ? SOMA_FIRING_FONT : SOMA_FONT, _soma_font_size);
 	glRasterPos3cv(coords());
-	gl_draw(s.c_str(), (int)s.length());
+	GL_Text::draw(s.c_str(), (int)s.length());
 }
 
 void Soma::draw_circled(const float *cv, const float *bgcv) const {
@@ -149,20 +152,22 @@ void Soma::draw_circled_firing(const Soma_Type *t, const float *cv, const float
 		wc[1] -= 4;
 		gluUnProject(wc[0], wc[1], wc[2], model_view, projection, viewport, &sc[0], &sc[1], &sc[2]);
 		glColor3fv(cv);
-		gl_font(firing ? SOMA_FIRING_FONT : SOMA_FONT, _soma_font_size);
+		GL_Text::font(firing ? SOMA_FIRING_FONT : SOMA_FONT, _soma_font_size);
 		glRasterPos3dv(sc);
-		gl_draw(&l, 1);
+		GL_Text::draw(&l, 1);
 		glEnable(GL_DEPTH_TEST);
 }
 
-void Soma::draw_fields(bool conn, const Brain_Model &bm) const {
-	glColor3fv(conn ? CONN_AXON_COLOR : AXON_COLOR);
+void Soma::draw_fields(Geometry_Batch &b, bool conn, const Brain_Model &bm) const {
+	// Neuritic fields may have been skipped when the model was loaded
+	if (!bm.num_fields()) { return; }
+	b.color(conn ? CONN_AXON_COLOR : AXON_COLOR);
 	for (size32_t i = 0; i < _num_axon_fields; i++) {
-		bm.field(_first_axon_field_index + i)->draw();
+		bm.field(_first_axon_field_index + i)->draw(b);
 	}
-	glColor3fv(conn ? CONN_DENDRITE_COLOR : DENDRITE_COLOR);
+	b.color(conn ? CONN_DENDRITE_COLOR : DENDRITE_COLOR);
 	for (size32_t i = 0; i < _num_den_fields; i++) {
-		bm.field(_first_den_field_index + i)->draw();
+		bm.field(_first_den_field_index + i)->draw(b);
 	}
 }
 
@@ -202,3 +207,12 @@ void Soma::read_from(Binary_Parser &bp, size32_t next_field_index) {
 	_first_den_field_index = next_field_index + _num_axon_fields;
 	initialize();
 }
+
+void Soma::write_to(Binary_Writer &bw) const {
+	// The same sequence that read_from(Binary_Parser &) parses, without its neuritic fields
+	bw.put_size8(_type_index);
+	bw.put_unsigned(_id);
+	bw.put_signed((int32_t)_coords[0]); bw.put_signed((int32_t)_coords[1]); bw.put_signed((int32_t)_coords[2]);
+	bw.put_size8(_num_axon_fields);
+	bw.put_size8(_num_den_fields);
+}
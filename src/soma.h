@@ -13,6 +13,8 @@ class Synapse;
 class Soma_Type;
 class Input_Parser;
 class Binary_Parser;
+class Binary_Writer;
+class Geometry_Batch;
 
 class Soma {
 private:
@@ -41,6 +43,7 @@ public:
 	inline size32_t first_axon_field_index(void) const { return _first_axon_field_index; }
 	inline size8_t num_den_fields(void) const { return _num_den_fields; }
 	inline size32_t first_den_field_index(void) const { return _first_den_field_index; }
+	inline void clear_fields(void) { _num_axon_fields = _num_den_fields = 0; }
 	inline size32_t num_axon_syns(void) const { return _num_axon_syns; }
 	inline size32_t first_axon_syn_index(void) const { return _first_axon_syn_index; }
 	void first_axon_syn(Synapse *ay, size32_t ai);
@@ -55,10 +58,11 @@ public:
 	void draw_circled(const float *cv, const float *bgcv) const;
 	void draw_circled_firing(const Soma_Type *t, const float *cv, const float *bgcv, bool firing,
 		const double model_view[16], const double projection[16], const int viewport[4]) const;
-	void draw_fields(bool conn, const Brain_Model &bm) const;
+	void draw_fields(Geometry_Batch &b, bool conn, const Brain_Model &bm) const;
 	void draw_for_selection(size32_t i) const;
 	void read_from(Input_Parser &ip, size32_t next_field_index);
 	void read_from(Binary_Parser &bp, size32_t next_field_index);
+	void write_to(Binary_Writer &bw) const;
 };
 
 #endif
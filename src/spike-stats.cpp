@@ -0,0 +1,229 @@
+#include <algorithm>
+
+#include "brain-model.h"
+#include "parallel.h"
+#include "spike-stats.h"
+
+Spike_Stats::Spike_Stats(const Brain_Model &bm, const std::vector<size32_t> &soma_indices, size32_t start,
+	size32_t stop, size32_t bin) : _model(bm), _soma_indices(soma_indices), _start(start), _stop(stop), _bin(bin),
+	_num_bins(0), _synchrony(0.0), _voltage_synchrony(0.0), _num_voltage_somas(0), _type_somas(), _type_spikes(),
+	_isi_counts(), _num_correlated(0), _correlograms() {
+	if (_stop < _start) { _stop = _start; }
+	size32_t n = _stop - _start + 1;
+	if (_bin < 1 || _bin > n) { _bin = n; }
+	_num_bins = n / _bin;
+}
+
+float Spike_Stats::type_hertz(size8_t t) const {
+	if (!_type_somas[t]) { return 0.0f; }
+	const Firing_Spikes *fd = _model.const_firing_spikes();
+	return (float)(_type_spikes[t] * fd->timescale() * 1000.0 / (_type_somas[t] * (double)(_stop - _start + 1)));
+}
+
+void Spike_Stats::compute_spike_stats() {
+	// Population synchrony is the variance over time of the population's mean binned spike count,
+	// relative to the mean of each soma's own variance over time (Golomb's chi-squared measure)
+	struct Partial {
+		std::vector<double> population;
+		double variance;
+		std::vector<size_t> type_somas, type_spikes, isi_counts;
+	};
+	const Firing_Spikes *fd = _model.const_firing_spikes();
+	size8_t nt = _model.num_types();
+	size_t ns = _soma_indices.size();
+	size_t nc = num_chunks(ns, 256);
+	std::vector<Partial> partials(nc);
+	parallel_chunks(ns, nc, [&](size_t begin, size_t end, size_t c) {
+		Partial &pt = partials[c];
+		pt.population.assign(_num_bins, 0.0);
+		pt.variance = 0.0;
+		pt.type_somas.assign(nt, 0);
+		pt.type_spikes.assign(nt, 0);
+		pt.isi_counts.assign(MAX_ISI_BINS, 0);
+		for (size_t k = begin; k < end; k++) {
+			size32_t index = _soma_indices[k];
+			size8_t t = _model.soma(index)->type_index();
+			pt.type_somas[t]++;
+			const size32_t *times = fd->spike_times(index);
+			size_t n = fd->num_spikes(index);
+			if (!n) { continue; }
+			const size32_t *first = std::lower_bound(times, times + n, _start);
+			const size32_t *last = std::upper_bound(first, times + n, _stop);
+			pt.type_spikes[t] += (size_t)(last - first);
+			// Spike times are sorted, so each bin's count is a run of consecutive spikes
+			double sum = 0.0, sum_sq = 0.0;
+			size32_t run_bin = NULL_INDEX, run_count = 0;
+			for (const size32_t *it = first; it != last; ++it) {
+				if (it != first) {
+					size_t b = (*it - *(it - 1)) / _bin;
+					pt.isi_counts[MIN(b, MAX_ISI_BINS - 1)]++;
+				}
+				size32_t b = (*it - _start) / _bin;
+				if (b >= _num_bins) { continue; }
+				pt.population[b] += 1.0;
+				if (b != run_bin) {
+					sum_sq += (double)run_count * run_count;
+					run_bin = b;
+					run_count = 0;
+				}
+				run_count++;
+				sum += 1.0;
+			}
+			sum_sq += (double)run_count * run_count;
+			double mean = sum / _num_bins;
+			pt.variance += sum_sq / _num_bins - mean * mean;
+		}
+	});
+	std::vector<double> population(_num_bins, 0.0);
+	double variance = 0.0;
+	_type_somas.assign(nt, 0);
+	_type_spikes.assign(nt, 0);
+	_isi_counts.assign(MAX_ISI_BINS, 0);
+	for (size_t c = 0; c < nc; c++) {
+		const Partial &pt = partials[c];
+		for (size32_t b = 0; b < _num_bins; b++) { population[b] += pt.population[b]; }
+		variance += pt.variance;
+		for (size8_t t = 0; t < nt; t++) {
+			_type_somas[t] += pt.type_somas[t];
+			_type_spikes[t] += pt.type_spikes[t];
+		}
+		for (size_t b = 0; b < MAX_ISI_BINS; b++) { _isi_counts[b] += pt.isi_counts[b]; }
+	}
+	_synchrony = 1.0;
+	if (!ns) { return; }
+	double sum = 0.0, sum_sq = 0.0;
+	for (size32_t b = 0; b < _num_bins; b++) {
+		double m = population[b] / ns;
+		sum += m;
+		sum_sq += m * m;
+	}
+	double mean = sum / _num_bins;
+	double population_variance = sum_sq / _num_bins - mean * mean;
+	double soma_variance = variance / ns;
+	if (soma_variance > 0.0) { _synchrony = population_variance / soma_variance; }
+}
+
+void Spike_Stats::compute_voltage_synchrony() {
+	// The same measure as for spikes, over the recorded membrane potentials (as in FindSynchrony.py)
+	_voltage_synchrony = 1.0;
+	_num_voltage_somas = 0;
+	if (!_model.has_voltages()) { return; }
+	const Voltages *vt = _model.const_voltages();
+	std::vector<size32_t> relatives;
+	for (std::vector<size32_t>::const_iterator it = _soma_indices.begin(); it != _soma_indices.end(); ++it) {
+		size32_t i = vt->active_soma_relative_index(*it);
+		if (vt->active_relative(i)) { relatives.push_back(i); }
+	}
+	std::sort(relatives.begin(), relatives.end());
+	size32_t nv = (size32_t)relatives.size();
+	_num_voltage_somas = nv;
+	if (!nv || _start > vt->max_time()) { return; }
+	size32_t stop = MIN(_stop, vt->max_time());
+	size32_t n_cycles = stop - _start + 1;
+	size_t nc = num_chunks(nv, 64);
+	std::vector<std::vector<double> > sums(nc);
+	std::vector<double> variances(nc, 0.0);
+	parallel_chunks(nv, nc, [&](size_t begin, size_t end, size_t c) {
+		// Step through time in the outer loop, since voltages are stored cycle by cycle
+		std::vector<double> &sum_v = sums[c];
+		sum_v.assign(n_cycles, 0.0);
+		std::vector<double> s(end - begin, 0.0), s2(end - begin, 0.0);
+		for (size32_t t = 0; t < n_cycles; t++) {
+			for (size_t k = begin; k < end; k++) {
+				double v = vt->voltage_relative(relatives[k], _start + t);
+				sum_v[t] += v;
+				s[k - begin] += v;
+				s2[k - begin] += v * v;
+			}
+		}
+		for (size_t k = 0; k < end - begin; k++) {
+			double mean = s[k] / n_cycles;
+			variances[c] += s2[k] / n_cycles - mean * mean;
+		}
+	});
+	double sum = 0.0, sum_sq = 0.0, variance = 0.0;
+	for (size32_t t = 0; t < n_cycles; t++) {
+		double m = 0.0;
+		for (size_t c = 0; c < nc; c++) { m += sums[c][t]; }
+		m /= nv;
+		sum += m;
+		sum_sq += m * m;
+	}
+	for (size_t c = 0; c < nc; c++) { variance += variances[c]; }
+	double mean = sum / n_cycles;
+	double population_variance = sum_sq / n_cycles - mean * mean;
+	double soma_variance = variance / nv;
+	if (soma_variance > 0.0) { _voltage_synchrony = population_variance / soma_variance; }
+}
+
+void Spike_Stats::compute_correlograms() {
+	// Count the lags from each spike of one soma to the nearby spikes of another, for each pair of somas
+	const Firing_Spikes *fd = _model.const_firing_spikes();
+	_num_correlated = MIN(_soma_indices.size(), MAX_CORRELATED_SOMAS);
+	size_t nl = 2 * MAX_LAG + 1;
+	_correlograms.assign(_num_correlated * _num_correlated * nl, 0);
+	std::vector<const size32_t *> firsts(_num_correlated), lasts(_num_correlated);
+	for (size_t i = 0; i < _num_correlated; i++) {
+		const size32_t *times = fd->spike_times(_soma_indices[i]);
+		size_t n = fd->num_spikes(_soma_indices[i]);
+		firsts[i] = n ? std::lower_bound(times, times + n, _start) : NULL;
+		lasts[i] = n ? std::upper_bound(firsts[i], times + n, _stop) : NULL;
+	}
+	size_t n_pairs = _num_correlated * _num_correlated;
+	parallel_chunks(n_pairs, num_chunks(n_pairs, 16), [&](size_t begin, size_t end, size_t) {
+		for (size_t pair = begin; pair < end; pair++) {
+			size_t i = pair / _num_correlated, j = pair % _num_correlated;
+			if (i >= j) { continue; }
+			size32_t *counts = &_correlograms[pair * nl];
+			const size32_t *lo = firsts[j];
+			for (const size32_t *a = firsts[i]; a != lasts[i]; ++a) {
+				while (lo != lasts[j] && *lo + MAX_LAG < *a) { ++lo; }
+				for (const size32_t *b = lo; b != lasts[j] && *b <= *a + MAX_LAG; ++b) {
+					counts[*b + MAX_LAG - *a]++;
+				}
+			}
+		}
+	});
+}
+
+void Spike_Stats::write_to(std::ofstream &ofs) const {
+	const Firing_Spikes *fd = _model.const_firing_spikes();
+	size8_t nt = _model.num_types();
+	ofs.setf(std::ios::fixed, std::ios::floatfield);
+	ofs.precision(4);
+	ofs << "# Population synchrony (firing spikes in " << _bin << "-cycle bins): " << _synchrony << "\n";
+	if (_model.has_voltages()) {
+		ofs << "# Population synchrony (voltages of " << _num_voltage_somas << " recorded somas): " <<
+			_voltage_synchrony << "\n";
+	}
+	ofs << "\n# Firing rates by type\n";
+	ofs << "# <type> <somas> <spikes> <hz>\n";
+	ofs.precision(2);
+	for (size8_t t = 0; t < nt; t++) {
+		if (!_type_somas[t]) { continue; }
+		ofs << _model.type(t)->name() << " " << _type_somas[t] << " " << _type_spikes[t] << " " << type_hertz(t) << "\n";
+	}
+	ofs << "\n# Inter-spike interval histogram\n";
+	ofs << "# <from> <to> <count>\n";
+	for (size_t b = 0; b < MAX_ISI_BINS; b++) {
+		ofs << (b * _bin) << " ";
+		if (b < MAX_ISI_BINS - 1) { ofs << ((b + 1) * _bin - 1); }
+		else { ofs << "-"; }
+		ofs << " " << _isi_counts[b] << "\n";
+	}
+	if (_num_correlated < 2) { return; }
+	ofs << "\n# Cross-correlograms of the first " << _num_correlated << " somas (spikes of the second soma at each lag "
+		"after spikes of the first, in cycles of " << (1.0f / fd->timescale()) << " ms)\n";
+	ofs << "# <id1> <id2>";
+	for (int lag = -(int)MAX_LAG; lag <= (int)MAX_LAG; lag++) { ofs << " <" << lag << ">"; }
+	ofs << "\n";
+	size_t nl = 2 * MAX_LAG + 1;
+	for (size_t i = 0; i < _num_correlated; i++) {
+		for (size_t j = i + 1; j < _num_correlated; j++) {
+			ofs << _model.soma(_soma_indices[i])->id() << " " << _model.soma(_soma_indices[j])->id();
+			const size32_t *counts = correlogram(i, j);
+			for (size_t l = 0; l < nl; l++) { ofs << " " << counts[l]; }
+			ofs << "\n";
+		}
+	}
+}
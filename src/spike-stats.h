@@ -0,0 +1,49 @@
+#ifndef SPIKE_STATS_H
+#define SPIKE_STATS_H
+
+#include <fstream>
+#include <vector>
+
+#include "utils.h"
+
+class Brain_Model;
+
+// Spike train statistics for a set of somas over a range of cycles, binned at a given width
+class Spike_Stats {
+public:
+	static const size_t MAX_ISI_BINS = 100;
+	static const size_t MAX_CORRELATED_SOMAS = 64;
+	static const size32_t MAX_LAG = 50;
+private:
+	const Brain_Model &_model;
+	std::vector<size32_t> _soma_indices;
+	size32_t _start, _stop, _bin;
+	size32_t _num_bins;
+	double _synchrony, _voltage_synchrony;
+	size32_t _num_voltage_somas;
+	std::vector<size_t> _type_somas, _type_spikes;
+	std::vector<size_t> _isi_counts;
+	size_t _num_correlated;
+	std::vector<size32_t> _correlograms;
+public:
+	Spike_Stats(const Brain_Model &bm, const std::vector<size32_t> &soma_indices, size32_t start, size32_t stop,
+		size32_t bin);
+	inline size_t num_somas(void) const { return _soma_indices.size(); }
+	inline double synchrony(void) const { return _synchrony; }
+	inline double voltage_synchrony(void) const { return _voltage_synchrony; }
+	inline size32_t num_voltage_somas(void) const { return _num_voltage_somas; }
+	inline size_t type_somas(size8_t t) const { return _type_somas[t]; }
+	inline size_t type_spikes(size8_t t) const { return _type_spikes[t]; }
+	float type_hertz(size8_t t) const;
+	inline const std::vector<size_t> &isi_counts(void) const { return _isi_counts; }
+	inline size_t num_correlated(void) const { return _num_correlated; }
+	inline const size32_t *correlogram(size_t i, size_t j) const {
+		return &_correlograms[(i * _num_correlated + j) * (2 * MAX_LAG + 1)];
+	}
+	void compute_spike_stats(void);
+	void compute_voltage_synchrony(void);
+	void compute_correlograms(void);
+	void write_to(std::ofstream &ofs) const;
+};
+
+#endif
@@ -200,37 +200,16 @@ void Summary_Dialog::refresh_body(const Synapse *y, size32_t index) {
 
 void Summary_Dialog::refresh_body(const Clip_Volume *v) {
 	std::ostringstream ss;
-	size32_t ncs = 0, ncy = 0;
 	ss.imbue(std::locale(""));
 	ss.setf(std::ios::fixed, std::ios::floatfield);
 	ss.precision(0);
 	size8_t nt = _model->num_types();
-	size_t *type_counts = new(std::nothrow) size_t[nt * nt + nt]();
-	if (type_counts == NULL) {
-		_body->copy_label("Could not summarize model!\nNot enough memory was available.");
-		return;
-	}
 	// Show model file name and size
 	_model->print(ss);
 	ss << ":";
-	// Count somas in clip volume
-	size32_t ns = _model->num_somas();
-	size32_t ny = _model->num_synapses();
-	for (size32_t i = 0; i < ns; i++) {
-		Soma *s = _model->soma(i);
-		if (v && !v->contains(s->coords())) { continue; }
-		size16_t index = (size16_t)s->type_index() * (nt + 1);
-		type_counts[index]++;
-		ncs++;
-		// Count soma's axonal connections
-		const Synapse *y = NULL;
-		for (size32_t a_index = s->first_axon_syn_index(); a_index < ny; a_index = y->next_axon_syn_index()) {
-			y = _model->synapse(a_index);
-			Soma *o = _model->soma(y->den_soma_index());
-			type_counts[index + o->type_index() + 1]++;
-			ncy++;
-		}
-	}
+	// Count somas and synapses in clip volume
+	const Conn_Counts &cc = _model->conn_counts(v);
+	size_t ncs = cc.num_somas, ncy = cc.num_synapses;
 	// Show total soma and synapse counts
 	ss << "\n" << ncs << " somas and " << ncy << " synapses";
 	if (v) { ss << " in clip volume"; }
@@ -242,9 +221,7 @@ void Summary_Dialog::refresh_body(const Clip_Volume *v) {
 	ss << ":";
 	if (!ncs) { ss << "\nNone"; }
 	for (size8_t i = 0; i < nt && ncs > 0; i++) {
-		size16_t r = (size16_t)i * (nt + 1);
-		// False positive "C6001: Using uninitialized memory" error with Visual Studio 2013 code analysis
-		size_t c = type_counts[r];
+		size_t c = cc.soma_counts[i];
 		if (!c) { continue; }
 		ss << "\n " << BULLET << " " << c << " " << _model->type(i)->name();
 		double pct = c * 100.0 / ncs;
@@ -255,7 +232,7 @@ void Summary_Dialog::refresh_body(const Clip_Volume *v) {
 		ss.precision(0);
 		// Show soma's axonal connections by type
 		for (size8_t j = 0; j < nt; j++) {
-			size_t cy = type_counts[r + j + 1];
+			size_t cy = cc.syn_count(i, j);
 			if (!cy) { continue; }
 			ss << "\n    " << SUB_BULLET << " " << cy << " connections to " << _model->type(j)->name();
 			pct = cy * 100.0 / ncy;
@@ -267,7 +244,6 @@ void Summary_Dialog::refresh_body(const Clip_Volume *v) {
 		}
 	}
 	_body->copy_label(ss.str().c_str());
-	delete [] type_counts;
 }
 
 void Summary_Dialog::refresh() {
@@ -7,8 +7,10 @@
 #include "utils.h"
 #include "input-parser.h"
 #include "binary-parser.h"
+#include "binary-writer.h"
 #include "soma.h"
 #include "brain-model.h"
+#include "geometry-batch.h"
 #include "synapse.h"
 
 Synapse::Synapse() : _axon_soma_index(NULL_INDEX), _den_soma_index(NULL_INDEX), _next_axon_syn_index(NULL_INDEX),
@@ -43,13 +45,18 @@ void Synapse::draw_marked(const float *cv, const float *bgcv) const {
 	glEnable(GL_DEPTH_TEST);
 }
 
-void Synapse::draw_conn(const Soma *a, const Soma *d, bool to_axon, bool to_via, bool to_syn, bool to_den) const {
-	glBegin(GL_LINE_STRIP);
-	if (to_axon) { glVertex3cv(a->coords()); }
-	if (to_via) { glVertex3cv(_via_coords); }
-	if (to_syn) { glVertex3cv(_coords); }
-	if (to_den) { glVertex3cv(d->coords()); }
-	glEnd();
+void Synapse::draw_conn(Geometry_Batch &b, const Soma *a, const Soma *d, bool to_axon, bool to_via, bool to_syn,
+	bool to_den) const {
+	// Draw the line strip through the chosen points as separate segments
+	const coord_t *strip[4];
+	size_t n = 0;
+	if (to_axon) { strip[n++] = a->coords(); }
+	if (to_via) { strip[n++] = _via_coords; }
+	if (to_syn) { strip[n++] = _coords; }
+	if (to_den) { strip[n++] = d->coords(); }
+	for (size_t i = 1; i < n; i++) {
+		b.line(strip[i-1], strip[i]);
+	}
 }
 
 void Synapse::draw_for_selection(size32_t i) const {
@@ -102,3 +109,17 @@ void Synapse::read_from(Binary_Parser &bp, const Brain_Model &bm) {
 		_via_coords[0] = _coords[0]; _via_coords[1] = _coords[1]; _via_coords[2] = _coords[2];
 	}
 }
+
+void Synapse::write_to(Binary_Writer &bw, const Brain_Model &bm, size32_t index) const {
+	// The same sequence that read_from(Binary_Parser &, const Brain_Model &) parses
+	bw.put_unsigned(index);
+	bool via = has_via();
+	bw.put_bool(via);
+	bw.put_unsigned(bm.soma(_axon_soma_index)->id());
+	bw.put_unsigned(bm.soma(_den_soma_index)->id());
+	if (via) {
+		bw.put_signed((int32_t)_via_coords[0]); bw.put_signed((int32_t)_via_coords[1]);
+		bw.put_signed((int32_t)_via_coords[2]);
+	}
+	bw.put_signed((int32_t)_coords[0]); bw.put_signed((int32_t)_coords[1]); bw.put_signed((int32_t)_coords[2]);
+}
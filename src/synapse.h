@@ -6,7 +6,9 @@
 class Soma;
 class Input_Parser;
 class Binary_Parser;
+class Binary_Writer;
 class Brain_Model;
+class Geometry_Batch;
 
 class Synapse {
 private:
@@ -27,10 +29,12 @@ public:
 		_coords[2] != _via_coords[2]; }
 	void draw(void) const;
 	void draw_marked(const float *cv, const float *bgcv) const;
-	void draw_conn(const Soma *a, const Soma *d, bool to_axon, bool to_via, bool to_syn, bool to_den) const;
+	void draw_conn(Geometry_Batch &b, const Soma *a, const Soma *d, bool to_axon, bool to_via, bool to_syn,
+		bool to_den) const;
 	void draw_for_selection(size32_t i) const;
 	void read_from(Input_Parser &ip, const Brain_Model &bm);
 	void read_from(Binary_Parser &bp, const Brain_Model &bm);
+	void write_to(Binary_Writer &bw, const Brain_Model &bm, size32_t index) const;
 };
 
 #endif
@@ -19,6 +19,7 @@
 #include <FL/fl_draw.H>
 #include <FL/Fl_Tooltip.H>
 #include <FL/filename.H>
+#include <FL/fl_utf8.h>
 #pragma warning(pop)
 
 #include "utils.h"
@@ -31,6 +32,7 @@
 #include "widgets.h"
 #include "overview-area.h"
 #include "model-area.h"
+#include "model-loader.h"
 #include "help-window.h"
 #include "modal-dialog.h"
 #include "option-dialogs.h"
@@ -40,9 +42,13 @@
 #include "voltage-graph-window.h"
 #include "input-parser.h"
 #include "binary-parser.h"
+#include "binary-writer.h"
+#include "mapped-file.h"
 #include "firing-spikes.h"
 #include "voltages.h"
 #include "weights.h"
+#include "parallel.h"
+#include "profiler.h"
 #include "viz-window.h"
 
 #ifdef _WIN32
@@ -58,8 +64,11 @@
 #include "viz-16.xpm"
 #endif
 
-// Hz: {1, 2, 5, 10, 20, 25, 33, 50, 67, 100}
-const double Viz_Window::FIRING_SPEED_TIMEOUTS[10] = {1.0, 0.5, 0.2, 0.1, 0.05, 0.04, 0.03, 0.02, 0.015, 0.01};
+// Cycles per second to play at for each speed
+const double Viz_Window::FIRING_SPEED_RATES[10] = {1.0, 2.0, 5.0, 10.0, 20.0, 25.0, 100.0 / 3.0, 50.0, 200.0 / 3.0, 100.0};
+
+// How often to show the synapses and gap junctions that have been read while a model is loading
+const double Viz_Window::MODEL_LOADER_TIMEOUT = 0.25;
 
 static int text_width(const char *l, int pad = 0) {
 	int lw = 0, lh = 0;
@@ -68,7 +77,8 @@ static int text_width(const char *l, int pad = 0) {
 }
 
 Viz_Window::Viz_Window(int x, int y, int w, int h, const char *) : Fl_Double_Window(x, y, w, h, PROGRAM_NAME),
-	_shown_selected(0), _playing(false), _wx(x), _wy(y), _ww(w), _wh(h)
+	_model_loader(NULL), _model_filename(), _model_cache_filename(), _model_cached(false), _shown_selected(0),
+	_playing(false), _playback(), _wx(x), _wy(y), _ww(w), _wh(h)
 #ifdef __LINUX__
 	, _icon_pixmap(), _icon_mask()
 #endif
@@ -384,6 +394,15 @@ Viz_Window::Viz_Window(int x, int y, int w, int h, const char *) : Fl_Double_Win
 	gw -= _firing_select_top->w() + 5;
 	Spacer *firing_spikes_spacer1 = new Spacer(fx+gw-2, fy, 2, wgt_h);
 	gw -= firing_spikes_spacer1->w() + 5;
+	_firing_next_selected = new OS_Repeat_Button(fx+gw-wgt_h, fy, wgt_h, wgt_h);
+	gw -= _firing_next_selected->w() + 5;
+	_firing_prev_selected = new OS_Repeat_Button(fx+gw-wgt_h, fy, wgt_h, wgt_h);
+	gw -= _firing_prev_selected->w() + 5;
+	Spacer *firing_spikes_spacer3 = new Spacer(fx+gw-2, fy, 2, wgt_h);
+	gw -= firing_spikes_spacer3->w() + 5;
+	wgt_w = text_width("Statistics", btn_pad);
+	_firing_report_stats = new OS_Button(fx+gw-wgt_w, fy, wgt_w, wgt_h, "Statistics");
+	gw -= _firing_report_stats->w() + 5;
 	wgt_w = text_width("Average", btn_pad);
 	_firing_report_average = new OS_Button(fx+gw-wgt_w, fy, wgt_w, wgt_h, "Average");
 	gw -= _firing_report_average->w() + 5;
@@ -499,6 +518,7 @@ Viz_Window::Viz_Window(int x, int y, int w, int h, const char *) : Fl_Double_Win
 	_config_load_chooser = new Fl_Native_File_Chooser(Fl_Native_File_Chooser::BROWSE_FILE);
 	_config_save_chooser = new Fl_Native_File_Chooser(Fl_Native_File_Chooser::BROWSE_SAVE_FILE);
 	_text_report_chooser = new Fl_Native_File_Chooser(Fl_Native_File_Chooser::BROWSE_SAVE_FILE);
+	_trace_chooser = new Fl_Native_File_Chooser(Fl_Native_File_Chooser::BROWSE_SAVE_FILE);
 	_help_window = new Help_Window(24, 24, 640, 480, PROGRAM_NAME " Manual");
 	_about_dialog = new Modal_Dialog(this, "About " PROGRAM_NAME, Modal_Dialog::PROGRAM_ICON);
 	_success_dialog = new Modal_Dialog(this, "Success", Modal_Dialog::SUCCESS_ICON);
@@ -508,6 +528,8 @@ Viz_Window::Viz_Window(int x, int y, int w, int h, const char *) : Fl_Double_Win
 	_waiting_dialog = new Waiting_Dialog(this, "Progress...");
 	_report_somas_dialog = new Report_Somas_Dialog("Report Selected Somas");
 	_report_averages_dialog = new Report_Averages_Dialog("Report Average Frequencies");
+	_report_stats_dialog = new Report_Averages_Dialog("Report Spike Statistics", "Bin size:");
+	_export_animation_dialog = new Export_Animation_Dialog("Export Animation");
 	_summary_dialog = new Summary_Dialog("Summary");
 	// Initialize window
 	resizable(_model_area);
@@ -548,7 +570,8 @@ Viz_Window::Viz_Window(int x, int y, int w, int h, const char *) : Fl_Double_Win
 			{"Unload Wei&ghts" VWP, 0, (Fl_Callback *)unload_weights_cb, this, FL_MENU_DIVIDER, VW_MENU_STYLE},
 			{"&Report Selected Somas..." VWP, FL_SHIFT + '8', (Fl_Callback *)report_selected_cb, this, 0, VW_MENU_STYLE},
 			{"Report Selected S&ynapses..." VWP, FL_SHIFT + '7', (Fl_Callback *)report_synapses_cb, this, 0, VW_MENU_STYLE},
-			{"Report Mar&ked Synapses..." VWP, FL_SHIFT + '6', (Fl_Callback *)report_marked_cb, this, FL_MENU_DIVIDER,
+			{"Report Mar&ked Synapses..." VWP, FL_SHIFT + '6', (Fl_Callback *)report_marked_cb, this, 0, VW_MENU_STYLE},
+			{"Save Profiler &Trace..." VWP, 0, (Fl_Callback *)save_profiler_trace_cb, this, FL_MENU_DIVIDER,
 				VW_MENU_STYLE},
 			{"&Export Image..." VWP, FL_COMMAND + 'p', (Fl_Callback *)export_image_cb, this, 0, VW_MENU_STYLE},
 #ifdef __APPLE__
@@ -608,6 +631,8 @@ Viz_Window::Viz_Window(int x, int y, int w, int h, const char *) : Fl_Double_Win
 				(opts.show_bulletin() ? FL_MENU_VALUE : 0), VW_MENU_STYLE},
 			{"Show F&PS" VWP, FL_SHIFT + '3', (Fl_Callback *)show_fps_cb, this, FL_MENU_TOGGLE |
 				(opts.show_fps() ? FL_MENU_VALUE : 0), VW_MENU_STYLE},
+			{"Show Profil&er" VWP, FL_COMMAND + FL_SHIFT + '3', (Fl_Callback *)show_profiler_cb, this, FL_MENU_TOGGLE |
+				(opts.show_profiler() ? FL_MENU_VALUE : 0), VW_MENU_STYLE},
 			{"&Invert Background" VWP, FL_COMMAND + FL_SHIFT + 'i', (Fl_Callback *)invert_background_cb, this,
 				FL_MENU_TOGGLE | (opts.invert_background() ? FL_MENU_VALUE : 0) | FL_MENU_DIVIDER, VW_MENU_STYLE},
 			{"Su&mmary..." VWP, FL_SHIFT + '/', (Fl_Callback *)summary_cb, this, FL_MENU_DIVIDER, VW_MENU_STYLE},
@@ -1218,9 +1243,18 @@ Viz_Window::Viz_Window(int x, int y, int w, int h, const char *) : Fl_Double_Win
 	_firing_cycle_length->align(FL_ALIGN_RIGHT | FL_ALIGN_INSIDE | FL_ALIGN_CLIP); // right-justified
 	_firing_report_current->callback((Fl_Callback *)firing_report_current_cb, this);
 	_firing_report_average->callback((Fl_Callback *)firing_report_average_cb, this);
+	_firing_report_stats->callback((Fl_Callback *)firing_report_stats_cb, this);
+	_firing_prev_selected->image(PREVIOUS_SELECTED_ICON);
+	_firing_prev_selected->deimage(PREVIOUS_SELECTED_DISABLED_ICON);
+	_firing_prev_selected->tooltip("Previous Selected Spike");
+	_firing_prev_selected->callback((Fl_Callback *)firing_prev_selected_cb, this);
+	_firing_next_selected->image(NEXT_SELECTED_ICON);
+	_firing_next_selected->deimage(NEXT_SELECTED_DISABLED_ICON);
+	_firing_next_selected->tooltip("Next Selected Spike");
+	_firing_next_selected->callback((Fl_Callback *)firing_next_selected_cb, this);
 	_firing_select_top->callback((Fl_Callback *)firing_select_top_cb, this);
 	_firing_select_top_spinner->type(FL_INT_INPUT);
-	_firing_select_top_spinner->range(1.0, (double)Model_State::MAX_SELECTED);
+	_firing_select_top_spinner->range(1.0, 1.0);
 	_firing_select_top_spinner->step(1.0);
 	_firing_select_top_spinner->value(5.0);
 	_voltages_count->align(FL_ALIGN_RIGHT | FL_ALIGN_INSIDE | FL_ALIGN_CLIP); // right-justified
@@ -1283,17 +1317,17 @@ Viz_Window::Viz_Window(int x, int y, int w, int h, const char *) : Fl_Double_Win
 	_model_chooser->filter("Model Files\t*.{vbm,vbm.gz,txt.gz}\nBinary Model Files\t*.vbm\nText Model Files\t*.txt\n"
 		"Compressed Model Files\t*.{vbm.gz,txt.gz}\nAll Model Files\t*.{vbm,txt,vbm.gz,txt.gz}\n");
 	_firing_chooser->title("Load Firing Spikes");
-	_firing_chooser->filter("All Firing Spike Files\t*.{txt,txt.gz}\nText Firing Spike Files\t*.txt\n"
-		"Compressed Firing Spike Files\t*.txt.gz\n");
+	_firing_chooser->filter("All Firing Spike Files\t*.{txt,txt.gz,vbf}\nText Firing Spike Files\t*.txt\n"
+		"Compressed Firing Spike Files\t*.txt.gz\nBinary Firing Spike Files\t*.vbf\n");
 	_voltages_chooser->title("Load Voltages");
-	_voltages_chooser->filter("All Voltage Files\t*.{txt,txt.gz}\nText Voltage Files\t*.txt\n"
-		"Compressed Voltage Files\t*.txt.gz\n");
+	_voltages_chooser->filter("All Voltage Files\t*.{txt,txt.gz,vbv}\nText Voltage Files\t*.txt\n"
+		"Compressed Voltage Files\t*.txt.gz\nBinary Voltage Files\t*.vbv\n");
 	_weights_chooser->title("Load Weights");
-	_weights_chooser->filter("All Weight Files\t*.{txt,txt.gz}\nText Weight Files\t*.txt\n"
-		"Compressed Weight Files\t*.txt.gz\n");
+	_weights_chooser->filter("All Weight Files\t*.{txt,txt.gz,vbw}\nText Weight Files\t*.txt\n"
+		"Compressed Weight Files\t*.txt.gz\nBinary Weight Files\t*.vbw\n");
 	_prunings_chooser->title("Load Prunings");
-	_prunings_chooser->filter("All Pruning Files\t*.{txt,txt.gz}\nText Pruning Files\t*.txt\n"
-		"Compressed Pruning Files\t*.txt.gz\n");
+	_prunings_chooser->filter("All Pruning Files\t*.{txt,txt.gz,vbw}\nText Pruning Files\t*.txt\n"
+		"Compressed Pruning Files\t*.txt.gz\nBinary Pruning Files\t*.vbw\n");
 	_image_chooser->title("Export Image");
 	_image_chooser->filter(Image::FILE_CHOOSER_FILTER);
 	_image_chooser->preset_file("viz_screenshot.png");
@@ -1310,6 +1344,9 @@ Viz_Window::Viz_Window(int x, int y, int w, int h, const char *) : Fl_Double_Win
 	_text_report_chooser->title("Save Report");
 	_text_report_chooser->filter("Text File\t*.txt\n");
 	_text_report_chooser->preset_file("viz_report.txt");
+	_trace_chooser->title("Save Profiler Trace");
+	_trace_chooser->filter("Chrome Trace File\t*.json\n");
+	_trace_chooser->preset_file("viz_trace.json");
 	// Initialize help window
 	_help_window->file("help.html");
 	// Initialize dialogs
@@ -1426,10 +1463,8 @@ void Viz_Window::refresh_model_file(void) {
 		ss.str("");
 		ss << ns << " soma" << (ns == 1 ? "" : "s");
 		_soma_count->copy_label(ss.str().c_str());
-		size32_t ny = _model_area->model().num_synapses();
-		ss.str("");
-		ss << ny << " synapse" << (ny == 1 ? "" : "s");
-		_synapse_count->copy_label(ss.str().c_str());
+		refresh_synapse_count();
+		refresh_connectivity();
 		// Refresh soma ID selector
 		refresh_selected();
 		redraw();
@@ -1500,12 +1535,9 @@ void Viz_Window::refresh_firing_spikes() {
 		// Refresh display choice wizard
 		_display_wizard->value(_display_firing_group);
 		// Refresh firing spikes rate
-		ss.precision(1);
-		ss.str("");
-		size32_t nc = fd->num_cycles();
-		ss << nc << " cycle" << (nc != 1 ? "s" : "") << "; ";
-		ss << (1.0f / fd->timescale()) << " ms/cycle";
-		_firing_cycle_length->copy_label(ss.str().c_str());
+		refresh_playback_rate();
+		// Refresh top firing soma count spinner
+		_firing_select_top_spinner->range(1.0, (double)bm.num_somas());
 		if (!contains(_simulation_bar)) {
 			// Refresh firing spikes
 			double t = (double)fd->start_time(0);
@@ -1623,6 +1655,8 @@ void Viz_Window::refresh_selected(bool show_last) {
 		_report_synapses->deactivate();
 		_report_selected->deactivate();
 		_deselect_shown->deactivate();
+		_firing_prev_selected->deactivate();
+		_firing_next_selected->deactivate();
 		_weights_prev_selected->deactivate();
 		_weights_next_selected->deactivate();
 		_selected_count->reset_label();
@@ -1635,9 +1669,12 @@ void Viz_Window::refresh_selected(bool show_last) {
 		_fetch_select_id->activate();
 		_fetch_axon_id->activate();
 		_fetch_den_id->activate();
-		_report_synapses->activate();
+		if (_model_area->const_model().connected()) { _report_synapses->activate(); }
+		else { _report_synapses->deactivate(); }
 		_report_selected->activate();
 		_deselect_shown->activate();
+		_firing_prev_selected->activate();
+		_firing_next_selected->activate();
 		_weights_prev_selected->activate();
 		_weights_next_selected->activate();
 		const Brain_Model &bm = _model_area->const_model();
@@ -1712,6 +1749,26 @@ void Viz_Window::refresh_selected_sim_data() {
 	_selected_voltage->copy_label(ss.str().c_str());
 }
 
+void Viz_Window::refresh_playback_rate() {
+	const Firing_Spikes *fd = _model_area->const_model().const_firing_spikes();
+	if (!fd) { return; }
+	std::ostringstream ss;
+	ss.imbue(std::locale(""));
+	ss.setf(std::ios::fixed, std::ios::floatfield);
+	ss.precision(1);
+	if (_playing && _playback.measured()) {
+		// Report the achieved rate while playing, and how many cycles were skipped to keep up
+		ss << _playback.cycle_rate() << " cycles/s; " << _playback.dropped() << " skipped";
+	}
+	else {
+		size32_t nc = fd->num_cycles();
+		ss << nc << " cycle" << (nc != 1 ? "s" : "") << "; ";
+		ss << (1.0f / fd->timescale()) << " ms/cycle";
+	}
+	_firing_cycle_length->copy_label(ss.str().c_str());
+	_firing_cycle_length->redraw();
+}
+
 void Viz_Window::refresh_config() {
 	// Refresh sidebar
 	_type_choice->clear();
@@ -1790,7 +1847,44 @@ void Viz_Window::refresh_config() {
 	}
 }
 
+void Viz_Window::refresh_synapse_count() {
+	std::ostringstream ss;
+	ss.imbue(std::locale(""));
+	ss.setf(std::ios::fixed, std::ios::floatfield);
+	ss.precision(0);
+	size32_t ny = _model_area->const_model().num_synapses();
+	size32_t nt = _model_loader ? MAX(_model_loader->num_synapses(), ny) : ny;
+	if (nt > ny) { ss << ny << " of "; }
+	ss << nt << " synapse" << (nt == 1 ? "" : "s");
+	_synapse_count->copy_label(ss.str().c_str());
+}
+
+void Viz_Window::refresh_connectivity() {
+	// Features that need all of the synapses are disabled until they have been read
+	if (_model_area->const_model().connected()) {
+		_select_syn_count->activate();
+		_report_syn_count->activate();
+		_mark_conn_paths->activate();
+		_select_conn_paths->activate();
+		_report_conn_paths->activate();
+	}
+	else {
+		_select_syn_count->deactivate();
+		_report_syn_count->deactivate();
+		_mark_conn_paths->deactivate();
+		_select_conn_paths->deactivate();
+		_report_conn_paths->deactivate();
+	}
+}
+
 void Viz_Window::summary_dialog() {
+	// The model's connection counts need all of the synapses
+	if (!_model_area->const_model().connected()) {
+		std::string msg = "The model's synapses are still loading!";
+		_warning_dialog->message(msg);
+		_warning_dialog->show(this);
+		return;
+	}
 	bool clipped = _model_area->const_state().clipped() && _model_area->draw_options().only_show_clipped();
 	const Clip_Volume *v = clipped ? &_model_area->const_state().const_clip_volume() : NULL;
 	_summary_dialog->show(this, v);
@@ -1813,69 +1907,75 @@ static bool ends_with(std::string const &s, std::string const &end) {
 	return si.compare(si.length() - end.length(), end.length(), end) == 0;
 }
 
-bool Viz_Window::open_model(const char *filename) {
+// A text file's binary cache keeps the text file's whole name, so it cannot collide with another file's cache
+// or overwrite a binary file of the user's
+static std::string binary_cache_filename(const char *filename, const char *ext) {
+	return std::string(filename) + ext;
+}
+
+bool Viz_Window::open_model(const char *filename, bool use_cache) {
+	Profiler::Scope scope("open model");
 	const char *basename = fl_filename_name(filename);
+	// Stop loading the previous model, if any
+	stop_loading_model();
 	// Unload related files, if any
 	unload_weights_cb(NULL, this);
 	unload_voltages_cb(NULL, this);
 	unload_firing_spikes_cb(NULL, this);
 	// Open and parse model file
-	Read_Status status;
-	if (ends_with(basename, ".vbm.gz")) {
-		// Open chosen file as compressed binary
-		Gzip_Binary_Parser gbp(filename);
-		if (!gbp.good()) {
-			std::string msg = "Could not open ";
-			msg = msg + basename + "!";
-			_error_dialog->message(msg);
-			_error_dialog->show(this);
-			return false;
+	Read_Status status = FAILURE;
+	bool binary = ends_with(basename, ".vbm") || ends_with(basename, ".vbm.gz");
+	// Use the binary cache of a text file instead, if it is up to date
+	std::string cache_filename = binary_cache_filename(filename, ".model-cache.vbm");
+	time_t cache_time = modified_time(cache_filename.c_str());
+	bool cached = use_cache && !binary && cache_time && cache_time >= modified_time(filename);
+	if (cached) {
+		Binary_Parser *bp = new Binary_Parser(cache_filename.c_str());
+		if (bp->good()) {
+			_model_loader = new Model_Loader(_model_area->model(), bp);
+			// Show progress
+			_progress_dialog->title("Opening...");
+			_progress_dialog->show(this);
+			// Parse cached model file
+			status = _model_area->read_model_from(*_model_loader, _progress_dialog);
+			_model_area->model().filename(basename);
+			_progress_dialog->hide();
 		}
-		// Show progress
-		_progress_dialog->title("Opening...");
-		_progress_dialog->show(this);
-		// Parse model file
-		status = _model_area->read_model_from(gbp, _progress_dialog);
-		_progress_dialog->hide();
-	}
-	else if (ends_with(basename, ".txt.gz")) {
-		// Open chosen file as compressed text
-		Gzip_Input_Parser gip(filename);
-		if (!gip.good()) {
-			std::string msg = "Could not open ";
-			msg = msg + basename + "!";
-			_error_dialog->message(msg);
-			_error_dialog->show(this);
-			return false;
+		else {
+			delete bp;
 		}
-		// Show progress
-		_progress_dialog->title("Opening...");
-		_progress_dialog->show(this);
-		// Parse model file
-		status = _model_area->read_model_from(gip, _progress_dialog);
-		_progress_dialog->hide();
-	}
-	else if (ends_with(basename, ".vbm")) {
-		// Open chosen file as binary
-		Binary_Parser bp(filename);
-		if (!bp.good()) {
-			std::string msg = "Could not open ";
-			msg = msg + basename + "!";
-			_error_dialog->message(msg);
-			_error_dialog->show(this);
-			return false;
+		// Parse the text file after all if the cache is unusable
+		cached = status == SUCCESS || status == CANCELED;
+		if (!cached) { stop_loading_model(); }
+	}
+	if (!cached) {
+		bool good = false;
+		if (ends_with(basename, ".vbm.gz")) {
+			// Open chosen file as compressed binary
+			Gzip_Binary_Parser *gbp = new Gzip_Binary_Parser(filename);
+			good = gbp->good();
+			_model_loader = new Model_Loader(_model_area->model(), gbp);
 		}
-		// Show progress
-		_progress_dialog->title("Opening...");
-		_progress_dialog->show(this);
-		// Parse model file
-		status = _model_area->read_model_from(bp, _progress_dialog);
-		_progress_dialog->hide();
-	}
-	else {
-		// Open chosen file as text
-		Input_Parser ip(filename);
-		if (!ip.good()) {
+		else if (ends_with(basename, ".txt.gz")) {
+			// Open chosen file as compressed text
+			Gzip_Input_Parser *gip = new Gzip_Input_Parser(filename);
+			good = gip->good();
+			_model_loader = new Model_Loader(_model_area->model(), gip);
+		}
+		else if (ends_with(basename, ".vbm")) {
+			// Open chosen file as binary
+			Binary_Parser *bp = new Binary_Parser(filename);
+			good = bp->good();
+			_model_loader = new Model_Loader(_model_area->model(), bp);
+		}
+		else {
+			// Open chosen file as text
+			Input_Parser *ip = new Input_Parser(filename);
+			good = ip->good();
+			_model_loader = new Model_Loader(_model_area->model(), ip);
+		}
+		if (!good) {
+			stop_loading_model();
 			std::string msg = "Could not open ";
 			msg = msg + basename + "!";
 			_error_dialog->message(msg);
@@ -1886,16 +1986,23 @@ bool Viz_Window::open_model(const char *filename) {
 		_progress_dialog->title("Opening...");
 		_progress_dialog->show(this);
 		// Parse model file
-		status = _model_area->read_model_from(ip, _progress_dialog);
+		status = _model_area->read_model_from(*_model_loader, _progress_dialog);
 		_progress_dialog->hide();
 	}
 	if (status != SUCCESS) {
+		stop_loading_model();
 		std::string msg = read_status_message(status, basename);
 		_error_dialog->message(msg);
 		_error_dialog->show(this);
 		close_model_cb(NULL, this);
 		return false;
 	}
+	// Show the somas while the synapses and gap junctions are read in the background, and cache a text file
+	// as binary for faster reopening once it is read
+	_model_filename = filename;
+	_model_cache_filename = !binary ? cache_filename : "";
+	_model_cached = cached;
+	Fl::add_timeout(MODEL_LOADER_TIMEOUT, (Fl_Timeout_Handler)model_loader_cb, this);
 	// Open default configuration file
 	std::ifstream ifs(DEFAULT_CONFIG_FILE);
 	bool cfg_opened = ifs.good();
@@ -1915,6 +2022,75 @@ bool Viz_Window::open_model(const char *filename) {
 	return true;
 }
 
+bool Viz_Window::finish_loading_model() {
+	Profiler::Scope scope("finish loading model");
+	if (!_model_loader) { return _model_area->opened(); }
+	Fl::remove_timeout((Fl_Timeout_Handler)model_loader_cb, this);
+	// Show progress while waiting for the rest of the model
+	_progress_dialog->title("Opening...");
+	_progress_dialog->message("Parsing synapses and gap junctions...");
+	_progress_dialog->canceled(false);
+	_progress_dialog->show(this);
+	while (!_model_loader->done()) {
+		_progress_dialog->progress(_model_loader->progress());
+		Fl::wait(POLL_INTERVAL_MS / 1000.0);
+		if (_progress_dialog->canceled()) {
+			// Keep loading in the background
+			_progress_dialog->hide();
+			Fl::add_timeout(MODEL_LOADER_TIMEOUT, (Fl_Timeout_Handler)model_loader_cb, this);
+			return false;
+		}
+	}
+	_progress_dialog->hide();
+	return finished_loading_model();
+}
+
+bool Viz_Window::finished_loading_model() {
+	Profiler::Scope scope("finished loading model");
+	// Publish the rest of the synapses and gap junctions, and index them
+	Read_Status status = _model_loader->finish();
+	delete _model_loader;
+	_model_loader = NULL;
+	if (status != SUCCESS) {
+		if (_model_cached) {
+			// Parse the text file after all if the cache is unusable
+			fl_unlink(_model_cache_filename.c_str());
+			std::string filename = _model_filename;
+			open_model(filename.c_str(), false);
+			return false;
+		}
+		std::string msg = read_status_message(status, fl_filename_name(_model_filename.c_str()));
+		_error_dialog->message(msg);
+		_error_dialog->show(this);
+		close_model_cb(NULL, this);
+		return false;
+	}
+	if (!_model_cached && !_model_cache_filename.empty()) {
+		// Convert the text file to binary and cache it for faster reopening
+		Binary_Writer bw(_model_cache_filename.c_str());
+		if (bw.good()) {
+			_progress_dialog->title("Caching...");
+			_progress_dialog->show(this);
+			if (!_model_area->model().write_to(bw, false, _progress_dialog)) {
+				bw.close();
+				fl_unlink(_model_cache_filename.c_str());
+			}
+			_progress_dialog->hide();
+		}
+	}
+	refresh_synapse_count();
+	refresh_connectivity();
+	refresh_selected(false);
+	return true;
+}
+
+void Viz_Window::stop_loading_model() {
+	if (!_model_loader) { return; }
+	Fl::remove_timeout((Fl_Timeout_Handler)model_loader_cb, this);
+	delete _model_loader;
+	_model_loader = NULL;
+}
+
 static std::string replace_last(std::string s, std::string a, std::string b) {
 	size_t i = s.rfind(a);
 	if (i == std::string::npos) { return s; }
@@ -1959,6 +2135,7 @@ bool Viz_Window::open_and_load_all(const char *filename) {
 }
 
 bool Viz_Window::load_firing_spikes(const char *filename, bool warn) {
+	Profiler::Scope scope("load firing spikes");
 	const char *basename = fl_filename_name(filename);
 	Firing_Spikes *fd = new(std::nothrow) Firing_Spikes(&_model_area->const_model());
 	if (fd == NULL) {
@@ -1968,8 +2145,45 @@ bool Viz_Window::load_firing_spikes(const char *filename, bool warn) {
 		_error_dialog->show(this);
 		return false;
 	}
-	Read_Status status;
-	if (ends_with(basename, ".gz")) {
+	Read_Status status = FAILURE;
+	bool binary = ends_with(basename, ".vbf");
+	// Use the binary cache of a text file instead, if it is up to date
+	std::string cache_filename = binary_cache_filename(filename, ".spikes-cache.vbf");
+	time_t cache_time = modified_time(cache_filename.c_str());
+	bool cached = !binary && cache_time && cache_time >= modified_time(filename);
+	if (cached) {
+		Binary_Parser bp(cache_filename.c_str());
+		if (bp.good()) {
+			// Show progress
+			_progress_dialog->title("Loading...");
+			_progress_dialog->show(this);
+			// Parse cached firing spikes file
+			status = fd->read_from(bp, _progress_dialog);
+			fd->filename(basename);
+			_progress_dialog->hide();
+		}
+		// Parse the text file after all if the cache is unusable
+		cached = status == SUCCESS || status == CANCELED;
+	}
+	if (!cached && binary) {
+		// Open chosen file as binary
+		Binary_Parser bp(filename);
+		if (!bp.good()) {
+			std::string msg = "Could not load ";
+			msg = msg + basename + "!";
+			Modal_Dialog *md = warn ? _warning_dialog : _error_dialog;
+			md->message(msg);
+			md->show(this);
+			return false;
+		}
+		// Show progress
+		_progress_dialog->title("Loading...");
+		_progress_dialog->show(this);
+		// Parse firing spikes file
+		status = fd->read_from(bp, _progress_dialog);
+		_progress_dialog->hide();
+	}
+	else if (!cached && ends_with(basename, ".gz")) {
 		// Open chosen file as compressed text
 		Gzip_Input_Parser gip(filename);
 		if (!gip.good()) {
@@ -1987,7 +2201,7 @@ bool Viz_Window::load_firing_spikes(const char *filename, bool warn) {
 		status = fd->read_from(gip, _progress_dialog);
 		_progress_dialog->hide();
 	}
-	else {
+	else if (!cached) {
 		// Open chosen file as text
 		Input_Parser ip(filename);
 		if (!ip.good()) {
@@ -2005,6 +2219,19 @@ bool Viz_Window::load_firing_spikes(const char *filename, bool warn) {
 		status = fd->read_from(ip, _progress_dialog);
 		_progress_dialog->hide();
 	}
+	if (status == SUCCESS && !binary && !cached) {
+		// Convert the text file to binary and cache it for faster reloading
+		Binary_Writer bw(cache_filename.c_str());
+		if (bw.good()) {
+			_progress_dialog->title("Caching...");
+			_progress_dialog->show(this);
+			if (!fd->write_to(bw, _progress_dialog)) {
+				bw.close();
+				fl_unlink(cache_filename.c_str());
+			}
+			_progress_dialog->hide();
+		}
+	}
 	if (status != SUCCESS) {
 		delete fd;
 		std::string msg = read_status_message(status, basename);
@@ -2013,12 +2240,16 @@ bool Viz_Window::load_firing_spikes(const char *filename, bool warn) {
 		return false;
 	}
 	// Use firing spikes
+	if (_playing) {
+		play_pause_firing_cb(_play_pause_firing, this);
+	}
 	_model_area->model().firing_spikes(fd);
 	set_simulation_display_tb_cb(_display_firing_spikes, this);
 	return true;
 }
 
 bool Viz_Window::load_voltages(const char *filename, bool warn) {
+	Profiler::Scope scope("load voltages");
 	const char *basename = fl_filename_name(filename);
 	const Brain_Model &bm = _model_area->const_model();
 	Voltages *v = new(std::nothrow) Voltages(&bm, bm.const_firing_spikes()->num_cycles());
@@ -2029,8 +2260,45 @@ bool Viz_Window::load_voltages(const char *filename, bool warn) {
 		_error_dialog->show(this);
 		return false;
 	}
-	Read_Status status;
-	if (ends_with(basename, ".gz")) {
+	Read_Status status = FAILURE;
+	bool binary = ends_with(basename, ".vbv");
+	// Use the binary cache of a text file instead, if it is up to date
+	std::string cache_filename = binary_cache_filename(filename, ".voltages-cache.vbv");
+	time_t cache_time = modified_time(cache_filename.c_str());
+	bool cached = !binary && cache_time && cache_time >= modified_time(filename);
+	if (cached) {
+		Mapped_File mf(cache_filename.c_str());
+		if (mf.good()) {
+			// Show progress
+			_progress_dialog->title("Loading...");
+			_progress_dialog->show(this);
+			// Parse cached voltages file
+			status = v->read_from(mf, _progress_dialog);
+			v->filename(basename);
+			_progress_dialog->hide();
+		}
+		// Parse the text file after all if the cache is unusable
+		cached = status == SUCCESS || status == CANCELED;
+	}
+	if (!cached && binary) {
+		// Open chosen file as binary
+		Mapped_File mf(filename);
+		if (!mf.good()) {
+			std::string msg = "Could not load ";
+			msg = msg + basename + "!";
+			Modal_Dialog *md = warn ? _warning_dialog : _error_dialog;
+			md->message(msg);
+			md->show(this);
+			return false;
+		}
+		// Show progress
+		_progress_dialog->title("Loading...");
+		_progress_dialog->show(this);
+		// Parse voltages file
+		status = v->read_from(mf, _progress_dialog);
+		_progress_dialog->hide();
+	}
+	else if (!cached && ends_with(basename, ".gz")) {
 		// Open chosen file as compressed text
 		Gzip_Input_Parser gip(filename);
 		if (!gip.good()) {
@@ -2048,7 +2316,7 @@ bool Viz_Window::load_voltages(const char *filename, bool warn) {
 		status = v->read_from(gip, _progress_dialog);
 		_progress_dialog->hide();
 	}
-	else {
+	else if (!cached) {
 		// Open chosen file as text
 		Input_Parser ip(filename);
 		if (!ip.good()) {
@@ -2066,6 +2334,19 @@ bool Viz_Window::load_voltages(const char *filename, bool warn) {
 		status = v->read_from(ip, _progress_dialog);
 		_progress_dialog->hide();
 	}
+	if (status == SUCCESS && !binary && !cached) {
+		// Convert the text file to binary and cache it for faster reloading
+		Binary_Writer bw(cache_filename.c_str());
+		if (bw.good()) {
+			_progress_dialog->title("Caching...");
+			_progress_dialog->show(this);
+			if (!v->write_to(bw, false, _progress_dialog)) {
+				bw.close();
+				fl_unlink(cache_filename.c_str());
+			}
+			_progress_dialog->hide();
+		}
+	}
 	if (status != SUCCESS) {
 		delete v;
 		std::string msg = read_status_message(status, basename);
@@ -2080,7 +2361,10 @@ bool Viz_Window::load_voltages(const char *filename, bool warn) {
 }
 
 bool Viz_Window::load_weights(const char *filename, bool warn) {
+	Profiler::Scope scope("load weights");
 	const char *basename = fl_filename_name(filename);
+	// Weights belong to synapses, so wait for all of them to be read
+	if (!finish_loading_model()) { return false; }
 	const Brain_Model &bm = _model_area->const_model();
 	Weights *w = new(std::nothrow) Weights(&bm, bm.const_firing_spikes()->num_cycles());
 	if (w == NULL) {
@@ -2090,8 +2374,45 @@ bool Viz_Window::load_weights(const char *filename, bool warn) {
 		_error_dialog->show(this);
 		return false;
 	}
-	Read_Status status;
-	if (ends_with(basename, ".gz")) {
+	Read_Status status = FAILURE;
+	bool binary = ends_with(basename, ".vbw");
+	// Use the binary cache of a text file instead, if it is up to date
+	std::string cache_filename = binary_cache_filename(filename, ".weights-cache.vbw");
+	time_t cache_time = modified_time(cache_filename.c_str());
+	bool cached = !binary && cache_time && cache_time >= modified_time(filename);
+	if (cached) {
+		Binary_Parser bp(cache_filename.c_str());
+		if (bp.good()) {
+			// Show progress
+			_progress_dialog->title("Loading...");
+			_progress_dialog->show(this);
+			// Parse cached weights file
+			status = w->read_from(bp, _progress_dialog);
+			w->filename(basename);
+			_progress_dialog->hide();
+		}
+		// Parse the text file after all if the cache is unusable
+		cached = status == SUCCESS || status == CANCELED;
+	}
+	if (!cached && binary) {
+		// Open chosen file as binary
+		Binary_Parser bp(filename);
+		if (!bp.good()) {
+			std::string msg = "Could not load ";
+			msg = msg + basename + "!";
+			Modal_Dialog *md = warn ? _warning_dialog : _error_dialog;
+			md->message(msg);
+			md->show(this);
+			return false;
+		}
+		// Show progress
+		_progress_dialog->title("Loading...");
+		_progress_dialog->show(this);
+		// Parse weights file
+		status = w->read_from(bp, _progress_dialog);
+		_progress_dialog->hide();
+	}
+	else if (!cached && ends_with(basename, ".gz")) {
 		// Open chosen file as compressed text
 		Gzip_Input_Parser gip(filename);
 		if (!gip.good()) {
@@ -2109,7 +2430,7 @@ bool Viz_Window::load_weights(const char *filename, bool warn) {
 		status = w->read_from(gip, _progress_dialog);
 		_progress_dialog->hide();
 	}
-	else {
+	else if (!cached) {
 		// Open chosen file as text
 		Input_Parser ip(filename);
 		if (!ip.good()) {
@@ -2127,6 +2448,19 @@ bool Viz_Window::load_weights(const char *filename, bool warn) {
 		status = w->read_from(ip, _progress_dialog);
 		_progress_dialog->hide();
 	}
+	if (status == SUCCESS && !binary && !cached) {
+		// Convert the text file to binary and cache it for faster reloading
+		Binary_Writer bw(cache_filename.c_str());
+		if (bw.good()) {
+			_progress_dialog->title("Caching...");
+			_progress_dialog->show(this);
+			if (!w->write_to(bw, _progress_dialog)) {
+				bw.close();
+				fl_unlink(cache_filename.c_str());
+			}
+			_progress_dialog->hide();
+		}
+	}
 	if (status != SUCCESS) {
 		delete w;
 		std::string msg = read_status_message(status, basename);
@@ -2141,7 +2475,10 @@ bool Viz_Window::load_weights(const char *filename, bool warn) {
 }
 
 bool Viz_Window::load_prunings(const char *filename, bool warn) {
+	Profiler::Scope scope("load prunings");
 	const char *basename = fl_filename_name(filename);
+	// Weights belong to synapses, so wait for all of them to be read
+	if (!finish_loading_model()) { return false; }
 	Brain_Model &bm = _model_area->model();
 	Weights *w = bm.weights();
 	if (w == NULL) {
@@ -2152,8 +2489,55 @@ bool Viz_Window::load_prunings(const char *filename, bool warn) {
 		md->show(this);
 		return false;
 	}
-	Read_Status status;
-	if (ends_with(basename, ".gz")) {
+	// Prunings are in the same format as weights, so parse them separately and then apply them
+	Weights *pw = new(std::nothrow) Weights(&bm, w->num_cycles());
+	if (pw == NULL) {
+		std::string msg = "Could not load ";
+		msg = msg + basename + "!\nNot enough memory was available.";
+		_error_dialog->message(msg);
+		_error_dialog->show(this);
+		return false;
+	}
+	Read_Status status = FAILURE;
+	bool binary = ends_with(basename, ".vbw");
+	// Use the binary cache of a text file instead, if it is up to date
+	std::string cache_filename = binary_cache_filename(filename, ".prunings-cache.vbw");
+	time_t cache_time = modified_time(cache_filename.c_str());
+	bool cached = !binary && cache_time && cache_time >= modified_time(filename);
+	if (cached) {
+		Binary_Parser bp(cache_filename.c_str());
+		if (bp.good()) {
+			// Show progress
+			_progress_dialog->title("Loading...");
+			_progress_dialog->show(this);
+			// Parse cached prunings file
+			status = pw->read_from(bp, _progress_dialog, true);
+			pw->filename(basename);
+			_progress_dialog->hide();
+		}
+		// Parse the text file after all if the cache is unusable
+		cached = status == SUCCESS || status == CANCELED;
+	}
+	if (!cached && binary) {
+		// Open chosen file as binary
+		Binary_Parser bp(filename);
+		if (!bp.good()) {
+			std::string msg = "Could not load ";
+			msg = msg + basename + "!";
+			Modal_Dialog *md = warn ? _warning_dialog : _error_dialog;
+			md->message(msg);
+			md->show(this);
+			delete pw;
+			return false;
+		}
+		// Show progress
+		_progress_dialog->title("Loading...");
+		_progress_dialog->show(this);
+		// Parse prunings file
+		status = pw->read_from(bp, _progress_dialog, true);
+		_progress_dialog->hide();
+	}
+	else if (!cached && ends_with(basename, ".gz")) {
 		// Open chosen file as compressed text
 		Gzip_Input_Parser gip(filename);
 		if (!gip.good()) {
@@ -2162,16 +2546,17 @@ bool Viz_Window::load_prunings(const char *filename, bool warn) {
 			Modal_Dialog *md = warn ? _warning_dialog : _error_dialog;
 			md->message(msg);
 			md->show(this);
+			delete pw;
 			return false;
 		}
 		// Show progress
 		_progress_dialog->title("Loading...");
 		_progress_dialog->show(this);
-		// Parse weights file
-		status = w->read_prunings_from(gip, _progress_dialog);
+		// Parse prunings file
+		status = pw->read_from(gip, _progress_dialog, true);
 		_progress_dialog->hide();
 	}
-	else {
+	else if (!cached) {
 		// Open chosen file as text
 		Input_Parser ip(filename);
 		if (!ip.good()) {
@@ -2180,23 +2565,39 @@ bool Viz_Window::load_prunings(const char *filename, bool warn) {
 			Modal_Dialog *md = warn ? _warning_dialog : _error_dialog;
 			md->message(msg);
 			md->show(this);
+			delete pw;
 			return false;
 		}
 		// Show progress
 		_progress_dialog->title("Loading...");
 		_progress_dialog->show(this);
-		// Parse weights file
-		status = w->read_prunings_from(ip, _progress_dialog);
+		// Parse prunings file
+		status = pw->read_from(ip, _progress_dialog, true);
 		_progress_dialog->hide();
 	}
+	if (status == SUCCESS && !binary && !cached) {
+		// Convert the text file to binary and cache it for faster reloading
+		Binary_Writer bw(cache_filename.c_str());
+		if (bw.good()) {
+			_progress_dialog->title("Caching...");
+			_progress_dialog->show(this);
+			if (!pw->write_to(bw, _progress_dialog, true)) {
+				bw.close();
+				fl_unlink(cache_filename.c_str());
+			}
+			_progress_dialog->hide();
+		}
+	}
 	if (status != SUCCESS) {
-		delete w;
+		delete pw;
 		std::string msg = read_status_message(status, basename);
 		_error_dialog->message(msg);
 		_error_dialog->show(this);
 		return false;
 	}
-	// Use weights
+	// Apply prunings to weights
+	w->add_prunings(*pw);
+	delete pw;
 	set_simulation_display_tb_cb(_display_weights, this);
 	return true;
 }
@@ -2271,6 +2672,7 @@ void Viz_Window::open_model_cb(Fl_Widget *, Viz_Window *vw) {
 }
 
 void Viz_Window::close_model_cb(Fl_Widget *w, Viz_Window *vw) {
+	vw->stop_loading_model();
 	if (!vw->_model_area->opened()) { return; }
 	unload_weights_cb(w, vw);
 	unload_voltages_cb(w, vw);
@@ -2279,6 +2681,21 @@ void Viz_Window::close_model_cb(Fl_Widget *w, Viz_Window *vw) {
 	vw->refresh_model_file();
 }
 
+void Viz_Window::model_loader_cb(Viz_Window *vw) {
+	if (!vw->_model_loader) { return; }
+	if (vw->_model_loader->done()) {
+		vw->finished_loading_model();
+		return;
+	}
+	// Show the synapses and gap junctions that have been read so far
+	Profiler::Scope scope("publish model");
+	if (vw->_model_loader->publish()) {
+		vw->refresh_synapse_count();
+		vw->_model_area->refresh();
+	}
+	Fl::repeat_timeout(MODEL_LOADER_TIMEOUT, (Fl_Timeout_Handler)model_loader_cb, vw);
+}
+
 void Viz_Window::open_and_load_all_cb(Fl_Widget *, Viz_Window *vw) {
 	int status = vw->_model_chooser->show();
 	if (status == 1) { return; }
@@ -2430,6 +2847,9 @@ void Viz_Window::export_image_cb(Fl_Widget *, Viz_Window *vw) {
 
 void Viz_Window::export_animation_cb(Fl_Widget *, Viz_Window *vw) {
 	if (!vw->_model_area->opened() || !vw->_model_area->const_model().has_firing_spikes()) { return; }
+	vw->_export_animation_dialog->limit_spinners(vw->_model_area->model().const_firing_spikes());
+	vw->_export_animation_dialog->show(vw);
+	if (vw->_export_animation_dialog->canceled()) { return; }
 	int status = vw->_animation_chooser->show();
 	if (status == 1) { return; }
 	// Get name of chosen directory
@@ -2450,35 +2870,21 @@ void Viz_Window::export_animation_cb(Fl_Widget *, Viz_Window *vw) {
 	if (vw->_model_area->draw_options().display() == Draw_Options::STATIC_MODEL) {
 		set_simulation_display_tb_cb(vw->_display_firing_spikes, vw);
 	}
-	vw->_firing_time_spinner->value(0.0);
-	firing_start_time_cb(vw->_firing_time_spinner, vw);
-	// Get the number of cycles
-	size32_t n = vw->_model_area->const_model().const_firing_spikes()->num_cycles();
-	// Prepare to show frame-writing progress
-	bool canceled = false;
-	size_t denom = n / Progress_Dialog::PROGRESS_STEPS;
-	if (!denom) { denom = 1; }
-	vw->_progress_dialog->message("Exporting animation...");
-	vw->_progress_dialog->progress(0.0f);
-	Fl::check();
-	canceled = vw->_progress_dialog->canceled();
-	// Write animation frames
-	std::ostringstream ss;
-	int z = (int)ceil(log10((float)n));
-	int err = 0;
-	for (size32_t i = 0; !canceled && i < n; i++) {
-		ss.str("");
-		ss << dirname << "/viz_anim_" << std::setw(z) << std::setfill('0') << i << ".png";
-		err = vw->_model_area->write_image(ss.str().c_str(), Image::PNG);
-		if (err) { break; }
-		step_firing_cb(vw->_step_firing, vw);
-		if (!((i + 1) % denom)) {
-			vw->_progress_dialog->progress((float)(i + 1) / n);
-		}
-		Fl::check();
-		canceled = vw->_progress_dialog->canceled();
-	}
+	size32_t start = vw->_export_animation_dialog->start_time();
+	size32_t stop = vw->_export_animation_dialog->stop_time();
+	size32_t step = vw->_export_animation_dialog->step_time();
+	std::string prefix = dirname;
+	prefix += "/viz_anim_";
+	int err = vw->_model_area->write_animation(prefix, start, stop, step, vw->_export_animation_dialog->format(),
+		vw->_export_animation_dialog->compression(), NULL, vw->_progress_dialog);
+	bool canceled = vw->_progress_dialog->canceled();
 	vw->_progress_dialog->hide();
+	// Show the cycle that the animation stopped at
+	size32_t t = vw->_model_area->const_model().const_firing_spikes()->time();
+	vw->_firing_time_spinner->value((double)t);
+	vw->_firing_time_slider->value((double)t);
+	vw->refresh_selected_sim_data();
+	vw->redraw();
 	if (canceled) {
 		std::string msg = "Canceled exporting to ";
 		msg = msg + basename + "!";
@@ -2527,6 +2933,8 @@ void Viz_Window::copy_state_cb(Fl_Widget *, Viz_Window *vw) {
 
 void Viz_Window::paste_state_cb(Fl_Widget *, Viz_Window *vw) {
 	if (!vw->_model_area->opened()) { return; }
+	// Marked synapses in the state refer to all of the model's synapses, so wait for them to be read
+	if (!vw->finish_loading_model()) { return; }
 	vw->_model_area->paste();
 }
 
@@ -2544,6 +2952,8 @@ void Viz_Window::load_state_cb(Fl_Widget *, Viz_Window *vw) {
 	if (!vw->_model_area->opened()) { return; }
 	int status = vw->_state_load_chooser->show();
 	if (status == 1) { return; }
+	// Marked synapses in the state refer to all of the model's synapses, so wait for them to be read
+	if (!vw->finish_loading_model()) { return; }
 	const char *filename = vw->_state_load_chooser->filename();
 	const char *basename = fl_filename_name(filename);
 	// Open chosen file
@@ -2772,6 +3182,13 @@ void Viz_Window::show_fps_cb(Fl_Menu_ *m, Viz_Window *vw) {
 	vw->redraw();
 }
 
+void Viz_Window::show_profiler_cb(Fl_Menu_ *m, Viz_Window *vw) {
+	int v = m->mvalue()->value();
+	vw->_model_area->draw_options().show_profiler(!!v);
+	vw->_model_area->refresh();
+	vw->redraw();
+}
+
 void Viz_Window::invert_background_cb(Fl_Menu_ *m, Viz_Window *vw) {
 	int v = m->mvalue()->value();
 	vw->_model_area->draw_options().invert_background(!!v);
@@ -3252,6 +3669,7 @@ void Viz_Window::reset_settings_cb(Fl_Widget *, Viz_Window *vw) {
 	d.show_axis_labels(true); VW_WITH_MENU_ITEM_CB(show_axis_labels_cb, set);
 	d.show_bulletin(false); VW_WITH_MENU_ITEM_CB(show_bulletin_cb, clear);
 	d.show_fps(false); VW_WITH_MENU_ITEM_CB(show_fps_cb, clear);
+	d.show_profiler(false); VW_WITH_MENU_ITEM_CB(show_profiler_cb, clear);
 	d.invert_background(false); VW_WITH_MENU_ITEM_CB(invert_background_cb, clear);
 	d.display_value_for_somas(false); VW_WITH_MENU_ITEM_CB(display_value_for_somas_cb, clear);
 	vw->_display_value_for_somas->clear();
@@ -3817,6 +4235,7 @@ void Viz_Window::fetch_den_id_cb(Fl_Widget *, Viz_Window *vw) {
 }
 
 void Viz_Window::report_synapses_cb(Fl_Widget *, Viz_Window *vw) {
+	if (!vw->_model_area->const_model().connected()) { return; }
 	vw->_text_report_chooser->preset_file("viz_selected_synapses.txt");
 	int status = vw->_text_report_chooser->show();
 	if (status == 1) { return; }
@@ -3860,6 +4279,27 @@ void Viz_Window::report_marked_cb(Fl_Widget *, Viz_Window *vw) {
 	}
 }
 
+void Viz_Window::save_profiler_trace_cb(Fl_Widget *, Viz_Window *vw) {
+	int status = vw->_trace_chooser->show();
+	if (status == 1) { return; }
+	const char *filename = vw->_trace_chooser->filename();
+	const char *basename = fl_filename_name(filename);
+	std::ofstream ofs(filename);
+	if (!ofs.good()) {
+		std::string msg = "Could not write to ";
+		msg = msg + basename + "!";
+		vw->_error_dialog->message(msg);
+		vw->_error_dialog->show(vw);
+	}
+	else {
+		Profiler::write_trace_to(ofs);
+		std::string msg = "Saved trace to ";
+		msg = msg + basename + "!";
+		vw->_success_dialog->message(msg);
+		vw->_success_dialog->show(vw);
+	}
+}
+
 void Viz_Window::report_selected_cb(Fl_Widget *, Viz_Window *vw) {
 	if (!vw->_model_area->opened()) { return; }
 	vw->_report_somas_dialog->show(vw);
@@ -4044,7 +4484,9 @@ void Viz_Window::play_pause_firing_cb(Fl_Widget *, Viz_Window *vw) {
 		vw->_play_pause_firing->image(PLAY_ICON);
 		vw->_play_pause_firing->tooltip("Play (.)");
 		Fl::remove_timeout((Fl_Timeout_Handler)do_step_firing_time_cb, vw);
+		vw->_model_area->stop_producing();
 		vw->_playing = false;
+		vw->refresh_playback_rate();
 	}
 	else {
 		// Don't play while showing static model
@@ -4059,7 +4501,9 @@ void Viz_Window::play_pause_firing_cb(Fl_Widget *, Viz_Window *vw) {
 		}
 		vw->_play_pause_firing->image(PAUSE_ICON);
 		vw->_play_pause_firing->tooltip("Pause (.)");
-		Fl::add_timeout(0.0, (Fl_Timeout_Handler)do_step_firing_time_cb, vw);
+		vw->_model_area->start_producing();
+		vw->_playback.start(FIRING_SPEED_RATES[(int)(vw->_firing_speed_spinner->value() - 1.0)]);
+		Fl::add_timeout(vw->_playback.wait(), (Fl_Timeout_Handler)do_step_firing_time_cb, vw);
 		vw->_playing = true;
 	}
 	vw->redraw();
@@ -4067,17 +4511,28 @@ void Viz_Window::play_pause_firing_cb(Fl_Widget *, Viz_Window *vw) {
 
 void Viz_Window::step_firing_cb(Fl_Widget *, Viz_Window *vw) {
 	if (!vw->contains(vw->_simulation_bar)) { return; }
-	size32_t t = vw->_model_area->model().step_time();
+	Profiler::Scope scope("step firing");
+	size32_t t;
+	{
+		Profiler::Scope step("step time");
+		t = vw->_model_area->model().step_time();
+	}
 	vw->_firing_time_spinner->value((double)t);
 	vw->_firing_time_slider->value((double)t);
 	vw->_model_area->refresh();
-	vw->refresh_selected_sim_data();
+	{
+		Profiler::Scope sidebar("sidebar");
+		vw->refresh_selected_sim_data();
+	}
 	vw->redraw();
 }
 
 void Viz_Window::firing_start_time_cb(Fl_Widget *w, Viz_Window *vw) {
 	double ut = w == vw->_firing_time_spinner ? vw->_firing_time_spinner->value() : vw->_firing_time_slider->value();
+	// Seeking invalidates any colors produced ahead of playback
+	vw->_model_area->stop_producing();
 	size32_t tt = vw->_model_area->model().start_time((size32_t)ut);
+	if (vw->_playing) { vw->_model_area->start_producing(); }
 	vw->_firing_time_spinner->value((double)tt);
 	vw->_firing_time_slider->value((double)tt);
 	vw->_model_area->refresh();
@@ -4092,9 +4547,26 @@ void Viz_Window::do_step_firing_time_cb(Viz_Window *vw) {
 		play_pause_firing_cb(vw->_play_pause_firing, vw);
 		return;
 	}
-	step_firing_cb(vw->_step_firing, vw);
-	double r = FIRING_SPEED_TIMEOUTS[(int)(vw->_firing_speed_spinner->value() - 1.0)];
-	Fl::repeat_timeout(r, (Fl_Timeout_Handler)do_step_firing_time_cb, vw);
+	// Step by every cycle due since the last frame, and draw only the latest one
+	vw->_playback.rate(FIRING_SPEED_RATES[(int)(vw->_firing_speed_spinner->value() - 1.0)]);
+	size32_t n = vw->_playback.due();
+	if (n) {
+		Profiler::Scope scope("playback");
+		{
+			Profiler::Scope step("step time");
+			t = vw->_model_area->model().step_time(n);
+		}
+		vw->_firing_time_spinner->value((double)t);
+		vw->_firing_time_slider->value((double)t);
+		vw->_model_area->refresh();
+		{
+			Profiler::Scope sidebar("sidebar");
+			vw->refresh_selected_sim_data();
+		}
+		vw->refresh_playback_rate();
+		vw->redraw();
+	}
+	Fl::add_timeout(vw->_playback.wait(), (Fl_Timeout_Handler)do_step_firing_time_cb, vw);
 }
 
 void Viz_Window::firing_report_current_cb(Fl_Widget *, Viz_Window *vw) {
@@ -4158,6 +4630,63 @@ void Viz_Window::firing_report_average_cb(Fl_Widget *, Viz_Window *vw) {
 	}
 }
 
+void Viz_Window::firing_report_stats_cb(Fl_Widget *, Viz_Window *vw) {
+	vw->_report_stats_dialog->limit_spinners(vw->_model_area->model().const_firing_spikes());
+	vw->_report_stats_dialog->show(vw);
+	bool canceled = vw->_report_stats_dialog->canceled();
+	if (canceled) { return; }
+	vw->_text_report_chooser->preset_file("viz_spike_statistics.txt");
+	int status = vw->_text_report_chooser->show();
+	if (status == 1) { return; }
+	const char *filename = vw->_text_report_chooser->filename();
+	const char *basename = fl_filename_name(filename);
+	std::ofstream ofs(filename);
+	if (!ofs.good()) {
+		std::string msg = "Could not write to ";
+		msg = msg + basename + "!";
+		vw->_error_dialog->message(msg);
+		vw->_error_dialog->show(vw);
+	}
+	else {
+		size32_t start = vw->_report_stats_dialog->start_time();
+		size32_t stop = vw->_report_stats_dialog->stop_time();
+		size32_t step = vw->_report_stats_dialog->step_time();
+		vw->_progress_dialog->title("Analyzing...");
+		vw->_progress_dialog->show(vw);
+		vw->_model_area->write_spike_stats_to(ofs, start, stop, step, vw->_progress_dialog);
+		vw->_progress_dialog->hide();
+		if (vw->_progress_dialog->canceled()) {
+			std::string msg = "Canceled reporting spike statistics!";
+			vw->_warning_dialog->message(msg);
+			vw->_warning_dialog->show(vw);
+		}
+		else {
+			std::string msg = "Saved report to ";
+			msg = msg + basename + "!";
+			vw->_success_dialog->message(msg);
+			vw->_success_dialog->show(vw);
+		}
+	}
+}
+
+void Viz_Window::firing_prev_selected_cb(Fl_Widget *, Viz_Window *vw) {
+	const Model_State &ms = vw->_model_area->const_state();
+	if (!ms.num_selected()) { return; }
+	size32_t sel_index = ms.selected_index(vw->_shown_selected);
+	size32_t t = vw->_model_area->const_model().const_firing_spikes()->prev_spike_time(sel_index);
+	vw->_firing_time_spinner->value(t);
+	firing_start_time_cb(vw->_firing_time_spinner, vw);
+}
+
+void Viz_Window::firing_next_selected_cb(Fl_Widget *, Viz_Window *vw) {
+	const Model_State &ms = vw->_model_area->const_state();
+	if (!ms.num_selected()) { return; }
+	size32_t sel_index = ms.selected_index(vw->_shown_selected);
+	size32_t t = vw->_model_area->const_model().const_firing_spikes()->next_spike_time(sel_index);
+	vw->_firing_time_spinner->value(t);
+	firing_start_time_cb(vw->_firing_time_spinner, vw);
+}
+
 void Viz_Window::firing_select_top_cb(Fl_Widget *, Viz_Window *vw) {
 	int n = (int)vw->_firing_select_top_spinner->value();
 	vw->_model_area->select_top(n);
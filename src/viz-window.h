@@ -1,12 +1,15 @@
 #ifndef VIZ_WINDOW_H
 #define VIZ_WINDOW_H
 
+#include <string>
+
 #pragma warning(push, 0)
 #include <FL/Fl_Double_Window.H>
 #include <FL/Fl_Sys_Menu_Bar.H>
 #pragma warning(pop)
 
 #include "utils.h"
+#include "playback-scheduler.h"
 
 #ifdef _DEBUG
 #define PROGRAM_NAME "Brain Visualizer [DEBUG]"
@@ -25,6 +28,7 @@ class Fl_Native_File_Chooser;
 class Soma;
 class Synapse;
 class Model_Area;
+class Model_Loader;
 class Overview_Area;
 class Sidebar;
 class Toolbar;
@@ -60,10 +64,12 @@ class Progress_Dialog;
 class Waiting_Dialog;
 class Report_Somas_Dialog;
 class Report_Averages_Dialog;
+class Export_Animation_Dialog;
 
 class Viz_Window : public Fl_Double_Window {
 private:
-	static const double FIRING_SPEED_TIMEOUTS[10];
+	static const double FIRING_SPEED_RATES[10];
+	static const double MODEL_LOADER_TIMEOUT;
 private:
 	DnD_Receiver *_dnd_receiver;
 	Fl_Sys_Menu_Bar *_menu_bar;
@@ -87,6 +93,9 @@ private:
 		*_mark_mi, *_2d_arcball_mi, *_3d_arcball_mi, *_x_axis_mi, *_y_axis_mi, *_z_axis_mi, *_2d_arcball_dd_mi,
 		*_3d_arcball_dd_mi, *_x_axis_dd_mi, *_y_axis_dd_mi, *_z_axis_dd_mi;
 	Model_Area *_model_area;
+	Model_Loader *_model_loader;
+	std::string _model_filename, _model_cache_filename;
+	bool _model_cached;
 	Sidebar *_sidebar;
 	Expander_Collapser *_overview_heading;
 	Overview_Area *_overview_area;
@@ -125,7 +134,8 @@ private:
 	Fl_Group *_display_static_group, *_display_firing_group, *_display_voltages_group, *_display_weights_group;
 	Label *_static_size;
 	Label *_firing_cycle_length;
-	OS_Button *_firing_report_current, *_firing_report_average, *_firing_select_top;
+	OS_Button *_firing_report_current, *_firing_report_average, *_firing_report_stats, *_firing_select_top;
+	OS_Repeat_Button *_firing_prev_selected, *_firing_next_selected;
 	OS_Spinner *_firing_select_top_spinner;
 	Label *_voltages_count;
 	OS_Button *_voltages_graph_selected;
@@ -139,16 +149,18 @@ private:
 	OS_Slider *_firing_time_slider;
 	Fl_Native_File_Chooser *_model_chooser, *_firing_chooser, *_voltages_chooser, *_weights_chooser, *_prunings_chooser,
 		*_image_chooser, *_animation_chooser, *_state_load_chooser, *_state_save_chooser, *_config_load_chooser,
-		*_config_save_chooser, *_text_report_chooser;
+		*_config_save_chooser, *_text_report_chooser, *_trace_chooser;
 	Help_Window *_help_window;
 	Modal_Dialog *_about_dialog, *_success_dialog, *_warning_dialog, *_error_dialog;
 	Progress_Dialog *_progress_dialog;
 	Waiting_Dialog *_waiting_dialog;
 	Report_Somas_Dialog *_report_somas_dialog;
-	Report_Averages_Dialog *_report_averages_dialog;
+	Report_Averages_Dialog *_report_averages_dialog, *_report_stats_dialog;
+	Export_Animation_Dialog *_export_animation_dialog;
 	Summary_Dialog *_summary_dialog;
 	size_t _shown_selected;
 	bool _playing;
+	Playback_Scheduler _playback;
 	int _wx, _wy, _ww, _wh;
 #if defined(__LINUX__)
 	Pixmap _icon_pixmap, _icon_mask;
@@ -166,10 +178,11 @@ public:
 	void refresh_weights(void);
 	void refresh_selected(bool show_last = true);
 	void refresh_selected_sim_data(void);
+	void refresh_playback_rate(void);
 	void summary_dialog(void);
 	void summary_dialog(const Soma *s, size32_t index);
 	void summary_dialog(const Synapse *y, size32_t index);
-	bool open_model(const char *filename);
+	bool open_model(const char *filename, bool use_cache = true);
 	bool open_and_load_all(const char *filename);
 	bool load_firing_spikes(const char *filename, bool warn = false);
 	bool load_voltages(const char *filename, bool warn = false);
@@ -178,6 +191,12 @@ public:
 	void overview_area(bool show);
 private:
 	void refresh_config(void);
+	void refresh_synapse_count(void);
+	void refresh_connectivity(void);
+	bool finish_loading_model(void);
+	bool finished_loading_model(void);
+	void stop_loading_model(void);
+	static void model_loader_cb(Viz_Window *vw);
 	static void drag_and_drop_cb(DnD_Receiver *dndr, Viz_Window *vw);
 	static void open_model_cb(Fl_Widget *w, Viz_Window *vw);
 	static void close_model_cb(Fl_Widget *w, Viz_Window *vw);
@@ -211,6 +230,7 @@ private:
 	static void show_axis_labels_cb(Fl_Menu_ *m, Viz_Window *vw);
 	static void show_bulletin_cb(Fl_Menu_ *m, Viz_Window *vw);
 	static void show_fps_cb(Fl_Menu_ *m, Viz_Window *vw);
+	static void show_profiler_cb(Fl_Menu_ *m, Viz_Window *vw);
 	static void invert_background_cb(Fl_Menu_ *m, Viz_Window *vw);
 	static void transparent_cb(Fl_Menu_ *m, Viz_Window *vw);
 	static void full_screen_cb(Fl_Menu_ *m, Viz_Window *vw);
@@ -302,6 +322,7 @@ private:
 	static void fetch_den_id_cb(Fl_Widget *w, Viz_Window *vw);
 	static void report_synapses_cb(Fl_Widget *w, Viz_Window *vw);
 	static void report_marked_cb(Fl_Widget *w, Viz_Window *vw);
+	static void save_profiler_trace_cb(Fl_Widget *w, Viz_Window *vw);
 	static void report_selected_cb(Fl_Widget *w, Viz_Window *vw);
 	static void prev_selected_cb(Fl_Widget *w, Viz_Window *vw);
 	static void next_selected_cb(Fl_Widget *w, Viz_Window *vw);
@@ -322,6 +343,9 @@ private:
 	static void do_step_firing_time_cb(Viz_Window *vw);
 	static void firing_report_current_cb(Fl_Widget *w, Viz_Window *vw);
 	static void firing_report_average_cb(Fl_Widget *w, Viz_Window *vw);
+	static void firing_report_stats_cb(Fl_Widget *w, Viz_Window *vw);
+	static void firing_prev_selected_cb(Fl_Widget *w, Viz_Window *vw);
+	static void firing_next_selected_cb(Fl_Widget *w, Viz_Window *vw);
 	static void firing_select_top_cb(Fl_Widget *w, Viz_Window *vw);
 	static void voltages_graph_selected_cb(Fl_Widget *w, Viz_Window *vw);
 	static void weights_color_after_cb(Toggle_Switch *w, Viz_Window *vw);
@@ -1,4 +1,6 @@
 #include <cmath>
+#include <cstring>
+#include <vector>
 
 #pragma warning(push, 0)
 #include <FL/Fl.H>
@@ -8,16 +10,23 @@
 #include "algebra.h"
 #include "color-maps.h"
 #include "input-parser.h"
+#include "binary-parser.h"
+#include "binary-writer.h"
+#include "mapped-file.h"
 #include "progress-dialog.h"
 #include "soma.h"
 #include "brain-model.h"
+#include "parallel.h"
 #include "voltages.h"
 
 const firings_instance_t Voltages::NO_FIRINGS;
+const float Voltages::MIN_VOLTAGE = -100.0f;
+const float Voltages::MAX_VOLTAGE = 120.0f;
 
 Voltages::Voltages(const Brain_Model *bm, size32_t nc) : Sim_Data(bm, new Thermal_Map()), _num_active_somas(0),
 	_active_somas(NULL), _voltages(NULL), _firings(NULL) {
 	_num_cycles = nc;
+	bake_scale(MIN_VOLTAGE, MAX_VOLTAGE);
 }
 
 Voltages::~Voltages() {
@@ -75,9 +84,12 @@ void Voltages::color(size32_t index, const Soma_Type *, float *cv, bool invert)
 		cv[0] = bgcv[0]; cv[1] = bgcv[1]; cv[2] = bgcv[2];
 		return;
 	}
-	float v = voltage_relative(i);
-	float s = scale(v);
-	_color_map->map(s, cv);
+	map_color(voltage_relative(i), cv);
+}
+
+void Voltages::active_colors(float *cv) const {
+	// The active somas' voltages at one time are stored together, so they can all be mapped at once
+	if (_num_active_somas) { map_colors(_voltages + (size_t)_num_active_somas * _time, _num_active_somas, cv); }
 }
 
 Read_Status Voltages::read_from(Input_Parser &ip, Progress_Dialog *p) {
@@ -129,7 +141,8 @@ Read_Status Voltages::read_from(Input_Parser &ip, Progress_Dialog *p) {
 		size32_t r = _num_active_somas * t;
 		for (size32_t j = 0; j < _num_active_somas; j++) {
 			_voltages[r + j] = ip.get_float();
-			_firings[j][t] = (Firing_State)ip.get_size8();
+			Firing_State state = (Firing_State)ip.get_size8();
+			if (state != NOTHING) { _firings[j][t] = state; }
 		}
 		// Update progress
 		if (p && !((i + 1) % denom)) {
@@ -145,3 +158,274 @@ Read_Status Voltages::read_from(Input_Parser &ip, Progress_Dialog *p) {
 	}
 	return SUCCESS;
 }
+
+// A binary voltages file is formatted as:
+//     signature "\aRJP\xF7", version byte, comment string, num_somas, num_active_somas, active_soma_ids,
+//     num_cycles, precision byte (16 or 32 bits), cycles_per_tile, somas_per_tile, num_tiles + 1 fixed-size tile
+//     offsets, tiles
+// The tiles cover the cycles and active somas in a grid, stored one row of cycles after another. Each tile holds
+// its voltages cycle by cycle as big-endian floats, then a state format byte and its firing states in the same
+// order: all NOTHING and omitted (format 0), packed two to a byte (format 1), or one to a byte (format 2).
+
+static size16_t float_to_half(float f) {
+	size32_t x;
+	memcpy(&x, &f, sizeof(x));
+	size16_t sign = (size16_t)((x >> 16) & 0x8000);
+	size32_t e = (x >> 23) & 0xFF, m = x & 0x7FFFFF;
+	if (e == 0xFF) { return sign | 0x7C00 | (m ? 0x200 : 0); }
+	int32_t he = (int32_t)e - 127 + 15;
+	if (he >= 0x1F) { return sign | 0x7C00; }
+	if (he <= 0) {
+		// Denormalized or too small
+		if (he < -10) { return sign; }
+		m |= 0x800000;
+		size32_t shift = (size32_t)(14 - he);
+		size32_t h = m >> shift;
+		if ((m >> (shift - 1)) & 1) { h++; }
+		return sign | (size16_t)h;
+	}
+	size32_t h = ((size32_t)he << 10) | (m >> 13);
+	// Rounding may carry into the exponent, which is still correct
+	if (m & 0x1000) { h++; }
+	return sign | (size16_t)h;
+}
+
+static float half_to_float(size16_t h) {
+	size32_t sign = (size32_t)(h & 0x8000) << 16;
+	size32_t e = (h >> 10) & 0x1F, m = h & 0x3FF;
+	size32_t x;
+	if (e == 0x1F) {
+		x = sign | 0x7F800000 | (m << 13);
+	}
+	else if (e) {
+		x = sign | ((e + 127 - 15) << 23) | (m << 13);
+	}
+	else if (m) {
+		// Normalize a denormalized value
+		e = 127 - 15 + 1;
+		while (!(m & 0x400)) { m <<= 1; e--; }
+		x = sign | (e << 23) | ((m & 0x3FF) << 13);
+	}
+	else {
+		x = sign;
+	}
+	float f;
+	memcpy(&f, &x, sizeof(f));
+	return f;
+}
+
+Read_Status Voltages::read_from(const Mapped_File &mf, Progress_Dialog *p) {
+	// Get the file name and size
+	_filename = mf.filename();
+	_filesize = mf.filesize();
+	Buffer_Binary_Parser bbp(mf.data(), mf.size());
+	// Get the file signature
+	char sig[5];
+	bbp.get_chars(5, sig);
+	if (sig[0] != '\a' || sig[1] != 'R' || sig[2] != 'J' || sig[3] != 'P' || sig[4] != '\xF7') {
+		return BAD_SIGNATURE;
+	}
+	// Get the file format version
+	size8_t version = bbp.get_size8();
+	if (version != 1) { return BAD_VERSION; }
+	// Get the comment
+	bbp.get_string();
+	// Get the number of somas
+	size32_t somas_in_model = bbp.get_size32();
+	if (somas_in_model != num_somas()) { return WRONG_NUM_SOMAS; }
+	// Get the number of active somas
+	_num_active_somas = bbp.get_size32();
+	if (bbp.overrun() || _num_active_somas > num_somas()) { return END_OF_FILE; }
+	// Initialize the array of active soma IDs
+	delete [] _active_somas;
+	_active_somas = _num_active_somas > 0 ? new(std::nothrow) size32_t[_num_active_somas] : NULL;
+	if (_active_somas == NULL && _num_active_somas > 0) { return NO_MEMORY; }
+	// Get each active soma ID
+	for (size32_t i = 0; i < _num_active_somas; i++) {
+		size32_t id = bbp.get_size32();
+		size32_t index = _model->soma_index(id);
+		if (index >= num_somas()) { return BAD_SOMA_ID; }
+		_active_somas[i] = index;
+	}
+	// Get the number of cycles
+	size32_t cycles_in_data = bbp.get_size32();
+	if (cycles_in_data != _num_cycles) { return WRONG_NUM_CYCLES; }
+	// Get the tile offsets
+	size8_t precision = bbp.get_size8();
+	if (precision != 16 && precision != 32) { return BAD_VERSION; }
+	size_t value_size = precision / 8;
+	size32_t cycles_per_tile = bbp.get_size32();
+	size32_t somas_per_tile = bbp.get_size32();
+	if (!cycles_per_tile || !somas_per_tile) { return FAILURE; }
+	size32_t num_rows = (_num_cycles + cycles_per_tile - 1) / cycles_per_tile;
+	size32_t num_cols = (_num_active_somas + somas_per_tile - 1) / somas_per_tile;
+	size_t num_tiles = (size_t)num_rows * num_cols;
+	std::vector<size64_t> offsets(num_tiles + 1);
+	for (size_t k = 0; k <= num_tiles; k++) {
+		offsets[k] = bbp.get_fixed64();
+		if (k && offsets[k] < offsets[k-1]) { return FAILURE; }
+	}
+	if (bbp.overrun() || offsets[num_tiles] > mf.size()) { return END_OF_FILE; }
+	// Prepare to show voltage-parsing progress
+	if (p) {
+		p->message("Parsing voltages...");
+		p->progress(0.0f);
+		Fl::check();
+		if (p->canceled()) { return CANCELED; }
+	}
+	// Initialize the array of voltages
+	delete [] _voltages;
+	_voltages = _num_active_somas > 0 ? new(std::nothrow) float[_num_cycles * _num_active_somas]() : NULL;
+	delete [] _firings;
+	_firings = _num_active_somas > 0 ? new(std::nothrow) firings_instance_t[_num_active_somas]() : NULL;
+	if ((_voltages == NULL || _firings == NULL) && _num_active_somas > 0) { return NO_MEMORY; }
+	if (!num_tiles) { return SUCCESS; }
+	// Decode the tiles straight from the file data in parallel, a few rows of tiles at a time
+	std::vector<size8_t> states((size_t)_num_cycles * _num_active_somas, NOTHING);
+	std::vector<Read_Status> statuses(num_tiles, SUCCESS);
+	size32_t rows_per_batch = MAX((size32_t)(num_threads() * 2 / num_cols), 1);
+	for (size32_t r0 = 0; r0 < num_rows; r0 += rows_per_batch) {
+		size32_t r1 = MIN(r0 + rows_per_batch, num_rows);
+		size_t k0 = (size_t)r0 * num_cols, k1 = (size_t)r1 * num_cols;
+		parallel_chunks(k1 - k0, num_chunks(k1 - k0, 1), [&](size_t begin, size_t end, size_t) {
+			for (size_t k = k0 + begin; k < k0 + end; k++) {
+				size32_t t0 = (size32_t)(k / num_cols) * cycles_per_tile, j0 = (size32_t)(k % num_cols) * somas_per_tile;
+				size32_t nt = MIN(cycles_per_tile, _num_cycles - t0), ns = MIN(somas_per_tile, _num_active_somas - j0);
+				size_t nv = (size_t)nt * ns;
+				const unsigned char *data = mf.data() + offsets[k];
+				size_t n = (size_t)(offsets[k+1] - offsets[k]);
+				if (n < nv * value_size + 1) { statuses[k] = END_OF_FILE; continue; }
+				for (size32_t t = 0; t < nt; t++) {
+					float *row = _voltages + (size_t)_num_active_somas * (t0 + t) + j0;
+					for (size32_t j = 0; j < ns; j++, data += value_size) {
+						if (value_size == 2) {
+							row[j] = half_to_float((size16_t)(data[0] << 8 | data[1]));
+						}
+						else {
+							size32_t x = (size32_t)data[0] << 24 | (size32_t)data[1] << 16 | (size32_t)data[2] << 8 | data[3];
+							memcpy(&row[j], &x, sizeof(float));
+						}
+					}
+				}
+				size8_t format = *data++;
+				if (format > 2) { statuses[k] = FAILURE; continue; }
+				if (!format) { continue; }
+				if (n < nv * value_size + 1 + (format == 1 ? (nv + 1) / 2 : nv)) { statuses[k] = END_OF_FILE; continue; }
+				for (size_t v = 0; v < nv; v++) {
+					size8_t state = format == 2 ? data[v] : v & 1 ? data[v/2] & 0xF : data[v/2] >> 4;
+					states[(size_t)_num_active_somas * (t0 + v / ns) + j0 + v % ns] = state;
+				}
+			}
+		});
+		for (size_t k = k0; k < k1; k++) {
+			if (statuses[k] != SUCCESS) { return statuses[k]; }
+		}
+		// Update progress
+		if (p) {
+			p->progress((float)r1 / num_rows);
+			Fl::check();
+			if (p->canceled()) { return CANCELED; }
+		}
+	}
+	// Collect each soma's firing states
+	parallel_chunks(_num_active_somas, num_chunks(_num_active_somas, 16), [&](size_t begin, size_t end, size_t) {
+		for (size_t j = begin; j < end; j++) {
+			firings_instance_t &fs = _firings[j];
+			for (size32_t t = 0; t < _num_cycles; t++) {
+				size8_t state = states[(size_t)_num_active_somas * t + j];
+				if (state != NOTHING) { fs.insert(fs.end(), std::make_pair(t, (Firing_State)state)); }
+			}
+		}
+	});
+	if (p) {
+		p->progress(1.0f);
+		Fl::check();
+		if (p->canceled()) { return CANCELED; }
+	}
+	return SUCCESS;
+}
+
+bool Voltages::write_to(Binary_Writer &bw, bool half_precision, Progress_Dialog *p) const {
+	if (!bw.good()) { return false; }
+	// Write the header
+	bw.put_chars(5, "\aRJP\xF7");
+	bw.put_size8(1);
+	bw.put_string("Converted from " + _filename);
+	bw.put_unsigned(num_somas());
+	bw.put_unsigned(_num_active_somas);
+	for (size32_t i = 0; i < _num_active_somas; i++) {
+		bw.put_unsigned(_model->soma(_active_somas[i])->id());
+	}
+	bw.put_unsigned(_num_cycles);
+	bw.put_size8(half_precision ? 16 : 32);
+	bw.put_unsigned(CYCLES_PER_TILE);
+	bw.put_unsigned(SOMAS_PER_TILE);
+	// Reserve space for the tile offsets, to be filled in after the tiles are written
+	size32_t num_rows = (_num_cycles + CYCLES_PER_TILE - 1) / CYCLES_PER_TILE;
+	size32_t num_cols = (_num_active_somas + SOMAS_PER_TILE - 1) / SOMAS_PER_TILE;
+	size_t num_tiles = (size_t)num_rows * num_cols;
+	std::vector<size64_t> offsets(num_tiles + 1);
+	size64_t offsets_place = bw.tell();
+	for (size_t k = 0; k <= num_tiles; k++) { bw.put_fixed64(0); }
+	// Prepare to show voltage-writing progress
+	if (p) {
+		p->message("Caching voltages...");
+		p->progress(0.0f);
+		Fl::check();
+		if (p->canceled()) { return false; }
+	}
+	// Write each tile
+	std::vector<size8_t> states;
+	for (size_t k = 0; k < num_tiles; k++) {
+		offsets[k] = bw.tell();
+		size32_t t0 = (size32_t)(k / num_cols) * CYCLES_PER_TILE, j0 = (size32_t)(k % num_cols) * SOMAS_PER_TILE;
+		size32_t nt = MIN(CYCLES_PER_TILE, _num_cycles - t0), ns = MIN(SOMAS_PER_TILE, _num_active_somas - j0);
+		for (size32_t t = t0; t < t0 + nt; t++) {
+			for (size32_t j = j0; j < j0 + ns; j++) {
+				float v = voltage_relative(j, t);
+				if (half_precision) {
+					size16_t h = float_to_half(v);
+					bw.put_size8((size8_t)(h >> 8));
+					bw.put_size8((size8_t)h);
+				}
+				else {
+					size32_t x;
+					memcpy(&x, &v, sizeof(x));
+					for (int s = 24; s >= 0; s -= 8) { bw.put_size8((size8_t)(x >> s)); }
+				}
+			}
+		}
+		states.assign((size_t)nt * ns, NOTHING);
+		size8_t format = 0;
+		for (size32_t j = 0; j < ns; j++) {
+			const firings_instance_t &fs = _firings[j0 + j];
+			firings_instance_t::const_iterator it = fs.lower_bound(t0);
+			for (; it != fs.end() && it->first < t0 + nt; ++it) {
+				states[(size_t)(it->first - t0) * ns + j] = (size8_t)it->second;
+				if (it->second > 0xF) { format = 2; }
+				else if (it->second != NOTHING && !format) { format = 1; }
+			}
+		}
+		bw.put_size8(format);
+		if (format == 1) {
+			for (size_t v = 0; v < states.size(); v += 2) {
+				size8_t lo = v + 1 < states.size() ? states[v+1] : 0;
+				bw.put_size8((size8_t)(states[v] << 4 | lo));
+			}
+		}
+		else if (format == 2) {
+			for (size_t v = 0; v < states.size(); v++) { bw.put_size8(states[v]); }
+		}
+		// Update progress
+		if (p && (k + 1) % num_cols == 0) {
+			p->progress((float)(k + 1) / num_tiles);
+			Fl::check();
+			if (p->canceled()) { return false; }
+		}
+	}
+	offsets[num_tiles] = bw.tell();
+	// Fill in the tile offsets
+	bw.seek(offsets_place);
+	for (size_t k = 0; k <= num_tiles; k++) { bw.put_fixed64(offsets[k]); }
+	return bw.close();
+}
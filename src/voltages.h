@@ -9,11 +9,16 @@
 typedef std::map<size32_t, Firing_State> firings_instance_t;
 
 class Input_Parser;
+class Mapped_File;
+class Binary_Writer;
 class Progress_Dialog;
 
 class Voltages : public virtual Sim_Data {
 private:
 	static const firings_instance_t NO_FIRINGS;
+	static const size32_t CYCLES_PER_TILE = 256;
+	static const size32_t SOMAS_PER_TILE = 256;
+	static const float MIN_VOLTAGE, MAX_VOLTAGE;
 private:
 	size32_t _num_active_somas;
 	size32_t *_active_somas;
@@ -31,12 +36,16 @@ public:
 	inline float voltage(size32_t index, size32_t t) const { return voltage_relative(active_soma_relative_index(index), t); }
 	inline float voltage_relative(size32_t i) const { return voltage_relative(i, _time); }
 	inline float voltage_relative(size32_t i, size32_t t) const { return _voltages[_num_active_somas * t + i]; }
+	// Colors the active somas in relative index order, three floats each
+	void active_colors(float *cv) const;
 	inline const firings_instance_t &firings(size32_t index) const { return firings_relative(active_soma_relative_index(index)); }
 	const firings_instance_t &firings_relative(size32_t i) const;
 	virtual float scale(float v) const;
 	virtual float quantity(float s) const;
 	virtual void color(size32_t index, const Soma_Type *t, float *cv, bool invert) const;
 	Read_Status read_from(Input_Parser &ip, Progress_Dialog *p);
+	Read_Status read_from(const Mapped_File &mf, Progress_Dialog *p);
+	bool write_to(Binary_Writer &bw, bool half_precision, Progress_Dialog *p) const;
 };
 
 #endif
@@ -1,6 +1,8 @@
 #include <cmath>
 #include <map>
 #include <utility>
+#include <vector>
+#include <limits>
 
 #pragma warning(push, 0)
 #include <FL/Fl.H>
@@ -12,13 +14,20 @@
 #include "color.h"
 #include "color-maps.h"
 #include "input-parser.h"
+#include "binary-parser.h"
+#include "binary-writer.h"
 #include "progress-dialog.h"
 #include "brain-model.h"
+#include "parallel.h"
 #include "weights.h"
 
+const float Weights::MIN_WEIGHT = -163.84f;
+const float Weights::MAX_WEIGHT = 163.83f;
+
 Weights::Weights(const Brain_Model *bm, size32_t nc) : Sim_Data(bm, new Opposed_Map()), _weights(NULL),
 	_center(0.0f), _spread(0.0f) {
 	_num_cycles = nc;
+	bake_scale(MIN_WEIGHT, MAX_WEIGHT);
 }
 
 Weights::~Weights() {
@@ -104,14 +113,29 @@ void Weights::color(size32_t, const Soma_Type *t, float *cv, bool) const {
 }
 
 void Weights::synapse_color(size32_t index, float *cv, bool after) const {
-	float w = after ? weight_after(index) : weight_before(index);
-	float s = scale(w);
-	_color_map->map(s, cv);
+	map_color(after ? weight_after(index) : weight_before(index), cv);
+}
+
+void Weights::synapse_colors(float *cv, bool after) const {
+	// Gather a block of weights at a time, then map them all to colors
+	const weights_instance_t &wcs = weight_changes();
+	float w[BATCH_SIZE];
+	size_t k = 0;
+	for (weights_instance_t::const_iterator ys = wcs.begin(); ys != wcs.end(); ++ys) {
+		w[k++] = (after ? ys->second.second : ys->second.first) / 100.0f;
+		if (k == BATCH_SIZE) {
+			map_colors(w, k, cv);
+			cv += k * 3;
+			k = 0;
+		}
+	}
+	if (k) { map_colors(w, k, cv); }
 }
 
 void Weights::rescale(float min_w, float max_w) {
 	if (max_w <= min_w) {
 		_center = _spread = 0.0f;
+		bake_scale(MIN_WEIGHT, MAX_WEIGHT);
 		return;
 	}
 	_center = floor((min_w + max_w) / 2.0f + 0.5f);
@@ -122,10 +146,10 @@ void Weights::rescale(float min_w, float max_w) {
 		if (range <= quantity(0.95f) - _center) { break; }
 	}
 	if (_spread > 2.0f) { _spread = 2.0f; }
+	bake_scale(MIN_WEIGHT, MAX_WEIGHT);
 }
 
-Read_Status Weights::read_from(Input_Parser &ip, Progress_Dialog *p) {
-	size_t denom = 1;
+Read_Status Weights::read_from(Input_Parser &ip, Progress_Dialog *p, bool prunings) {
 	// Get the file name and size
 	_filename = ip.filename();
 	_filesize = ip.filesize();
@@ -142,13 +166,9 @@ Read_Status Weights::read_from(Input_Parser &ip, Progress_Dialog *p) {
 	delete [] _weights;
 	_weights = new(std::nothrow) weights_instance_t[_num_cycles]();
 	if (_weights == NULL) { return NO_MEMORY; }
-	// Approximate number of changes (assuming 40 characters per line)
-	size_t approx_num_changes = ip.filesize() / 40;
 	// Prepare to show weight-parsing progress
 	if (p) {
-		denom = approx_num_changes / Progress_Dialog::PROGRESS_STEPS;
-		if (!denom) { denom = 1; }
-		p->message("Parsing weights...");
+		p->message(prunings ? "Parsing prunings..." : "Parsing weights...");
 		p->progress(0.0f);
 		Fl::check();
 		if (p->canceled()) { return CANCELED; }
@@ -157,27 +177,25 @@ Read_Status Weights::read_from(Input_Parser &ip, Progress_Dialog *p) {
 	int16_t min_w = (std::numeric_limits<int16_t>::max)();
 	int16_t max_w = (std::numeric_limits<int16_t>::min)();
 	// Get each weight change
-	size_t num_weights = 0;
 	for (size_t i = 0; ip.good() && !ip.done(); i++) {
 		// A line defining a weight change is formatted as:
 		//     cycle_id synapse_init_index axon_id den_id synapse_runsim_id weight_before weight_after
 		size16_t t = ip.get_size16();
 		size32_t y_index = ip.get_size32();
-		ip.get_size32(); // axonal soma ID
-		ip.get_size32(); // dendritic soma ID
-		ip.get_size32(); // RUNSIM synapse ID
+		ip.skip_field(); // axonal soma ID
+		ip.skip_field(); // dendritic soma ID
+		ip.skip_field(); // RUNSIM synapse ID
 		int16_t w_before = ip.get_int16();
 		int16_t w_after = ip.get_int16();
 		_weights[t][y_index] = std::make_pair(w_before, w_after);
-		num_weights++;
 		// Keep track of weight range
 		if (w_before < min_w) { min_w = w_before; }
 		if (w_before > max_w) { max_w = w_before; }
 		if (w_after < min_w) { min_w = w_after; }
 		if (w_after > max_w) { max_w = w_after; }
-		// Update progress
-		if (p && !((i + 1) % denom)) {
-			p->progress((float)(i + 1) / approx_num_changes);
+		// Update progress by how much of the file has been read
+		if (p && !((i + 1) % CHANGES_PER_PROGRESS) && _filesize) {
+			p->progress((float)ip.position() / _filesize);
 			Fl::check();
 			if (p->canceled()) { return CANCELED; }
 		}
@@ -191,64 +209,130 @@ Read_Status Weights::read_from(Input_Parser &ip, Progress_Dialog *p) {
 	return SUCCESS;
 }
 
-Read_Status Weights::read_prunings_from(Input_Parser &ip, Progress_Dialog *p) {
-	size_t denom = 1;
+// A binary weights file is formatted as:
+//     signature "\aRJW\xF7", version byte, comment string, num_somas, num_synapses, num_cycles, num_changes,
+//     cycles_per_chunk, num_chunks + 1 fixed-size chunk offsets, chunks
+// Each chunk holds cycles_per_chunk cycles, and each cycle is formatted as:
+//     num_changes synapse_index_delta_1 weight_before_1 weight_after_1 ... synapse_index_delta_n weight_before_n
+//     weight_after_n
+// where the synapse indices ascend and each is stored as the difference from the previous one.
+
+Read_Status Weights::read_chunk(const unsigned char *data, size_t n, size32_t t0, size32_t t1, int16_t &min_w,
+	int16_t &max_w) {
+	Buffer_Binary_Parser bbp(data, n);
+	size32_t ny = _model->num_synapses();
+	for (size32_t t = t0; t < t1; t++) {
+		weights_instance_t &wc = _weights[t];
+		size64_t num_changes = bbp.get_unsigned();
+		if (bbp.overrun()) { return END_OF_FILE; }
+		if (num_changes > ny) { return FAILURE; }
+		size64_t y_index = 0;
+		for (size_t j = 0; j < num_changes; j++) {
+			y_index += bbp.get_unsigned();
+			if (y_index >= ny) { return BAD_SYNAPSE_INDEX; }
+			int16_t w_before = bbp.get_int16();
+			int16_t w_after = bbp.get_int16();
+			// The indices ascend, so each insertion goes at the end
+			wc.insert(wc.end(), std::make_pair((size32_t)y_index, std::make_pair(w_before, w_after)));
+			// Keep track of weight range
+			if (w_before < min_w) { min_w = w_before; }
+			if (w_before > max_w) { max_w = w_before; }
+			if (w_after < min_w) { min_w = w_after; }
+			if (w_after > max_w) { max_w = w_after; }
+		}
+		if (bbp.overrun()) { return END_OF_FILE; }
+	}
+	return SUCCESS;
+}
+
+Read_Status Weights::read_from(Binary_Parser &bp, Progress_Dialog *p, bool prunings) {
 	// Get the file name and size
-	_filename = ip.filename();
-	_filesize = ip.filesize();
+	_filename = bp.filename();
+	_filesize = bp.filesize();
+	// Get the file signature
+	char sig[5];
+	bp.get_chars(5, sig);
+	if (sig[0] != '\a' || sig[1] != 'R' || sig[2] != 'J' || sig[3] != 'W' || sig[4] != '\xF7') {
+		return BAD_SIGNATURE;
+	}
+	// Get the file format version
+	size8_t version = bp.get_size8();
+	if (version != 1) { return BAD_VERSION; }
+	// Get the comment
+	bp.get_string();
 	// Get the total number of somas
-	size32_t somas_in_model = ip.get_size32();
+	size32_t somas_in_model = bp.get_size32();
 	if (somas_in_model != num_somas()) { return WRONG_NUM_SOMAS; }
 	// Get the total number of synapses
-	size32_t synapses_in_model = ip.get_size32();
+	size32_t synapses_in_model = bp.get_size32();
 	if (synapses_in_model != _model->num_synapses()) { return WRONG_NUM_SYNAPSES; }
 	// Get the number of cycles
-	size32_t cycles_in_data = ip.get_size32();
+	size32_t cycles_in_data = bp.get_size32();
 	if (cycles_in_data != _num_cycles) { return WRONG_NUM_CYCLES; }
-	// Approximate number of changes (assuming 40 characters per line)
-	size_t approx_num_changes = ip.filesize() / 40;
+	// Get the number of weight changes
+	size64_t num_changes = bp.get_size64();
+	// Get the chunk offsets
+	size32_t cycles_per_chunk = bp.get_size32();
+	if (!cycles_per_chunk || !_num_cycles) { return FAILURE; }
+	size32_t num_chunks = (_num_cycles - 1) / cycles_per_chunk + 1;
+	std::vector<size64_t> offsets(num_chunks + 1);
+	for (size32_t c = 0; c <= num_chunks; c++) {
+		offsets[c] = bp.get_fixed64();
+		if (c && offsets[c] < offsets[c-1]) { return FAILURE; }
+	}
+	if (bp.done() && offsets[num_chunks] > offsets[0]) { return END_OF_FILE; }
 	// Prepare to show weight-parsing progress
 	if (p) {
-		denom = approx_num_changes / Progress_Dialog::PROGRESS_STEPS;
-		if (!denom) { denom = 1; }
-		p->message("Parsing prunings...");
+		p->message(prunings ? "Parsing prunings..." : "Parsing weights...");
 		p->progress(0.0f);
 		Fl::check();
 		if (p->canceled()) { return CANCELED; }
 	}
-	// Get each weight change
-	for (size_t i = 0; ip.good() && !ip.done(); i++) {
-		// A line defining a weight change is formatted as:
-		//     cycle_id synapse_init_index axon_id den_id synapse_runsim_id weight_before weight_after
-		size16_t t = ip.get_size16();
-		size32_t y_index = ip.get_size32();
-		ip.get_size32(); // axonal soma ID
-		ip.get_size32(); // dendritic soma ID
-		ip.get_size32(); // RUNSIM synapse ID
-		int16_t w_before = ip.get_int16();
-		int16_t w_after = ip.get_int16();
-		if (_weights[t].find(y_index) == _weights[t].end()) {
-			if (_weights[t][y_index].first == w_after) {
-				_weights[t][y_index].first = w_before;
-			}
-			else if (_weights[t][y_index].second == w_before) {
-				_weights[t][y_index].second = w_after;
-			}
-			else {
-				_weights[t][y_index].first = w_before;
-				_weights[t][y_index].second = w_after;
-			}
+	// Initialize the array of weight changes
+	delete [] _weights;
+	_weights = new(std::nothrow) weights_instance_t[_num_cycles]();
+	if (_weights == NULL) { return NO_MEMORY; }
+	// Read the chunks in batches, and parse each batch's chunks in parallel, each with its own weight range
+	size32_t batch_size = (size32_t)num_threads() * 2;
+	std::vector<std::vector<unsigned char> > batch(batch_size);
+	std::vector<Read_Status> statuses(batch_size);
+	std::vector<int16_t> min_ws(batch_size), max_ws(batch_size);
+	int16_t min_w = (std::numeric_limits<int16_t>::max)();
+	int16_t max_w = (std::numeric_limits<int16_t>::min)();
+	size64_t num_read = 0;
+	for (size32_t c0 = 0; c0 < num_chunks; c0 += batch_size) {
+		size32_t nb = MIN(batch_size, num_chunks - c0);
+		for (size32_t b = 0; b < nb; b++) {
+			size_t n = (size_t)(offsets[c0+b+1] - offsets[c0+b]);
+			batch[b].resize(n);
+			if (n && bp.get_bytes(n, &batch[b][0]) < n) { return END_OF_FILE; }
 		}
-		else {
-			_weights[t][y_index] = std::make_pair(w_before, w_after);
+		parallel_chunks(nb, nb, [&](size_t begin, size_t end, size_t) {
+			for (size_t b = begin; b < end; b++) {
+				size32_t c = c0 + (size32_t)b;
+				size32_t t0 = c * cycles_per_chunk, t1 = MIN(t0 + cycles_per_chunk, _num_cycles);
+				const std::vector<unsigned char> &data = batch[b];
+				min_ws[b] = (std::numeric_limits<int16_t>::max)();
+				max_ws[b] = (std::numeric_limits<int16_t>::min)();
+				statuses[b] = read_chunk(data.empty() ? NULL : &data[0], data.size(), t0, t1, min_ws[b], max_ws[b]);
+			}
+		});
+		for (size32_t b = 0; b < nb; b++) {
+			if (statuses[b] != SUCCESS) { return statuses[b]; }
+			if (min_ws[b] < min_w) { min_w = min_ws[b]; }
+			if (max_ws[b] > max_w) { max_w = max_ws[b]; }
+			size32_t t0 = (c0 + b) * cycles_per_chunk, t1 = MIN(t0 + cycles_per_chunk, _num_cycles);
+			for (size32_t t = t0; t < t1; t++) { num_read += _weights[t].size(); }
 		}
-		// Update progress
-		if (p && !((i + 1) % denom)) {
-			p->progress((float)(i + 1) / approx_num_changes);
+		// Update progress by the number of weight changes read
+		if (p && num_changes) {
+			p->progress((float)((double)num_read / num_changes));
 			Fl::check();
 			if (p->canceled()) { return CANCELED; }
 		}
 	}
+	if (num_read != num_changes) { return FAILURE; }
+	rescale(min_w / 100.0f, max_w / 100.0f);
 	if (p) {
 		p->progress(1.0f);
 		Fl::check();
@@ -256,3 +340,70 @@ Read_Status Weights::read_prunings_from(Input_Parser &ip, Progress_Dialog *p) {
 	}
 	return SUCCESS;
 }
+
+bool Weights::write_to(Binary_Writer &bw, Progress_Dialog *p, bool prunings) const {
+	if (_weights == NULL || !_num_cycles || !bw.good()) { return false; }
+	size_t denom = 1;
+	size64_t num_changes = 0;
+	for (size32_t t = 0; t < _num_cycles; t++) { num_changes += _weights[t].size(); }
+	// Write the header
+	bw.put_chars(5, "\aRJW\xF7");
+	bw.put_size8(1);
+	bw.put_string("Converted from " + _filename);
+	bw.put_unsigned(num_somas());
+	bw.put_unsigned(_model->num_synapses());
+	bw.put_unsigned(_num_cycles);
+	bw.put_unsigned(num_changes);
+	bw.put_unsigned(CYCLES_PER_CHUNK);
+	// Reserve space for the chunk offsets, to be filled in after the chunks are written
+	size32_t num_chunks = (_num_cycles - 1) / CYCLES_PER_CHUNK + 1;
+	std::vector<size64_t> offsets(num_chunks + 1);
+	size64_t offsets_place = bw.tell();
+	for (size32_t c = 0; c <= num_chunks; c++) { bw.put_fixed64(0); }
+	// Prepare to show weight-writing progress
+	if (p) {
+		denom = _num_cycles / Progress_Dialog::PROGRESS_STEPS;
+		if (!denom) { denom = 1; }
+		p->message(prunings ? "Caching prunings..." : "Caching weights...");
+		p->progress(0.0f);
+		Fl::check();
+		if (p->canceled()) { return false; }
+	}
+	// Write each cycle
+	for (size32_t t = 0; t < _num_cycles; t++) {
+		if (!(t % CYCLES_PER_CHUNK)) { offsets[t / CYCLES_PER_CHUNK] = bw.tell(); }
+		const weights_instance_t &wc = _weights[t];
+		bw.put_unsigned(wc.size());
+		size32_t prev_index = 0;
+		for (weights_instance_t::const_iterator it = wc.begin(); it != wc.end(); ++it) {
+			bw.put_unsigned(it->first - prev_index);
+			bw.put_signed(it->second.first);
+			bw.put_signed(it->second.second);
+			prev_index = it->first;
+		}
+		// Update progress
+		if (p && !((t + 1) % denom)) {
+			p->progress((float)(t + 1) / _num_cycles);
+			Fl::check();
+			if (p->canceled()) { return false; }
+		}
+	}
+	offsets[num_chunks] = bw.tell();
+	// Fill in the chunk offsets
+	bw.seek(offsets_place);
+	for (size32_t c = 0; c <= num_chunks; c++) { bw.put_fixed64(offsets[c]); }
+	return bw.close();
+}
+
+void Weights::add_prunings(const Weights &pw) {
+	// Each pruning replaces any weight change to the same synapse in the same cycle
+	size32_t nc = MIN(_num_cycles, pw._num_cycles);
+	parallel_chunks(nc, num_chunks(nc, 64), [&](size_t begin, size_t end, size_t) {
+		for (size_t t = begin; t < end; t++) {
+			const weights_instance_t &pc = pw._weights[t];
+			for (weights_instance_t::const_iterator it = pc.begin(); it != pc.end(); ++it) {
+				_weights[t][it->first] = it->second;
+			}
+		}
+	});
+}
@@ -7,8 +7,14 @@ typedef std::pair<int16_t, int16_t> weight_pair_t;
 typedef std::map<size32_t, weight_pair_t> weights_instance_t;
 
 class Input_Parser;
+class Binary_Parser;
+class Binary_Writer;
 
 class Weights : public virtual Sim_Data {
+private:
+	static const size32_t CYCLES_PER_CHUNK = 100;
+	static const size_t CHANGES_PER_PROGRESS = 4096;
+	static const float MIN_WEIGHT, MAX_WEIGHT;
 private:
 	weights_instance_t *_weights;
 	float _center, _spread;
@@ -16,9 +22,9 @@ public:
 	Weights(const Brain_Model *bm, size32_t nc);
 	~Weights();
 	inline float center(void) const { return _center; }
-	inline void center(float c) { _center = c; }
+	inline void center(float c) { _center = c; bake_scale(MIN_WEIGHT, MAX_WEIGHT); }
 	inline float spread(void) const { return _spread; }
-	inline void spread(float s) { _spread = s; }
+	inline void spread(float s) { _spread = s; bake_scale(MIN_WEIGHT, MAX_WEIGHT); }
 	inline const weights_instance_t &weight_changes(void) const { return _weights[_time]; }
 	size32_t prev_change_time(void) const;
 	size32_t prev_change_time(size32_t index) const;
@@ -27,13 +33,20 @@ public:
 	inline virtual bool active(size32_t) const { return true; }
 	inline float weight_before(size32_t index) const { return weights(index).first / 100.0f; }
 	inline float weight_after(size32_t index) const { return weights(index).second / 100.0f; }
+	// Colors the synapses whose weights change at the current time in weight_changes() order, three floats each
+	void synapse_colors(float *cv, bool after) const;
 	virtual void color(size32_t index, const Soma_Type *t, float *cv, bool invert) const;
 	virtual float scale(float w) const;
 	virtual float quantity(float s) const;
 	void synapse_color(size32_t index, float *cv, bool after) const;
-	Read_Status read_from(Input_Parser &ip, Progress_Dialog *p);
-	Read_Status read_prunings_from(Input_Parser &ip, Progress_Dialog *p);
+	// Prunings are in the same format as weights, and only their progress messages differ
+	Read_Status read_from(Input_Parser &ip, Progress_Dialog *p, bool prunings = false);
+	Read_Status read_from(Binary_Parser &bp, Progress_Dialog *p, bool prunings = false);
+	bool write_to(Binary_Writer &bw, Progress_Dialog *p, bool prunings = false) const;
+	void add_prunings(const Weights &pw);
 private:
+	Read_Status read_chunk(const unsigned char *data, size_t n, size32_t t0, size32_t t1, int16_t &min_w,
+		int16_t &max_w);
 	inline const weight_pair_t weights(size32_t index) const { return _weights[_time].find(index)->second; }
 	void rescale(float min_w, float max_w);
 };